@@ -0,0 +1,254 @@
+//Generated code benchmark: runs each kernel as built by this compiler and by gcc -O0 and -O2, counting cycles and instructions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+#define DEFAULT_RUNS 5
+#define NUM_BUILDS 3
+#define LEN_PATH 4097
+
+//Builds of each kernel, the binary being <kernel>.<suffix>; the first is this compiler's
+char *buildSuffixes[NUM_BUILDS] = {"comp", "O0", "O2"};
+
+//Counts of one run of a binary
+typedef struct counts_t {
+  uint64_t cycles;
+  uint64_t instructions;
+  int status;
+} counts_t;
+
+//Median counts of each build of a kernel
+typedef struct kernelresult_t {
+  const char *kernel;
+  counts_t builds[NUM_BUILDS];
+  int mismatch;
+} kernelresult_t;
+
+//Whether cycles and instructions come from perf_event_open, or cycles from rdtsc around the whole process
+int usePerf = 1;
+
+/**
+ * openCounter(pid_t pid, uint64_t config)
+ * Opens a hardware counter of a process's user space, counting from its exec.
+ *
+ * param pid - the process
+ * param config - the counter, PERF_COUNT_HW_*
+ * return int - returns the counter's file descriptor, or -1 if counters are unavailable
+ **/
+int openCounter(pid_t pid, uint64_t config){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+/**
+ * readCounter(int fd)
+ * Reads and closes a counter.
+ *
+ * param fd - the counter's file descriptor, -1 for none
+ * return uint64_t - returns the count, 0 without a counter
+ **/
+uint64_t readCounter(int fd){
+  uint64_t count = 0;
+  if(fd < 0)
+    return 0;
+  if(read(fd, &count, sizeof(count)) != sizeof(count))
+    count = 0;
+  close(fd);
+  return count;
+}
+
+/**
+ * runOnce(const char *path, counts_t *counts)
+ * Runs a binary once. The child waits on a pipe until its counters are open, so they only count
+ * from its exec on. Without perf counters, cycles are TSC ticks around the whole process.
+ *
+ * param *path - the binary
+ * param *counts - set to the run's counts and exit status
+ * return void
+ **/
+void runOnce(const char *path, counts_t *counts){
+  int go[2];
+  if(pipe(go) != 0){
+    fprintf(stderr, "Failed to create a pipe.\n");
+    exit(1);
+  }
+  pid_t pid = fork();
+  if(pid < 0){
+    fprintf(stderr, "Failed to fork.\n");
+    exit(1);
+  }
+  if(pid == 0){
+    char byte;
+    close(go[1]);
+    if(read(go[0], &byte, 1) < 0)
+      _exit(127);
+    execl(path, path, (char *) NULL);
+    _exit(127);
+  }
+  close(go[0]);
+  int cycles = usePerf ? openCounter(pid, PERF_COUNT_HW_CPU_CYCLES) : -1;
+  int instructions = (cycles >= 0) ? openCounter(pid, PERF_COUNT_HW_INSTRUCTIONS) : -1;
+  if(cycles < 0)
+    usePerf = 0;
+  uint64_t start = __rdtsc();
+  close(go[1]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  uint64_t end = __rdtsc();
+  counts->cycles = usePerf ? readCounter(cycles) : end - start;
+  counts->instructions = readCounter(instructions);
+  counts->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  if(counts->status == 127){
+    fprintf(stderr, "Failed to run %s\n", path);
+    exit(1);
+  }
+}
+
+/**
+ * compareCounts(const void *a, const void *b)
+ * Orders runs by cycles, for qsort().
+ *
+ * param *a - the first counts_t
+ * param *b - the second counts_t
+ * return int - returns <0, 0 or >0 as a has fewer, as many or more cycles than b
+ **/
+int compareCounts(const void *a, const void *b){
+  uint64_t x = ((const counts_t *) a)->cycles;
+  uint64_t y = ((const counts_t *) b)->cycles;
+  return (x > y) - (x < y);
+}
+
+/**
+ * measureBuild(const char *path, int runs, counts_t *runCounts, counts_t *median)
+ * Runs a binary several times and keeps the run with the median cycles.
+ *
+ * param *path - the binary
+ * param runs - the number of runs
+ * param *runCounts - space for the counts of each run
+ * param *median - set to the median run
+ * return int - returns 1 if every run exited with the same status, 0 otherwise
+ **/
+int measureBuild(const char *path, int runs, counts_t *runCounts, counts_t *median){
+  int same = 1;
+  int i;
+  for(i = 0; i < runs; i++){
+    runOnce(path, &runCounts[i]);
+    same &= (runCounts[i].status == runCounts[0].status);
+  }
+  qsort(runCounts, runs, sizeof(counts_t), compareCounts);
+  *median = runCounts[runs / 2];
+  return same;
+}
+
+/**
+ * writeJSON(const char *path, const char *label, kernelresult_t *results, int numKernels, int runs)
+ * Saves the results as JSON, for comparing runs across commits.
+ *
+ * param *path - the JSON file
+ * param *label - a name for the run, e.g. the commit
+ * param *results - the results of each kernel
+ * param numKernels - the number of kernels
+ * param runs - the runs of each build
+ * return void
+ **/
+void writeJSON(const char *path, const char *label, kernelresult_t *results, int numKernels, int runs){
+  FILE *out = fopen(path, "w");
+  if(out == NULL){
+    fprintf(stderr, "Failed to open %s for writing.\n", path);
+    exit(1);
+  }
+  fprintf(out, "{\"label\": \"%s\", \"runs\": %d, \"counter\": \"%s\", \"kernels\": [", label, runs,
+          usePerf ? "perf" : "rdtsc");
+  int i, build;
+  for(i = 0; i < numKernels; i++){
+    kernelresult_t *result = &results[i];
+    fprintf(out, "%s\n  {\"kernel\": \"%s\", \"exit\": %d, \"mismatch\": %s, \"builds\": {", (i > 0) ? "," : "",
+            result->kernel, result->builds[0].status, result->mismatch ? "true" : "false");
+    for(build = 0; build < NUM_BUILDS; build++)
+      fprintf(out, "%s\"%s\": {\"cycles\": %llu, \"instructions\": %llu}", (build > 0) ? ", " : "", buildSuffixes[build],
+              (unsigned long long) result->builds[build].cycles, (unsigned long long) result->builds[build].instructions);
+    fprintf(out, "}, \"slowdown_vs_O0\": %.4f, \"slowdown_vs_O2\": %.4f}",
+            (double) result->builds[0].cycles / result->builds[1].cycles,
+            (double) result->builds[0].cycles / result->builds[2].cycles);
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+}
+
+int main(int argc, char *argv[]){
+  int runs = DEFAULT_RUNS;
+  const char *jsonPath = NULL;
+  const char *label = "";
+  int i;
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      runs = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+      label = argv[++i];
+    else
+      break;
+  }
+  if(i == argc || runs < 1){
+    fprintf(stderr, "Usage: %s [-n runs] [-o results.json] [-l label] <kernel>...\n"
+            "  Runs <kernel>.comp (built by this compiler), <kernel>.O0 and <kernel>.O2 (built by gcc)\n", argv[0]);
+    exit(1);
+  }
+  int numKernels = argc - i;
+  kernelresult_t *results = (kernelresult_t *) calloc(numKernels, sizeof(kernelresult_t));
+  counts_t *runCounts = (counts_t *) calloc(runs, sizeof(counts_t));
+  if(results == NULL || runCounts == NULL){
+    fprintf(stderr, "Failed to allocate space for results.\n");
+    exit(1);
+  }
+  int mismatches = 0;
+  int kernel, build;
+  for(kernel = 0; kernel < numKernels; kernel++){
+    kernelresult_t *result = &results[kernel];
+    result->kernel = argv[i + kernel];
+    for(build = 0; build < NUM_BUILDS; build++){
+      char path[LEN_PATH];
+      snprintf(path, LEN_PATH, "%s.%s", result->kernel, buildSuffixes[build]);
+      if(!measureBuild(path, runs, runCounts, &result->builds[build])
+         || result->builds[build].status != result->builds[0].status)
+        result->mismatch = 1;
+    }
+    mismatches += result->mismatch;
+  }
+  printf("%s, median of %d runs\n", usePerf ? "User space cycles and instructions (perf)" : "TSC ticks per process (rdtsc)", runs);
+  printf("%-20s %5s %14s %14s %14s %14s %14s %14s %7s %7s\n", "kernel", "exit", "cycles", "O0 cycles", "O2 cycles",
+         "instrs", "O0 instrs", "O2 instrs", "vs O0", "vs O2");
+  for(kernel = 0; kernel < numKernels; kernel++){
+    kernelresult_t *result = &results[kernel];
+    const char *name = strrchr(result->kernel, '/');
+    printf("%-20s %5d", (name == NULL) ? result->kernel : name + 1, result->builds[0].status);
+    for(build = 0; build < NUM_BUILDS; build++)
+      printf(" %14llu", (unsigned long long) result->builds[build].cycles);
+    for(build = 0; build < NUM_BUILDS; build++){
+      if(usePerf)
+        printf(" %14llu", (unsigned long long) result->builds[build].instructions);
+      else
+        printf(" %14s", "-");
+    }
+    printf(" %6.2fx %6.2fx%s\n", (double) result->builds[0].cycles / result->builds[1].cycles,
+           (double) result->builds[0].cycles / result->builds[2].cycles, result->mismatch ? "  EXIT STATUS MISMATCH" : "");
+  }
+  if(jsonPath != NULL)
+    writeJSON(jsonPath, label, results, numKernels, runs);
+  return (mismatches > 0) ? 1 : 0;
+}
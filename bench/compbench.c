@@ -0,0 +1,211 @@
+//Compile throughput benchmark: times lexing, parsing, optimizing and code generation separately over source files
+#include "../src/lex.h"
+#include "../src/parse.h"
+#include "../src/gen.h"
+#include "../src/scan.h"
+#include "../src/opt.h"
+#include "../src/pp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+char sourcePath[LEN_PATH];
+char outPath[LEN_PATH];
+
+#define DEFAULT_ITERATIONS 10
+#define NUM_PHASES 4
+
+typedef enum PHASE {LEX, PARSE, OPTIMIZE, GENERATE} PHASE;
+
+char *phaseNames[NUM_PHASES] = {"lex", "parse", "optimize", "generate"};
+
+//Timings of one source file, in seconds per iteration of each phase
+typedef struct fileresult_t {
+  const char *path;
+  size_t bytes;
+  uint64_t numTokens;
+  double *times[NUM_PHASES];
+} fileresult_t;
+
+/**
+ * nowSeconds()
+ * Returns a monotonic timestamp in seconds.
+ *
+ * return double - returns the current time
+ **/
+double nowSeconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * meanTime(double *times, int n)
+ * Returns the mean of n timings.
+ *
+ * param *times - the timings
+ * param n - the number of timings
+ * return double - returns the mean
+ **/
+double meanTime(double *times, int n){
+  double sum = 0;
+  int i;
+  for(i = 0; i < n; i++)
+    sum += times[i];
+  return sum / n;
+}
+
+/**
+ * stddevTime(double *times, int n)
+ * Returns the sample standard deviation of n timings (0 for a single one).
+ *
+ * param *times - the timings
+ * param n - the number of timings
+ * return double - returns the standard deviation
+ **/
+double stddevTime(double *times, int n){
+  if(n < 2)
+    return 0;
+  double mean = meanTime(times, n);
+  double sum = 0;
+  int i;
+  for(i = 0; i < n; i++)
+    sum += (times[i] - mean) * (times[i] - mean);
+  return sqrt(sum / (n - 1));
+}
+
+/**
+ * compileOnce(fileresult_t *result, int iteration, FILE *sink)
+ * Compiles the source file once, the way the compiler does without options, recording the time
+ * of each phase. Parsing includes preprocessing and checking calls.
+ *
+ * param *result - the file's results
+ * param iteration - the slot to record the times in, -1 for a warm up run
+ * param *sink - where the assembly is written
+ * return void
+ **/
+void compileOnce(fileresult_t *result, int iteration, FILE *sink){
+  double start = nowSeconds();
+  tokenlist_t *tokens = lexParallel(1);
+  double lexed = nowSeconds();
+  forgetFunctions();
+  preprocess(tokens);
+  astnode_t *progAST = parseProgram(tokens);
+  freePreprocessor(tokens);
+  checkCalls(progAST);
+  double parsed = nowSeconds();
+  optimize(progAST);
+  double optimized = nowSeconds();
+  generate(progAST, sink);
+  fflush(sink);
+  double generated = nowSeconds();
+  result->numTokens = tokens->numTokens;
+  freeTokens(tokens);
+  if(iteration < 0)
+    return;
+  result->times[LEX][iteration] = lexed - start;
+  result->times[PARSE][iteration] = parsed - lexed;
+  result->times[OPTIMIZE][iteration] = optimized - parsed;
+  result->times[GENERATE][iteration] = generated - optimized;
+}
+
+/**
+ * writeJSON(const char *path, const char *label, fileresult_t *results, int numFiles, int iterations)
+ * Saves the results as JSON, for comparing runs across commits.
+ *
+ * param *path - the JSON file
+ * param *label - a name for the run, e.g. the commit
+ * param *results - the results of each file
+ * param numFiles - the number of files
+ * param iterations - the timed iterations of each file
+ * return void
+ **/
+void writeJSON(const char *path, const char *label, fileresult_t *results, int numFiles, int iterations){
+  FILE *out = fopen(path, "w");
+  if(out == NULL){
+    fprintf(stderr, "Failed to open %s for writing.\n", path);
+    exit(1);
+  }
+  fprintf(out, "{\"label\": \"%s\", \"iterations\": %d, \"files\": [", label, iterations);
+  int i, phase;
+  for(i = 0; i < numFiles; i++){
+    fileresult_t *result = &results[i];
+    fprintf(out, "%s\n  {\"file\": \"%s\", \"bytes\": %zu, \"tokens\": %llu, \"phases\": {", (i > 0) ? "," : "",
+            result->path, result->bytes, (unsigned long long) result->numTokens);
+    for(phase = 0; phase < NUM_PHASES; phase++){
+      double mean = meanTime(result->times[phase], iterations);
+      fprintf(out, "%s\"%s\": {\"mean_s\": %.6g, \"stddev_s\": %.6g, \"mb_per_s\": %.6g, \"tokens_per_s\": %.6g}",
+              (phase > 0) ? ", " : "", phaseNames[phase], mean, stddevTime(result->times[phase], iterations),
+              result->bytes / 1e6 / mean, result->numTokens / mean);
+    }
+    fprintf(out, "}}");
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+}
+
+int main(int argc, char *argv[]){
+  int iterations = DEFAULT_ITERATIONS;
+  const char *jsonPath = NULL;
+  const char *label = "";
+  int i;
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      iterations = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+      label = argv[++i];
+    else
+      break;
+  }
+  if(i == argc || iterations < 1){
+    fprintf(stderr, "Usage: %s [-n iterations] [-o results.json] [-l label] <source file>...\n", argv[0]);
+    exit(1);
+  }
+  initScan(SCAN_AUTO);
+  FILE *sink = fopen("/dev/null", "w");
+  int numFiles = argc - i;
+  fileresult_t *results = (fileresult_t *) calloc(numFiles, sizeof(fileresult_t));
+  if(sink == NULL || results == NULL){
+    fprintf(stderr, "Failed to set up the benchmark.\n");
+    exit(1);
+  }
+  printf("%-24s %-9s %10s %12s %12s %9s\n", "file", "phase", "mean (ms)", "MB/s", "Mtokens/s", "stddev");
+  int file, phase;
+  for(file = 0; file < numFiles; file++){
+    fileresult_t *result = &results[file];
+    result->path = argv[i + file];
+    strncpy(sourcePath, result->path, LEN_PATH-1);
+    struct stat sourceStat;
+    if(stat(sourcePath, &sourceStat) != 0){
+      fprintf(stderr, "Failed to stat %s\n", sourcePath);
+      exit(1);
+    }
+    result->bytes = sourceStat.st_size;
+    for(phase = 0; phase < NUM_PHASES; phase++){
+      result->times[phase] = (double *) calloc(iterations, sizeof(double));
+      if(result->times[phase] == NULL){
+        fprintf(stderr, "Failed to allocate space for timings.\n");
+        exit(1);
+      }
+    }
+    int iteration;
+    for(iteration = -1; iteration < iterations; iteration++)
+      compileOnce(result, iteration, sink);
+    for(phase = 0; phase < NUM_PHASES; phase++){
+      double mean = meanTime(result->times[phase], iterations);
+      printf("%-24s %-9s %10.3f %12.1f %12.2f %8.1f%%\n", (phase == 0) ? result->path : "", phaseNames[phase],
+             mean * 1e3, result->bytes / 1e6 / mean, result->numTokens / 1e6 / mean,
+             100 * stddevTime(result->times[phase], iterations) / mean);
+    }
+  }
+  if(jsonPath != NULL)
+    writeJSON(jsonPath, label, results, numFiles, iterations);
+  fclose(sink);
+  return 0;
+}
@@ -0,0 +1,214 @@
+//Synthetic corpus generator for the compile throughput benchmark: writes C source of a given shape and size to stdout
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+//Operands of a wide expression, nesting of a deep function, and length of a long line
+#define WIDE_OPERANDS 64
+#define DEEP_STATEMENTS 24
+#define DEEP_PARENS 48
+#define LONG_LINE 65536
+
+typedef enum SHAPE {WIDE, DEEP, FUNCS, LINES, MIXED, NUM_SHAPES} SHAPE;
+
+char *shapeNames[NUM_SHAPES] = {"wide", "deep", "funcs", "lines", "mixed"};
+
+unsigned seed = 12345;
+size_t written = 0;
+int numFunctions = 0;
+
+/**
+ * nextRandom(unsigned bound)
+ * Returns the next pseudo-random number below bound, the same sequence for the same seed.
+ *
+ * param bound - one past the largest number returned
+ * return unsigned - returns the number
+ **/
+unsigned nextRandom(unsigned bound){
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 16) & 0x7fff) % bound;
+}
+
+/**
+ * put(const char *format, ...)
+ * Writes formatted source to stdout, counting the bytes written.
+ *
+ * param *format - printf style format of the source text
+ * return void
+ **/
+void put(const char *format, ...){
+  va_list args;
+  va_start(args, format);
+  int len = vprintf(format, args);
+  va_end(args);
+  if(len < 0){
+    fprintf(stderr, "Failed to write the corpus.\n");
+    exit(1);
+  }
+  written += len;
+}
+
+/**
+ * putOperand(int numVars)
+ * Writes a random operand: a parameter, one of the first numVars locals, or a literal.
+ *
+ * param numVars - the number of locals x0, x1, ... declared so far
+ * return void
+ **/
+void putOperand(int numVars){
+  unsigned pick = nextRandom(4);
+  if(pick == 0)
+    put("%u", nextRandom(1000));
+  else if(pick == 1 && numVars > 0)
+    put("x%u", nextRandom(numVars));
+  else
+    put("%c", "ab"[nextRandom(2)]);
+}
+
+/**
+ * putWideExpression(int numOperands, int numVars)
+ * Writes a flat expression of numOperands operands joined by random binary operators, with
+ * some parenthesized pairs. Divisors and shift counts are nonzero literals.
+ *
+ * param numOperands - the number of operands
+ * param numVars - the number of locals that may be used
+ * return void
+ **/
+void putWideExpression(int numOperands, int numVars){
+  static char *operators[] = {"+", "-", "*", "&", "|", "^", "<", "==", "!=", ">=", "&&", "||"};
+  int i;
+  putOperand(numVars);
+  for(i = 1; i < numOperands; i++){
+    unsigned pick = nextRandom(16);
+    if(pick == 0)
+      put(" / %u", nextRandom(9) + 1);
+    else if(pick == 1)
+      put(" << %u", nextRandom(8) + 1);
+    else if(pick == 2){
+      put(" + (");
+      putOperand(numVars);
+      put(" %% %u)", nextRandom(9) + 2);
+    }
+    else{
+      put(" %s ", operators[nextRandom(sizeof(operators) / sizeof(operators[0]))]);
+      putOperand(numVars);
+    }
+  }
+}
+
+/**
+ * putWideFunction(const char *lineEnd, int numOperands, int numStatements)
+ * Writes a function of locals initialized with wide expressions. With lineEnd " " and many
+ * statements, the whole function is one very long line.
+ *
+ * param *lineEnd - what separates statements, "\n  " or " "
+ * param numOperands - the operands of each expression
+ * param numStatements - the number of statements
+ * return void
+ **/
+void putWideFunction(const char *lineEnd, int numOperands, int numStatements){
+  int i;
+  put("int f%d(int a, int b){%s", numFunctions++, lineEnd);
+  for(i = 0; i < numStatements; i++){
+    put("int x%d = ", i);
+    putWideExpression(numOperands, i);
+    put(";%s", lineEnd);
+  }
+  put("return x%d;\n}\n\n", numStatements - 1);
+}
+
+/**
+ * putNestedParens(int depth)
+ * Writes an expression nested depth parentheses deep, as in ((((a + 1) * 2) - b) ...).
+ *
+ * param depth - the nesting depth
+ * return void
+ **/
+void putNestedParens(int depth){
+  int i;
+  for(i = 0; i < depth; i++)
+    put("(");
+  put("a");
+  for(i = 0; i < depth; i++)
+    put(" %s %u)", (i % 3 == 0) ? "+" : ((i % 3 == 1) ? "*" : "-"), nextRandom(100) + 1);
+}
+
+/**
+ * putDeepFunction()
+ * Writes a function of if/while/for/switch statements nested DEEP_STATEMENTS deep around a
+ * deeply parenthesized expression.
+ *
+ * return void
+ **/
+void putDeepFunction(){
+  int depth;
+  put("int f%d(int a, int b){\n  int x = b;\n", numFunctions++);
+  for(depth = 0; depth < DEEP_STATEMENTS; depth++){
+    put("%*s", 2*depth + 2, "");
+    switch(nextRandom(4)){
+    case 0: put("if(x < %u){\n", nextRandom(1000)); break;
+    case 1: put("while(x > %u){\n", nextRandom(1000)); break;
+    case 2: put("for(int i%d = 0; i%d < %u; i%d = i%d + 1){\n", depth, depth, nextRandom(10) + 1, depth, depth); break;
+    default: put("switch(x & 3){\n%*scase %u:\n", 2*depth + 2, "", nextRandom(4)); break;
+    }
+  }
+  put("%*sx = x + ", 2*depth + 2, "");
+  putNestedParens(DEEP_PARENS);
+  put(";\n");
+  for(depth = DEEP_STATEMENTS - 1; depth >= 0; depth--)
+    put("%*s}\n", 2*depth + 2, "");
+  put("  return x;\n}\n\n");
+}
+
+/**
+ * putSmallFunction()
+ * Writes a small function calling an earlier one, or itself.
+ *
+ * return void
+ **/
+void putSmallFunction(){
+  int self = numFunctions++;
+  int callee = (self > 0) ? (int) nextRandom(self + 1) : self;
+  put("int f%d(int a, int b){\n  if(a < %u)\n    return b + %d;\n  return f%d(a - %u, b) * %u;\n}\n\n",
+      self, nextRandom(8) + 1, self, callee, nextRandom(3) + 1, nextRandom(5) + 2);
+}
+
+/**
+ * putFunction(SHAPE shape)
+ * Writes one function of the given shape (mixed picks one of the others at random).
+ *
+ * param shape - the shape
+ * return void
+ **/
+void putFunction(SHAPE shape){
+  if(shape == MIXED)
+    shape = (SHAPE) nextRandom(MIXED);
+  switch(shape){
+  case WIDE: putWideFunction("\n  ", WIDE_OPERANDS, 8); break;
+  case DEEP: putDeepFunction(); break;
+  case FUNCS: putSmallFunction(); break;
+  default: putWideFunction(" ", 16, LONG_LINE / 128); break;
+  }
+}
+
+int main(int argc, char *argv[]){
+  if(argc < 3){
+    fprintf(stderr, "Usage: %s <wide|deep|funcs|lines|mixed> <kilobytes> [seed]\n", argv[0]);
+    exit(1);
+  }
+  SHAPE shape;
+  for(shape = 0; shape < NUM_SHAPES && strcmp(argv[1], shapeNames[shape]) != 0; shape++)
+    ;
+  long kilobytes = atol(argv[2]);
+  if(shape == NUM_SHAPES || kilobytes < 1){
+    fprintf(stderr, "Usage: %s <wide|deep|funcs|lines|mixed> <kilobytes> [seed]\n", argv[0]);
+    exit(1);
+  }
+  if(argc > 3)
+    seed = strtoul(argv[3], NULL, 10);
+  while(written < (size_t) kilobytes * 1024)
+    putFunction(shape);
+  put("int main(){\n  return f0(%u, %u) & 255;\n}\n", nextRandom(10), nextRandom(10));
+  return 0;
+}
@@ -0,0 +1,23 @@
+//Kernel: Collatz sequence lengths, a data dependent loop of shifts, adds and branches
+int steps(int n){
+  int count = 0;
+  while(n != 1){
+    if(n & 1)
+      n = 3 * n + 1;
+    else
+      n = n >> 1;
+    count = count + 1;
+  }
+  return count;
+}
+
+int main(){
+  int longest = 0;
+  int total = 0;
+  for(int n = 1; n < 100000; n = n + 1){
+    int s = steps(n);
+    total = total + s;
+    longest = (s > longest) ? s : longest;
+  }
+  return (total ^ longest) & 255;
+}
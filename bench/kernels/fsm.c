@@ -0,0 +1,25 @@
+//Kernel: a switch driven state machine over a generated input, dense cases for jump tables
+int next(int state, int c){
+  switch(state){
+  case 0: return (c < 3) ? 1 : 4;
+  case 1: return (c == 0) ? 2 : 0;
+  case 2: return (c > 5) ? 3 : 1;
+  case 3: return c & 7;
+  case 4: return (c + state) % 6;
+  case 5: return (c & 1) ? 6 : 7;
+  case 6: return 0;
+  default: return (c ^ state) & 3;
+  }
+}
+
+int main(){
+  int state = 0;
+  int seed = 1;
+  int visits = 0;
+  for(int i = 0; i < 10000000; i = i + 1){
+    seed = (seed * 75 + 74) % 65537;
+    state = next(state, seed & 7);
+    visits = visits + (state == 3);
+  }
+  return visits & 255;
+}
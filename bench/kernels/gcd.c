@@ -0,0 +1,17 @@
+//Kernel: Euclid's algorithm over a grid of pairs, bound by division
+int gcd(int a, int b){
+  while(b != 0){
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+int main(){
+  int sum = 0;
+  for(int a = 1; a < 1200; a = a + 1)
+    for(int b = 1; b < 1200; b = b + 1)
+      sum = sum + gcd(a, b);
+  return sum & 255;
+}
@@ -0,0 +1,20 @@
+//Kernel: xorshift and multiplicative hashing, straight-line shifts, masks and xors in a hot loop.
+//Values are masked so that no shift or multiply overflows.
+int mix(int h, int v){
+  h = h ^ v;
+  h = (h & 32767) * 40503 + ((h >> 16) & 32767);
+  h = h ^ ((h >> 13) & 524287);
+  return h & 2147483647;
+}
+
+int main(){
+  int state = 2463534;
+  int h = 0;
+  for(int i = 0; i < 10000000; i = i + 1){
+    state = state ^ ((state & 262143) << 13);
+    state = state ^ (state >> 17);
+    state = (state ^ ((state & 67108863) << 5)) & 2147483647;
+    h = mix(h, state);
+  }
+  return h & 255;
+}
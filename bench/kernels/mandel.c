@@ -0,0 +1,27 @@
+//Kernel: Mandelbrot set iteration counts in 16.16 fixed point, multiply heavy with an inner exit test
+#define ONE 65536
+#define MAX_ITER 200
+
+int escape(int cx, int cy){
+  int x = 0;
+  int y = 0;
+  int i = 0;
+  while(i < MAX_ITER){
+    int xx = (x >> 8) * (x >> 8);
+    int yy = (y >> 8) * (y >> 8);
+    if(xx + yy > 4 * ONE)
+      break;
+    y = 2 * ((x >> 8) * (y >> 8)) + cy;
+    x = xx - yy + cx;
+    i = i + 1;
+  }
+  return i;
+}
+
+int main(){
+  int total = 0;
+  for(int py = 0; py < 200; py = py + 1)
+    for(int px = 0; px < 300; px = px + 1)
+      total = total + escape(px * (3 * ONE / 300) - 2 * ONE, py * (2 * ONE / 200) - ONE);
+  return total & 255;
+}
@@ -0,0 +1,17 @@
+//Kernel: counting primes by trial division, nested loops with early exit
+int isPrime(int n){
+  if(n < 2)
+    return 0;
+  for(int d = 2; d * d <= n; d = d + 1){
+    if(n % d == 0)
+      return 0;
+  }
+  return 1;
+}
+
+int main(){
+  int count = 0;
+  for(int n = 0; n < 2000000; n = n + 1)
+    count = count + isPrime(n);
+  return count & 255;
+}
@@ -0,0 +1,13 @@
+//Kernel: the Takeuchi function, deep non-tail recursion with three arguments
+int tak(int x, int y, int z){
+  if(y < x)
+    return tak(tak(x - 1, y, z), tak(y - 1, z, x), tak(z - 1, x, y));
+  return z;
+}
+
+int main(){
+  int sum = 0;
+  for(int i = 0; i < 30; i = i + 1)
+    sum = sum + tak(18 + i % 3, 12, 6);
+  return sum & 255;
+}
@@ -0,0 +1,64 @@
+//Parallel lexing scaling benchmark: times lexParallel() on 1 to N threads over one source file
+#include "../src/lex.h"
+#include "../src/scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+char sourcePath[LEN_PATH];
+
+#define REPEATS 5
+
+/**
+ * nowSeconds()
+ * Returns a monotonic timestamp in seconds.
+ *
+ * return double - returns the current time
+ **/
+double nowSeconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]){
+  if(argc < 2){
+    fprintf(stderr, "Usage: %s <source file> [max threads]\n", argv[0]);
+    exit(1);
+  }
+  strncpy(sourcePath, argv[1], LEN_PATH-1);
+  initScan(SCAN_AUTO);
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+  struct stat sourceStat;
+  if(stat(sourcePath, &sourceStat) != 0){
+    fprintf(stderr, "Failed to stat %s\n", sourcePath);
+    exit(1);
+  }
+  double megabytes = sourceStat.st_size / 1e6;
+  double baseTime = 0;
+  int threads;
+  printf("%-8s %-12s %-10s %-12s %s\n", "threads", "best (s)", "MB/s", "tokens", "speedup");
+  for(threads = 1; threads <= maxThreads; threads++){
+    double best = 0;
+    uint64_t numTokens = 0;
+    int i;
+    for(i = 0; i < REPEATS; i++){
+      double start = nowSeconds();
+      tokenlist_t *tokens = lexParallel(threads);
+      double elapsed = nowSeconds() - start;
+      numTokens = tokens->numTokens;
+      freeTokens(tokens);
+      if(i == 0 || elapsed < best)
+        best = elapsed;
+    }
+    if(threads == 1)
+      baseTime = best;
+    printf("%-8d %-12.4f %-10.1f %-12llu %.2fx\n", threads, best, megabytes / best,
+           (unsigned long long) numTokens, baseTime / best);
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+//Lexer scanner microbenchmark: compares the scalar, SSE2 and AVX2 scanners on synthetic source
+#include "../src/scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SIZE (32 << 20)
+#define REPEATS 5
+
+
+/**
+ * nowSeconds()
+ * Returns a monotonic timestamp in seconds.
+ *
+ * return double - returns the current time
+ **/
+double nowSeconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * fillSource(char *buf, size_t len, int indent)
+ * Fills buf with generated expression source: indented lines of identifiers, literals and operators.
+ *
+ * param *buf - the buffer to fill
+ * param len - the size of the buffer
+ * param indent - the number of spaces each line is indented by
+ * return void
+ **/
+void fillSource(char *buf, size_t len, int indent){
+  static char *words[] = {"value", "x", "counter_1", "42", "1000000", "+", "*", "<<", "(", ")", "==", "return", "tmp"};
+  size_t pos = 0;
+  unsigned seed = 12345;
+  while(pos < len){
+    int i;
+    for(i = 0; i < indent && pos < len; i++)
+      buf[pos++] = ' ';
+    for(i = 0; i < 8 && pos < len; i++){
+      seed = seed * 1103515245 + 12345;
+      char *word = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+      size_t wordLen = strlen(word);
+      if(pos + wordLen + 1 > len)
+        break;
+      memcpy(&buf[pos], word, wordLen);
+      pos += wordLen;
+      buf[pos++] = ' ';
+    }
+    if(pos < len)
+      buf[pos++] = '\n';
+  }
+}
+
+/**
+ * scanAll(const char *buf, size_t len, int *newlines)
+ * Splits the buffer into whitespace, identifier/literal runs and single operator characters,
+ * the way lexToken() does, with the selected scanner.
+ *
+ * param *buf - the source to scan
+ * param len - the length of the source
+ * param *newlines - set to the number of newlines found
+ * return size_t - returns the number of non-whitespace runs found
+ **/
+size_t scanAll(const char *buf, size_t len, int *newlines){
+  scancache_t cache = {NULL};
+  size_t pos = 0;
+  size_t runs = 0;
+  *newlines = 0;
+  while(pos < len){
+    pos += scanRun(&cache, &buf[pos], len - pos, CC_SPACE, newlines);
+    if(pos >= len)
+      break;
+    int classes = charClass[(unsigned char) buf[pos]];
+    if(classes & CC_DIGIT)
+      pos += 1 + scanRun(&cache, &buf[pos+1], len - pos - 1, CC_DIGIT, NULL);
+    else if(classes & CC_ALPHA)
+      pos += 1 + scanRun(&cache, &buf[pos+1], len - pos - 1, CC_IDENT, NULL);
+    else
+      pos++;
+    runs++;
+  }
+  return runs;
+}
+
+int main(void){
+  char *buf = malloc(BENCH_SIZE);
+  if(buf == NULL){
+    fprintf(stderr, "Failed to allocate benchmark buffer.\n");
+    exit(1);
+  }
+  int indents[] = {2, 32};
+  int i;
+  for(i = 0; i < 2; i++){
+    fillSource(buf, BENCH_SIZE, indents[i]);
+    printf("indent %d:\n%-8s %-10s %-10s %s\n", indents[i], "scanner", "best (s)", "MB/s", "speedup");
+    double scalarTime = 0;
+    size_t scalarRuns = 0;
+    int scalarNewlines = 0;
+    int level;
+    for(level = SCAN_SCALAR; level <= SCAN_AVX2; level++){
+      if(initScan(level) != (SCAN_LEVEL) level)
+        continue;
+      double best = 0;
+      size_t runs = 0;
+      int newlines = 0;
+      int rep;
+      for(rep = 0; rep < REPEATS; rep++){
+        double start = nowSeconds();
+        runs = scanAll(buf, BENCH_SIZE, &newlines);
+        double elapsed = nowSeconds() - start;
+        if(rep == 0 || elapsed < best)
+          best = elapsed;
+      }
+      if(level == SCAN_SCALAR){
+        scalarTime = best;
+        scalarRuns = runs;
+        scalarNewlines = newlines;
+      }
+      else if(runs != scalarRuns || newlines != scalarNewlines){
+        fprintf(stderr, "%s scanner disagrees with scalar: %zu runs/%d lines vs %zu/%d\n",
+                scanLevelName(level), runs, newlines, scalarRuns, scalarNewlines);
+        exit(1);
+      }
+      printf("%-8s %-10.4f %-10.1f %.2fx\n", scanLevelName(level), best, BENCH_SIZE / 1e6 / best, scalarTime / best);
+    }
+  }
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,903 @@
+//Differential tester: compiles random programs with this compiler and with gcc, runs both and compares the results
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#define LEN_PATH 4097
+//Functions per batch (at most 250, the checking program's exit status names the failing one), and
+//how many of the first are leaves that the others may call
+#define DEFAULT_BATCH 100
+#define MAX_BATCH 250
+#define LEAF_FRACTION 3
+//Shape of each function: statements, locals, expression depth and loop trip counts
+#define MAX_STMTS 6
+#define MAX_LOCALS 4
+#define MAX_DEPTH 5
+#define MAX_TRIPS 9
+//CPU seconds any one command may take, and seconds between progress reports
+#define CPU_LIMIT 20
+#define REPORT_INTERVAL 5
+
+typedef enum EXPR_KIND {LITERAL, VAR, UNARY, BINARY, DIVIDE, SHIFT, TERNARY, CALL} EXPR_KIND;
+
+//Expression tree node. VAR values index a, b, c, the locals x0.. and the loop variable i
+//(LOOP_VAR); DIVIDE and SHIFT print their right operand guarded, so no minimization makes them
+//undefined. paren says whether the node is printed in parentheses.
+typedef struct expr_t {
+  EXPR_KIND kind;
+  const char *op;
+  int value;
+  int paren;
+  struct expr_t *kids[3];
+} expr_t;
+
+#define NUM_PARAMS 3
+#define LOOP_VAR 100
+
+typedef enum STMT_KIND {DECLARE, ASSIGN, IF_ELSE, FOR_LOOP, SWITCH, EARLY_RETURN} STMT_KIND;
+
+//Statement of a generated function: "int x<var> = e0;", "v = e0;", "if(e0) v = e1; else v = e2;",
+//"for(int i = 0; i < count; i = i + 1) v = v + e0;", a switch on e0 assigning e1 or e2 to v, or
+//an error path "if(e0){ switch on e1 returning negatives; return -1; }" that goes to the cold code
+typedef struct stmt_t {
+  STMT_KIND kind;
+  int var;
+  int count;
+  int removed;
+  expr_t *exprs[3];
+} stmt_t;
+
+//A generated function t<n>(a, b, c), with the arguments it is checked with
+typedef struct case_t {
+  stmt_t stmts[MAX_STMTS];
+  int numStmts;
+  expr_t *ret;
+  int args[NUM_PARAMS];
+} case_t;
+
+typedef enum OUTCOME {PASS, MISMATCH, COMPILE_ERROR, CRASH, REFERENCE_ERROR} OUTCOME;
+
+char *outcomeNames[] = {"pass", "wrong result", "compile error", "crash or timeout", "reference error"};
+
+//Growable text buffer
+typedef struct strbuf_t {
+  char *text;
+  size_t len;
+  size_t cap;
+} strbuf_t;
+
+//Options
+const char *compilerPath = "./compiler";
+const char *referenceCommand = "gcc -O0 -fwrapv -w \"$SRC\" -o \"$BIN\"";
+const char *linkCommand = "gcc -m32 \"$ASM\" -o \"$BIN\"";
+const char *workDir = "/tmp";
+const char *failDir = ".";
+//Compiler flags each batch is compiled with: the defaults, and every optimization off
+const char *configs[8] = {"", "-fno-cse -fno-dce -fno-cmov -fno-licm -fno-unroll -fno-jump-tables -fno-inline -fno-fold "
+                          "-fno-omit-frame-pointer -fno-tail-calls"};
+int numConfigs = 2;
+//The only configuration checked while minimizing, -1 for all of them
+int onlyConfig = -1;
+int batchSize = DEFAULT_BATCH;
+//Generator state of the batch being run
+uint64_t rngState = 1;
+case_t cases[MAX_BATCH];
+//Where the batch's files go
+char jobDir[LEN_PATH];
+
+//Values that make good corner cases
+int interesting[] = {0, 1, 2, 3, 7, 8, 31, 32, 33, 100, 255, 256, 1000, 65535, 65536, -1, -2, -8, -255, -256,
+                     2147483647, -2147483647, INT_MIN, 1073741824, 12345678};
+
+/**
+ * nextRandom(unsigned bound)
+ * Returns the next number below bound from the batch's xorshift generator.
+ *
+ * param bound - one past the largest number returned
+ * return unsigned - returns the number
+ **/
+unsigned nextRandom(unsigned bound){
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (unsigned) ((rngState >> 16) % bound);
+}
+
+/**
+ * randomValue()
+ * Returns a random int, often a corner case.
+ *
+ * return int - returns the value
+ **/
+int randomValue(){
+  unsigned pick = nextRandom(8);
+  if(pick < 4)
+    return interesting[nextRandom(sizeof(interesting) / sizeof(interesting[0]))];
+  if(pick < 7)
+    return (int) nextRandom(2000) - 1000;
+  return (int) ((uint32_t) nextRandom(65536) << 16 | nextRandom(65536));
+}
+
+/**
+ * appendText(strbuf_t *buf, const char *format, ...)
+ * Appends formatted text to a buffer.
+ *
+ * param *buf - the buffer
+ * param *format - printf style format
+ * return void
+ **/
+void appendText(strbuf_t *buf, const char *format, ...){
+  va_list args;
+  for(;;){
+    va_start(args, format);
+    int len = vsnprintf(buf->text + buf->len, buf->cap - buf->len, format, args);
+    va_end(args);
+    if(len >= 0 && buf->len + len < buf->cap){
+      buf->len += len;
+      return;
+    }
+    buf->cap = (buf->cap == 0) ? 4096 : buf->cap * 2;
+    buf->text = realloc(buf->text, buf->cap);
+    if(buf->text == NULL){
+      fprintf(stderr, "Failed to allocate space for program text.\n");
+      exit(2);
+    }
+  }
+}
+
+/**
+ * newExpr(EXPR_KIND kind, const char *op, int value)
+ * Allocates an expression node.
+ *
+ * param kind - the node kind
+ * param *op - the operator, NULL for none
+ * param value - the literal, variable or callee
+ * return expr_t* - returns the node
+ **/
+expr_t *newExpr(EXPR_KIND kind, const char *op, int value){
+  expr_t *expr = (expr_t *) calloc(1, sizeof(expr_t));
+  if(expr == NULL){
+    fprintf(stderr, "Failed to allocate space for expression.\n");
+    exit(2);
+  }
+  expr->kind = kind;
+  expr->op = op;
+  expr->value = value;
+  return expr;
+}
+
+/**
+ * genExpr(int depth, int numLocals, int inLoop, int numCallees)
+ * Generates a random expression. Generation recurses, but never deeper than MAX_DEPTH.
+ *
+ * param depth - how many more levels of operators are allowed
+ * param numLocals - the locals declared so far
+ * param inLoop - whether the loop variable is in scope
+ * param numCallees - how many leaf functions may be called
+ * return expr_t* - returns the expression
+ **/
+expr_t *genExpr(int depth, int numLocals, int inLoop, int numCallees){
+  static const char *binaryOps[] = {"+", "-", "*", "&", "|", "^", "<", "<=", ">", ">=", "==", "!=", "&&", "||"};
+  static const char *unaryOps[] = {"-", "~", "!"};
+  static const char *shiftOps[] = {"<<", ">>"};
+  expr_t *expr = NULL;
+  unsigned pick = nextRandom(20);
+  if(depth == 0 || pick < 4){
+    unsigned numVars = NUM_PARAMS + numLocals + (inLoop ? 1 : 0);
+    if(nextRandom(3) == 0)
+      return newExpr(LITERAL, NULL, randomValue());
+    unsigned var = nextRandom(numVars);
+    return newExpr(VAR, NULL, (var == (unsigned) (NUM_PARAMS + numLocals)) ? LOOP_VAR : (int) var);
+  }
+  if(pick < 6){
+    expr = newExpr(UNARY, unaryOps[nextRandom(3)], 0);
+    expr->kids[0] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+  }
+  else if(pick < 8 || (pick == 19 && numCallees == 0)){
+    expr = newExpr(pick == 7 ? SHIFT : DIVIDE, pick == 7 ? shiftOps[nextRandom(2)] : (nextRandom(2) ? "/" : "%"), nextRandom(2));
+    expr->kids[0] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+    expr->kids[1] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+  }
+  else if(pick < 10){
+    expr = newExpr(TERNARY, NULL, 0);
+    int i;
+    for(i = 0; i < 3; i++)
+      expr->kids[i] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+  }
+  else if(pick == 19){
+    expr = newExpr(CALL, NULL, nextRandom(numCallees));
+    int i;
+    for(i = 0; i < NUM_PARAMS; i++)
+      expr->kids[i] = genExpr(depth - 1, numLocals, inLoop, 0);
+  }
+  else{
+    expr = newExpr(BINARY, binaryOps[nextRandom(sizeof(binaryOps) / sizeof(binaryOps[0]))], 0);
+    expr->kids[0] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+    expr->kids[1] = genExpr(depth - 1, numLocals, inLoop, numCallees);
+  }
+  //Mostly parenthesized, but not always, so that precedence is tested too. Shifts always are: an
+  //operator after them would bind tighter and take the count out of 0..31.
+  expr->paren = (nextRandom(4) != 0 || expr->kind == SHIFT);
+  return expr;
+}
+
+/**
+ * genCase(case_t *c, int numCallees)
+ * Generates a function: a few statements and a return.
+ *
+ * param *c - the case to fill in
+ * param numCallees - how many leaf functions it may call
+ * return void
+ **/
+void genCase(case_t *c, int numCallees){
+  int numLocals = 0;
+  int i;
+  memset(c, 0, sizeof(case_t));
+  c->numStmts = nextRandom(MAX_STMTS + 1);
+  for(i = 0; i < c->numStmts; i++){
+    stmt_t *stmt = &c->stmts[i];
+    stmt->kind = (STMT_KIND) nextRandom(6);
+    if(stmt->kind == DECLARE && numLocals == MAX_LOCALS)
+      stmt->kind = ASSIGN;
+    stmt->var = (stmt->kind == DECLARE) ? NUM_PARAMS + numLocals : (int) nextRandom(NUM_PARAMS + numLocals);
+    stmt->count = nextRandom(MAX_TRIPS + 1);
+    int e;
+    for(e = 0; e < 3; e++)
+      stmt->exprs[e] = genExpr(nextRandom(MAX_DEPTH) + 1, numLocals, stmt->kind == FOR_LOOP, numCallees);
+    if(stmt->kind == DECLARE)
+      numLocals++;
+  }
+  c->ret = genExpr(MAX_DEPTH, numLocals, 0, numCallees);
+  for(i = 0; i < NUM_PARAMS; i++)
+    c->args[i] = randomValue();
+}
+
+/**
+ * printValue(strbuf_t *buf, int value)
+ * Prints an int literal the same way to both compilers: negative ones in parentheses, and
+ * INT_MIN (whose magnitude is no int) as a subtraction.
+ *
+ * param *buf - the buffer
+ * param value - the value
+ * return void
+ **/
+void printValue(strbuf_t *buf, int value){
+  if(value == INT_MIN)
+    appendText(buf, "(-2147483647 - 1)");
+  else if(value < 0)
+    appendText(buf, "(%d)", value);
+  else
+    appendText(buf, "%d", value);
+}
+
+/**
+ * printVar(strbuf_t *buf, int var)
+ * Prints a variable name.
+ *
+ * param *buf - the buffer
+ * param var - the variable
+ * return void
+ **/
+void printVar(strbuf_t *buf, int var){
+  if(var == LOOP_VAR)
+    appendText(buf, "i");
+  else if(var < NUM_PARAMS)
+    appendText(buf, "%c", 'a' + var);
+  else
+    appendText(buf, "x%d", var - NUM_PARAMS);
+}
+
+/**
+ * printExpr(strbuf_t *buf, expr_t *expr)
+ * Prints an expression. Divisors are kept away from 0 and -1, shift counts within 0..31, and unary
+ * operands are parenthesized so that "- -" never prints as "--".
+ *
+ * param *buf - the buffer
+ * param *expr - the expression
+ * return void
+ **/
+void printExpr(strbuf_t *buf, expr_t *expr){
+  if(expr->kind == LITERAL){
+    printValue(buf, expr->value);
+    return;
+  }
+  if(expr->kind == VAR){
+    printVar(buf, expr->value);
+    return;
+  }
+  if(expr->paren)
+    appendText(buf, "(");
+  switch(expr->kind){
+  case UNARY:
+    appendText(buf, "%s(", expr->op);
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, ")");
+    break;
+  case BINARY:
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, " %s ", expr->op);
+    printExpr(buf, expr->kids[1]);
+    break;
+  case DIVIDE:
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, expr->value ? " %s (((" : " %s (-((", expr->op);
+    printExpr(buf, expr->kids[1]);
+    appendText(buf, expr->value ? ") & 255) | 1)" : ") & 255) - 2)");
+    break;
+  case SHIFT:
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, " %s ((", expr->op);
+    printExpr(buf, expr->kids[1]);
+    appendText(buf, ") & 31)");
+    break;
+  case TERNARY:
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, " ? ");
+    printExpr(buf, expr->kids[1]);
+    appendText(buf, " : ");
+    printExpr(buf, expr->kids[2]);
+    break;
+  default:
+    appendText(buf, "t%d(", expr->value);
+    printExpr(buf, expr->kids[0]);
+    appendText(buf, ", ");
+    printExpr(buf, expr->kids[1]);
+    appendText(buf, ", ");
+    printExpr(buf, expr->kids[2]);
+    appendText(buf, ")");
+    break;
+  }
+  if(expr->paren)
+    appendText(buf, ")");
+}
+
+/**
+ * printAssign(strbuf_t *buf, int var, expr_t *value)
+ * Prints "v = value;".
+ *
+ * param *buf - the buffer
+ * param var - the variable assigned
+ * param *value - the value
+ * return void
+ **/
+void printAssign(strbuf_t *buf, int var, expr_t *value){
+  printVar(buf, var);
+  appendText(buf, " = ");
+  printExpr(buf, value);
+  appendText(buf, ";");
+}
+
+/**
+ * printCase(strbuf_t *buf, int index)
+ * Prints a generated function.
+ *
+ * param *buf - the buffer
+ * param index - the case
+ * return void
+ **/
+void printCase(strbuf_t *buf, int index){
+  case_t *c = &cases[index];
+  int i;
+  appendText(buf, "int t%d(int a, int b, int c){\n", index);
+  for(i = 0; i < c->numStmts; i++){
+    stmt_t *stmt = &c->stmts[i];
+    if(stmt->removed)
+      continue;
+    appendText(buf, "  ");
+    switch(stmt->kind){
+    case DECLARE:
+      appendText(buf, "int ");
+      printAssign(buf, stmt->var, stmt->exprs[0]);
+      break;
+    case ASSIGN:
+      printAssign(buf, stmt->var, stmt->exprs[0]);
+      break;
+    case IF_ELSE:
+      appendText(buf, "if(");
+      printExpr(buf, stmt->exprs[0]);
+      appendText(buf, ")\n    ");
+      printAssign(buf, stmt->var, stmt->exprs[1]);
+      appendText(buf, "\n  else\n    ");
+      printAssign(buf, stmt->var, stmt->exprs[2]);
+      break;
+    case FOR_LOOP:
+      appendText(buf, "for(int i = 0; i < %d; i = i + 1)\n    ", stmt->count);
+      printVar(buf, stmt->var);
+      appendText(buf, " = ");
+      printVar(buf, stmt->var);
+      appendText(buf, " + (");
+      printExpr(buf, stmt->exprs[0]);
+      appendText(buf, ");");
+      break;
+    case SWITCH:
+      appendText(buf, "switch((");
+      printExpr(buf, stmt->exprs[0]);
+      appendText(buf, ") & 3){\n  case 0:\n    ");
+      printAssign(buf, stmt->var, stmt->exprs[1]);
+      appendText(buf, "\n    break;\n  case 1:\n  case 2:\n    ");
+      printAssign(buf, stmt->var, stmt->exprs[2]);
+      appendText(buf, "\n    break;\n  default:\n    ");
+      printVar(buf, stmt->var);
+      appendText(buf, " = ");
+      printVar(buf, stmt->var);
+      appendText(buf, " ^ 1;\n  }");
+      break;
+    case EARLY_RETURN:
+      //Dense enough for a jump table, which then sits in the cold code
+      appendText(buf, "if(");
+      printExpr(buf, stmt->exprs[0]);
+      appendText(buf, "){\n    switch((");
+      printExpr(buf, stmt->exprs[1]);
+      appendText(buf, ") & 7){\n");
+      int k;
+      for(k = 0; k < 6; k++)
+        appendText(buf, "    case %d:\n      return -%d;\n", k, stmt->count*8 + k + 2);
+      appendText(buf, "    }\n    return -1;\n  }");
+      break;
+    }
+    appendText(buf, "\n");
+  }
+  appendText(buf, "  return ");
+  printExpr(buf, c->ret);
+  appendText(buf, ";\n}\n\n");
+}
+
+/**
+ * printCall(strbuf_t *buf, int index)
+ * Prints the call of a case with its arguments.
+ *
+ * param *buf - the buffer
+ * param index - the case
+ * return void
+ **/
+void printCall(strbuf_t *buf, int index){
+  int i;
+  appendText(buf, "t%d(", index);
+  for(i = 0; i < NUM_PARAMS; i++){
+    if(i > 0)
+      appendText(buf, ", ");
+    printValue(buf, cases[index].args[i]);
+  }
+  appendText(buf, ")");
+}
+
+/**
+ * writeFile(const char *name, strbuf_t *buf)
+ * Writes a buffer to a file of the job's directory.
+ *
+ * param *name - the file name
+ * param *buf - the contents
+ * return void
+ **/
+void writeFile(const char *name, strbuf_t *buf){
+  char path[2*LEN_PATH];
+  snprintf(path, sizeof(path), "%s/%s", jobDir, name);
+  FILE *file = fopen(path, "w");
+  if(file == NULL || fwrite(buf->text, 1, buf->len, file) != buf->len){
+    fprintf(stderr, "Failed to write %s\n", path);
+    exit(2);
+  }
+  fclose(file);
+}
+
+/**
+ * runCommand(const char *command)
+ * Runs a shell command in the job's directory, with $SRC, $ASM and $BIN naming its files and
+ * every process limited to CPU_LIMIT seconds.
+ *
+ * param *command - the command
+ * return int - returns the exit status, or -1 if the command was killed by a signal
+ **/
+int runCommand(const char *command){
+  pid_t pid = fork();
+  if(pid < 0){
+    fprintf(stderr, "Failed to fork.\n");
+    exit(2);
+  }
+  if(pid == 0){
+    struct rlimit limit = {CPU_LIMIT, CPU_LIMIT};
+    setrlimit(RLIMIT_CPU, &limit);
+    if(chdir(jobDir) != 0)
+      _exit(126);
+    execl("/bin/sh", "sh", "-c", command, (char *) NULL);
+    _exit(127);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if(!WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+/**
+ * checkCases(const int *tested, int numTested, int *failing, int *failedConfig)
+ * Checks cases: gcc compiles them with a main printing each one's value, and this compiler,
+ * with each configuration, compiles them with a main returning 1 + the position of the first
+ * one whose value differs from gcc's. Functions the tested ones call are included.
+ *
+ * param *tested - the cases to check
+ * param numTested - the number of cases to check
+ * param *failing - set to the position of the failing case, for MISMATCH
+ * param *failedConfig - set to the configuration that failed
+ * return OUTCOME - returns the outcome
+ **/
+OUTCOME checkCases(const int *tested, int numTested, int *failing, int *failedConfig){
+  strbuf_t functions = {NULL, 0, 0};
+  strbuf_t source = {NULL, 0, 0};
+  int included[MAX_BATCH] = {0};
+  int i;
+  //Tested cases only call leaves, which call nothing
+  for(i = 0; i < numTested; i++){
+    included[tested[i]] = 1;
+    int s, e;
+    case_t *c = &cases[tested[i]];
+    expr_t *stack[4096];
+    int depth = 0;
+    for(s = 0; s <= c->numStmts; s++){
+      if(s < c->numStmts && c->stmts[s].removed)
+        continue;
+      for(e = 0; e < 3 && (s < c->numStmts || e == 0); e++)
+        stack[depth++] = (s < c->numStmts) ? c->stmts[s].exprs[e] : c->ret;
+    }
+    while(depth > 0){
+      expr_t *expr = stack[--depth];
+      if(expr->kind == CALL)
+        included[expr->value] = 1;
+      int k;
+      for(k = 0; k < 3; k++){
+        if(expr->kids[k] != NULL && depth < 4096)
+          stack[depth++] = expr->kids[k];
+      }
+    }
+  }
+  for(i = 0; i < batchSize; i++){
+    if(included[i])
+      printCase(&functions, i);
+  }
+  appendText(&source, "#include <stdio.h>\n\n%sint main(){\n", functions.text);
+  for(i = 0; i < numTested; i++){
+    appendText(&source, "  printf(\"%%d\\n\", ");
+    printCall(&source, tested[i]);
+    appendText(&source, ");\n");
+  }
+  appendText(&source, "  return 0;\n}\n");
+  writeFile("ref.c", &source);
+  setenv("SRC", "ref.c", 1);
+  setenv("BIN", "ref", 1);
+  if(runCommand(referenceCommand) != 0 || runCommand("./ref > ref.out") != 0)
+    return REFERENCE_ERROR;
+  char path[2*LEN_PATH];
+  snprintf(path, sizeof(path), "%s/ref.out", jobDir);
+  FILE *values = fopen(path, "r");
+  source.len = 0;
+  appendText(&source, "%sint main(){\n", functions.text);
+  for(i = 0; i < numTested; i++){
+    int value = 0;
+    if(values == NULL || fscanf(values, "%d", &value) != 1){
+      if(values != NULL)
+        fclose(values);
+      return REFERENCE_ERROR;
+    }
+    appendText(&source, "  if(");
+    printCall(&source, tested[i]);
+    appendText(&source, " != ");
+    printValue(&source, value);
+    appendText(&source, ")\n    return %d;\n", i + 1);
+  }
+  fclose(values);
+  appendText(&source, "  return 0;\n}\n");
+  writeFile("test.c", &source);
+  free(functions.text);
+  free(source.text);
+  setenv("SRC", "test.c", 1);
+  setenv("ASM", "test.s", 1);
+  setenv("BIN", "test", 1);
+  int config;
+  for(config = 0; config < numConfigs; config++){
+    if(onlyConfig >= 0 && config != onlyConfig)
+      continue;
+    char command[LEN_PATH];
+    *failedConfig = config;
+    snprintf(command, LEN_PATH, "%s %s test.c -o test.s 2> compile.err", compilerPath, configs[config]);
+    if(runCommand(command) != 0 || runCommand(linkCommand) != 0)
+      return COMPILE_ERROR;
+    int status = runCommand("exec ./test");
+    if(status < 0 || status > numTested)
+      return CRASH;
+    if(status > 0){
+      *failing = status - 1;
+      return MISMATCH;
+    }
+  }
+  return PASS;
+}
+
+/**
+ * stillFails(int index, OUTCOME outcome)
+ * Checks whether a case still fails the same way, for minimization.
+ *
+ * param index - the case
+ * param outcome - the way it failed
+ * return int - returns 1 if it does, 0 otherwise
+ **/
+int stillFails(int index, OUTCOME outcome){
+  int failing = 0, config = 0;
+  return checkCases(&index, 1, &failing, &config) == outcome;
+}
+
+/**
+ * collectSlots(expr_t **slot, expr_t ***slots, int *numSlots, int cap)
+ * Lists the slots of an expression's nodes in preorder.
+ *
+ * param **slot - the slot of the expression
+ * param ***slots - the list
+ * param *numSlots - the number of slots listed
+ * param cap - the list's capacity
+ * return void
+ **/
+void collectSlots(expr_t **slot, expr_t ***slots, int *numSlots, int cap){
+  if(*numSlots == cap)
+    return;
+  slots[(*numSlots)++] = slot;
+  int k;
+  for(k = 0; k < 3; k++){
+    if((*slot)->kids[k] != NULL)
+      collectSlots(&(*slot)->kids[k], slots, numSlots, cap);
+  }
+}
+
+/**
+ * collectCaseSlots(case_t *c, expr_t ***slots, int cap)
+ * Lists the slots of every expression node of a case's remaining statements and return.
+ *
+ * param *c - the case
+ * param ***slots - the list
+ * param cap - the list's capacity
+ * return int - returns the number of slots listed
+ **/
+int collectCaseSlots(case_t *c, expr_t ***slots, int cap){
+  int numSlots = 0;
+  int s, e;
+  for(s = 0; s < c->numStmts; s++){
+    for(e = 0; e < 3 && !c->stmts[s].removed; e++)
+      collectSlots(&c->stmts[s].exprs[e], slots, &numSlots, cap);
+  }
+  collectSlots(&c->ret, slots, &numSlots, cap);
+  return numSlots;
+}
+
+/**
+ * minimizeCase(int index, OUTCOME outcome)
+ * Shrinks a failing case while it keeps failing the same way: removes statements, and replaces
+ * expression nodes, outermost first, by a 0 or 1 or by one of their operands, until nothing more
+ * can go.
+ *
+ * param index - the failing case
+ * param outcome - the way it fails
+ * return void
+ **/
+void minimizeCase(int index, OUTCOME outcome){
+  case_t *c = &cases[index];
+  int changed = 1;
+  while(changed){
+    changed = 0;
+    int s;
+    for(s = 0; s < c->numStmts; s++){
+      if(c->stmts[s].removed || c->stmts[s].kind == DECLARE)
+        continue;
+      c->stmts[s].removed = 1;
+      if(stillFails(index, outcome))
+        changed = 1;
+      else
+        c->stmts[s].removed = 0;
+    }
+    expr_t **slots[4096];
+    int numSlots = collectCaseSlots(c, slots, 4096);
+    int i;
+    for(i = 0; i < numSlots; i++){
+      expr_t *node = *slots[i];
+      if(node->kind == LITERAL && (node->value == 0 || node->value == 1))
+        continue;
+      expr_t *candidates[5] = {newExpr(LITERAL, NULL, 0), (node->kind == LITERAL) ? NULL : newExpr(LITERAL, NULL, 1),
+                               node->kids[0], node->kids[1], node->kids[2]};
+      int k;
+      for(k = 0; k < 5; k++){
+        if(candidates[k] == NULL)
+          continue;
+        *slots[i] = candidates[k];
+        if(stillFails(index, outcome)){
+          //Try the replacement in turn, the slots of the dropped nodes are gone
+          changed = 1;
+          numSlots = collectCaseSlots(c, slots, 4096);
+          i--;
+          break;
+        }
+        *slots[i] = node;
+      }
+    }
+  }
+}
+
+/**
+ * runBatch(uint64_t seed)
+ * Generates and checks a batch of cases. A failing case is minimized and saved to the failure
+ * directory as fail-<seed>.c, the program this compiler got.
+ *
+ * param seed - the batch's seed
+ * return int - returns 0 if every case passed, 1 for a failure, 2 if the reference build failed
+ **/
+int runBatch(uint64_t seed){
+  rngState = seed * 2654435761ULL + 1;
+  int leaves = batchSize / LEAF_FRACTION;
+  int tested[MAX_BATCH];
+  int i;
+  for(i = 0; i < batchSize; i++){
+    genCase(&cases[i], (i < leaves) ? 0 : leaves);
+    tested[i] = i;
+  }
+  snprintf(jobDir, LEN_PATH, "%s/difftest.%d.%llu", workDir, (int) getppid(), (unsigned long long) seed);
+  mkdir(jobDir, 0755);
+  int failing = 0, config = 0;
+  OUTCOME outcome = checkCases(tested, batchSize, &failing, &config);
+  onlyConfig = config;
+  if(outcome == MISMATCH)
+    failing = tested[failing];
+  else if(outcome == COMPILE_ERROR || outcome == CRASH){
+    //Bisect for the case, assuming one is to blame
+    int low = 0, high = batchSize;
+    while(high - low > 1){
+      int mid = (low + high) / 2;
+      int position = 0;
+      if(checkCases(&tested[low], mid - low, &position, &config) == outcome)
+        high = mid;
+      else
+        low = mid;
+    }
+    failing = low;
+  }
+  int isolated = (outcome == MISMATCH || outcome == COMPILE_ERROR || outcome == CRASH) && stillFails(failing, outcome);
+  if(isolated){
+    minimizeCase(failing, outcome);
+    stillFails(failing, outcome);
+    char command[2*LEN_PATH];
+    snprintf(command, sizeof(command), "{ echo '//%s with flags: %s'; cat test.c; } > %s/fail-%llu.c", outcomeNames[outcome],
+             configs[config], failDir, (unsigned long long) seed);
+    runCommand(command);
+    fprintf(stderr, "Seed %llu: %s in t%d with flags \"%s\", minimized to %s/fail-%llu.c\n", (unsigned long long) seed,
+            outcomeNames[outcome], failing, configs[config], failDir, (unsigned long long) seed);
+  }
+  else if(outcome != PASS){
+    fprintf(stderr, "Seed %llu: %s, not reproduced by any one case, see %s\n", (unsigned long long) seed,
+            outcomeNames[outcome], jobDir);
+  }
+  if(outcome == PASS || isolated){
+    char command[2*LEN_PATH];
+    snprintf(command, sizeof(command), "rm -rf '%s'", jobDir);
+    if(system(command) != 0)
+      fprintf(stderr, "Failed to remove %s\n", jobDir);
+  }
+  return (outcome == PASS) ? 0 : ((outcome == REFERENCE_ERROR) ? 2 : 1);
+}
+
+/**
+ * nowSeconds()
+ * Returns a monotonic timestamp in seconds.
+ *
+ * return double - returns the current time
+ **/
+double nowSeconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * usage(char *progName)
+ * Prints the usage message and exits.
+ *
+ * param *progName - the name the tester was invoked as
+ * return void
+ **/
+void usage(char *progName){
+  fprintf(stderr, "Usage: %s [options]\n\n"
+          "  Checks batches of random functions, compiled by this compiler with each set of flags, against gcc.\n"
+          "  Batches run in parallel, each in a process of its own; a failing case is minimized and saved.\n\n"
+          "Options:\n"
+          "  -j <n>          batches to run at once (default: the number of cores)\n"
+          "  -n <n>          batches to run (default: until -t runs out)\n"
+          "  -t <seconds>    stop starting batches after this long (default: 60, 0 for no limit)\n"
+          "  -s <seed>       seed of the first batch, batches use consecutive seeds (default: the time)\n"
+          "  -b <n>          functions per batch, at most %d (default: %d)\n"
+          "  -c <compiler>   the compiler to test (default: ./compiler)\n"
+          "  -f <flags>      also test with these compiler flags (up to 6 times)\n"
+          "  -L <command>    assemble and link $ASM into $BIN (default: %s)\n"
+          "  -R <command>    build the reference $SRC into $BIN (default: %s)\n"
+          "  -w <dir>        directory for the batches' files (default: /tmp)\n"
+          "  -o <dir>        directory for minimized failures (default: .)\n", progName, MAX_BATCH, DEFAULT_BATCH,
+          linkCommand, referenceCommand);
+  exit(2);
+}
+
+int main(int argc, char *argv[]){
+  long numJobs = sysconf(_SC_NPROCESSORS_ONLN);
+  long long maxBatches = -1;
+  double timeLimit = 60;
+  uint64_t seed = (uint64_t) time(NULL);
+  int i;
+  for(i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 == argc)
+      usage(argv[0]);
+    char *value = argv[++i];
+    switch(argv[i-1][1]){
+    case 'j': numJobs = atol(value); break;
+    case 'n': maxBatches = atoll(value); break;
+    case 't': timeLimit = atof(value); break;
+    case 's': seed = strtoull(value, NULL, 10); break;
+    case 'b': batchSize = atoi(value); break;
+    case 'c': compilerPath = value; break;
+    case 'L': linkCommand = value; break;
+    case 'R': referenceCommand = value; break;
+    case 'w': workDir = value; break;
+    case 'o': failDir = value; break;
+    case 'f':
+      if(numConfigs == 8)
+        usage(argv[0]);
+      configs[numConfigs++] = value;
+      break;
+    default: usage(argv[0]);
+    }
+  }
+  if(numJobs < 1 || batchSize < 1 || batchSize > MAX_BATCH)
+    usage(argv[0]);
+  //The children resolve relative paths from their job directories
+  static char absolute[LEN_PATH];
+  if(compilerPath[0] != '/' && realpath(compilerPath, absolute) != NULL)
+    compilerPath = absolute;
+  static char absoluteFails[LEN_PATH];
+  if(realpath(failDir, absoluteFails) != NULL)
+    failDir = absoluteFails;
+  double start = nowSeconds();
+  double lastReport = start;
+  long long started = 0, finished = 0, failures = 0, referenceErrors = 0;
+  int running = 0;
+  for(;;){
+    while(running < numJobs && (maxBatches < 0 || started < maxBatches)
+          && (timeLimit <= 0 || nowSeconds() - start < timeLimit)){
+      pid_t pid = fork();
+      if(pid < 0){
+        fprintf(stderr, "Failed to fork.\n");
+        exit(2);
+      }
+      if(pid == 0)
+        exit(runBatch(seed + started));
+      started++;
+      running++;
+    }
+    if(running == 0)
+      break;
+    int status = 0;
+    if(wait(&status) < 0)
+      break;
+    running--;
+    finished++;
+    if(!WIFEXITED(status) || WEXITSTATUS(status) == 1)
+      failures++;
+    else if(WEXITSTATUS(status) == 2)
+      referenceErrors++;
+    double now = nowSeconds();
+    if(now - lastReport >= REPORT_INTERVAL || running == 0){
+      fprintf(stderr, "%lld batches, %lld cases in %.0fs (%.0f cases/s), %lld failures, %lld reference errors\n", finished,
+              finished * batchSize, now - start, finished * batchSize / (now - start), failures, referenceErrors);
+      lastReport = now;
+    }
+  }
+  return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+#include "asmcache.h"
+#include "astcache.h"
+#include "gen.h"
+#include "dump.h"
+#include "opt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char asmCachePath[LEN_PATH];
+
+//A memory mapped assembly cache, with its functions indexed by interned name
+typedef struct asmcache_t {
+  const char *map;
+  size_t size;
+  const asmcachehdr_t *header;
+  const asmcachefn_t *functions;
+  const char *text;
+  int *functionIndex;
+  size_t functionIndexCap;
+} asmcache_t;
+
+//A function's assembly for this build, reused from the old cache or freshly generated (owned)
+typedef struct asmtext_t {
+  uint64_t fingerprint;
+  const char *name;
+  const char *text;
+  size_t len;
+  char *owned;
+} asmtext_t;
+
+/**
+ * closeAsmCache(asmcache_t *cache, const char *reason)
+ * Unmaps an assembly cache, saying why it could not be used with -v when a reason is given.
+ *
+ * param *cache - the cache to close
+ * param *reason - why it cannot be used, or NULL
+ * return asmcache_t* - returns NULL
+ **/
+static asmcache_t *closeAsmCache(asmcache_t *cache, const char *reason){
+  if(reason != NULL && verbose)
+    fprintf(stderr, "Ignoring codegen cache %s: %s.\n", asmCachePath, reason);
+  munmap((void *) cache->map, cache->size);
+  free(cache->functionIndex);
+  free(cache);
+  return NULL;
+}
+
+/**
+ * openAsmCache(const char *path)
+ * Maps an assembly cache and checks it before use: version, codegen signature, bounds and checksum.
+ *
+ * param *path - the cache file
+ * return asmcache_t* - returns the mapped cache, or NULL if there is no usable cache
+ **/
+static asmcache_t *openAsmCache(const char *path){
+  int fd = open(path, O_RDONLY);
+  struct stat cacheStat;
+  if(fd < 0)
+    return NULL;
+  if(fstat(fd, &cacheStat) != 0 || (size_t) cacheStat.st_size < sizeof(asmcachehdr_t)){
+    close(fd);
+    return NULL;
+  }
+  asmcache_t *cache = calloc(1, sizeof(asmcache_t));
+  if(cache == NULL){
+    fprintf(stderr, "Failed to allocate space for the codegen cache.\n");
+    exit(1);
+  }
+  cache->size = cacheStat.st_size;
+  cache->map = mmap(NULL, cache->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(cache->map == MAP_FAILED){
+    free(cache);
+    return NULL;
+  }
+  const asmcachehdr_t *header = (const asmcachehdr_t *) cache->map;
+  cache->header = header;
+  if(memcmp(header->magic, ASM_CACHE_MAGIC, sizeof(header->magic)) != 0)
+    return closeAsmCache(cache, "not a codegen cache");
+  if(header->version != ASM_CACHE_VERSION)
+    return closeAsmCache(cache, "written by another version");
+  if(header->signature != codegenSignature())
+    return closeAsmCache(cache, "generated with other options");
+  if(header->functionsOffset % 8 != 0 || header->functionsOffset > cache->size || header->textOffset > cache->size
+     || header->numFunctions > (cache->size - header->functionsOffset) / sizeof(asmcachefn_t)
+     || header->textSize == 0 || header->textSize > cache->size - header->textOffset)
+    return closeAsmCache(cache, "truncated");
+  if(hashBytes(cache->map + sizeof(asmcachehdr_t), cache->size - sizeof(asmcachehdr_t)) != header->checksum)
+    return closeAsmCache(cache, "checksum mismatch");
+  cache->functions = (const asmcachefn_t *) (cache->map + header->functionsOffset);
+  cache->text = cache->map + header->textOffset;
+  if(cache->text[header->textSize-1] != '\0')
+    return closeAsmCache(cache, "bad text");
+  uint32_t i;
+  for(i = 0; i < header->numFunctions; i++){
+    const asmcachefn_t *func = &cache->functions[i];
+    if(func->name >= header->textSize || func->asmStart > header->textSize
+       || func->asmLength > header->textSize - func->asmStart)
+      return closeAsmCache(cache, "bad function table");
+    const char *name = &cache->text[func->name];
+    uint32_t symbol = intern(name, strlen(name));
+    size_t oldCap = cache->functionIndexCap;
+    growArray((void **) &cache->functionIndex, &cache->functionIndexCap, (size_t) symbol + 1, sizeof(int));
+    memset(&cache->functionIndex[oldCap], 0, (cache->functionIndexCap - oldCap) * sizeof(int));
+    cache->functionIndex[symbol] = i + 1;
+  }
+  return cache;
+}
+
+/**
+ * writeAsmCache(const char *path, asmtext_t *texts, size_t numTexts)
+ * Writes every function's assembly to a new cache file, aside and then renamed over the old one.
+ *
+ * param *path - the cache file
+ * param *texts - each function's fingerprint, name and assembly
+ * param numTexts - the number of functions
+ * return void
+ **/
+static void writeAsmCache(const char *path, asmtext_t *texts, size_t numTexts){
+  asmcachehdr_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ASM_CACHE_MAGIC, sizeof(header.magic));
+  header.version = ASM_CACHE_VERSION;
+  header.numFunctions = numTexts;
+  header.signature = codegenSignature();
+  header.functionsOffset = sizeof(asmcachehdr_t);
+  header.textOffset = header.functionsOffset + numTexts * sizeof(asmcachefn_t);
+  size_t i;
+  //Each function's name (NUL terminated) then its assembly, and a final NUL
+  header.textSize = 1;
+  for(i = 0; i < numTexts; i++)
+    header.textSize += strlen(texts[i].name) + 1 + texts[i].len;
+  size_t fileSize = header.textOffset + header.textSize;
+  char *file = calloc(1, fileSize);
+  if(file == NULL){
+    fprintf(stderr, "Failed to allocate space for the codegen cache.\n");
+    exit(1);
+  }
+  asmcachefn_t *functions = (asmcachefn_t *) (file + header.functionsOffset);
+  char *text = file + header.textOffset;
+  uint64_t textPos = 0;
+  for(i = 0; i < numTexts; i++){
+    size_t nameLen = strlen(texts[i].name) + 1;
+    functions[i].fingerprint = texts[i].fingerprint;
+    functions[i].name = textPos;
+    memcpy(&text[textPos], texts[i].name, nameLen);
+    textPos += nameLen;
+    functions[i].asmStart = textPos;
+    functions[i].asmLength = texts[i].len;
+    memcpy(&text[textPos], texts[i].text, texts[i].len);
+    textPos += texts[i].len;
+  }
+  header.checksum = hashBytes(file + sizeof(asmcachehdr_t), fileSize - sizeof(asmcachehdr_t));
+  memcpy(file, &header, sizeof(header));
+
+  char tmpPath[LEN_PATH + 4];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  FILE *cacheFile = fopen(tmpPath, "wb");
+  if(cacheFile == NULL || fwrite(file, 1, fileSize, cacheFile) != fileSize || fclose(cacheFile) != 0
+     || rename(tmpPath, path) != 0){
+    fprintf(stderr, "Warning: failed to write codegen cache %s.\n", path);
+    remove(tmpPath);
+  }
+  free(file);
+}
+
+/**
+ * generateIncremental(astnode_t *root, FILE *outFile)
+ * Generates the program parsed by parseIncremental(), reusing the cached assembly of every
+ * function whose token fingerprint is unchanged and generating the rest. The fingerprint of a
+ * function other functions were inlined into also covers theirs, see inlinedCallees(). Functions
+ * are written in source order, and the cache (<output>.fncache) is rewritten for the next build.
+ *
+ * param *root - the first PROGRAM node of the program
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateIncremental(astnode_t *root, FILE *outFile){
+  int astLen = strnlen(astCachePath, LEN_PATH);
+  snprintf(asmCachePath, LEN_PATH, "%.*s.fncache", astLen - 4, astCachePath);
+  asmcache_t *cache = openAsmCache(asmCachePath);
+  asmtext_t *texts = malloc(sizeof(asmtext_t) * (numProgramSpans + 1));
+  if(texts == NULL){
+    fprintf(stderr, "Failed to allocate space for the codegen cache.\n");
+    exit(1);
+  }
+  size_t numTexts = 0;
+  int reused = 0;
+  startLineInfo(outFile);
+  astnode_t *program = NULL;
+  for(program = root; program != NULL && numTexts < numProgramSpans; program = program->fields.children.right){
+    astnode_t *funcNode = program->fields.children.left;
+    uint32_t symbol = funcNode->fields.children.left->fields.symbol;
+    asmtext_t *text = &texts[numTexts];
+    const int *inlined = NULL;
+    size_t numInlined = inlinedCallees(numTexts, &inlined);
+    size_t i;
+    text->fingerprint = programSpans[numTexts].fingerprint;
+    for(i = 0; i < numInlined; i++)
+      text->fingerprint = (text->fingerprint ^ programSpans[inlined[i]].fingerprint) * 1099511628211ULL;
+    //Line information moves with the function and the functions inlined into it
+    if(debugLines){
+      text->fingerprint = (text->fingerprint ^ (uint32_t) programSpans[numTexts].line) * 1099511628211ULL;
+      for(i = 0; i < numInlined; i++)
+        text->fingerprint = (text->fingerprint ^ (uint32_t) programSpans[inlined[i]].line) * 1099511628211ULL;
+    }
+    numTexts++;
+    text->name = symbolName(symbol);
+    text->owned = NULL;
+    int fn = (cache != NULL && symbol < cache->functionIndexCap) ? cache->functionIndex[symbol] - 1 : -1;
+    if(fn >= 0 && cache->functions[fn].fingerprint == text->fingerprint){
+      text->text = &cache->text[cache->functions[fn].asmStart];
+      text->len = cache->functions[fn].asmLength;
+      currFuncName = (char *) text->name;
+      emitText(outFile, text->text, text->len);
+      reused++;
+      continue;
+    }
+    FILE *funcFile = open_memstream(&text->owned, &text->len);
+    if(funcFile == NULL){
+      fprintf(stderr, "Failed to open assembly buffer for function %s.\n", text->name);
+      exit(1);
+    }
+    generate(funcNode, funcFile);
+    fclose(funcFile);
+    text->text = text->owned;
+    fwrite(text->text, 1, text->len, outFile);
+  }
+  if(verbose)
+    fprintf(stderr, "Codegen cache: reused %d of %zu functions\n", reused, numTexts);
+  writeAsmCache(asmCachePath, texts, numTexts);
+  size_t i;
+  for(i = 0; i < numTexts; i++)
+    free(texts[i].owned);
+  free(texts);
+  if(cache != NULL)
+    closeAsmCache(cache, NULL);
+}
@@ -0,0 +1,37 @@
+#ifndef ASMCACHE_H_
+#define ASMCACHE_H_
+
+#include "parse.h"
+#include <stdio.h>
+#include <stdint.h>
+
+//Identifies per-function assembly cache files, and the layout they were written with
+#define ASM_CACHE_MAGIC "TWCCASM"
+#define ASM_CACHE_VERSION 1
+
+//Cache file header, followed by the function table and the text (names and assembly).
+//Sections are located by byte offsets from the start of the file.
+typedef struct asmcachehdr_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t numFunctions;
+  uint64_t signature;
+  uint64_t functionsOffset;
+  uint64_t textOffset;
+  uint64_t textSize;
+  uint64_t checksum;
+} asmcachehdr_t;
+
+//A cached function: the fingerprint of its tokens, and its name and assembly in the text
+typedef struct asmcachefn_t {
+  uint64_t fingerprint;
+  uint64_t name;
+  uint64_t asmStart;
+  uint64_t asmLength;
+} asmcachefn_t;
+
+extern char asmCachePath[LEN_PATH];
+
+void generateIncremental(astnode_t *root, FILE *outFile);
+
+#endif // ASMCACHE_H_
@@ -0,0 +1,565 @@
+#include "astcache.h"
+#include "gen.h"
+#include "dump.h"
+#include "pp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char astCachePath[LEN_PATH];
+//The cache read at the start of this build, kept mapped since reused nodes point into it
+astcache_t *astCache = NULL;
+//Where each function of the program parsed by parseIncremental() is, in program order
+funcspan_t *programSpans = NULL;
+size_t numProgramSpans = 0;
+
+//Serialization stack frame: a node, and the record slot its index goes in
+typedef struct serframe_t {
+  astnode_t *node;
+  uint32_t parent;
+  int slot;
+} serframe_t;
+
+/**
+ * hashBytes(const char *bytes, size_t len)
+ * Hashes a byte range with 64 bit FNV-1a.
+ *
+ * param *bytes - the bytes to hash
+ * param len - the number of bytes
+ * return uint64_t - returns the hash
+ **/
+uint64_t hashBytes(const char *bytes, size_t len){
+  uint64_t hash = 14695981039346656037ULL;
+  size_t i;
+  for(i = 0; i < len; i++){
+    hash ^= (unsigned char) bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * setASTCachePath()
+ * Sets the cache path next to the output: the output path with its .s extension replaced by .ast.
+ *
+ * return int - returns 1 if the build can be cached, 0 when reading stdin or writing stdout
+ **/
+int setASTCachePath(){
+  defaultOutPath();
+  if(strcmp(sourcePath, "-") == 0 || strcmp(outPath, "-") == 0)
+    return 0;
+  int outLen = strnlen(outPath, LEN_PATH);
+  if(outLen > 2 && strcmp(&outPath[outLen-2], ".s") == 0)
+    outLen -= 2;
+  snprintf(astCachePath, LEN_PATH, "%.*s.ast", outLen, outPath);
+  return 1;
+}
+
+/**
+ * rejectCache(astcache_t *cache, const char *reason)
+ * Unmaps a cache file that cannot be used, saying why with -v.
+ *
+ * param *cache - the cache to drop
+ * param *reason - why it cannot be used
+ * return astcache_t* - returns NULL
+ **/
+static astcache_t *rejectCache(astcache_t *cache, const char *reason){
+  if(verbose)
+    fprintf(stderr, "Ignoring AST cache %s: %s.\n", astCachePath, reason);
+  munmap((void *) cache->map, cache->size);
+  free(cache);
+  return NULL;
+}
+
+/**
+ * openASTCache(const char *path)
+ * Maps a cache file and checks it before use: version, section bounds, checksum, and that every
+ * index in it is in range, so loading never has to check again.
+ *
+ * param *path - the cache file
+ * return astcache_t* - returns the mapped cache, or NULL if there is no usable cache
+ **/
+astcache_t *openASTCache(const char *path){
+  int fd = open(path, O_RDONLY);
+  struct stat cacheStat;
+  if(fd < 0)
+    return NULL;
+  if(fstat(fd, &cacheStat) != 0 || (size_t) cacheStat.st_size < sizeof(astcachehdr_t)){
+    close(fd);
+    return NULL;
+  }
+  astcache_t *cache = calloc(1, sizeof(astcache_t));
+  if(cache == NULL){
+    fprintf(stderr, "Failed to allocate space for the AST cache.\n");
+    exit(1);
+  }
+  cache->size = cacheStat.st_size;
+  cache->map = mmap(NULL, cache->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(cache->map == MAP_FAILED){
+    free(cache);
+    return NULL;
+  }
+  const astcachehdr_t *header = (const astcachehdr_t *) cache->map;
+  cache->header = header;
+  if(memcmp(header->magic, AST_CACHE_MAGIC, sizeof(header->magic)) != 0)
+    return rejectCache(cache, "not an AST cache");
+  if(header->version != AST_CACHE_VERSION)
+    return rejectCache(cache, "written by another version");
+  //Every section has to fit in the file
+  if(header->functionsOffset % 8 != 0 || header->nodesOffset % 8 != 0 || header->symbolsOffset % 8 != 0
+     || header->functionsOffset > cache->size || header->nodesOffset > cache->size
+     || header->symbolsOffset > cache->size || header->stringsOffset > cache->size
+     || header->numFunctions > (cache->size - header->functionsOffset) / sizeof(astcachefn_t)
+     || header->numNodes > (cache->size - header->nodesOffset) / sizeof(astrec_t)
+     || header->numSymbols > (cache->size - header->symbolsOffset) / sizeof(uint32_t)
+     || header->stringsSize == 0 || header->stringsSize > cache->size - header->stringsOffset)
+    return rejectCache(cache, "truncated");
+  if(hashBytes(cache->map + sizeof(astcachehdr_t), cache->size - sizeof(astcachehdr_t)) != header->checksum)
+    return rejectCache(cache, "checksum mismatch");
+  cache->functions = (const astcachefn_t *) (cache->map + header->functionsOffset);
+  cache->nodes = (const astrec_t *) (cache->map + header->nodesOffset);
+  cache->symbols = (const uint32_t *) (cache->map + header->symbolsOffset);
+  cache->strings = cache->map + header->stringsOffset;
+  //A terminated string table means any offset into it is a terminated string
+  if(cache->strings[header->stringsSize-1] != '\0')
+    return rejectCache(cache, "bad string table");
+  uint32_t i;
+  for(i = 0; i < header->numSymbols; i++){
+    if(cache->symbols[i] >= header->stringsSize)
+      return rejectCache(cache, "bad symbol table");
+  }
+  //Functions tile the node records in order
+  uint32_t nextNode = 0;
+  for(i = 0; i < header->numFunctions; i++){
+    const astcachefn_t *func = &cache->functions[i];
+    if(func->firstNode != nextNode || func->numNodes == 0 || func->numNodes > header->numNodes - nextNode
+       || func->name >= header->numSymbols || cache->nodes[func->firstNode].nodeType != FUNCTION)
+      return rejectCache(cache, "bad function table");
+    uint32_t end = func->firstNode + func->numNodes;
+    uint32_t j;
+    for(j = func->firstNode; j < end; j++){
+      const astrec_t *rec = &cache->nodes[j];
+      if(rec->nodeType >= NUM_AST_TYPES)
+        return rejectCache(cache, "bad node type");
+      if(rec->nodeType == INTEGER)
+        continue;
+      if(rec->nodeType == DATA){
+        if(rec->fields.str >= header->stringsSize)
+          return rejectCache(cache, "bad string");
+        continue;
+      }
+      if(rec->nodeType == SYMBOL){
+        if(rec->fields.symbol >= header->numSymbols)
+          return rejectCache(cache, "bad symbol");
+        continue;
+      }
+      int c;
+      for(c = 0; c < 3; c++){
+        uint32_t child = rec->fields.children[c];
+        if(child != NO_NODE && (child <= j || child >= end))
+          return rejectCache(cache, "bad child index");
+      }
+    }
+    nextNode = end;
+  }
+  if(nextNode != header->numNodes)
+    return rejectCache(cache, "bad function table");
+  cache->symbolMap = malloc(sizeof(uint32_t) * (header->numSymbols + 1));
+  if(cache->symbolMap == NULL){
+    fprintf(stderr, "Failed to allocate space for the AST cache.\n");
+    exit(1);
+  }
+  for(i = 0; i < header->numSymbols; i++)
+    cache->symbolMap[i] = NO_SYMBOL;
+  //Index the functions by name so moved functions are still found
+  for(i = 0; i < header->numFunctions; i++){
+    uint32_t symbol = cachedSymbol(cache, cache->functions[i].name);
+    size_t oldCap = cache->functionIndexCap;
+    growArray((void **) &cache->functionIndex, &cache->functionIndexCap, (size_t) symbol + 1, sizeof(int));
+    memset(&cache->functionIndex[oldCap], 0, (cache->functionIndexCap - oldCap) * sizeof(int));
+    cache->functionIndex[symbol] = i + 1;
+  }
+  return cache;
+}
+
+/**
+ * cachedSymbol(astcache_t *cache, uint32_t index)
+ * Interns a name of the cache's symbol table, once.
+ *
+ * param *cache - the cache
+ * param index - the symbol table index
+ * return uint32_t - returns the interned symbol ID
+ **/
+uint32_t cachedSymbol(astcache_t *cache, uint32_t index){
+  if(cache->symbolMap[index] == NO_SYMBOL){
+    const char *name = &cache->strings[cache->symbols[index]];
+    cache->symbolMap[index] = intern(name, strlen(name));
+  }
+  return cache->symbolMap[index];
+}
+
+/**
+ * findCachedFunction(astcache_t *cache, uint32_t symbol)
+ * Looks up a cached function by name.
+ *
+ * param *cache - the cache
+ * param symbol - the function's name symbol ID
+ * return int - returns the function's index in the cache, -1 if it is not cached
+ **/
+int findCachedFunction(astcache_t *cache, uint32_t symbol){
+  if(symbol >= cache->functionIndexCap)
+    return -1;
+  return cache->functionIndex[symbol] - 1;
+}
+
+/**
+ * loadCachedFunction(astcache_t *cache, int fn, int line)
+ * Turns a cached function's records into AST nodes with a single allocation and one pass over
+ * the records, fixing record indexes up into pointers. Operator strings stay in the mapping.
+ *
+ * param *cache - the cache
+ * param fn - the function's index in the cache
+ * param line - the line the function's name is on now
+ * return astnode_t* - returns the FUNCTION node
+ **/
+astnode_t *loadCachedFunction(astcache_t *cache, int fn, int line){
+  const astcachefn_t *func = &cache->functions[fn];
+  astnode_t *nodes = calloc(func->numNodes, sizeof(astnode_t));
+  if(nodes == NULL){
+    fprintf(stderr, "Failed to allocate space for cached function.\n");
+    exit(1);
+  }
+  uint32_t i;
+  for(i = 0; i < func->numNodes; i++){
+    const astrec_t *rec = &cache->nodes[func->firstNode + i];
+    astnode_t *node = &nodes[i];
+    node->nodeType = rec->nodeType;
+    node->lineNum = line + rec->line;
+    node->file = NO_SYMBOL;
+    if(rec->nodeType == INTEGER)
+      node->fields.intVal = rec->fields.intVal;
+    else if(rec->nodeType == DATA)
+      node->fields.strVal = (char *) &cache->strings[rec->fields.str];
+    else if(rec->nodeType == SYMBOL)
+      node->fields.symbol = cachedSymbol(cache, rec->fields.symbol);
+    else{
+      astnode_t **children[3] = {&node->fields.children.left, &node->fields.children.middle, &node->fields.children.right};
+      int c;
+      for(c = 0; c < 3; c++){
+        uint32_t child = rec->fields.children[c];
+        *children[c] = (child == NO_NODE) ? NULL : &nodes[child - func->firstNode];
+      }
+    }
+  }
+  return nodes;
+}
+
+/**
+ * writeASTCache(const char *path, astnode_t *program, funcspan_t *spans, const char *source, size_t sourceLen, uint64_t sourceHash)
+ * Serializes the program's AST to a cache file. Each function's subtree is written in pre-order
+ * as a contiguous run of records. The file is written aside and renamed over the old cache, which
+ * may still be mapped.
+ *
+ * param *path - the cache file
+ * param *program - the first PROGRAM node of the program
+ * param *spans - where each function is in the source, in program order
+ * param *source - the source the program was parsed from
+ * param sourceLen - the length of the source
+ * param sourceHash - the hash of the whole source
+ * return void
+ **/
+void writeASTCache(const char *path, astnode_t *program, funcspan_t *spans, const char *source, size_t sourceLen, uint64_t sourceHash){
+  astcachefn_t *functions = NULL;
+  size_t numFunctions = 0, functionsCap = 0;
+  astrec_t *nodes = NULL;
+  size_t numNodes = 0, nodesCap = 0;
+  uint32_t *symbols = NULL;
+  size_t numSymbolsUsed = 0, symbolsCap = 0;
+  char *strings = NULL;
+  size_t stringsSize = 0, stringsCap = 0;
+  serframe_t *stack = NULL;
+  size_t depth = 0, stackCap = 0;
+  //Interned symbol ID to symbol table index, and the distinct operator strings written so far
+  uint32_t *symbolIndex = malloc(sizeof(uint32_t) * (numSymbols() + 1));
+  char *opStrings[64];
+  uint32_t opOffsets[64];
+  int numOps = 0;
+  if(symbolIndex == NULL){
+    fprintf(stderr, "Failed to allocate space for the AST cache.\n");
+    exit(1);
+  }
+  uint32_t i;
+  for(i = 0; i < numSymbols(); i++)
+    symbolIndex[i] = NO_SYMBOL;
+  //Offset 0 is the empty string
+  growArray((void **) &strings, &stringsCap, 1, 1);
+  strings[stringsSize++] = '\0';
+
+  for(; program != NULL; program = program->fields.children.right, spans++){
+    astnode_t *funcNode = program->fields.children.left;
+    growArray((void **) &functions, &functionsCap, numFunctions + 1, sizeof(astcachefn_t));
+    astcachefn_t *func = &functions[numFunctions++];
+    func->start = spans->start;
+    func->length = spans->length;
+    func->hash = hashBytes(&source[spans->start], spans->length);
+    func->fingerprint = spans->fingerprint;
+    func->firstNode = numNodes;
+    func->line = funcNode->lineNum;
+    growArray((void **) &stack, &stackCap, 1, sizeof(serframe_t));
+    stack[0].node = funcNode;
+    stack[0].parent = NO_NODE;
+    stack[0].slot = 0;
+    depth = 1;
+    while(depth > 0){
+      serframe_t frame = stack[--depth];
+      astnode_t *node = frame.node;
+      uint32_t index = numNodes++;
+      growArray((void **) &nodes, &nodesCap, numNodes, sizeof(astrec_t));
+      if(frame.parent != NO_NODE)
+        nodes[frame.parent].fields.children[frame.slot] = index;
+      astrec_t *rec = &nodes[index];
+      memset(rec, 0, sizeof(astrec_t));
+      rec->nodeType = node->nodeType;
+      rec->line = node->lineNum - funcNode->lineNum;
+      if(node->nodeType == INTEGER)
+        rec->fields.intVal = node->fields.intVal;
+      else if(node->nodeType == DATA){
+        int op;
+        for(op = 0; op < numOps; op++){
+          if(opStrings[op] == node->fields.strVal || strcmp(opStrings[op], node->fields.strVal) == 0)
+            break;
+        }
+        if(op == numOps){
+          size_t len = strlen(node->fields.strVal) + 1;
+          growArray((void **) &strings, &stringsCap, stringsSize + len, 1);
+          memcpy(&strings[stringsSize], node->fields.strVal, len);
+          if(numOps < 64){
+            opStrings[numOps] = node->fields.strVal;
+            opOffsets[numOps++] = stringsSize;
+          }
+          rec->fields.str = stringsSize;
+          stringsSize += len;
+        }
+        else
+          rec->fields.str = opOffsets[op];
+      }
+      else if(node->nodeType == SYMBOL){
+        uint32_t symbol = node->fields.symbol;
+        if(symbolIndex[symbol] == NO_SYMBOL){
+          char *name = symbolName(symbol);
+          size_t len = strlen(name) + 1;
+          growArray((void **) &strings, &stringsCap, stringsSize + len, 1);
+          memcpy(&strings[stringsSize], name, len);
+          growArray((void **) &symbols, &symbolsCap, numSymbolsUsed + 1, sizeof(uint32_t));
+          symbols[numSymbolsUsed] = stringsSize;
+          symbolIndex[symbol] = numSymbolsUsed++;
+          stringsSize += len;
+        }
+        rec->fields.symbol = symbolIndex[symbol];
+      }
+      else{
+        astnode_t *children[3] = {node->fields.children.left, node->fields.children.middle, node->fields.children.right};
+        int c;
+        //Pushed last to first so the left child is visited first
+        for(c = 2; c >= 0; c--){
+          rec->fields.children[c] = NO_NODE;
+          if(children[c] == NULL)
+            continue;
+          growArray((void **) &stack, &stackCap, depth + 1, sizeof(serframe_t));
+          stack[depth].node = children[c];
+          stack[depth].parent = index;
+          stack[depth].slot = c;
+          depth++;
+        }
+      }
+    }
+    func->numNodes = numNodes - func->firstNode;
+    func->name = nodes[func->firstNode + 1].fields.symbol;
+  }
+
+  //Lay the sections out after the header, 8 byte aligned
+  astcachehdr_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+  header.version = AST_CACHE_VERSION;
+  header.numFunctions = numFunctions;
+  header.numNodes = numNodes;
+  header.numSymbols = numSymbolsUsed;
+  header.functionsOffset = sizeof(astcachehdr_t);
+  header.nodesOffset = header.functionsOffset + numFunctions * sizeof(astcachefn_t);
+  header.symbolsOffset = header.nodesOffset + ((numNodes * sizeof(astrec_t) + 7) & ~(size_t) 7);
+  header.stringsOffset = header.symbolsOffset + ((numSymbolsUsed * sizeof(uint32_t) + 7) & ~(size_t) 7);
+  header.stringsSize = stringsSize;
+  header.sourceLen = sourceLen;
+  header.sourceHash = sourceHash;
+  size_t fileSize = header.stringsOffset + stringsSize;
+  char *file = calloc(1, fileSize);
+  if(file == NULL){
+    fprintf(stderr, "Failed to allocate space for the AST cache.\n");
+    exit(1);
+  }
+  memcpy(file + header.functionsOffset, functions, numFunctions * sizeof(astcachefn_t));
+  memcpy(file + header.nodesOffset, nodes, numNodes * sizeof(astrec_t));
+  memcpy(file + header.symbolsOffset, symbols, numSymbolsUsed * sizeof(uint32_t));
+  memcpy(file + header.stringsOffset, strings, stringsSize);
+  header.checksum = hashBytes(file + sizeof(astcachehdr_t), fileSize - sizeof(astcachehdr_t));
+  memcpy(file, &header, sizeof(header));
+
+  char tmpPath[LEN_PATH + 4];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  FILE *cacheFile = fopen(tmpPath, "wb");
+  if(cacheFile == NULL || fwrite(file, 1, fileSize, cacheFile) != fileSize || fclose(cacheFile) != 0
+     || rename(tmpPath, path) != 0){
+    fprintf(stderr, "Warning: failed to write AST cache %s.\n", path);
+    remove(tmpPath);
+  }
+  free(file);
+  free(functions);
+  free(nodes);
+  free(symbols);
+  free(strings);
+  free(stack);
+  free(symbolIndex);
+}
+
+/**
+ * countLines(const char *bytes, size_t len)
+ * Counts the newlines in a byte range.
+ *
+ * param *bytes - the bytes to count newlines in
+ * param len - the number of bytes
+ * return int - returns the number of newlines
+ **/
+static int countLines(const char *bytes, size_t len){
+  int lines = 0;
+  const char *end = bytes + len;
+  while((bytes = memchr(bytes, '\n', end - bytes)) != NULL){
+    lines++;
+    bytes++;
+  }
+  return lines;
+}
+
+/**
+ * parseIncremental()
+ * Parses the source file, reusing functions whose source text is unchanged since the cache was
+ * written. Functions are lexed on demand, so a reused function is neither lexed nor parsed beyond
+ * its first two tokens (which find it in the cache), and an unchanged file is not lexed at all.
+ * The cache is rewritten for the next build.
+ *
+ * return astnode_t* - returns the first PROGRAM node, or NULL if the source cannot be mapped, has directives or
+ *                      macros are defined with -D
+ **/
+astnode_t *parseIncremental(){
+  size_t len = 0;
+  const char *source = mapSource(&len);
+  if(source == NULL)
+    return NULL;
+  //Functions are matched by their own source text, which does not cover the macros and headers they use.
+  //Nothing here expands macros either, so -D macros need the full parse too.
+  if(memchr(source, '#', len) != NULL || hasMacroOptions()){
+    if(verbose)
+      fprintf(stderr, "AST cache: %s, parsing it all\n",
+              hasMacroOptions() ? "macros defined with -D" : "source has preprocessor directives");
+    munmap((void *) source, len);
+    return NULL;
+  }
+  astCache = openASTCache(astCachePath);
+  uint64_t sourceHash = hashBytes(source, len);
+  funcspan_t *spans = NULL;
+  size_t numSpans = 0, spansCap = 0;
+  uint64_t fingerprint = 0;
+  astnode_t *root = NULL;
+  astnode_t **nextFunction = &root;
+  int reused = 0;
+  tokenlist_t *tokens = NULL;
+  if(astCache != NULL && astCache->header->sourceLen == len && astCache->header->sourceHash == sourceHash){
+    uint32_t fn;
+    for(fn = 0; fn < astCache->header->numFunctions; fn++){
+      *nextFunction = createNode(PROGRAM, 0);
+      (*nextFunction)->fields.children.left = loadCachedFunction(astCache, fn, astCache->functions[fn].line);
+      nextFunction = &(*nextFunction)->fields.children.right;
+      growArray((void **) &spans, &spansCap, numSpans + 1, sizeof(funcspan_t));
+      spans[numSpans].start = astCache->functions[fn].start;
+      spans[numSpans].length = astCache->functions[fn].length;
+      spans[numSpans].line = astCache->functions[fn].line;
+      spans[numSpans++].fingerprint = astCache->functions[fn].fingerprint;
+      reused++;
+    }
+  }
+  if(root == NULL){
+    lexer_t *lexer = initBufferLexer(source, 0, len);
+    tokens = lexOnDemand(lexer);
+    tokens->fingerprinting = 1;
+    do{
+      token_t *first = peekN(tokens, 0);
+      token_t *name = peekN(tokens, 1);
+      uint64_t start = first->offset;
+      uint64_t length = 0;
+      astnode_t *funcNode = NULL;
+      int fn = -1;
+      if(astCache != NULL && first->type == INT_KEYW && name->type == IDENTIFIER)
+        fn = findCachedFunction(astCache, name->symbol);
+      if(fn >= 0 && astCache->functions[fn].length <= len - start
+         && hashBytes(&source[start], astCache->functions[fn].length) == astCache->functions[fn].hash){
+        defineFunction(name->symbol, name->lineNum);
+        length = astCache->functions[fn].length;
+        funcNode = loadCachedFunction(astCache, fn, name->lineNum);
+        fingerprint = astCache->functions[fn].fingerprint;
+        seekTokens(tokens, start + length, first->lineNum + countLines(&source[start], length));
+        reused++;
+      }
+      else{
+        tokens->fingerprint = FINGERPRINT_INIT;
+        funcNode = parseFunction(tokens);
+        length = lexer->bufOffset + lexer->pos - start;
+        fingerprint = tokens->fingerprint;
+        releaseTokens(tokens);
+      }
+      *nextFunction = createNode(PROGRAM, 0);
+      (*nextFunction)->fields.children.left = funcNode;
+      nextFunction = &(*nextFunction)->fields.children.right;
+      growArray((void **) &spans, &spansCap, numSpans + 1, sizeof(funcspan_t));
+      spans[numSpans].start = start;
+      spans[numSpans].length = length;
+      spans[numSpans].line = funcNode->lineNum;
+      spans[numSpans++].fingerprint = fingerprint;
+    } while(peek(tokens)->type != END_OF_INPUT);
+  }
+  if(verbose)
+    fprintf(stderr, "AST cache: reused %d of %zu functions\n", reused, numSpans);
+  //An unchanged source leaves the cache as it is
+  if(tokens != NULL)
+    writeASTCache(astCachePath, root, spans, source, len, sourceHash);
+  freeTokens(tokens);
+  munmap((void *) source, len);
+  programSpans = spans;
+  numProgramSpans = numSpans;
+  return root;
+}
+
+/**
+ * closeASTCache()
+ * Unmaps the cache read at the start of the build, once nothing points into it anymore.
+ * Also drops the function spans of the program.
+ *
+ * return void
+ **/
+void closeASTCache(){
+  free(programSpans);
+  programSpans = NULL;
+  numProgramSpans = 0;
+  if(astCache == NULL)
+    return;
+  munmap((void *) astCache->map, astCache->size);
+  free(astCache->symbolMap);
+  free(astCache->functionIndex);
+  free(astCache);
+  astCache = NULL;
+}
@@ -0,0 +1,97 @@
+#ifndef ASTCACHE_H_
+#define ASTCACHE_H_
+
+#include "parse.h"
+#include <stdint.h>
+
+//Identifies AST cache files, and the layout they were written with
+#define AST_CACHE_MAGIC "TWCCAST"
+#define AST_CACHE_VERSION 3
+//Child index of a missing child
+#define NO_NODE UINT32_MAX
+
+//Cache file header, followed by the function table, node records, symbol table and string table.
+//Sections are located by byte offsets from the start of the file and are 8 byte aligned.
+typedef struct astcachehdr_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t numFunctions;
+  uint32_t numNodes;
+  uint32_t numSymbols;
+  uint64_t functionsOffset;
+  uint64_t nodesOffset;
+  uint64_t symbolsOffset;
+  uint64_t stringsOffset;
+  uint64_t stringsSize;
+  uint64_t sourceLen;
+  uint64_t sourceHash;
+  uint64_t checksum;
+} astcachehdr_t;
+
+//A cached function: where its source text (int keyword through closing brace) was, its hash,
+//its token fingerprint, the contiguous range of node records holding its subtree, FUNCTION record
+//first, and the line of its name
+typedef struct astcachefn_t {
+  uint64_t start;
+  uint64_t length;
+  uint64_t hash;
+  uint64_t fingerprint;
+  uint32_t name;
+  uint32_t firstNode;
+  uint32_t numNodes;
+  int32_t line;
+} astcachefn_t;
+
+//A node record: astnode_t with children as record indexes (always past the parent's),
+//strings as string table offsets, symbols as symbol table indexes, and its line less its
+//function's, so an unchanged function that moved keeps its lines right
+typedef struct astrec_t {
+  uint32_t nodeType;
+  int32_t line;
+  union {
+    int32_t intVal;
+    uint32_t str;
+    uint32_t symbol;
+    uint32_t children[3];
+  } fields;
+} astrec_t;
+
+//A memory mapped cache file, used in place
+typedef struct astcache_t {
+  const char *map;
+  size_t size;
+  const astcachehdr_t *header;
+  const astcachefn_t *functions;
+  const astrec_t *nodes;
+  const uint32_t *symbols;
+  const char *strings;
+  uint32_t *symbolMap;
+  int *functionIndex;
+  size_t functionIndexCap;
+} astcache_t;
+
+//Where a function of the program is in the source, the fingerprint of its tokens and the line of its name
+typedef struct funcspan_t {
+  uint64_t start;
+  uint64_t length;
+  uint64_t fingerprint;
+  int line;
+} funcspan_t;
+
+extern char astCachePath[LEN_PATH];
+extern astcache_t *astCache;
+extern funcspan_t *programSpans;
+extern size_t numProgramSpans;
+
+uint64_t hashBytes(const char *bytes, size_t len);
+int setASTCachePath();
+astcache_t *openASTCache(const char *path);
+uint32_t cachedSymbol(astcache_t *cache, uint32_t index);
+int findCachedFunction(astcache_t *cache, uint32_t symbol);
+astnode_t *loadCachedFunction(astcache_t *cache, int fn, int line);
+void writeASTCache(const char *path, astnode_t *program, funcspan_t *spans, const char *source, size_t sourceLen,
+                   uint64_t sourceHash);
+astnode_t *parseIncremental();
+void closeASTCache();
+
+#endif // ASTCACHE_H_
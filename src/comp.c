@@ -2,36 +2,227 @@
 #include "lex.h"
 #include "parse.h"
 #include "gen.h"
+#include "dump.h"
+#include "scan.h"
+#include "astcache.h"
+#include "asmcache.h"
+#include "opt.h"
+#include "pp.h"
+#include "prof.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 char sourcePath[LEN_PATH];
+char outPath[LEN_PATH];
 
+/**
+ * usage(char *progName)
+ * Prints the usage message and exits.
+ *
+ * param *progName - the name the compiler was invoked as
+ * return void
+ **/
+void usage(char *progName){
+  fprintf(stderr, "Usage: %s [options] <source code file>...\n\n"
+          "  This compiler should generate an assembly file, assemblable and linkable with:\n"
+          "\tgcc <generated .s file> -m32 -o <output file> for x86.\n\n"
+          "  Pass - as the source file to read from stdin. Each of several source files is compiled to\n"
+          "  its own .s file, sharing the headers they include.\n\n"
+          "Options:\n"
+          "  -o <file>             write the assembly to <file> (- for stdout), with a single source file\n"
+          "  -I <dir>              look for included files in <dir>, after the including file's directory\n"
+          "  -D <name>[=<tokens>]  define a macro, to 1 without tokens\n"
+          "  -v                    print progress messages to stderr\n"
+          "  -g                    emit line information, for debuggers and profilers\n"
+          "  -j <n>                lex large files on <n> threads\n"
+          "  --pipeline            lex on a separate thread, overlapping lexing with parsing\n"
+          "  --ring-size=<n>       tokens the pipelined lexer may run ahead (default: %d)\n"
+          "  --no-simd             use the scalar lexer scanner even if SSE2/AVX2 are available\n"
+          "  --incremental         reuse unchanged functions' ASTs and assembly from caches next to the output\n"
+          "  --max-nesting=<n>     deepest expression nesting accepted (default: %d)\n"
+          "  -fno-dce              keep unreachable statements and dead stores\n"
+          "  -fno-cse              do not share repeated subexpressions within a statement\n"
+          "  -fno-cmov             always branch for if/else and ?:, never select with cmov\n"
+          "  -fno-licm             do not hoist loop invariant expressions out of loops\n"
+          "  -fno-unroll           do not unroll small counted loops\n"
+          "  -fno-jump-tables      lower every switch to a binary search of its cases\n"
+          "  -fno-inline           never inline calls\n"
+          "  -fno-fold             do not fold constant expressions\n"
+          "  -fno-omit-frame-pointer keep %%ebp as a frame pointer in leaf functions too (for profiling)\n"
+          "  -fno-tail-calls       return the value of a call instead of jumping to it\n"
+          "  -fprofile-generate[=<file>] count how often branches, loops and calls run, into <file> (default:\n"
+          "                        the output with .prof for .s) when the compiled program exits\n"
+          "  -fprofile-use[=<file>] lay out branches and pick what to inline and unroll by a profile\n"
+          "  --inline-threshold=<n> largest callee, in AST nodes less the call's cost, to inline (default: %d)\n"
+          "  --dump=<channels>     write JSON lines dumps of tokens,ast,ir,asm (off by default)\n"
+          "  --dump-dir=<dir>      directory for dump files (default: .)\n", progName, DEFAULT_RING_SIZE, DEFAULT_MAX_NESTING,
+          DEFAULT_INLINE_THRESHOLD);
+  exit(1);
+}
+
+/**
+ * compileFile(const char *path, int incremental, int pipelined, int numThreads, long ringSize)
+ * Compiles one source file to assembly
+ *
+ * param *path - the source file, - for stdin
+ * param incremental - whether to reuse the caches of the last build (--incremental)
+ * param pipelined - whether to lex on a separate thread (--pipeline)
+ * param numThreads - the number of threads to lex on (-j)
+ * param ringSize - tokens the pipelined lexer may run ahead (--ring-size)
+ * return void
+ **/
+static void compileFile(const char *path, int incremental, int pipelined, int numThreads, long ringSize){
+  strncpy(sourcePath, path, LEN_PATH-1);
+  //If source file extension is not .c (and not stdin), raise error and exit.
+  int sourceLen = strnlen(sourcePath, LEN_PATH);
+  if(strcmp(sourcePath, "-") != 0 && (sourceLen < 3 || strncmp(".c", &sourcePath[sourceLen-2], 2) != 0)){
+    fprintf(stderr, "Can only compile .c files!\n");
+    exit(1);
+  }
+  tokenlist_t *tokens = NULL;
+  astnode_t *progAST = NULL;
+  if(incremental && setASTCachePath())
+    progAST = parseIncremental();
+  incremental = (progAST != NULL);
+  if(progAST == NULL){
+    tokens = pipelined ? lexPipelined(ringSize) : lexParallel(numThreads);
+    preprocess(tokens);
+    progAST = parseProgram(tokens);
+    freePreprocessor(tokens);
+  }
+  checkCalls(progAST);
+  if(profileMode != PROFILE_NONE)
+    assignCounters(progAST);
+  optimize(progAST);
+  if(dumpEnabled(DUMP_AST))
+    dumpAST(progAST);
+  if(dumpEnabled(DUMP_IR))
+    dumpIR(progAST);
+  FILE *outFile = getOutFile();
+  if(incremental)
+    generateIncremental(progAST, outFile);
+  else
+    generate(progAST, outFile);
+  if(outFile == stdout)
+    fflush(outFile);
+  else
+    fclose(outFile);
+  closeDumps();
+  closeASTCache();
+  freeProfile();
+  freeTokens(tokens);
+}
 
 int main(int argc, char *argv[]) {
-  if(argc < 2){
-    fprintf(stderr, "Usage: %s <source code file>\n\n  This compiler should generate an assembly file, assemblable and linkable with:\n\tgcc <generated .s file> -m32 -o <output file> for x86.\n", argv[0]);
+  int i;
+  int pipelined = 0;
+  int incremental = 0;
+  int numThreads = 1;
+  SCAN_LEVEL simdLevel = SCAN_AUTO;
+  long ringSize = DEFAULT_RING_SIZE;
+  //Source files, at most one per argument
+  char **sources = (char **) malloc(argc*sizeof(char *));
+  int numSources = 0;
+  if(sources == NULL){
+    fprintf(stderr, "Failed to allocate space for the source file list.\n");
     exit(1);
   }
-  strncpy(sourcePath, argv[1], LEN_PATH);
-  //If source file extension is not .c, raise error and exit.
-  if(strncmp(".c", &sourcePath[strnlen(sourcePath, LEN_PATH)-2], 2) != 0){
-    fprintf(stderr, "Can only compile .c files!\n");
+  sourcePath[0] = '\0';
+  outPath[0] = '\0';
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-v") == 0)
+      verbose = 1;
+    else if(strcmp(argv[i], "-g") == 0)
+      debugLines = 1;
+    else if(strcmp(argv[i], "-o") == 0){
+      if(++i == argc)
+        usage(argv[0]);
+      strncpy(outPath, argv[i], LEN_PATH-1);
+    }
+    else if(strcmp(argv[i], "-I") == 0 || strcmp(argv[i], "-D") == 0){
+      if(i + 1 == argc)
+        usage(argv[0]);
+      if(argv[i++][1] == 'I')
+        addIncludeDir(argv[i]);
+      else
+        addMacroOption(argv[i]);
+    }
+    else if(strncmp(argv[i], "-I", 2) == 0)
+      addIncludeDir(&argv[i][2]);
+    else if(strncmp(argv[i], "-D", 2) == 0)
+      addMacroOption(&argv[i][2]);
+    else if(strcmp(argv[i], "-j") == 0){
+      if(++i == argc || (numThreads = atoi(argv[i])) < 1)
+        usage(argv[0]);
+    }
+    else if(strcmp(argv[i], "--no-simd") == 0)
+      simdLevel = SCAN_SCALAR;
+    else if(strcmp(argv[i], "--incremental") == 0)
+      incremental = 1;
+    else if(strcmp(argv[i], "--pipeline") == 0)
+      pipelined = 1;
+    else if(strncmp(argv[i], "--ring-size=", 12) == 0){
+      ringSize = strtol(&argv[i][12], NULL, 10);
+      if(ringSize < 2)
+        usage(argv[0]);
+    }
+    else if(strncmp(argv[i], "--max-nesting=", 14) == 0){
+      if((maxNesting = atoi(&argv[i][14])) < 1)
+        usage(argv[0]);
+    }
+    else if(strncmp(argv[i], "--inline-threshold=", 19) == 0){
+      if((inlineThreshold = atoi(&argv[i][19])) < 0)
+        usage(argv[0]);
+    }
+    else if(strncmp(argv[i], "-fno-", 5) == 0){
+      if(disableOptimization(&argv[i][5]) != 0)
+        usage(argv[0]);
+    }
+    else if(strncmp(argv[i], "-fprofile-generate", 18) == 0 && (argv[i][18] == '\0' || argv[i][18] == '='))
+      setProfileOption(PROFILE_GENERATE, &argv[i][18 + (argv[i][18] == '=')]);
+    else if(strncmp(argv[i], "-fprofile-use", 13) == 0 && (argv[i][13] == '\0' || argv[i][13] == '='))
+      setProfileOption(PROFILE_USE, &argv[i][13 + (argv[i][13] == '=')]);
+    else if(strncmp(argv[i], "--dump=", 7) == 0){
+      if(parseDumpSpec(&argv[i][7]) != 0)
+        exit(1);
+    }
+    else if(strncmp(argv[i], "--dump-dir=", 11) == 0)
+      setDumpDir(&argv[i][11]);
+    else if(argv[i][0] == '-' && argv[i][1] != '\0')
+      usage(argv[0]);
+    else
+      sources[numSources++] = argv[i];
+  }
+  if(numSources == 0)
+    usage(argv[0]);
+  if(numSources > 1 && outPath[0] != '\0'){
+    fprintf(stderr, "Cannot use -o with several source files.\n");
     exit(1);
   }
-  initRegexp();
-  tokenlist_t *tokens = lex();
-  //printf("Token List Size: %d\n", tokens->numTokens);
-  printTokens(tokens);
-  astnode_t * progAST = parseProgram(tokens);
-  //printf("── printing AST ──\n");
-  printAST(progAST);
-  FILE *outFile = getOutFile();
-  generate(progAST, outFile);
+  if(numSources > 1 && profileOption[0] != '\0'){
+    fprintf(stderr, "Cannot name the profile file with several source files.\n");
+    exit(1);
+  }
+  //Profiles are not kept in the caches
+  if(incremental && profileMode != PROFILE_NONE){
+    fprintf(stderr, "Cannot use --incremental with -fprofile-generate or -fprofile-use.\n");
+    exit(1);
+  }
+  initScan(simdLevel);
+  if(verbose)
+    fprintf(stderr, "Lexer scanner: %s\n", scanLevelName(scanLevel));
+  for(i = 0; i < numSources; i++){
+    //Each file gets its own default output and a program of its own
+    if(numSources > 1)
+      outPath[0] = '\0';
+    forgetFunctions();
+    compileFile(sources[i], incremental, pipelined, numThreads, ringSize);
+  }
   //Free's
-  freeTokens(tokens);
-  freeRegs();
+  free(sources);
+  freeHeaders();
+  freeSymbols();
   return 0;
 }
@@ -0,0 +1,663 @@
+#include "dump.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int verbose = 0;
+int dumpMask = 0;
+
+char *dumpDir = ".";
+char *channelNames[NUM_DUMP_CHANNELS] = {"tokens", "ast", "ir", "asm"};
+FILE *channelSinks[NUM_DUMP_CHANNELS] = {NULL};
+
+/**
+ * parseDumpSpec(char *spec)
+ * Parses the comma separated channel list of a --dump= option and enables those channels.
+ *
+ * param *spec - the channel list, e.g. "tokens,ast"
+ * return int - returns 0 on success, -1 if an unknown channel was named
+ **/
+int parseDumpSpec(char *spec){
+  char *start = spec;
+  while(*start != '\0'){
+    size_t len = strcspn(start, ",");
+    int i;
+    for(i = 0; i < NUM_DUMP_CHANNELS; i++){
+      if(strlen(channelNames[i]) == len && strncmp(start, channelNames[i], len) == 0){
+        dumpMask |= 1 << i;
+        break;
+      }
+    }
+    if(i == NUM_DUMP_CHANNELS){
+      fprintf(stderr, "Unknown dump channel '%.*s' (expected tokens, ast, ir or asm).\n", (int) len, start);
+      return -1;
+    }
+    start += len;
+    if(*start == ',')
+      start++;
+  }
+  return 0;
+}
+
+/**
+ * setDumpDir(char *dir)
+ * Sets the directory channel sinks are created in.
+ *
+ * param *dir - the directory to write <source>.<channel>.jsonl files to
+ * return void
+ **/
+void setDumpDir(char *dir){
+  dumpDir = dir;
+}
+
+/**
+ * dumpSink(DUMP_CHANNEL channel)
+ * Returns the buffered sink for a channel, opening <dumpDir>/<source>.<channel>.jsonl on first use.
+ *
+ * param channel - the channel to get the sink of
+ * return FILE* - returns the channel's sink
+ **/
+FILE *dumpSink(DUMP_CHANNEL channel){
+  if(channelSinks[channel] != NULL)
+    return channelSinks[channel];
+  //Name the sink after the source file, without directories or the .c extension
+  char *stem = strrchr(sourcePath, '/');
+  stem = (stem == NULL) ? sourcePath : stem + 1;
+  if(strcmp(stem, "-") == 0)
+    stem = "stdin";
+  int stemLen = strnlen(stem, LEN_PATH);
+  if(stemLen > 2 && strcmp(&stem[stemLen-2], ".c") == 0)
+    stemLen -= 2;
+  char dumpPath[LEN_PATH];
+  snprintf(dumpPath, LEN_PATH, "%s/%.*s.%s.jsonl", dumpDir, stemLen, stem, channelNames[channel]);
+  FILE *sink = fopen(dumpPath, "w");
+  if(sink == NULL){
+    fprintf(stderr, "Failed to open dump file %s for writing.\n", dumpPath);
+    exit(1);
+  }
+  setvbuf(sink, NULL, _IOFBF, DUMP_BUF_SIZE);
+  channelSinks[channel] = sink;
+  return sink;
+}
+
+/**
+ * closeDumps()
+ * Flushes and closes every opened channel sink.
+ *
+ * return void
+ **/
+void closeDumps(){
+  int i;
+  for(i = 0; i < NUM_DUMP_CHANNELS; i++){
+    if(channelSinks[i] != NULL){
+      fclose(channelSinks[i]);
+      channelSinks[i] = NULL;
+    }
+  }
+}
+
+/**
+ * dumpJSONString(FILE *sink, const char *str)
+ * Writes a string to the sink as a quoted, escaped JSON string.
+ *
+ * param *sink - the sink to write to
+ * param *str - the string to write
+ * return void
+ **/
+void dumpJSONString(FILE *sink, const char *str){
+  putc('"', sink);
+  for(; *str != '\0'; str++){
+    unsigned char c = *str;
+    if(c == '"' || c == '\\'){
+      putc('\\', sink);
+      putc(c, sink);
+    }
+    else if(c == '\t')
+      fputs("\\t", sink);
+    else if(c == '\n')
+      fputs("\\n", sink);
+    else if(c < 0x20)
+      fprintf(sink, "\\u%04x", c);
+    else
+      putc(c, sink);
+  }
+  putc('"', sink);
+}
+
+/**
+ * dumpToken(token_t *token)
+ * Writes a token to the tokens channel as a JSON line.
+ *
+ * param *token - the token to dump
+ * return void
+ **/
+void dumpToken(token_t *token){
+  FILE *sink = dumpSink(DUMP_TOKENS);
+  fprintf(sink, "{\"line\":%d,\"type\":\"%s\",\"value\":", token->lineNum, tokenTypeName(token->type));
+  dumpJSONString(sink, token->value);
+  if(token->symbol != NO_SYMBOL)
+    fprintf(sink, ",\"symbol\":%u", token->symbol);
+  fputs("}\n", sink);
+}
+
+/**
+ * dumpASTStatements(FILE *sink, astnode_t *statement)
+ * Writes a chain of statements to the sink as a JSON array
+ *
+ * param *sink - the sink to write to
+ * param *statement - the first STATEMENT node of the chain
+ * return void
+ **/
+void dumpASTStatements(FILE *sink, astnode_t *statement){
+  putc('[', sink);
+  astnode_t *first = statement;
+  for(; statement != NULL; statement = statement->fields.children.right){
+    if(statement != first)
+      putc(',', sink);
+    dumpASTNode(sink, statement);
+  }
+  putc(']', sink);
+}
+
+/**
+ * dumpASTNode(FILE *sink, astnode_t *node)
+ * Writes an AST node and its children to the sink as a nested JSON object. Children are
+ * visited with an explicit stack so deep expressions do not use up the C stack.
+ *
+ * param *sink - the sink to write to
+ * param *node - the node to write
+ * return void
+ **/
+void dumpASTNode(FILE *sink, astnode_t *node){
+  aststack_t stack = {0};
+  pushFrame(&stack, node);
+  while(stack.depth > 0){
+    astframe_t *frame = &stack.frames[stack.depth-1];
+    node = frame->node;
+    int state = frame->state++;
+    if(node == NULL){
+      fputs("null", sink);
+      stack.depth--;
+      continue;
+    }
+    if(state == 0)
+      fprintf(sink, "{\"kind\":\"%s\"", astTypeName(node->nodeType));
+    switch(node->nodeType){
+    case FUNCTION:
+      fputs(",\"name\":", sink);
+      dumpJSONString(sink, symbolName(node->fields.children.left->fields.symbol));
+      fputs(",\"params\":[", sink);
+      astnode_t *param = node->fields.children.middle;
+      for(; param != NULL; param = param->fields.children.right){
+        dumpJSONString(sink, symbolName(param->fields.children.left->fields.symbol));
+        if(param->fields.children.right != NULL)
+          putc(',', sink);
+      }
+      fputs("],\"body\":", sink);
+      dumpASTStatements(sink, node->fields.children.right);
+      break;
+    //The arguments nest, each ARGUMENT holding the next one
+    case CALL:
+      if(state == 0){
+        fputs(",\"name\":", sink);
+        dumpJSONString(sink, symbolName(node->fields.children.left->fields.symbol));
+        fputs(",\"args\":", sink);
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      break;
+    case ARGUMENT:
+      if(state < 2){
+        fputs((state == 0) ? ",\"expr\":" : ",\"next\":", sink);
+        pushFrame(&stack, (state == 0) ? node->fields.children.left : node->fields.children.right);
+        continue;
+      }
+      break;
+    case STATEMENT:
+      if(state == 0){
+        fputs(",\"stmt\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      break;
+    case RETURN:
+      if(state == 0){
+        fputs(",\"expr\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      break;
+    case IF:
+      if(state == 0){
+        fputs(",\"cond\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      fputs(",\"then\":", sink);
+      dumpASTStatements(sink, node->fields.children.middle);
+      if(node->fields.children.right != NULL){
+        fputs(",\"else\":", sink);
+        dumpASTStatements(sink, node->fields.children.right);
+      }
+      break;
+    //A for(;;) loop has a null condition
+    case WHILE:
+    case DO_WHILE:
+      if(state == 0){
+        fputs(",\"cond\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      fputs(",\"body\":", sink);
+      dumpASTStatements(sink, node->fields.children.middle);
+      if(node->fields.children.right != NULL){
+        fputs(",\"step\":", sink);
+        dumpASTStatements(sink, node->fields.children.right);
+      }
+      break;
+    case SWITCH:
+      if(state == 0){
+        fputs(",\"expr\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      fputs(",\"body\":", sink);
+      dumpASTStatements(sink, node->fields.children.middle);
+      break;
+    case CASE:
+      fprintf(sink, ",\"value\":%d", node->fields.children.left->fields.intVal);
+      break;
+    case TERNARY:
+      if(state < 3){
+        fputs((state == 0) ? ",\"cond\":" : (state == 1) ? ",\"then\":" : ",\"else\":", sink);
+        pushFrame(&stack, (state == 0) ? node->fields.children.left
+                  : (state == 1) ? node->fields.children.middle : node->fields.children.right);
+        continue;
+      }
+      break;
+    case DECLARATION:
+    case ASSIGNMENT:
+      if(state == 0){
+        fputs(",\"name\":", sink);
+        dumpJSONString(sink, symbolName(node->fields.children.left->fields.symbol));
+        fputs(",\"value\":", sink);
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      break;
+    case INTEGER:
+      fprintf(sink, ",\"value\":%d", node->fields.intVal);
+      break;
+    case SHARED:
+      if(state == 0){
+        fprintf(sink, ",\"temp\":%d,\"expr\":", node->fields.children.right->fields.intVal);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      break;
+    case UNARY_OP:
+      if(state == 0){
+        fputs(",\"op\":", sink);
+        dumpJSONString(sink, node->fields.children.left->fields.strVal);
+        fputs(",\"operand\":", sink);
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      break;
+    case BINARY_OP:
+      if(state == 0){
+        fputs(",\"op\":", sink);
+        dumpJSONString(sink, node->fields.children.middle->fields.strVal);
+        fputs(",\"left\":", sink);
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      if(state == 1){
+        fputs(",\"right\":", sink);
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      break;
+    case DATA:
+      fputs(",\"value\":", sink);
+      dumpJSONString(sink, node->fields.strVal);
+      break;
+    case SYMBOL:
+      fprintf(sink, ",\"symbol\":%u,\"name\":", node->fields.symbol);
+      dumpJSONString(sink, symbolName(node->fields.symbol));
+      break;
+    default:
+      break;
+    }
+    putc('}', sink);
+    stack.depth--;
+  }
+  freeASTStack(&stack);
+}
+
+/**
+ * dumpAST(astnode_t *root)
+ * Writes the AST to the ast channel, one JSON line per function.
+ *
+ * param *root - the PROGRAM node of the AST
+ * return void
+ **/
+void dumpAST(astnode_t *root){
+  if(root == NULL)
+    return;
+  FILE *sink = dumpSink(DUMP_AST);
+  if(root->nodeType != PROGRAM){
+    dumpASTNode(sink, root);
+    putc('\n', sink);
+    return;
+  }
+  for(; root != NULL; root = root->fields.children.right){
+    dumpASTNode(sink, root->fields.children.left);
+    putc('\n', sink);
+  }
+}
+
+/**
+ * pushId(int **ids, int *numIds, int *idsCap, int id)
+ * Pushes the id of a finished value on dumpIRNode()'s operand id stack
+ *
+ * param **ids - the stack
+ * param *numIds - the number of ids on it
+ * param *idsCap - its capacity
+ * param id - the id to push
+ * return void
+ **/
+static void pushId(int **ids, int *numIds, size_t *idsCap, int id){
+  growArray((void **) ids, idsCap, *numIds + 1, sizeof(int));
+  (*ids)[(*numIds)++] = id;
+}
+
+/**
+ * dumpIRNode(FILE *sink, char *funcName, astnode_t *node, int *nextId)
+ * Writes the post-order (evaluation order) linearization of an expression, one JSON line per value.
+ * The expression is walked with an explicit stack, keeping the ids of finished operands on a second one.
+ *
+ * param *sink - the sink to write to
+ * param *funcName - the name of the function the expression belongs to
+ * param *node - the expression to linearize
+ * param *nextId - the next free value id in the function
+ * return int - returns the id of the value computed by node
+ **/
+int dumpIRNode(FILE *sink, char *funcName, astnode_t *node, int *nextId){
+  aststack_t stack = {0};
+  int *ids = NULL;
+  int numIds = 0;
+  size_t idsCap = 0;
+  //Ids of the statement's SHARED values by temporary, -1 until computed
+  int *tempIds = NULL;
+  size_t tempIdsCap = 0;
+  pushFrame(&stack, node);
+  while(stack.depth > 0){
+    astframe_t *frame = &stack.frames[stack.depth-1];
+    node = frame->node;
+    int state = frame->state++;
+    int args[3] = {-1, -1, -1};
+    int numArgs = 0;
+    char *op = NULL;
+    char *name = NULL;
+    if(node->nodeType == UNARY_OP){
+      if(state == 0){
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      numArgs = 1;
+      op = node->fields.children.left->fields.strVal;
+    }
+    else if(node->nodeType == BINARY_OP){
+      if(state < 2){
+        pushFrame(&stack, (state == 0) ? node->fields.children.left : node->fields.children.right);
+        continue;
+      }
+      numArgs = 2;
+      op = node->fields.children.middle->fields.strVal;
+    }
+    //Both arms are listed before the select, whichever way the code generator lowers it
+    else if(node->nodeType == TERNARY){
+      if(state < 3){
+        pushFrame(&stack, (state == 0) ? node->fields.children.left
+                  : (state == 1) ? node->fields.children.middle : node->fields.children.right);
+        continue;
+      }
+      numArgs = 3;
+      op = "select";
+    }
+    //Only an if's condition, its branches follow as statements of their own
+    else if(node->nodeType == IF){
+      if(state == 0){
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      numArgs = 1;
+      op = "if";
+    }
+    else if(node->nodeType == BREAK || node->nodeType == CONTINUE)
+      op = (node->nodeType == BREAK) ? "break" : "continue";
+    //Arguments are pushed last to first, by an "arg" line each, which the call pops
+    else if(node->nodeType == ARGUMENT){
+      if(state == 0 && node->fields.children.right == NULL)
+        state = frame->state++;
+      if(state < 2){
+        pushFrame(&stack, (state == 0) ? node->fields.children.right : node->fields.children.left);
+        continue;
+      }
+      numArgs = 1;
+      op = "arg";
+    }
+    else if(node->nodeType == CALL){
+      if(state == 0 && node->fields.children.right != NULL){
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      astnode_t *arg = node->fields.children.right;
+      for(; arg != NULL; arg = arg->fields.children.right)
+        numIds--;
+      op = "call";
+      name = symbolName(node->fields.children.left->fields.symbol);
+    }
+    else if(node->nodeType == SWITCH){
+      if(state == 0){
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      numArgs = 1;
+      op = "switch";
+    }
+    else if(node->nodeType == CASE || node->nodeType == DEFAULT)
+      op = (node->nodeType == CASE) ? "case" : "default";
+    else if(node->nodeType == RETURN){
+      if(state == 0){
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      numArgs = 1;
+      op = "return";
+    }
+    else if(node->nodeType == DECLARATION || node->nodeType == ASSIGNMENT){
+      if(state == 0 && node->fields.children.right != NULL){
+        pushFrame(&stack, node->fields.children.right);
+        continue;
+      }
+      numArgs = (node->fields.children.right != NULL);
+      op = (node->nodeType == DECLARATION) ? "decl" : "store";
+      name = symbolName(node->fields.children.left->fields.symbol);
+    }
+    else if(node->nodeType == SYMBOL){
+      op = "load";
+      name = symbolName(node->fields.symbol);
+    }
+    //A common subexpression is only linearized where it is first used, later uses refer to its id
+    else if(node->nodeType == SHARED){
+      int temp = node->fields.children.right->fields.intVal;
+      if((size_t) temp >= tempIdsCap){
+        size_t oldCap = tempIdsCap;
+        growArray((void **) &tempIds, &tempIdsCap, (size_t) temp + 1, sizeof(int));
+        memset(&tempIds[oldCap], 0xff, (tempIdsCap - oldCap)*sizeof(int));
+      }
+      if(state == 0 && tempIds[temp] < 0){
+        pushFrame(&stack, node->fields.children.left);
+        continue;
+      }
+      if(state == 1)
+        tempIds[temp] = ids[numIds-1];
+      else
+        pushId(&ids, &numIds, &idsCap, tempIds[temp]);
+      stack.depth--;
+      continue;
+    }
+    //Operand ids were pushed in evaluation order
+    numIds -= numArgs;
+    if(numArgs > 0)
+      args[0] = ids[numIds];
+    if(numArgs > 1)
+      args[1] = ids[numIds + 1];
+    if(numArgs > 2)
+      args[2] = ids[numIds + 2];
+    int id = (*nextId)++;
+    fputs("{\"fn\":", sink);
+    dumpJSONString(sink, funcName);
+    fprintf(sink, ",\"id\":%d,\"kind\":\"%s\"", id, astTypeName(node->nodeType));
+    if(node->nodeType == INTEGER)
+      fprintf(sink, ",\"value\":%d", node->fields.intVal);
+    else if(node->nodeType == CASE)
+      fprintf(sink, ",\"value\":%d", node->fields.children.left->fields.intVal);
+    if(op != NULL){
+      fputs(",\"op\":", sink);
+      dumpJSONString(sink, op);
+    }
+    if(name != NULL){
+      fputs(",\"name\":", sink);
+      dumpJSONString(sink, name);
+    }
+    if(node->nodeType == CALL){
+      int argc = 0;
+      astnode_t *arg = node->fields.children.right;
+      for(; arg != NULL; arg = arg->fields.children.right)
+        argc++;
+      fprintf(sink, ",\"argc\":%d", argc);
+    }
+    if(args[2] != -1)
+      fprintf(sink, ",\"args\":[%d,%d,%d]", args[0], args[1], args[2]);
+    else if(args[1] != -1)
+      fprintf(sink, ",\"args\":[%d,%d]", args[0], args[1]);
+    else if(args[0] != -1)
+      fprintf(sink, ",\"args\":[%d]", args[0]);
+    fputs("}\n", sink);
+    pushId(&ids, &numIds, &idsCap, id);
+    stack.depth--;
+  }
+  int rootId = ids[0];
+  free(ids);
+  free(tempIds);
+  freeASTStack(&stack);
+  return rootId;
+}
+
+/**
+ * dumpIRStatements(FILE *sink, char *funcName, astnode_t *statement, int *nextId)
+ * Writes the linearization of a chain of statements. The branches of an if follow its "if"
+ * line, the else branch after an "else" line, and an "endif" line closes it. A loop opens with
+ * a "loop" (or "dowhile") line followed by its body, its step after a "step" line, then its
+ * condition, tested by the "endloop" line closing it. A "switch" line is followed by its body,
+ * with "case" and "default" lines for its labels, and an "endswitch" line.
+ *
+ * param *sink - the sink to write to
+ * param *funcName - the name of the function the statements belong to
+ * param *statement - the first STATEMENT node of the chain
+ * param *nextId - the next free value id in the function
+ * return void
+ **/
+void dumpIRStatements(FILE *sink, char *funcName, astnode_t *statement, int *nextId){
+  for(; statement != NULL; statement = statement->fields.children.right){
+    astnode_t *content = statement->fields.children.left;
+    if(content->nodeType == WHILE || content->nodeType == DO_WHILE){
+      const char *kind = astTypeName(content->nodeType);
+      fputs("{\"fn\":", sink);
+      dumpJSONString(sink, funcName);
+      fprintf(sink, ",\"id\":%d,\"kind\":\"%s\",\"op\":\"%s\"}\n", (*nextId)++, kind,
+              (content->nodeType == WHILE) ? "loop" : "dowhile");
+      dumpIRStatements(sink, funcName, content->fields.children.middle, nextId);
+      fputs("{\"fn\":", sink);
+      dumpJSONString(sink, funcName);
+      fprintf(sink, ",\"id\":%d,\"kind\":\"%s\",\"op\":\"step\"}\n", (*nextId)++, kind);
+      dumpIRStatements(sink, funcName, content->fields.children.right, nextId);
+      int cond = -1;
+      if(content->fields.children.left != NULL)
+        cond = dumpIRNode(sink, funcName, content->fields.children.left, nextId);
+      fputs("{\"fn\":", sink);
+      dumpJSONString(sink, funcName);
+      fprintf(sink, ",\"id\":%d,\"kind\":\"%s\",\"op\":\"endloop\"", (*nextId)++, kind);
+      if(cond >= 0)
+        fprintf(sink, ",\"args\":[%d]", cond);
+      fputs("}\n", sink);
+      continue;
+    }
+    dumpIRNode(sink, funcName, content, nextId);
+    if(content->nodeType == SWITCH){
+      dumpIRStatements(sink, funcName, content->fields.children.middle, nextId);
+      fputs("{\"fn\":", sink);
+      dumpJSONString(sink, funcName);
+      fprintf(sink, ",\"id\":%d,\"kind\":\"SWITCH\",\"op\":\"endswitch\"}\n", (*nextId)++);
+      continue;
+    }
+    if(content->nodeType != IF)
+      continue;
+    dumpIRStatements(sink, funcName, content->fields.children.middle, nextId);
+    const char *markers[2] = {"else", "endif"};
+    int i;
+    for(i = (content->fields.children.right == NULL); i < 2; i++){
+      fputs("{\"fn\":", sink);
+      dumpJSONString(sink, funcName);
+      fprintf(sink, ",\"id\":%d,\"kind\":\"IF\",\"op\":\"%s\"}\n", (*nextId)++, markers[i]);
+      if(i == 0)
+        dumpIRStatements(sink, funcName, content->fields.children.right, nextId);
+    }
+  }
+}
+
+/**
+ * dumpIR(astnode_t *root)
+ * Writes the linearized form of every function body to the ir channel.
+ *
+ * param *root - the PROGRAM node of the AST
+ * return void
+ **/
+void dumpIR(astnode_t *root){
+  if(root == NULL)
+    return;
+  FILE *sink = dumpSink(DUMP_IR);
+  astnode_t *program = NULL;
+  for(program = root; program != NULL; program = program->fields.children.right){
+    astnode_t *funcNode = (root->nodeType == PROGRAM) ? program->fields.children.left : root;
+    char *funcName = symbolName(funcNode->fields.children.left->fields.symbol);
+    int nextId = 0;
+    dumpIRStatements(sink, funcName, funcNode->fields.children.right, &nextId);
+    if(root->nodeType != PROGRAM)
+      break;
+  }
+}
+
+/**
+ * dumpAsm(const char *funcName, const char *text)
+ * Writes one line of emitted assembly to the asm channel.
+ *
+ * param *funcName - the function being generated, or NULL outside of functions
+ * param *text - the assembly line, without its trailing newline
+ * return void
+ **/
+void dumpAsm(const char *funcName, const char *text){
+  FILE *sink = dumpSink(DUMP_ASM);
+  fputs("{\"fn\":", sink);
+  if(funcName == NULL)
+    fputs("null", sink);
+  else
+    dumpJSONString(sink, funcName);
+  fputs(",\"text\":", sink);
+  dumpJSONString(sink, text);
+  fputs("}\n", sink);
+}
@@ -0,0 +1,34 @@
+#ifndef DUMP_H_
+#define DUMP_H_
+
+#include "parse.h"
+#include <stdio.h>
+
+//Diagnostic dump channels, selected with --dump=tokens,ast,ir,asm
+typedef enum DUMP_CHANNEL {DUMP_TOKENS, DUMP_AST, DUMP_IR, DUMP_ASM, NUM_DUMP_CHANNELS} DUMP_CHANNEL;
+
+//Size of the stdio buffer given to each channel sink
+#define DUMP_BUF_SIZE (1 << 20)
+
+extern int verbose;
+extern int dumpMask;
+
+#define dumpEnabled(channel) (dumpMask & (1 << (channel)))
+
+//Channel setup functions
+int parseDumpSpec(char *spec);
+void setDumpDir(char *dir);
+FILE *dumpSink(DUMP_CHANNEL channel);
+void closeDumps();
+
+//JSON lines writers
+void dumpJSONString(FILE *sink, const char *str);
+void dumpToken(token_t *token);
+void dumpASTNode(FILE *sink, astnode_t *node);
+void dumpASTStatements(FILE *sink, astnode_t *statement);
+void dumpAST(astnode_t *root);
+void dumpIRStatements(FILE *sink, char *funcName, astnode_t *statement, int *nextId);
+void dumpIR(astnode_t *root);
+void dumpAsm(const char *funcName, const char *text);
+
+#endif // DUMP_H_
@@ -0,0 +1,787 @@
+#include "flow.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Explicit stack of the expression walks
+static astnode_t **walkStack = NULL;
+static size_t walkStackCap = 0;
+//Blocks break and continue jump to in each loop or switch around the chain buildChain() is on,
+//innermost last; a switch passes continue on to the loop around it
+static int *jumpTargets = NULL;
+static size_t jumpTargetsCap = 0;
+static size_t numJumpTargets = 0;
+//Block of the innermost switch being built, which continues to each of its case labels
+static int switchBlock = -1;
+
+/**
+ * newBlock(cfg_t *cfg)
+ * Adds an empty basic block to a CFG
+ *
+ * param *cfg - the CFG
+ * return int - returns the index of the new block
+ **/
+static int newBlock(cfg_t *cfg){
+  growArray((void **) &cfg->blocks, &cfg->blocksCap, cfg->numBlocks + 1, sizeof(block_t));
+  memset(&cfg->blocks[cfg->numBlocks], 0, sizeof(block_t));
+  return cfg->numBlocks++;
+}
+
+/**
+ * addStatement(cfg_t *cfg, int block, astnode_t *statement)
+ * Appends a STATEMENT node to a basic block
+ *
+ * param *cfg - the CFG
+ * param block - the block's index
+ * param *statement - the STATEMENT node
+ * return void
+ **/
+static void addStatement(cfg_t *cfg, int block, astnode_t *statement){
+  block_t *b = &cfg->blocks[block];
+  growArray((void **) &b->statements, &b->statementsCap, b->numStatements + 1, sizeof(astnode_t *));
+  b->statements[b->numStatements++] = statement;
+}
+
+/**
+ * addSucc(cfg_t *cfg, int block, int succ)
+ * Records that control may continue from one block to another
+ *
+ * param *cfg - the CFG
+ * param block - the block control leaves
+ * param succ - the block control continues to
+ * return void
+ **/
+static void addSucc(cfg_t *cfg, int block, int succ){
+  block_t *b = &cfg->blocks[block];
+  growArray((void **) &b->succs, &b->succsCap, b->numSuccs + 1, sizeof(int));
+  b->succs[b->numSuccs++] = succ;
+}
+
+static int buildChain(cfg_t *cfg, astnode_t *statement, int block);
+
+/**
+ * buildLoop(cfg_t *cfg, astnode_t *statement, int block)
+ * Adds a loop to the CFG. A while loop's statement, which evaluates its condition, is alone in a
+ * header block that continues to the body and past the loop; the body continues to the step and
+ * the step back to the header. A do-while's body comes first and is its header, and the block
+ * with its statement continues back to it or past the loop.
+ *
+ * param *cfg - the CFG
+ * param *statement - the loop's STATEMENT node
+ * param block - the block control is in before the loop
+ * return int - returns the block after the loop
+ **/
+static int buildLoop(cfg_t *cfg, astnode_t *statement, int block){
+  astnode_t *loopNode = statement->fields.children.left;
+  int isWhile = (loopNode->nodeType == WHILE);
+  int condBlock = newBlock(cfg);
+  int bodyBlock = isWhile ? newBlock(cfg) : condBlock;
+  if(!isWhile)
+    condBlock = newBlock(cfg);
+  int stepBlock = isWhile ? newBlock(cfg) : condBlock;
+  int exitBlock = newBlock(cfg);
+  addStatement(cfg, condBlock, statement);
+  cfg->blocks[isWhile ? condBlock : bodyBlock].loop = statement;
+  if(block >= 0)
+    addSucc(cfg, block, isWhile ? condBlock : bodyBlock);
+  if(isWhile)
+    addSucc(cfg, condBlock, bodyBlock);
+  growArray((void **) &jumpTargets, &jumpTargetsCap, 2*numJumpTargets + 2, sizeof(int));
+  jumpTargets[2*numJumpTargets] = exitBlock;
+  jumpTargets[2*numJumpTargets + 1] = stepBlock;
+  numJumpTargets++;
+  int bodyEnd = buildChain(cfg, loopNode->fields.children.middle, bodyBlock);
+  numJumpTargets--;
+  if(bodyEnd >= 0)
+    addSucc(cfg, bodyEnd, stepBlock);
+  if(isWhile){
+    int stepEnd = buildChain(cfg, loopNode->fields.children.right, stepBlock);
+    addSucc(cfg, stepEnd, condBlock);
+  }
+  else
+    addSucc(cfg, condBlock, bodyBlock);
+  //Without a condition, only a break leaves the loop
+  if(loopNode->fields.children.left != NULL)
+    addSucc(cfg, condBlock, exitBlock);
+  return exitBlock;
+}
+
+/**
+ * buildSwitch(cfg_t *cfg, astnode_t *switchNode, int block)
+ * Adds a switch's body to the CFG. The block evaluating the switch continues to each case label,
+ * see buildChain(), and past the switch if it has no default label.
+ *
+ * param *cfg - the CFG
+ * param *switchNode - the SWITCH node
+ * param block - the block holding the switch's statement
+ * return int - returns the block after the switch
+ **/
+static int buildSwitch(cfg_t *cfg, astnode_t *switchNode, int block){
+  int exitBlock = newBlock(cfg);
+  int outerSwitch = switchBlock;
+  switchBlock = block;
+  growArray((void **) &jumpTargets, &jumpTargetsCap, 2*numJumpTargets + 2, sizeof(int));
+  jumpTargets[2*numJumpTargets] = exitBlock;
+  jumpTargets[2*numJumpTargets + 1] = (numJumpTargets > 0) ? jumpTargets[2*numJumpTargets - 1] : -1;
+  numJumpTargets++;
+  int bodyEnd = buildChain(cfg, switchNode->fields.children.middle, -1);
+  numJumpTargets--;
+  switchBlock = outerSwitch;
+  if(bodyEnd >= 0)
+    addSucc(cfg, bodyEnd, exitBlock);
+  astnode_t *statement = switchNode->fields.children.middle;
+  for(; statement != NULL && statement->fields.children.left->nodeType != DEFAULT; statement = statement->fields.children.right);
+  if(statement == NULL)
+    addSucc(cfg, block, exitBlock);
+  return exitBlock;
+}
+
+/**
+ * buildChain(cfg_t *cfg, astnode_t *statement, int block)
+ * Adds a chain of statements to the CFG, starting in a block. A return ends its block; the
+ * statements after it start a block no other block continues to, and so do those after a
+ * break or continue, which continue to the end or the step of the innermost loop. An if ends
+ * its block too, which continues to each branch (or past the if, without an else), and the
+ * branches to a new block after the if. Loops are added by buildLoop(), and switches by
+ * buildSwitch(); a case label starts a block the switch and the statement before continue to.
+ * Nested statements are handled recursively.
+ *
+ * param *cfg - the CFG
+ * param *statement - the first STATEMENT node of the chain
+ * param block - the block the chain starts in, or -1 if control does not get there
+ * return int - returns the block control is in after the chain, or -1 if it does not get there
+ **/
+static int buildChain(cfg_t *cfg, astnode_t *statement, int block){
+  for(; statement != NULL; statement = statement->fields.children.right){
+    astnode_t *content = statement->fields.children.left;
+    if(content->nodeType == WHILE || content->nodeType == DO_WHILE){
+      block = buildLoop(cfg, statement, block);
+      continue;
+    }
+    if(content->nodeType == CASE || content->nodeType == DEFAULT){
+      int labelBlock = newBlock(cfg);
+      if(block >= 0)
+        addSucc(cfg, block, labelBlock);
+      addSucc(cfg, switchBlock, labelBlock);
+      block = labelBlock;
+    }
+    if(block < 0)
+      block = newBlock(cfg);
+    addStatement(cfg, block, statement);
+    if(content->nodeType == RETURN)
+      block = -1;
+    else if(content->nodeType == BREAK || content->nodeType == CONTINUE){
+      addSucc(cfg, block, jumpTargets[2*(numJumpTargets-1) + (content->nodeType == CONTINUE)]);
+      block = -1;
+    }
+    else if(content->nodeType == SWITCH)
+      block = buildSwitch(cfg, content, block);
+    else if(content->nodeType == IF){
+      int thenBlock = newBlock(cfg);
+      addSucc(cfg, block, thenBlock);
+      int thenEnd = buildChain(cfg, content->fields.children.middle, thenBlock);
+      int elseEnd = block;
+      if(content->fields.children.right != NULL){
+        int elseBlock = newBlock(cfg);
+        addSucc(cfg, block, elseBlock);
+        elseEnd = buildChain(cfg, content->fields.children.right, elseBlock);
+      }
+      block = newBlock(cfg);
+      if(thenEnd >= 0)
+        addSucc(cfg, thenEnd, block);
+      if(elseEnd >= 0)
+        addSucc(cfg, elseEnd, block);
+    }
+  }
+  return block;
+}
+
+/**
+ * buildCFG(cfg_t *cfg, astnode_t *funcNode)
+ * Splits a function body into basic blocks, see buildChain(), and finds the blocks reachable
+ * from the entry. Blocks are numbered roughly in source order, a loop's own blocks first.
+ *
+ * param *cfg - filled with the CFG, free with freeCFG()
+ * param *funcNode - the FUNCTION node
+ * return void
+ **/
+void buildCFG(cfg_t *cfg, astnode_t *funcNode){
+  memset(cfg, 0, sizeof(cfg_t));
+  numJumpTargets = 0;
+  buildChain(cfg, funcNode->fields.children.right, newBlock(cfg));
+  //Mark the blocks reachable from the entry
+  size_t depth = 0;
+  size_t stackCap = 0;
+  int *stack = NULL;
+  growArray((void **) &stack, &stackCap, 1, sizeof(int));
+  stack[depth++] = 0;
+  cfg->blocks[0].reachable = 1;
+  while(depth > 0){
+    block_t *b = &cfg->blocks[stack[--depth]];
+    size_t i;
+    for(i = 0; i < b->numSuccs; i++){
+      if(cfg->blocks[b->succs[i]].reachable)
+        continue;
+      cfg->blocks[b->succs[i]].reachable = 1;
+      growArray((void **) &stack, &stackCap, depth + 1, sizeof(int));
+      stack[depth++] = b->succs[i];
+    }
+  }
+  free(stack);
+}
+
+/**
+ * dominates(int *idom, int dominator, int block)
+ * Checks whether every path from the entry to a block goes through another, walking up the
+ * dominator tree
+ *
+ * param *idom - the immediate dominator of each reachable block, the entry its own
+ * param dominator - the block that may dominate
+ * param block - the block that may be dominated
+ * return int - returns 1 if dominator dominates block, 0 otherwise
+ **/
+static int dominates(int *idom, int dominator, int block){
+  while(block != dominator && idom[block] != block)
+    block = idom[block];
+  return block == dominator;
+}
+
+/**
+ * findLoops(cfg_t *cfg, looplist_t *loops)
+ * Finds the natural loops of a CFG. Dominators are computed with the iterative algorithm of
+ * Cooper, Harvey and Kennedy over a reverse postorder; an edge to a block that dominates its
+ * source is a back edge, and its loop is the header plus every block that reaches the source
+ * without going through the header. Loops sharing a header are merged.
+ *
+ * param *cfg - the CFG, see buildCFG()
+ * param *loops - filled with the loops, free with freeLoops()
+ * return void
+ **/
+void findLoops(cfg_t *cfg, looplist_t *loops){
+  memset(loops, 0, sizeof(looplist_t));
+  size_t n = cfg->numBlocks;
+  size_t b, i;
+  for(b = 0; b < n && cfg->blocks[b].loop == NULL; b++);
+  if(b == n)
+    return;
+  int *order = (int *) malloc(n*sizeof(int));
+  int *rpo = (int *) malloc(n*sizeof(int));
+  int *idom = (int *) malloc(n*sizeof(int));
+  int *mark = (int *) malloc(n*sizeof(int));
+  int *stack = NULL;
+  size_t stackCap = 0;
+  growArray((void **) &stack, &stackCap, n, sizeof(int));
+  size_t *nextSucc = (size_t *) calloc(n, sizeof(size_t));
+  int *numPreds = (int *) calloc(n + 1, sizeof(int));
+  if(order == NULL || rpo == NULL || idom == NULL || mark == NULL || nextSucc == NULL || numPreds == NULL){
+    fprintf(stderr, "Failed to allocate space for the optimizer.\n");
+    exit(1);
+  }
+  //Postorder of the blocks reachable from the entry
+  memset(rpo, 0xff, n*sizeof(int));
+  memset(idom, 0xff, n*sizeof(int));
+  size_t numOrdered = 0;
+  size_t depth = 0;
+  stack[depth++] = 0;
+  rpo[0] = 0;
+  while(depth > 0){
+    block_t *block = &cfg->blocks[stack[depth-1]];
+    if(nextSucc[stack[depth-1]] < block->numSuccs){
+      int succ = block->succs[nextSucc[stack[depth-1]]++];
+      if(rpo[succ] < 0){
+        rpo[succ] = 0;
+        stack[depth++] = succ;
+      }
+      continue;
+    }
+    order[numOrdered++] = stack[--depth];
+  }
+  for(i = 0; i < numOrdered; i++)
+    rpo[order[i]] = numOrdered - 1 - i;
+  //Predecessor lists of the reachable blocks, packed by block
+  for(i = 0; i < numOrdered; i++){
+    block_t *block = &cfg->blocks[order[i]];
+    size_t s;
+    for(s = 0; s < block->numSuccs; s++)
+      numPreds[block->succs[s] + 1]++;
+  }
+  for(b = 0; b < n; b++)
+    numPreds[b + 1] += numPreds[b];
+  int *preds = (int *) malloc((numPreds[n] + 1)*sizeof(int));
+  if(preds == NULL){
+    fprintf(stderr, "Failed to allocate space for the optimizer.\n");
+    exit(1);
+  }
+  memset(nextSucc, 0, n*sizeof(size_t));
+  for(i = 0; i < numOrdered; i++){
+    block_t *block = &cfg->blocks[order[i]];
+    size_t s;
+    for(s = 0; s < block->numSuccs; s++){
+      int succ = block->succs[s];
+      preds[numPreds[succ] + nextSucc[succ]++] = order[i];
+    }
+  }
+  //Immediate dominators, refined in reverse postorder until they settle
+  idom[0] = 0;
+  int changed = 1;
+  while(changed){
+    changed = 0;
+    i = numOrdered - 1;
+    while(i-- > 0){
+      int block = order[i];
+      int newIdom = -1;
+      int p;
+      for(p = numPreds[block]; p < numPreds[block + 1]; p++){
+        int pred = preds[p];
+        if(idom[pred] < 0)
+          continue;
+        if(newIdom < 0){
+          newIdom = pred;
+          continue;
+        }
+        int other = pred;
+        while(other != newIdom){
+          while(rpo[other] > rpo[newIdom])
+            other = idom[other];
+          while(rpo[newIdom] > rpo[other])
+            newIdom = idom[newIdom];
+        }
+      }
+      if(idom[block] != newIdom){
+        idom[block] = newIdom;
+        changed = 1;
+      }
+    }
+  }
+  //Back edges go against the reverse postorder, to a block dominating their source
+  memset(mark, 0xff, n*sizeof(int));
+  for(i = 0; i < numOrdered; i++){
+    int tail = order[i];
+    block_t *block = &cfg->blocks[tail];
+    size_t s;
+    for(s = 0; s < block->numSuccs; s++){
+      int header = block->succs[s];
+      if(rpo[header] > rpo[tail] || !dominates(idom, header, tail))
+        continue;
+      size_t l;
+      for(l = 0; l < loops->numLoops && loops->loops[l].header != header; l++);
+      if(l == loops->numLoops){
+        growArray((void **) &loops->loops, &loops->loopsCap, l + 1, sizeof(loop_t));
+        memset(&loops->loops[l], 0, sizeof(loop_t));
+        loops->loops[l].header = header;
+        loops->numLoops++;
+      }
+      loop_t *loop = &loops->loops[l];
+      depth = 0;
+      stack[depth++] = tail;
+      if(mark[header] != (int) l){
+        mark[header] = l;
+        growArray((void **) &loop->blocks, &loop->blocksCap, loop->numBlocks + 1, sizeof(int));
+        loop->blocks[loop->numBlocks++] = header;
+      }
+      while(depth > 0){
+        int member = stack[--depth];
+        if(mark[member] == (int) l)
+          continue;
+        mark[member] = l;
+        growArray((void **) &loop->blocks, &loop->blocksCap, loop->numBlocks + 1, sizeof(int));
+        loop->blocks[loop->numBlocks++] = member;
+        growArray((void **) &stack, &stackCap, depth + numPreds[member + 1] - numPreds[member], sizeof(int));
+        int p;
+        for(p = numPreds[member]; p < numPreds[member + 1]; p++)
+          stack[depth++] = preds[p];
+      }
+    }
+  }
+  free(order);
+  free(rpo);
+  free(idom);
+  free(mark);
+  free(stack);
+  free(nextSucc);
+  free(numPreds);
+  free(preds);
+}
+
+/**
+ * freeLoops(looplist_t *loops)
+ * Frees the loops found by findLoops()
+ *
+ * param *loops - the loops
+ * return void
+ **/
+void freeLoops(looplist_t *loops){
+  size_t l;
+  for(l = 0; l < loops->numLoops; l++)
+    free(loops->loops[l].blocks);
+  free(loops->loops);
+  memset(loops, 0, sizeof(looplist_t));
+}
+
+/**
+ * collectStatements(astnode_t *funcNode, astnode_t ***statements, size_t *cap)
+ * Lists every STATEMENT node of a function in source order, including those nested in branches
+ * and loops, walking the chains with an explicit stack
+ *
+ * param *funcNode - the FUNCTION node
+ * param ***statements - the array to fill, grown as needed
+ * param *cap - the array's capacity
+ * return size_t - returns the number of statements
+ **/
+size_t collectStatements(astnode_t *funcNode, astnode_t ***statements, size_t *cap){
+  size_t numStatements = 0;
+  size_t depth = 0;
+  growArray((void **) &walkStack, &walkStackCap, 1, sizeof(astnode_t *));
+  walkStack[depth++] = funcNode->fields.children.right;
+  while(depth > 0){
+    astnode_t *statement = walkStack[depth-1];
+    if(statement == NULL){
+      depth--;
+      continue;
+    }
+    walkStack[depth-1] = statement->fields.children.right;
+    growArray((void **) statements, cap, numStatements + 1, sizeof(astnode_t *));
+    (*statements)[numStatements++] = statement;
+    astnode_t *content = statement->fields.children.left;
+    if(content != NULL && hasNestedStatements(content)){
+      growArray((void **) &walkStack, &walkStackCap, depth + 2, sizeof(astnode_t *));
+      walkStack[depth++] = content->fields.children.right;
+      walkStack[depth++] = content->fields.children.middle;
+    }
+  }
+  return numStatements;
+}
+
+/**
+ * freeCFG(cfg_t *cfg)
+ * Frees a CFG's blocks
+ *
+ * param *cfg - the CFG
+ * return void
+ **/
+void freeCFG(cfg_t *cfg){
+  size_t i;
+  for(i = 0; i < cfg->numBlocks; i++){
+    free(cfg->blocks[i].statements);
+    free(cfg->blocks[i].succs);
+  }
+  free(cfg->blocks);
+  memset(cfg, 0, sizeof(cfg_t));
+}
+
+/**
+ * initDataflow(dataflow_t *flow, size_t numBlocks, size_t numBits)
+ * Allocates the (empty) sets of a dataflow problem
+ *
+ * param *flow - the problem
+ * param numBlocks - the number of blocks of its CFG
+ * param numBits - the number of elements of its sets
+ * return void
+ **/
+void initDataflow(dataflow_t *flow, size_t numBlocks, size_t numBits){
+  flow->numWords = (numBits + 63) / 64;
+  size_t setsSize = (numBlocks * flow->numWords + 1) * sizeof(uint64_t);
+  flow->gen = (uint64_t *) calloc(1, setsSize);
+  flow->kill = (uint64_t *) calloc(1, setsSize);
+  flow->in = (uint64_t *) calloc(1, setsSize);
+  flow->out = (uint64_t *) calloc(1, setsSize);
+  if(flow->gen == NULL || flow->kill == NULL || flow->in == NULL || flow->out == NULL){
+    fprintf(stderr, "Failed to allocate space for dataflow sets.\n");
+    exit(1);
+  }
+}
+
+/**
+ * freeDataflow(dataflow_t *flow)
+ * Frees the sets of a dataflow problem
+ *
+ * param *flow - the problem
+ * return void
+ **/
+void freeDataflow(dataflow_t *flow){
+  free(flow->gen);
+  free(flow->kill);
+  free(flow->in);
+  free(flow->out);
+}
+
+/**
+ * blockSet(uint64_t *sets, dataflow_t *flow, size_t block)
+ * Finds a block's set among the gen, kill, in or out sets of a dataflow problem
+ *
+ * param *sets - one of flow's set arrays
+ * param *flow - the problem
+ * param block - the block's index
+ * return uint64_t* - returns the block's bitset
+ **/
+uint64_t *blockSet(uint64_t *sets, dataflow_t *flow, size_t block){
+  return &sets[block * flow->numWords];
+}
+
+/**
+ * bitsetHas(uint64_t *set, size_t bit)
+ * Checks if an element is in a bitset
+ *
+ * param *set - the bitset
+ * param bit - the element
+ * return int - returns 1 if the element is in the set, 0 otherwise
+ **/
+int bitsetHas(uint64_t *set, size_t bit){
+  return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+/**
+ * bitsetAdd(uint64_t *set, size_t bit)
+ * Adds an element to a bitset
+ *
+ * param *set - the bitset
+ * param bit - the element
+ * return void
+ **/
+void bitsetAdd(uint64_t *set, size_t bit){
+  set[bit / 64] |= (uint64_t) 1 << (bit % 64);
+}
+
+/**
+ * bitsetRemove(uint64_t *set, size_t bit)
+ * Removes an element from a bitset
+ *
+ * param *set - the bitset
+ * param bit - the element
+ * return void
+ **/
+void bitsetRemove(uint64_t *set, size_t bit){
+  set[bit / 64] &= ~((uint64_t) 1 << (bit % 64));
+}
+
+/**
+ * solveBackward(cfg_t *cfg, dataflow_t *flow)
+ * Solves a backward dataflow problem to its fixed point, given each block's gen and kill sets.
+ * Blocks are visited last to first, which converges in one or two rounds without loops.
+ *
+ * param *cfg - the CFG
+ * param *flow - the problem, its in and out sets are filled in
+ * return void
+ **/
+void solveBackward(cfg_t *cfg, dataflow_t *flow){
+  size_t words = flow->numWords;
+  int changed = 1;
+  while(changed){
+    changed = 0;
+    size_t b = cfg->numBlocks;
+    while(b-- > 0){
+      block_t *block = &cfg->blocks[b];
+      uint64_t *out = blockSet(flow->out, flow, b);
+      uint64_t *in = blockSet(flow->in, flow, b);
+      uint64_t *gen = blockSet(flow->gen, flow, b);
+      uint64_t *kill = blockSet(flow->kill, flow, b);
+      size_t i, w;
+      for(i = 0; i < block->numSuccs; i++){
+        uint64_t *succIn = blockSet(flow->in, flow, block->succs[i]);
+        for(w = 0; w < words; w++)
+          out[w] |= succIn[w];
+      }
+      for(w = 0; w < words; w++){
+        uint64_t newIn = gen[w] | (out[w] & ~kill[w]);
+        if(newIn != in[w]){
+          in[w] = newIn;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * addVariable(varmap_t *vars, uint32_t symbol)
+ * Gives a variable the next number
+ *
+ * param *vars - the map being filled in
+ * param symbol - the variable's symbol ID
+ * return void
+ **/
+static void addVariable(varmap_t *vars, uint32_t symbol){
+  size_t oldCap = vars->indexCap;
+  growArray((void **) &vars->index, &vars->indexCap, (size_t) symbol + 1, sizeof(int));
+  memset(&vars->index[oldCap], 0xff, (vars->indexCap - oldCap) * sizeof(int));
+  growArray((void **) &vars->symbols, &vars->symbolsCap, vars->numVars + 1, sizeof(uint32_t));
+  vars->index[symbol] = vars->numVars;
+  vars->symbols[vars->numVars++] = symbol;
+}
+
+/**
+ * numberVariables(varmap_t *vars, astnode_t *funcNode)
+ * Numbers the variables of a function 0, 1, ...: its parameters, then those it declares in source order
+ *
+ * param *vars - the map to fill in, reused from function to function
+ * param *funcNode - the FUNCTION node
+ * return void
+ **/
+void numberVariables(varmap_t *vars, astnode_t *funcNode){
+  size_t i;
+  for(i = 0; i < vars->numVars; i++)
+    vars->index[vars->symbols[i]] = -1;
+  vars->numVars = 0;
+  astnode_t *param = funcNode->fields.children.middle;
+  for(; param != NULL; param = param->fields.children.right)
+    addVariable(vars, param->fields.children.left->fields.symbol);
+  size_t numStatements = collectStatements(funcNode, &vars->statements, &vars->statementsCap);
+  for(i = 0; i < numStatements; i++){
+    astnode_t *decl = vars->statements[i]->fields.children.left;
+    if(decl != NULL && decl->nodeType == DECLARATION)
+      addVariable(vars, decl->fields.children.left->fields.symbol);
+  }
+}
+
+/**
+ * variableIndex(varmap_t *vars, uint32_t symbol)
+ * Looks up the number of a variable
+ *
+ * param *vars - the function's variables
+ * param symbol - the variable's symbol ID
+ * return int - returns the variable's number, or -1 if it is not a variable of the function
+ **/
+int variableIndex(varmap_t *vars, uint32_t symbol){
+  return (symbol < vars->indexCap) ? vars->index[symbol] : -1;
+}
+
+/**
+ * freeVarmap(varmap_t *vars)
+ * Frees a variable numbering
+ *
+ * param *vars - the numbering
+ * return void
+ **/
+void freeVarmap(varmap_t *vars){
+  free(vars->index);
+  free(vars->symbols);
+  free(vars->statements);
+  memset(vars, 0, sizeof(varmap_t));
+}
+
+/**
+ * scanExpression(astnode_t *expr, varmap_t *vars, uint64_t *reads, uint64_t *writes)
+ * Finds the variables an expression (or statement) reads and assigns, walking it with an explicit stack
+ *
+ * param *expr - the expression
+ * param *vars - the function's variables
+ * param *reads - bitset the variables read are added to, or NULL
+ * param *writes - bitset the variables assigned are added to, or NULL
+ * return int - returns 1 if the expression has side effects (assignments and calls), 0 otherwise
+ **/
+int scanExpression(astnode_t *expr, varmap_t *vars, uint64_t *reads, uint64_t *writes){
+  int sideEffects = 0;
+  size_t depth = 0;
+  growArray((void **) &walkStack, &walkStackCap, 1, sizeof(astnode_t *));
+  walkStack[depth++] = expr;
+  while(depth > 0){
+    astnode_t *node = walkStack[--depth];
+    astnode_t *children[3] = {NULL, NULL, NULL};
+    int index = -1;
+    switch(node->nodeType){
+    case SYMBOL:
+      index = variableIndex(vars, node->fields.symbol);
+      if(reads != NULL && index >= 0)
+        bitsetAdd(reads, index);
+      break;
+    case ASSIGNMENT:
+      sideEffects = 1;
+      index = variableIndex(vars, node->fields.children.left->fields.symbol);
+      if(writes != NULL && index >= 0)
+        bitsetAdd(writes, index);
+      children[0] = node->fields.children.right;
+      break;
+    //A call cannot reach the caller's variables, but it may not return
+    case CALL:
+      sideEffects = 1;
+      children[0] = node->fields.children.right;
+      break;
+    case UNARY_OP:
+    case DECLARATION:
+      children[0] = node->fields.children.right;
+      break;
+    case ARGUMENT:
+    case BINARY_OP:
+      children[0] = node->fields.children.left;
+      children[1] = node->fields.children.right;
+      break;
+    case TERNARY:
+      children[2] = node->fields.children.middle;
+      children[0] = node->fields.children.left;
+      children[1] = node->fields.children.right;
+      break;
+    //Only the condition of an if, loop or switch belongs to the statement, the rest are statements of their own
+    case RETURN:
+    case SHARED:
+    case IF:
+    case WHILE:
+    case DO_WHILE:
+    case SWITCH:
+      children[0] = node->fields.children.left;
+      break;
+    default:
+      break;
+    }
+    growArray((void **) &walkStack, &walkStackCap, depth + 3, sizeof(astnode_t *));
+    int c;
+    for(c = 0; c < 3; c++){
+      if(children[c] != NULL)
+        walkStack[depth++] = children[c];
+    }
+  }
+  return sideEffects;
+}
+
+/**
+ * statementLiveness(astnode_t *statement, varmap_t *vars, uint64_t *live)
+ * Steps the live variables backward over a statement: the variable a declaration or top level
+ * assignment defines dies, then the variables the statement reads become live. Assignments
+ * nested in expressions may not be executed (&&, ||), so they do not kill anything.
+ *
+ * param *statement - the STATEMENT node
+ * param *vars - the function's variables
+ * param *live - the variables live after the statement, updated to those live before it
+ * return void
+ **/
+void statementLiveness(astnode_t *statement, varmap_t *vars, uint64_t *live){
+  astnode_t *content = statement->fields.children.left;
+  if(content == NULL)
+    return;
+  if(content->nodeType == DECLARATION || content->nodeType == ASSIGNMENT){
+    int index = variableIndex(vars, content->fields.children.left->fields.symbol);
+    if(index >= 0)
+      bitsetRemove(live, index);
+  }
+  scanExpression(content, vars, live, NULL);
+}
+
+/**
+ * computeLiveness(cfg_t *cfg, varmap_t *vars, dataflow_t *flow)
+ * Live variable analysis: fills in which of the function's variables are live into and out of each block
+ *
+ * param *cfg - the function's CFG
+ * param *vars - the function's variables
+ * param *flow - the problem, allocated here, free with freeDataflow()
+ * return void
+ **/
+void computeLiveness(cfg_t *cfg, varmap_t *vars, dataflow_t *flow){
+  initDataflow(flow, cfg->numBlocks, vars->numVars);
+  size_t b;
+  for(b = 0; b < cfg->numBlocks; b++){
+    block_t *block = &cfg->blocks[b];
+    uint64_t *gen = blockSet(flow->gen, flow, b);
+    uint64_t *kill = blockSet(flow->kill, flow, b);
+    size_t i = block->numStatements;
+    while(i-- > 0){
+      astnode_t *content = block->statements[i]->fields.children.left;
+      statementLiveness(block->statements[i], vars, gen);
+      if(content != NULL && (content->nodeType == DECLARATION || content->nodeType == ASSIGNMENT)){
+        int index = variableIndex(vars, content->fields.children.left->fields.symbol);
+        if(index >= 0)
+          bitsetAdd(kill, index);
+      }
+    }
+  }
+  solveBackward(cfg, flow);
+}
@@ -0,0 +1,83 @@
+#ifndef FLOW_H_
+#define FLOW_H_
+
+#include "parse.h"
+#include <stdint.h>
+
+//A basic block: a run of STATEMENT nodes always executed in order (an if or switch ends its block, as
+//only its condition is evaluated there), and the blocks control continues to after it (none when it returns
+//or falls off the end of the function)
+typedef struct block_t {
+  astnode_t **statements;
+  size_t numStatements;
+  size_t statementsCap;
+  int *succs;
+  size_t numSuccs;
+  size_t succsCap;
+  int reachable;
+  astnode_t *loop;
+} block_t;
+
+//Control flow graph of a function, the entry block first. The header block of each loop points
+//to the loop's STATEMENT node.
+typedef struct cfg_t {
+  block_t *blocks;
+  size_t numBlocks;
+  size_t blocksCap;
+} cfg_t;
+
+//A natural loop: its header block, and every block of the loop, the header first
+typedef struct loop_t {
+  int header;
+  int *blocks;
+  size_t numBlocks;
+  size_t blocksCap;
+} loop_t;
+
+typedef struct looplist_t {
+  loop_t *loops;
+  size_t numLoops;
+  size_t loopsCap;
+} looplist_t;
+
+//A backward gen/kill dataflow problem: in = gen | (out & ~kill), out = union of the successors' in.
+//Each set is a bitset of numWords words, one set per block.
+typedef struct dataflow_t {
+  size_t numWords;
+  uint64_t *gen;
+  uint64_t *kill;
+  uint64_t *in;
+  uint64_t *out;
+} dataflow_t;
+
+//Dense numbering of the variables of a function, for bitsets over them
+typedef struct varmap_t {
+  int *index;
+  size_t indexCap;
+  uint32_t *symbols;
+  size_t numVars;
+  size_t symbolsCap;
+  astnode_t **statements;
+  size_t statementsCap;
+} varmap_t;
+
+void buildCFG(cfg_t *cfg, astnode_t *funcNode);
+void freeCFG(cfg_t *cfg);
+void findLoops(cfg_t *cfg, looplist_t *loops);
+void freeLoops(looplist_t *loops);
+size_t collectStatements(astnode_t *funcNode, astnode_t ***statements, size_t *cap);
+void initDataflow(dataflow_t *flow, size_t numBlocks, size_t numBits);
+void freeDataflow(dataflow_t *flow);
+uint64_t *blockSet(uint64_t *sets, dataflow_t *flow, size_t block);
+int bitsetHas(uint64_t *set, size_t bit);
+void bitsetAdd(uint64_t *set, size_t bit);
+void bitsetRemove(uint64_t *set, size_t bit);
+void solveBackward(cfg_t *cfg, dataflow_t *flow);
+void numberVariables(varmap_t *vars, astnode_t *funcNode);
+int variableIndex(varmap_t *vars, uint32_t symbol);
+void freeVarmap(varmap_t *vars);
+int scanExpression(astnode_t *expr, varmap_t *vars, uint64_t *reads, uint64_t *writes);
+void statementLiveness(astnode_t *statement, varmap_t *vars, uint64_t *live);
+void computeLiveness(cfg_t *cfg, varmap_t *vars, dataflow_t *flow);
+
+#endif // FLOW_H_
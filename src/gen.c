@@ -1,38 +1,104 @@
 #include "parse.h"
+#include "gen.h"
+#include "dump.h"
+#include "opt.h"
+#include "flow.h"
+#include "prof.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 
 
+//Labels are numbered per function and named after it, so a function's assembly does not depend
+//on the functions before it and can be reused on its own (see generateIncremental())
 unsigned int labelCounter = 0;
+//Name of the function currently being generated, for the asm dump channel
+char *currFuncName = NULL;
+//%ebp offsets of the current function's variables indexed by symbol ID, and the next free slot
+int *varOffsets = NULL;
+size_t varOffsetsCap = 0;
+int stackIndex = 0;
+//Whether the current function addresses its slots from %esp instead of keeping a frame pointer, see
+//framePointerNeeded(); offsets are then still kept from where %ebp would be, the return address' slot,
+//and pushedBytes counts what the expression being generated has pushed since the last statement
+int omitFramePointer = 0;
+int pushedBytes = 0;
+//Parameters of the current function, a tail call can only pass as many arguments
+int numParams = 0;
+//Whether each stack temporary of the current statement holds its SHARED value yet; temporaries
+//are the first slots below %ebp, ahead of the variables
+unsigned char *tempReady = NULL;
+size_t tempReadyCap = 0;
+//Statements of the current function, nested ones included, and the stack selectCost() walks
+astnode_t **funcStatements = NULL;
+size_t funcStatementsCap = 0;
+astnode_t **costStack = NULL;
+size_t costStackCap = 0;
+//Where break and continue jump to in each loop or switch around the statement being generated,
+//innermost last, and the stack index to pop the stack back to first
+looplabels_t *loopLabels = NULL;
+size_t loopLabelsCap = 0;
+size_t numLoopLabels = 0;
+//Code of the current function generated apart from it, see deferredStream()
+deferred_t deferredCode[NUM_DEFERRED];
+//Whether to emit line information (-g), the files given .file numbers so far (the source is 1, the
+//others their index plus 2, see emitLoc()), and the last .loc, so a line is not repeated
+int debugLines = 0;
+uint32_t *locFiles = NULL;
+size_t numLocFiles = 0;
+size_t locFilesCap = 0;
+FILE *locStream = NULL;
+uint32_t locFile = NO_SYMBOL;
+int locLine = 0;
 
 char *generateLabel(){
   //over maximum int length/size...
-  char *label = malloc(sizeof(char)*12);
+  size_t labelLen = strlen(currFuncName) + 14;
+  char *label = malloc(sizeof(char)*labelLen);
   if(label == NULL){
     fprintf(stderr, "Failed to allocate space for new label.\n");
     exit(1);
   }
-  snprintf(label, 11, "_%d", labelCounter);
+  snprintf(label, labelLen, "_%s.%u", currFuncName, labelCounter);
   labelCounter++;
   return label;
 }
 
-FILE *getOutFile(){
-  int i;
-  int pathLen = strnlen(sourcePath, LEN_PATH)-1;
-  char outPath[LEN_PATH] = "";
-  //find first occurrence of '/' (working backwards)
-  for(i = pathLen; i > 0; i--){
-    if(sourcePath[i] == '/'){
-      i++;
-      break;
+/**
+ * defaultOutPath()
+ * Fills in the output path when -o was not given: the source file name with its .c extension
+ * replaced by .s, in the current directory, or "-" (stdout) for sources read from stdin.
+ *
+ * return void
+ **/
+void defaultOutPath(){
+  if(outPath[0] == '\0'){
+    if(strcmp(sourcePath, "-") == 0)
+      strcpy(outPath, "-");
+    else{
+      char *baseName = strrchr(sourcePath, '/');
+      baseName = (baseName == NULL) ? sourcePath : baseName + 1;
+      int baseLen = strnlen(baseName, LEN_PATH);
+      //Strip the trailing 'c' of the .c extension and replace it with 's'
+      snprintf(outPath, LEN_PATH, "%.*ss", baseLen-1, baseName);
     }
   }
-  strncpy(outPath, &sourcePath[i], strnlen(&sourcePath[i], LEN_PATH)-1);
-  strncat(outPath, "s", 2);
-  printf("Output file: %s\n", outPath);
+}
+
+/**
+ * getOutFile()
+ * Opens the assembly output file, see defaultOutPath() for where it goes without -o ("-" for stdout).
+ *
+ * return FILE* - returns the file pointer to write the assembly to
+ **/
+FILE *getOutFile(){
+  defaultOutPath();
+  if(strcmp(outPath, "-") == 0)
+    return stdout;
+  if(verbose)
+    fprintf(stderr, "Output file: %s\n", outPath);
   FILE *outFile = fopen(outPath, "w");
   if(outFile == NULL){
     fprintf(stderr, "Failed to open output file %s for writing.\n", outPath);
@@ -42,215 +108,1344 @@ FILE *getOutFile(){
 }
 
 /**
- * generate(astnode_t *root, FILE *outFile)
- * Given a valid AST, generates assemblable assembly and writes it to a file.
+ * emit(FILE *outFile, const char *format, ...)
+ * Writes formatted assembly to the output file, mirroring each line to the asm dump channel when it is enabled.
  *
- * param *root - the PROGRAM node of the ast
  * param *outFile - the file pointer to write the assembly to
+ * param *format - printf style format of the assembly text
  * return void
  **/
-void generate(astnode_t *root, FILE *outFile){
-  if(root == NULL){
-    fprintf(stderr, "Null AST node, cannot generate assembly.\n");
-    exit(1);
-  }
-  astnode_t *currNode = root;
-  //Now recursively traverse AST and use it to generate assembly
-  if(currNode->nodeType == PROGRAM){
-    generate(currNode->fields.children.left, outFile);
+void emit(FILE *outFile, const char *format, ...){
+  va_list args;
+  va_start(args, format);
+  if(!dumpEnabled(DUMP_ASM)){
+    vfprintf(outFile, format, args);
+    va_end(args);
     return;
   }
-  else if(currNode->nodeType == FUNCTION){
-    char *funcName = currNode->fields.children.left->fields.strVal;
-    fprintf(outFile, " .globl %s\n%s:\n", funcName, funcName);
-    generate(currNode->fields.children.right, outFile);
-    fprintf(outFile, " ret\n");
-    return;
+  char text[EMIT_BUF_SIZE];
+  vsnprintf(text, EMIT_BUF_SIZE, format, args);
+  va_end(args);
+  fputs(text, outFile);
+  char *line = text;
+  char *lineEnd = NULL;
+  while((lineEnd = strchr(line, '\n')) != NULL){
+    *lineEnd = '\0';
+    dumpAsm(currFuncName, line);
+    line = lineEnd + 1;
   }
-  else if(currNode->nodeType == STATEMENT){
-    //Not much to do with a statement yet, moving on...
-    generate(currNode->fields.children.left, outFile);
+  if(line[0] != '\0')
+    dumpAsm(currFuncName, line);
+}
+
+/**
+ * emitText(FILE *outFile, const char *text, size_t len)
+ * Writes already generated assembly to the output file, mirroring its lines to the asm dump channel when it is enabled.
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * param *text - the assembly text, made of whole lines
+ * param len - the length of the text
+ * return void
+ **/
+void emitText(FILE *outFile, const char *text, size_t len){
+  fwrite(text, 1, len, outFile);
+  if(!dumpEnabled(DUMP_ASM))
     return;
+  char line[EMIT_BUF_SIZE];
+  const char *end = text + len;
+  while(text < end){
+    const char *lineEnd = memchr(text, '\n', end - text);
+    size_t lineLen = (lineEnd == NULL) ? (size_t) (end - text) : (size_t) (lineEnd - text);
+    snprintf(line, EMIT_BUF_SIZE, "%.*s", (int) lineLen, text);
+    dumpAsm(currFuncName, line);
+    text += lineLen + 1;
   }
-  //Just an integer, move it into eax
-  else if(currNode->nodeType == INTEGER){
-    fprintf(outFile, " movl $%d, %%eax\n", currNode->fields.intVal);
+}
+
+/**
+ * emitQuoted(FILE *outFile, const char *text)
+ * Writes text as the contents of an assembler string, escaping quotes and backslashes
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * param *text - the text
+ * return void
+ **/
+void emitQuoted(FILE *outFile, const char *text){
+  for(; *text != '\0'; text++)
+    emit(outFile, (*text == '"' || *text == '\\') ? "\\%c" : "%c", *text);
+}
+
+/**
+ * startLineInfo(FILE *outFile)
+ * Starts the line information of a translation unit (-g): the source file is .file 1. The
+ * assembler makes the DWARF line table from the .file and .loc directives.
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void startLineInfo(FILE *outFile){
+  if(!debugLines)
+    return;
+  numLocFiles = 0;
+  locStream = NULL;
+  emit(outFile, " .file 1 \"");
+  emitQuoted(outFile, (strcmp(sourcePath, "-") == 0) ? "<stdin>" : sourcePath);
+  emit(outFile, "\"\n");
+}
+
+/**
+ * emitLoc(astnode_t *node, FILE *outFile)
+ * Attributes the code that follows to the node's line (-g), giving the node's header a .file number
+ * the first time it is seen. Nodes the optimizer made (line 0) leave the line as it is.
+ *
+ * param *node - the node
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitLoc(astnode_t *node, FILE *outFile){
+  if(node->lineNum <= 0 || (outFile == locStream && node->file == locFile && node->lineNum == locLine))
     return;
+  size_t number = 1;
+  if(node->file != NO_SYMBOL){
+    size_t i;
+    for(i = 0; i < numLocFiles && locFiles[i] != node->file; i++);
+    if(i == numLocFiles){
+      growArray((void **) &locFiles, &locFilesCap, numLocFiles + 1, sizeof(uint32_t));
+      locFiles[numLocFiles++] = node->file;
+      emit(outFile, " .file %zu \"", i + 2);
+      emitQuoted(outFile, symbolName(node->file));
+      emit(outFile, "\"\n");
+    }
+    number = i + 2;
+  }
+  emit(outFile, " .loc %zu %d\n", number, node->lineNum);
+  locStream = outFile;
+  locFile = node->file;
+  locLine = node->lineNum;
+}
+
+/**
+ * codegenSignature()
+ * Identifies the code generator and the options it was run with; assembly generated under
+ * one signature is never reused under another.
+ *
+ * return uint64_t - returns the signature
+ **/
+uint64_t codegenSignature(){
+  return ((uint64_t) debugLines << 63) | ((uint64_t) optFlags << 48) | ((uint64_t) (uint32_t) inlineThreshold << 16)
+         | CODEGEN_VERSION;
+}
+
+/**
+ * setVarOffset(uint32_t symbol, int offset)
+ * Records the %ebp offset of a variable declared in the current function
+ *
+ * param symbol - the variable's symbol ID
+ * param offset - the variable's offset from %ebp
+ * return void
+ **/
+void setVarOffset(uint32_t symbol, int offset){
+  growArray((void **) &varOffsets, &varOffsetsCap, (size_t) symbol + 1, sizeof(int));
+  varOffsets[symbol] = offset;
+}
+
+/**
+ * getVarOffset(uint32_t symbol)
+ * Looks up the %ebp offset of a variable, the parser has already checked it is declared
+ *
+ * param symbol - the variable's symbol ID
+ * return int - returns the variable's offset from %ebp
+ **/
+int getVarOffset(uint32_t symbol){
+  if(symbol >= varOffsetsCap || varOffsets[symbol] == 0){
+    fprintf(stderr, "No stack slot for variable %s.\n", symbolName(symbol));
+    exit(1);
+  }
+  return varOffsets[symbol];
+}
+
+/**
+ * frameRegister()
+ * Names the register the current function's stack slots are addressed from
+ *
+ * return const char* - returns "%esp" without a frame pointer, "%ebp" otherwise
+ **/
+const char *frameRegister(){
+  return omitFramePointer ? "%esp" : "%ebp";
+}
+
+/**
+ * slotOffset(int offset)
+ * Converts the offset of a stack slot from the frame base to one from frameRegister(). Without a
+ * frame pointer, %esp is below the base by the variables declared so far and anything pushed since.
+ *
+ * param offset - the slot's offset from the frame base, see getVarOffset()
+ * return int - returns the offset to address it with
+ **/
+int slotOffset(int offset){
+  return omitFramePointer ? offset - stackIndex + pushedBytes : offset;
+}
+
+/**
+ * deferredStream(DEFERRED kind)
+ * Opens a stream of the current function's code generated apart from it: out of line code
+ * (DEFER_OUT_OF_LINE) is written right after the function, so its hot path falls through, and
+ * unlikely code (DEFER_UNLIKELY) to .text.unlikely, away from the hot code of every function, see
+ * emitDeferredCode(). Each block is generated where it would have been, so the generator's state
+ * is right for it, and jumps back. Code generated into either stream is never deferred again.
+ *
+ * param kind - the stream
+ * return FILE* - returns the stream
+ **/
+FILE *deferredStream(DEFERRED kind){
+  deferred_t *deferred = &deferredCode[kind];
+  if(deferred->file == NULL){
+    deferred->file = open_memstream(&deferred->text, &deferred->len);
+    if(deferred->file == NULL){
+      fprintf(stderr, "Failed to open deferred code buffer for function %s.\n", currFuncName);
+      exit(1);
+    }
+  }
+  return deferred->file;
+}
+
+/**
+ * isDeferred(FILE *outFile)
+ * Checks whether code is being generated into a deferred stream, see deferredStream()
+ *
+ * param *outFile - the file pointer the code is generated to
+ * return int - returns 1 if it is a deferred stream, 0 otherwise
+ **/
+int isDeferred(FILE *outFile){
+  return outFile == deferredCode[DEFER_OUT_OF_LINE].file || outFile == deferredCode[DEFER_UNLIKELY].file;
+}
+
+/**
+ * writeDeferred(DEFERRED kind, FILE *outFile)
+ * Writes out and closes a deferred stream. Its code went to the asm dump channel when it was
+ * generated.
+ *
+ * param kind - the stream
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+static void writeDeferred(DEFERRED kind, FILE *outFile){
+  deferred_t *deferred = &deferredCode[kind];
+  fclose(deferred->file);
+  deferred->file = NULL;
+  fwrite(deferred->text, 1, deferred->len, outFile);
+  free(deferred->text);
+  deferred->text = NULL;
+}
+
+/**
+ * emitDeferredCode(char *funcName, int unlikely, FILE *outFile)
+ * Ends the current function: its out of line code, its size, and its unlikely code as a function
+ * of its own, <name>.cold, in .text.unlikely, see deferredStream(). Then switches back to .text.
+ *
+ * param *funcName - the function's name
+ * param unlikely - whether the function itself is in .text.unlikely
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitDeferredCode(char *funcName, int unlikely, FILE *outFile){
+  if(deferredCode[DEFER_OUT_OF_LINE].file != NULL)
+    writeDeferred(DEFER_OUT_OF_LINE, outFile);
+  emit(outFile, " .size %s, .-%s\n", funcName, funcName);
+  if(deferredCode[DEFER_UNLIKELY].file != NULL){
+    if(!unlikely)
+      emit(outFile, " .section .text.unlikely,\"ax\",@progbits\n");
+    emit(outFile, " .type %s.cold, @function\n%s.cold:\n", funcName, funcName);
+    writeDeferred(DEFER_UNLIKELY, outFile);
+    emit(outFile, " .size %s.cold, .-%s.cold\n", funcName, funcName);
+    unlikely = 1;
+  }
+  if(unlikely)
+    emit(outFile, " .text\n");
+}
+
+/**
+ * shortCircuitLayout(astnode_t *node, FILE *outFile)
+ * Lays out a && or || by its profile: its right operand falls through from the left one when it is
+ * evaluated at least half the time, goes out of line otherwise, and to the unlikely code when it is
+ * evaluated rarely (see profileCold()).
+ *
+ * param *node - the BINARY_OP node
+ * param *outFile - the file pointer the operator is generated to
+ * return LAYOUT - returns the layout, LAYOUT_STATIC without a profile for the operator
+ **/
+LAYOUT shortCircuitLayout(astnode_t *node, FILE *outFile){
+  uint64_t reached = 0, taken = 0;
+  if(isDeferred(outFile) || !profileCount(node, COUNT_REACHED, &reached) || reached == 0
+     || !profileCount(node, COUNT_TAKEN, &taken))
+    return LAYOUT_STATIC;
+  if(2*taken >= reached)
+    return LAYOUT_INLINE;
+  return profileCold(taken, reached) ? LAYOUT_UNLIKELY : LAYOUT_OUT_OF_LINE;
+}
+
+/**
+ * emitTruthValue(FILE *outFile)
+ * Turns %eax into 1 if it is not 0, the value of a && or ||
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitTruthValue(FILE *outFile){
+  emit(outFile, " cmpl $0, %%eax\n");
+  emit(outFile, " movl $0, %%eax\n");
+  emit(outFile, " setne %%al\n");
+}
+
+/**
+ * emitEpilogue(FILE *outFile)
+ * Pops the current function's frame, leaving %esp at the return address
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitEpilogue(FILE *outFile){
+  if(!omitFramePointer){
+    emit(outFile, " movl %%ebp, %%esp\n");
+    emit(outFile, " pop %%ebp\n");
+  }
+  else if(pushedBytes - stackIndex != 0)
+    emit(outFile, " addl $%d, %%esp\n", pushedBytes - stackIndex);
+}
+
+/**
+ * emitUnaryOp(char opType, FILE *outFile)
+ * Applies a unary operator to the operand in %eax
+ *
+ * param opType - the operator, one of ~ ! -
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitUnaryOp(char opType, FILE *outFile){
+  switch(opType){
+    case '~':
+      emit(outFile, " not %%eax\n");
+      break;
+    case '!':
+      emit(outFile, " cmpl $0, %%eax\n");
+      emit(outFile, " movl $0, %%eax\n");
+      emit(outFile, " sete %%al\n");
+      break;
+    case '-':
+      emit(outFile, " neg %%eax\n");
+      break;
+  }
+}
+
+/**
+ * rightOperandFirst(char *opType)
+ * Checks whether a binary operator evaluates its right operand first, leaving the left one
+ * in %eax and the right one in %ecx, as division and shifts need
+ *
+ * param *opType - the operator
+ * return int - returns 1 if the right operand is evaluated first, 0 otherwise
+ **/
+int rightOperandFirst(char *opType){
+  return strcmp(opType, "-") == 0 || strcmp(opType, "/") == 0 || strcmp(opType, "%") == 0
+    || strcmp(opType, "<<") == 0 || strcmp(opType, ">>") == 0;
+}
+
+/**
+ * emitBinaryOp(char *opType, FILE *outFile)
+ * Combines the operands of a (non short-circuit) binary operator into %eax. The operand
+ * evaluated first is in %ecx and the other in %eax, see rightOperandFirst().
+ *
+ * param *opType - the operator
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitBinaryOp(char *opType, FILE *outFile){
+  if(strncmp(opType, "+", 5) == 0)
+    emit(outFile, " addl %%ecx, %%eax\n");
+  else if(strncmp(opType, "-", 5) == 0)
+    emit(outFile, " subl %%ecx, %%eax\n");
+  else if(strncmp(opType, "*", 5) == 0)
+    emit(outFile, " imul %%ecx, %%eax\n");
+  else if(strncmp(opType, "/", 5) == 0){
+    emit(outFile, " cdq\n");
+    emit(outFile, " idivl %%ecx\n");
+  }
+  else if(strncmp(opType, "%", 5) == 0){
+    emit(outFile, " cdq\n");
+    emit(outFile, " idivl %%ecx\n");
+    //Move remainder into eax
+    emit(outFile, " movl %%edx, %%eax\n");
+  }
+  else if(strncmp(opType, "<<", 5) == 0)
+    emit(outFile, " sall %%cl, %%eax\n");
+  else if(strncmp(opType, ">>", 5) == 0)
+    emit(outFile, " sarl %%cl, %%eax\n");
+  //Binary conditional operators
+  else if(strncmp(opType, "<", 5) == 0 || strncmp(opType, ">", 5) == 0 || strncmp(opType, "<=", 5) == 0
+          || strncmp(opType, ">=", 5) == 0 || strncmp(opType, "!=", 5) == 0 || strncmp(opType, "==", 5) == 0){
+    char *setOp = "sete";
+    if(strncmp(opType, "<", 5) == 0)
+      setOp = "setl";
+    else if(strncmp(opType, ">", 5) == 0)
+      setOp = "setg";
+    else if(strncmp(opType, "<=", 5) == 0)
+      setOp = "setle";
+    else if(strncmp(opType, ">=", 5) == 0)
+      setOp = "setge";
+    else if(strncmp(opType, "!=", 5) == 0)
+      setOp = "setne";
+    emit(outFile, " cmpl %%eax, %%ecx\n");
+    emit(outFile, " movl $0, %%eax\n");
+    emit(outFile, " %s %%al\n", setOp);
+  }
+  //Bitwise ops
+  else if(strncmp(opType, "&", 5) == 0)
+    emit(outFile, " and %%ecx, %%eax\n");
+  else if(strncmp(opType, "^", 5) == 0)
+    emit(outFile, " xor %%ecx, %%eax\n");
+  else if(strncmp(opType, "|", 5) == 0)
+    emit(outFile, " or %%ecx, %%eax\n");
+}
+
+/**
+ * selectCost(astnode_t *expr)
+ * Estimates the cost of evaluating an arm of a select unconditionally, for choosing between a
+ * cmov and a branch. Arms with side effects, that may trap (division) or whose value may be a
+ * common subexpression computed for the first time cannot be evaluated when not selected. The
+ * walk stops as soon as the cost is over CMOV_MAX_COST.
+ *
+ * param *expr - the arm
+ * return int - returns the cost, or -1 if the arm cannot be evaluated unconditionally
+ **/
+int selectCost(astnode_t *expr){
+  int cost = 0;
+  size_t depth = 0;
+  growArray((void **) &costStack, &costStackCap, 1, sizeof(astnode_t *));
+  costStack[depth++] = expr;
+  while(depth > 0 && cost <= CMOV_MAX_COST){
+    astnode_t *node = costStack[--depth];
+    growArray((void **) &costStack, &costStackCap, depth + 3, sizeof(astnode_t *));
+    switch(node->nodeType){
+    case INTEGER:
+    case SYMBOL:
+      cost++;
+      break;
+    case UNARY_OP:
+      cost++;
+      costStack[depth++] = node->fields.children.right;
+      break;
+    case BINARY_OP:{
+      char *opType = node->fields.children.middle->fields.strVal;
+      if(strcmp(opType, "/") == 0 || strcmp(opType, "%") == 0)
+        return -1;
+      if(strcmp(opType, "*") == 0)
+        cost += 3;
+      else if(strcmp(opType, "&&") == 0 || strcmp(opType, "||") == 0)
+        cost += 2;
+      else
+        cost++;
+      costStack[depth++] = node->fields.children.left;
+      costStack[depth++] = node->fields.children.right;
+      break;
+    }
+    case TERNARY:
+      cost += 2;
+      costStack[depth++] = node->fields.children.left;
+      costStack[depth++] = node->fields.children.middle;
+      costStack[depth++] = node->fields.children.right;
+      break;
+    default:
+      return -1;
+    }
+  }
+  return cost;
+}
+
+/**
+ * useCmov(astnode_t *thenValue, astnode_t *elseValue)
+ * Cost model choosing how to lower a select: both arms evaluated and a cmov picking one, when
+ * they are cheap enough to beat a branch that may be mispredicted, or a branch around each
+ *
+ * param *thenValue - the value selected when the condition holds
+ * param *elseValue - the value selected otherwise
+ * return int - returns 1 to use a cmov, 0 to branch
+ **/
+int useCmov(astnode_t *thenValue, astnode_t *elseValue){
+  if(!(optFlags & OPT_CMOV))
+    return 0;
+  int thenCost = selectCost(thenValue);
+  if(thenCost < 0 || thenCost > CMOV_MAX_COST)
+    return 0;
+  int elseCost = selectCost(elseValue);
+  return elseCost >= 0 && thenCost + elseCost <= CMOV_MAX_COST;
+}
+
+/**
+ * emitCmov(FILE *outFile)
+ * Finishes a cmov select: the condition and then value were pushed in that order, and the
+ * else value is in %eax, which is left holding the selected value
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitCmov(FILE *outFile){
+  emit(outFile, " pop %%ecx\n");
+  emit(outFile, " pop %%edx\n");
+  pushedBytes -= 8;
+  emit(outFile, " cmpl $0, %%edx\n");
+  emit(outFile, " cmovne %%ecx, %%eax\n");
+}
+
+/**
+ * generateExpression(astnode_t *expr, FILE *outFile)
+ * Generates the assembly computing an expression into %eax. The AST is walked with an
+ * explicit stack, so deeply nested expressions do not use up the C stack.
+ *
+ * param *expr - the expression to generate
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateExpression(astnode_t *expr, FILE *outFile){
+  aststack_t stack = {0};
+  pushFrame(&stack, expr);
+  while(stack.depth > 0){
+    astframe_t *frame = &stack.frames[stack.depth-1];
+    astnode_t *currNode = frame->node;
+    int state = frame->state++;
+    //Just an integer, move it into eax
+    if(currNode->nodeType == INTEGER)
+      emit(outFile, " movl $%d, %%eax\n", currNode->fields.intVal);
+    else if(currNode->nodeType == SYMBOL)
+      emit(outFile, " movl %d(%s), %%eax\n", slotOffset(getVarOffset(currNode->fields.symbol)), frameRegister());
+    //Common subexpression, computed into its temporary the first time and reloaded after
+    else if(currNode->nodeType == SHARED){
+      int temp = currNode->fields.children.right->fields.intVal;
+      if(state == 0 && !tempReady[temp]){
+        pushFrame(&stack, currNode->fields.children.left);
+        continue;
+      }
+      if(state == 1){
+        emit(outFile, " movl %%eax, %d(%s)\n", slotOffset(-4*(temp+1)), frameRegister());
+        tempReady[temp] = 1;
+      }
+      else
+        emit(outFile, " movl %d(%s), %%eax\n", slotOffset(-4*(temp+1)), frameRegister());
+    }
+    else if(currNode->nodeType == ASSIGNMENT){
+      if(state == 0){
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      emit(outFile, " movl %%eax, %d(%s)\n", slotOffset(getVarOffset(currNode->fields.children.left->fields.symbol)),
+           frameRegister());
+    }
+    //Unary op
+    else if(currNode->nodeType == UNARY_OP){
+      if(state == 0){
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      emitUnaryOp(currNode->fields.children.left->fields.strVal[0], outFile);
+    }
+    //Short-circuiting binary ops, only evaluate the right operand when the left does not decide
+    else if(currNode->nodeType == BINARY_OP && (strncmp(currNode->fields.children.middle->fields.strVal, "&&", 5) == 0
+                                                || strncmp(currNode->fields.children.middle->fields.strVal, "||", 5) == 0)){
+      char *opType = currNode->fields.children.middle->fields.strVal;
+      if(state == 0){
+        frame->labels[0] = generateLabel();
+        frame->labels[1] = generateLabel();
+        emitCounter(currNode, COUNT_REACHED, outFile);
+        pushFrame(&stack, currNode->fields.children.left);
+        continue;
+      }
+      char *clauseLabel = frame->labels[0];
+      char *endLabel = frame->labels[1];
+      LAYOUT layout = (state == 1) ? shortCircuitLayout(currNode, outFile) : LAYOUT_STATIC;
+      if(state == 1 && layout == LAYOUT_INLINE){
+        //A false left operand of && is already its value; a true one of || jumps out of line for a 1
+        emit(outFile, " cmpl $0, %%eax\n");
+        if(opType[0] == '&')
+          emit(outFile, " je %s\n", endLabel);
+        else{
+          FILE *outOfLine = deferredStream(DEFER_OUT_OF_LINE);
+          emit(outFile, " jne %s\n", clauseLabel);
+          emit(outOfLine, "%s:\n", clauseLabel);
+          emit(outOfLine, " movl $1, %%eax\n");
+          emit(outOfLine, " jmp %s\n", endLabel);
+        }
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      if(state == 1 && layout == LAYOUT_STATIC){
+        emit(outFile, " cmpl $0, %%eax\n");
+        if(opType[0] == '&'){
+          emit(outFile, " jne %s\n", clauseLabel);
+        }
+        else{
+          emit(outFile, " je %s\n", clauseLabel);
+          emit(outFile, " movl $1, %%eax\n");
+        }
+        emit(outFile, " jmp %s\n", endLabel);
+        emit(outFile, "%s:\n", clauseLabel);
+        emitCounter(currNode, COUNT_TAKEN, outFile);
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      if(state == 1){
+        //The right operand deferred, generated right away (nothing in it is deferred again)
+        FILE *outOfLine = deferredStream((layout == LAYOUT_UNLIKELY) ? DEFER_UNLIKELY : DEFER_OUT_OF_LINE);
+        emit(outFile, " cmpl $0, %%eax\n");
+        if(opType[0] == '&')
+          emit(outFile, " jne %s\n", clauseLabel);
+        else{
+          emit(outFile, " je %s\n", clauseLabel);
+          emit(outFile, " movl $1, %%eax\n");
+        }
+        emit(outOfLine, "%s:\n", clauseLabel);
+        generateExpression(currNode->fields.children.right, outOfLine);
+        emitTruthValue(outOfLine);
+        emit(outOfLine, " jmp %s\n", endLabel);
+      }
+      else
+        emitTruthValue(outFile);
+      emit(outFile, "%s:\n", endLabel);
+      free(clauseLabel);
+      free(endLabel);
+    }
+    //Conditional operator, either both arms and a cmov (no labels) or a branch to the arm selected
+    else if(currNode->nodeType == TERNARY){
+      if(state == 0){
+        if(!useCmov(currNode->fields.children.middle, currNode->fields.children.right)){
+          frame->labels[0] = generateLabel();
+          frame->labels[1] = generateLabel();
+        }
+        pushFrame(&stack, currNode->fields.children.left);
+        continue;
+      }
+      char *elseLabel = frame->labels[0];
+      char *endLabel = frame->labels[1];
+      if(state == 1){
+        if(elseLabel == NULL){
+          emit(outFile, " push %%eax\n");
+          pushedBytes += 4;
+        }
+        else{
+          emit(outFile, " cmpl $0, %%eax\n");
+          emit(outFile, " je %s\n", elseLabel);
+        }
+        pushFrame(&stack, currNode->fields.children.middle);
+        continue;
+      }
+      if(state == 2){
+        if(elseLabel == NULL){
+          emit(outFile, " push %%eax\n");
+          pushedBytes += 4;
+        }
+        else{
+          emit(outFile, " jmp %s\n", endLabel);
+          emit(outFile, "%s:\n", elseLabel);
+        }
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      if(elseLabel == NULL)
+        emitCmov(outFile);
+      else{
+        emit(outFile, "%s:\n", endLabel);
+        free(elseLabel);
+        free(endLabel);
+      }
+    }
+    //Binary op, push the first operand evaluated while computing the second
+    else if(currNode->nodeType == BINARY_OP){
+      char *opType = currNode->fields.children.middle->fields.strVal;
+      astnode_t *first = currNode->fields.children.left;
+      astnode_t *second = currNode->fields.children.right;
+      if(rightOperandFirst(opType)){
+        first = currNode->fields.children.right;
+        second = currNode->fields.children.left;
+      }
+      if(state == 0){
+        pushFrame(&stack, first);
+        continue;
+      }
+      if(state == 1){
+        emit(outFile, " push %%eax\n");
+        pushedBytes += 4;
+        pushFrame(&stack, second);
+        continue;
+      }
+      emit(outFile, " pop %%ecx\n");
+      pushedBytes -= 4;
+      emitBinaryOp(opType, outFile);
+    }
+    //Arguments are pushed last to first (cdecl), each as soon as it is computed
+    else if(currNode->nodeType == ARGUMENT){
+      if(state == 0 && currNode->fields.children.right == NULL)
+        state = frame->state++;
+      if(state < 2){
+        pushFrame(&stack, (state == 0) ? currNode->fields.children.right : currNode->fields.children.left);
+        continue;
+      }
+      emit(outFile, " push %%eax\n");
+      pushedBytes += 4;
+    }
+    //Only %eax, %ecx and %edx are used, which the callee may clobber; anything live is on the stack
+    else if(currNode->nodeType == CALL){
+      if(state == 0 && currNode->fields.children.right != NULL){
+        pushFrame(&stack, currNode->fields.children.right);
+        continue;
+      }
+      emitCounter(currNode, COUNT_REACHED, outFile);
+      emit(outFile, " call %s\n", symbolName(currNode->fields.children.left->fields.symbol));
+      int numArgs = countArguments(currNode);
+      if(numArgs > 0)
+        emit(outFile, " addl $%d, %%esp\n", 4*numArgs);
+      pushedBytes -= 4*numArgs;
+    }
+    else{
+      fprintf(stderr, "Cannot generate assembly for %s node in an expression.\n", astTypeName(currNode->nodeType));
+      exit(1);
+    }
+    stack.depth--;
+  }
+  freeASTStack(&stack);
+}
+
+/**
+ * isTailCall(astnode_t *expr)
+ * Checks whether a returned expression is a call that can be made as a tail call: it passes no
+ * more arguments than the current function was passed, so they fit in its parameter slots
+ *
+ * param *expr - the RETURN node's expression
+ * return int - returns 1 for a tail call, 0 otherwise
+ **/
+int isTailCall(astnode_t *expr){
+  return (optFlags & OPT_TAIL_CALLS) && expr->nodeType == CALL && countArguments(expr) <= numParams;
+}
+
+/**
+ * generateTailCall(astnode_t *call, FILE *outFile)
+ * Generates a tail call as a jump. The arguments are pushed as for a call, then copied over the
+ * current function's parameters, and its frame is popped, so the callee returns straight to the
+ * caller (which pops what it pushed). Tail recursion thus runs in constant stack space.
+ *
+ * param *call - the CALL node, see isTailCall()
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateTailCall(astnode_t *call, FILE *outFile){
+  if(call->fields.children.right != NULL)
+    generateExpression(call->fields.children.right, outFile);
+  int paramOffset = omitFramePointer ? 4 : 8;
+  int numArgs = countArguments(call);
+  int i;
+  for(i = 0; i < numArgs; i++, paramOffset += 4){
+    emit(outFile, " movl %d(%%esp), %%eax\n", 4*i);
+    emit(outFile, " movl %%eax, %d(%s)\n", slotOffset(paramOffset), frameRegister());
+  }
+  emitEpilogue(outFile);
+  pushedBytes = 0;
+  emitCounter(call, COUNT_REACHED, outFile);
+  emit(outFile, " jmp %s\n", symbolName(call->fields.children.left->fields.symbol));
+}
+
+/**
+ * framePointerNeeded(astnode_t *funcNode)
+ * Checks whether a function sets up %ebp. Its stack use is all known statically, so its slots can
+ * be addressed from %esp instead; this is done for leaf functions, counting tail calls as they leave
+ * the frame first, while functions making calls keep %ebp for profilers and debuggers to walk the stack.
+ *
+ * param *funcNode - the FUNCTION node, with numParams already set for it
+ * return int - returns 1 if the function needs a frame pointer, 0 otherwise
+ **/
+int framePointerNeeded(astnode_t *funcNode){
+  if(!(optFlags & OPT_OMIT_FRAME_POINTER))
+    return 1;
+  size_t depth = 0;
+  growArray((void **) &costStack, &costStackCap, 1, sizeof(astnode_t *));
+  costStack[depth++] = funcNode->fields.children.right;
+  while(depth > 0){
+    astnode_t *node = costStack[--depth];
+    if(node == NULL || node->nodeType == INTEGER || node->nodeType == SYMBOL || node->nodeType == DATA
+       || node->nodeType == BREAK || node->nodeType == CONTINUE)
+      continue;
+    if(node->nodeType == CALL)
+      return 1;
+    growArray((void **) &costStack, &costStackCap, depth + 3, sizeof(astnode_t *));
+    if(node->nodeType == RETURN && isTailCall(node->fields.children.left)){
+      costStack[depth++] = node->fields.children.left->fields.children.right;
+      continue;
+    }
+    costStack[depth++] = node->fields.children.left;
+    costStack[depth++] = node->fields.children.middle;
+    costStack[depth++] = node->fields.children.right;
+  }
+  return 0;
+}
+
+/**
+ * generateStatements(astnode_t *statement, FILE *outFile)
+ * Generates a chain of statements. The variables declared in a nested chain (a block) are
+ * popped at its end, unless it returned.
+ *
+ * param *statement - the first STATEMENT node of the chain
+ * param *outFile - the file pointer to write the assembly to
+ * return astnode_t* - returns the last STATEMENT node of the chain, or NULL if it is empty
+ **/
+astnode_t *generateStatements(astnode_t *statement, FILE *outFile){
+  astnode_t *lastStatement = NULL;
+  for(; statement != NULL; statement = statement->fields.children.right){
+    if(statement->fields.children.middle != NULL)
+      memset(tempReady, 0, statement->fields.children.middle->fields.intVal);
+    if(debugLines)
+      emitLoc(statement, outFile);
+    generate(statement->fields.children.left, outFile);
+    lastStatement = statement;
+  }
+  return lastStatement;
+}
+
+/**
+ * generateBlock(astnode_t *statement, FILE *outFile)
+ * Generates the chain of statements of an if or else branch, then pops the variables it declared
+ *
+ * param *statement - the first STATEMENT node of the branch
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateBlock(astnode_t *statement, FILE *outFile){
+  int blockIndex = stackIndex;
+  astnode_t *lastStatement = generateStatements(statement, outFile);
+  AST_TYPE lastType = (lastStatement == NULL) ? STATEMENT : lastStatement->fields.children.left->nodeType;
+  if(stackIndex != blockIndex && lastType != RETURN && lastType != BREAK && lastType != CONTINUE)
+    emit(outFile, " addl $%d, %%esp\n", blockIndex - stackIndex);
+  stackIndex = blockIndex;
+}
+
+/**
+ * generateIfSelect(astnode_t *ifNode, FILE *outFile)
+ * Lowers an if whose branches each assign one cheap value to the same variable to a cmov,
+ * see useCmov(); without an else, the variable keeps its own value.
+ *
+ * param *ifNode - the IF node
+ * param *outFile - the file pointer to write the assembly to
+ * return int - returns 1 if the if was generated, 0 if it has to branch
+ **/
+int generateIfSelect(astnode_t *ifNode, FILE *outFile){
+  astnode_t *thenChain = ifNode->fields.children.middle;
+  astnode_t *elseChain = ifNode->fields.children.right;
+  if(thenChain == NULL || thenChain->fields.children.right != NULL
+     || thenChain->fields.children.left->nodeType != ASSIGNMENT)
+    return 0;
+  astnode_t *thenStore = thenChain->fields.children.left;
+  astnode_t *elseValue = thenStore->fields.children.left;
+  if(elseChain != NULL){
+    astnode_t *elseStore = elseChain->fields.children.left;
+    if(elseChain->fields.children.right != NULL || elseStore->nodeType != ASSIGNMENT
+       || elseStore->fields.children.left->fields.symbol != thenStore->fields.children.left->fields.symbol)
+      return 0;
+    elseValue = elseStore->fields.children.right;
+  }
+  if(!useCmov(thenStore->fields.children.right, elseValue))
+    return 0;
+  generateExpression(ifNode->fields.children.left, outFile);
+  emitCounterIf(ifNode, COUNT_TAKEN, outFile);
+  emit(outFile, " push %%eax\n");
+  pushedBytes += 4;
+  generateExpression(thenStore->fields.children.right, outFile);
+  emit(outFile, " push %%eax\n");
+  pushedBytes += 4;
+  generateExpression(elseValue, outFile);
+  emitCmov(outFile);
+  emit(outFile, " movl %%eax, %d(%s)\n", slotOffset(getVarOffset(thenStore->fields.children.left->fields.symbol)),
+       frameRegister());
+  return 1;
+}
+
+/**
+ * unlikelyBranch(astnode_t *chain)
+ * Guesses statically whether a branch is an error path: one that ends by returning a negative
+ * constant
+ *
+ * param *chain - the first STATEMENT of the branch
+ * return int - returns 1 if it is unlikely to be taken, 0 otherwise
+ **/
+int unlikelyBranch(astnode_t *chain){
+  if(chain == NULL)
+    return 0;
+  for(; chain->fields.children.right != NULL; chain = chain->fields.children.right);
+  astnode_t *statement = chain->fields.children.left;
+  if(statement->nodeType != RETURN)
+    return 0;
+  astnode_t *value = statement->fields.children.left;
+  if(value == NULL)
+    return 0;
+  if(value->nodeType == UNARY_OP && value->fields.children.left->fields.strVal[0] == '-')
+    return value->fields.children.right->nodeType == INTEGER && value->fields.children.right->fields.intVal > 0;
+  return value->nodeType == INTEGER && value->fields.intVal < 0;
+}
+
+/**
+ * endsInJump(astnode_t *chain)
+ * Checks whether a branch ends with a return, break or continue, so nothing runs after it
+ *
+ * param *chain - the first STATEMENT of the branch
+ * return int - returns 1 if it ends with a jump, 0 otherwise
+ **/
+int endsInJump(astnode_t *chain){
+  if(chain == NULL)
+    return 0;
+  for(; chain->fields.children.right != NULL; chain = chain->fields.children.right);
+  AST_TYPE type = chain->fields.children.left->nodeType;
+  return type == RETURN || type == BREAK || type == CONTINUE;
+}
+
+/**
+ * generateIfLayout(astnode_t *ifNode, FILE *outFile)
+ * Lays out an if away from the usual order when its then branch is cold. With a profile
+ * (-fprofile-use), a branch rarely taken (see profileCold()) goes to the unlikely code, see
+ * deferredStream(), and otherwise an else branch taken more often than the then branch falls
+ * through from the condition. Without one, a then branch that is an error path (see
+ * unlikelyBranch()) goes to the unlikely code.
+ *
+ * param *ifNode - the IF node
+ * param *outFile - the file pointer to write the assembly to
+ * return int - returns 1 if the if was generated, 0 if the usual layout is the one to use
+ **/
+int generateIfLayout(astnode_t *ifNode, FILE *outFile){
+  astnode_t *thenChain = ifNode->fields.children.middle;
+  astnode_t *elseChain = ifNode->fields.children.right;
+  int movable = !isDeferred(outFile);
+  int thenCold = 0, elseCold = 0, elseHotter = 0;
+  uint64_t reached = 0, taken = 0;
+  if(profileCount(ifNode, COUNT_REACHED, &reached) && profileCount(ifNode, COUNT_TAKEN, &taken)){
+    if(reached == 0)
+      return 0;
+    if(taken > reached)
+      taken = reached;
+    thenCold = movable && profileCold(taken, reached);
+    elseCold = movable && !thenCold && elseChain != NULL && profileCold(reached - taken, reached);
+    elseHotter = elseChain != NULL && reached - taken > taken;
+  }
+  else
+    thenCold = movable && unlikelyBranch(thenChain);
+  //Whether the condition branches to the then branch, the else branch falling through
+  int inverted = thenCold || (elseHotter && !elseCold);
+  if(!inverted && !elseCold)
+    return 0;
+  char *branchLabel = generateLabel();
+  char *endLabel = generateLabel();
+  generateExpression(ifNode->fields.children.left, outFile);
+  emit(outFile, " cmpl $0, %%eax\n");
+  emit(outFile, inverted ? " jne %s\n" : " je %s\n", branchLabel);
+  generateBlock(inverted ? elseChain : thenChain, outFile);
+  astnode_t *branched = inverted ? thenChain : elseChain;
+  if(thenCold || elseCold){
+    FILE *unlikely = deferredStream(DEFER_UNLIKELY);
+    emit(unlikely, "%s:\n", branchLabel);
+    generateBlock(branched, unlikely);
+    if(!endsInJump(branched))
+      emit(unlikely, " jmp %s\n", endLabel);
+  }
+  else{
+    emit(outFile, " jmp %s\n", endLabel);
+    emit(outFile, "%s:\n", branchLabel);
+    generateBlock(branched, outFile);
+  }
+  emit(outFile, "%s:\n", endLabel);
+  free(branchLabel);
+  free(endLabel);
+  return 1;
+}
+
+/**
+ * generateLoop(astnode_t *loopNode, FILE *outFile)
+ * Generates a while or do-while loop with its condition at the bottom, so each iteration takes a
+ * single conditional branch; a while loop jumps to its condition first.
+ *
+ * param *loopNode - the WHILE or DO_WHILE node
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateLoop(astnode_t *loopNode, FILE *outFile){
+  astnode_t *cond = loopNode->fields.children.left;
+  char *bodyLabel = generateLabel();
+  char *continueLabel = generateLabel();
+  char *endLabel = generateLabel();
+  char *condLabel = NULL;
+  emitCounter(loopNode, COUNT_REACHED, outFile);
+  if(loopNode->nodeType == WHILE && cond != NULL){
+    condLabel = generateLabel();
+    emit(outFile, " jmp %s\n", condLabel);
+  }
+  //The body is the loop's header, where each iteration starts; loops that never ran are not aligned
+  uint64_t entries = 1;
+  profileCount(loopNode, COUNT_REACHED, &entries);
+  if(!isDeferred(outFile) && entries > 0)
+    emit(outFile, " .p2align %d,,%d\n", LOOP_ALIGN, LOOP_ALIGN_MAX_SKIP);
+  emit(outFile, "%s:\n", bodyLabel);
+  emitCounter(loopNode, COUNT_TAKEN, outFile);
+  growArray((void **) &loopLabels, &loopLabelsCap, numLoopLabels + 1, sizeof(looplabels_t));
+  loopLabels[numLoopLabels].breakLabel = endLabel;
+  loopLabels[numLoopLabels].continueLabel = continueLabel;
+  loopLabels[numLoopLabels].stackIndex = stackIndex;
+  numLoopLabels++;
+  generateBlock(loopNode->fields.children.middle, outFile);
+  numLoopLabels--;
+  emit(outFile, "%s:\n", continueLabel);
+  generateBlock(loopNode->fields.children.right, outFile);
+  if(condLabel != NULL)
+    emit(outFile, "%s:\n", condLabel);
+  if(debugLines)
+    emitLoc(loopNode, outFile);
+  if(cond != NULL){
+    //The body reused the stack temporaries of the condition's common subexpressions
+    if(tempReadyCap > 0)
+      memset(tempReady, 0, tempReadyCap);
+    generateExpression(cond, outFile);
+    emit(outFile, " cmpl $0, %%eax\n");
+    emit(outFile, " jne %s\n", bodyLabel);
   }
-  //Unary op
-  else if(currNode->nodeType == UNARY_OP){
-    char opType = currNode->fields.children.left->fields.strVal[0];
-    generate(currNode->fields.children.right, outFile);
-    switch(opType){
-      case '~':
-        fprintf(outFile, " not %%eax\n");
-        break;
-      case '!':
-        fprintf(outFile, " cmpl $0, %%eax\n");
-        fprintf(outFile, " movl $0, %%eax\n");
-        fprintf(outFile, " sete %%al\n");
-        break;
-      case '-':
-        fprintf(outFile, " neg %%eax\n");
-        break;
+  else
+    emit(outFile, " jmp %s\n", bodyLabel);
+  emit(outFile, "%s:\n", endLabel);
+  free(bodyLabel);
+  free(continueLabel);
+  free(endLabel);
+  free(condLabel);
+}
+
+/**
+ * compareCases(const void *a, const void *b)
+ * Orders the cases of a switch by value
+ *
+ * param *a - a switchcase_t
+ * param *b - another switchcase_t
+ * return int - returns the qsort() comparison
+ **/
+static int compareCases(const void *a, const void *b){
+  int valueA = ((const switchcase_t *) a)->value;
+  int valueB = ((const switchcase_t *) b)->value;
+  return (valueA > valueB) - (valueA < valueB);
+}
+
+/**
+ * generateCaseSearch(switchcase_t *cases, int lo, int hi, char **targetLabels, char *defaultLabel, FILE *outFile)
+ * Generates a balanced binary search of sorted cases for the value in %eax: each step compares
+ * with the middle case, and a few cases left are compared with one after the other.
+ *
+ * param *cases - the switch's cases, sorted by value
+ * param lo - the first case to search
+ * param hi - one past the last case to search
+ * param **targetLabels - the labels the cases jump to
+ * param *defaultLabel - where to jump if no case matches
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateCaseSearch(switchcase_t *cases, int lo, int hi, char **targetLabels, char *defaultLabel, FILE *outFile){
+  if(hi - lo <= SEARCH_LINEAR_CASES){
+    for(; lo < hi; lo++){
+      emit(outFile, " cmpl $%d, %%eax\n", cases[lo].value);
+      emit(outFile, " je %s\n", targetLabels[cases[lo].target]);
     }
+    emit(outFile, " jmp %s\n", defaultLabel);
     return;
   }
-  //Binary op statement
-  else if(currNode->nodeType == BINARY_OP){
-    char *opType = currNode->fields.children.middle->fields.strVal;
-    if(strncmp(opType, "+", 5) == 0){
-        generate(currNode->fields.children.left, outFile);
-        fprintf(outFile, " push %%eax\n");
-        generate(currNode->fields.children.right, outFile);
-        fprintf(outFile, " pop %%ecx\n");
-        fprintf(outFile, " addl %%ecx, %%eax\n");
+  int mid = lo + (hi - lo) / 2;
+  char *lessLabel = generateLabel();
+  emit(outFile, " cmpl $%d, %%eax\n", cases[mid].value);
+  emit(outFile, " je %s\n", targetLabels[cases[mid].target]);
+  emit(outFile, " jl %s\n", lessLabel);
+  generateCaseSearch(cases, mid + 1, hi, targetLabels, defaultLabel, outFile);
+  emit(outFile, "%s:\n", lessLabel);
+  generateCaseSearch(cases, lo, mid, targetLabels, defaultLabel, outFile);
+  free(lessLabel);
+}
+
+/**
+ * generateSwitch(astnode_t *switchNode, FILE *outFile)
+ * Generates a switch. Labels with no statement between them share one target. The jump to the
+ * matching case is lowered by how the case values are spread (see gen.h for the thresholds):
+ * a bit test of a mask per target for a few targets within 32 values, an indexed jump table
+ * in .rodata for dense values, or a balanced binary search, see generateCaseSearch().
+ *
+ * param *switchNode - the SWITCH node
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generateSwitch(astnode_t *switchNode, FILE *outFile){
+  astnode_t *statement = NULL;
+  int numCases = 0;
+  int numTargets = 0;
+  int isLabel = 0;
+  for(statement = switchNode->fields.children.middle; statement != NULL; statement = statement->fields.children.right){
+    AST_TYPE type = statement->fields.children.left->nodeType;
+    numCases += (type == CASE);
+    numTargets += (type == CASE || type == DEFAULT) && !isLabel;
+    isLabel = (type == CASE || type == DEFAULT);
+  }
+  switchcase_t *cases = (switchcase_t *) malloc((numCases + 1)*sizeof(switchcase_t));
+  char **targetLabels = (char **) malloc((numTargets + 1)*sizeof(char *));
+  int *targetSeen = (int *) calloc(numTargets + 1, sizeof(int));
+  if(cases == NULL || targetLabels == NULL || targetSeen == NULL){
+    fprintf(stderr, "Failed to allocate space for switch cases.\n");
+    exit(1);
+  }
+  char *defaultLabel = NULL;
+  numCases = numTargets = isLabel = 0;
+  for(statement = switchNode->fields.children.middle; statement != NULL; statement = statement->fields.children.right){
+    astnode_t *content = statement->fields.children.left;
+    if(content->nodeType != CASE && content->nodeType != DEFAULT){
+      isLabel = 0;
+      continue;
     }
-    else if(strncmp(opType, "-", 5) == 0){
-        generate(currNode->fields.children.right, outFile);
-        fprintf(outFile, " push %%eax\n");
-        generate(currNode->fields.children.left, outFile);
-        fprintf(outFile, " pop %%ecx\n");
-        fprintf(outFile, " subl %%ecx, %%eax\n");
+    if(!isLabel)
+      targetLabels[numTargets++] = generateLabel();
+    isLabel = 1;
+    if(content->nodeType == DEFAULT)
+      defaultLabel = targetLabels[numTargets-1];
+    else{
+      cases[numCases].value = content->fields.children.left->fields.intVal;
+      cases[numCases++].target = numTargets - 1;
     }
-    else if(strncmp(opType, "*", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " imul %%ecx, %%eax\n");
+  }
+  char *endLabel = generateLabel();
+  if(defaultLabel == NULL)
+    defaultLabel = endLabel;
+  qsort(cases, numCases, sizeof(switchcase_t), compareCases);
+  int i;
+  int casesTargeted = 0;
+  for(i = 0; i < numCases; i++){
+    casesTargeted += !targetSeen[cases[i].target];
+    targetSeen[cases[i].target] = 1;
+  }
+  int64_t range = (numCases == 0) ? 0 : (int64_t) cases[numCases-1].value - cases[0].value + 1;
+  int useBitTest = (optFlags & OPT_JUMP_TABLES) && numCases >= BIT_TEST_MIN_CASES
+    && casesTargeted <= BIT_TEST_MAX_TARGETS && range <= 32;
+  int useTable = (optFlags & OPT_JUMP_TABLES) && numCases >= JUMP_TABLE_MIN_CASES
+    && 100*(int64_t) numCases >= JUMP_TABLE_MIN_DENSITY*range;
+  generateExpression(switchNode->fields.children.left, outFile);
+  if(useBitTest || useTable){
+    //Cases are numbered from the smallest; anything else is above the range once unsigned
+    if(cases[0].value != 0)
+      emit(outFile, " subl $%d, %%eax\n", cases[0].value);
+    emit(outFile, " cmpl $%d, %%eax\n", (int) (range - 1));
+    emit(outFile, " ja %s\n", defaultLabel);
+  }
+  if(useBitTest){
+    int target;
+    for(target = 0; target < numTargets; target++){
+      uint32_t mask = 0;
+      for(i = 0; i < numCases; i++){
+        if(cases[i].target == target)
+          mask |= (uint32_t) 1 << (uint32_t) (cases[i].value - cases[0].value);
+      }
+      if(mask == 0)
+        continue;
+      emit(outFile, " movl $0x%x, %%edx\n", mask);
+      emit(outFile, " btl %%eax, %%edx\n");
+      emit(outFile, " jc %s\n", targetLabels[target]);
     }
-    else if(strncmp(opType, "/", 5) == 0){
-      //Push e2
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " push %%eax\n");
-      //e1 in EAX
-      generate(currNode->fields.children.left, outFile);
-      //Pop e2 into ECX
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cdq\n");
-      fprintf(outFile, " idivl %%ecx\n");
+    emit(outFile, " jmp %s\n", defaultLabel);
+  }
+  else if(useTable){
+    char *tableLabel = generateLabel();
+    emit(outFile, " jmp *%s(,%%eax,4)\n", tableLabel);
+    //pushed rather than switching back to .text, since this code may be in .text.unlikely
+    emit(outFile, " .pushsection .rodata\n");
+    emit(outFile, " .p2align 2\n");
+    emit(outFile, "%s:\n", tableLabel);
+    int64_t value = cases[0].value;
+    for(i = 0; i < numCases; value++){
+      if(value == cases[i].value)
+        emit(outFile, " .long %s\n", targetLabels[cases[i++].target]);
+      else
+        emit(outFile, " .long %s\n", defaultLabel);
     }
-    else if(strncmp(opType, "%", 5) == 0){
-      //Push e2
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " push %%eax\n");
-      //e1 in EAX
-      generate(currNode->fields.children.left, outFile);
-      //Pop e2 into ECX
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cdq\n");
-      fprintf(outFile, " idivl %%ecx\n");
-      //Move remainder into eax
-      fprintf(outFile, " movl %%edx, %%eax\n");
+    emit(outFile, " .popsection\n");
+    free(tableLabel);
+  }
+  else
+    generateCaseSearch(cases, 0, numCases, targetLabels, defaultLabel, outFile);
+  //The body, with break leaving the switch
+  growArray((void **) &loopLabels, &loopLabelsCap, numLoopLabels + 1, sizeof(looplabels_t));
+  loopLabels[numLoopLabels].breakLabel = endLabel;
+  loopLabels[numLoopLabels].continueLabel = NULL;
+  loopLabels[numLoopLabels].stackIndex = stackIndex;
+  numLoopLabels++;
+  int target = 0;
+  isLabel = 0;
+  for(statement = switchNode->fields.children.middle; statement != NULL; statement = statement->fields.children.right){
+    astnode_t *content = statement->fields.children.left;
+    if(content->nodeType == CASE || content->nodeType == DEFAULT){
+      if(!isLabel)
+        emit(outFile, "%s:\n", targetLabels[target++]);
+      isLabel = 1;
+      continue;
     }
-    //Binary conditional operators
-    else if(strncmp(opType, "<", 5) == 0){
+    isLabel = 0;
+    if(statement->fields.children.middle != NULL)
+      memset(tempReady, 0, statement->fields.children.middle->fields.intVal);
+    generate(content, outFile);
+  }
+  numLoopLabels--;
+  emit(outFile, "%s:\n", endLabel);
+  for(i = 0; i < numTargets; i++)
+    free(targetLabels[i]);
+  free(targetLabels);
+  free(targetSeen);
+  free(cases);
+  free(endLabel);
+}
+
+/**
+ * generate(astnode_t *root, FILE *outFile)
+ * Given a valid AST, generates assemblable assembly and writes it to a file.
+ *
+ * param *root - the PROGRAM node of the ast
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void generate(astnode_t *root, FILE *outFile){
+  if(root == NULL){
+    fprintf(stderr, "Null AST node, cannot generate assembly.\n");
+    exit(1);
+  }
+  astnode_t *currNode = root;
+  //Now recursively traverse AST and use it to generate assembly
+  if(currNode->nodeType == PROGRAM){
+    startLineInfo(outFile);
+    for(; currNode != NULL; currNode = currNode->fields.children.right)
       generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setl %%al\n");
+    emitProfileRuntime(outFile);
+    return;
+  }
+  else if(currNode->nodeType == FUNCTION){
+    char *funcName = symbolName(currNode->fields.children.left->fields.symbol);
+    currFuncName = funcName;
+    labelCounter = 0;
+    numParams = countParameters(currNode);
+    omitFramePointer = !framePointerNeeded(currNode);
+    pushedBytes = 0;
+    //Functions the profile says never ran go with the unlikely code
+    uint64_t calls = 0;
+    int unlikely = profileCount(currNode, COUNT_REACHED, &calls) && calls == 0;
+    if(unlikely)
+      emit(outFile, " .section .text.unlikely,\"ax\",@progbits\n");
+    else
+      emit(outFile, " .p2align %d\n", FUNCTION_ALIGN);
+    emit(outFile, " .globl %s\n .type %s, @function\n%s:\n", funcName, funcName, funcName);
+    if(debugLines){
+      locStream = NULL;
+      emitLoc(currNode, outFile);
     }
-    else if(strncmp(opType, ">", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setg %%al\n");
+    if(!omitFramePointer){
+      emit(outFile, " push %%ebp\n");
+      emit(outFile, " movl %%esp, %%ebp\n");
     }
-    else if(strncmp(opType, "<=", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setle %%al\n");
+    emitCounter(currNode, COUNT_REACHED, outFile);
+    if(varOffsets != NULL)
+      memset(varOffsets, 0, varOffsetsCap*sizeof(int));
+    //Parameters are where the caller pushed them, above the return address (and saved %ebp)
+    int paramOffset = omitFramePointer ? 4 : 8;
+    astnode_t *param = currNode->fields.children.middle;
+    for(; param != NULL; param = param->fields.children.right, paramOffset += 4)
+      setVarOffset(param->fields.children.left->fields.symbol, paramOffset);
+    int numTemps = 0;
+    size_t numStatements = collectStatements(currNode, &funcStatements, &funcStatementsCap);
+    size_t i;
+    for(i = 0; i < numStatements; i++){
+      astnode_t *temps = funcStatements[i]->fields.children.middle;
+      if(temps != NULL && temps->fields.intVal > numTemps)
+        numTemps = temps->fields.intVal;
     }
-    else if(strncmp(opType, ">=", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setge %%al\n");
+    if(numTemps > 0){
+      emit(outFile, " subl $%d, %%esp\n", 4*numTemps);
+      growArray((void **) &tempReady, &tempReadyCap, numTemps, 1);
     }
-    else if(strncmp(opType, "!=", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setne %%al\n");
+    stackIndex = -4*numTemps;
+    astnode_t *lastStatement = generateStatements(currNode->fields.children.right, outFile);
+    //Falling off the end of a function returns 0
+    if(lastStatement == NULL || lastStatement->fields.children.left->nodeType != RETURN){
+      emit(outFile, " movl $0, %%eax\n");
+      emitEpilogue(outFile);
+      emit(outFile, " ret\n");
     }
-    else if(strncmp(opType, "==", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " cmpl %%eax, %%ecx\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " sete %%al\n");
+    emitDeferredCode(funcName, unlikely, outFile);
+    return;
+  }
+  else if(currNode->nodeType == RETURN){
+    if(isTailCall(currNode->fields.children.left)){
+      generateTailCall(currNode->fields.children.left, outFile);
+      return;
     }
-    else if(strncmp(opType, "&&", 5) == 0){
-      char *clauseLabel = generateLabel();
-      char *endLabel = generateLabel();
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " cmpl $0, %%eax\n");
-      fprintf(outFile, " jne %s\n", clauseLabel);
-      fprintf(outFile, " jmp %s\n", endLabel);
-      fprintf(outFile, "%s:\n", clauseLabel);
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " cmpl $0, %%eax\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setne %%al\n");
-      fprintf(outFile, "%s:\n", endLabel);
+    generate(currNode->fields.children.left, outFile);
+    emitEpilogue(outFile);
+    emit(outFile, " ret\n");
+    return;
+  }
+  else if(currNode->nodeType == IF){
+    //A constant condition, like the blocks of unrolled loops, only needs the branch it picks
+    if(currNode->fields.children.left->nodeType == INTEGER){
+      astnode_t *branch = currNode->fields.children.left->fields.intVal ? currNode->fields.children.middle : currNode->fields.children.right;
+      if(branch != NULL)
+        generateBlock(branch, outFile);
+      return;
     }
-    else if(strncmp(opType, "||", 5) == 0){
-      char *clauseLabel = generateLabel();
+    emitCounter(currNode, COUNT_REACHED, outFile);
+    if(generateIfSelect(currNode, outFile) || generateIfLayout(currNode, outFile))
+      return;
+    char *elseLabel = generateLabel();
+    generateExpression(currNode->fields.children.left, outFile);
+    emit(outFile, " cmpl $0, %%eax\n");
+    emit(outFile, " je %s\n", elseLabel);
+    emitCounter(currNode, COUNT_TAKEN, outFile);
+    generateBlock(currNode->fields.children.middle, outFile);
+    if(currNode->fields.children.right != NULL){
       char *endLabel = generateLabel();
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " cmpl $0, %%eax\n");
-      fprintf(outFile, " je %s\n", clauseLabel);
-      fprintf(outFile, " movl $1, %%eax\n");
-      fprintf(outFile, " jmp %s\n", endLabel);
-      fprintf(outFile, "%s:\n", clauseLabel);
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " cmpl $0, %%eax\n");
-      fprintf(outFile, " movl $0, %%eax\n");
-      fprintf(outFile, " setne %%al\n");
-      fprintf(outFile, "%s:\n", endLabel);
-    }
-    //Bitwise ops
-    else if(strncmp(opType, "&", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
-      generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " and %%ecx, %%eax\n");
+      emit(outFile, " jmp %s\n", endLabel);
+      emit(outFile, "%s:\n", elseLabel);
+      generateBlock(currNode->fields.children.right, outFile);
+      emit(outFile, "%s:\n", endLabel);
+      free(endLabel);
     }
-    else if(strncmp(opType, "^", 5) == 0){
-      generate(currNode->fields.children.left, outFile);
-      fprintf(outFile, " push %%eax\n");
+    else
+      emit(outFile, "%s:\n", elseLabel);
+    free(elseLabel);
+    return;
+  }
+  else if(currNode->nodeType == WHILE || currNode->nodeType == DO_WHILE){
+    generateLoop(currNode, outFile);
+    return;
+  }
+  else if(currNode->nodeType == SWITCH){
+    generateSwitch(currNode, outFile);
+    return;
+  }
+  //Pop the variables declared inside the loop or switch, then jump; continue skips switches
+  else if(currNode->nodeType == BREAK || currNode->nodeType == CONTINUE){
+    looplabels_t *labels = &loopLabels[numLoopLabels-1];
+    while(currNode->nodeType == CONTINUE && labels->continueLabel == NULL)
+      labels--;
+    if(stackIndex != labels->stackIndex && omitFramePointer)
+      emit(outFile, " addl $%d, %%esp\n", labels->stackIndex - stackIndex);
+    else if(stackIndex != labels->stackIndex)
+      emit(outFile, " leal %d(%%ebp), %%esp\n", labels->stackIndex);
+    emit(outFile, " jmp %s\n", (currNode->nodeType == BREAK) ? labels->breakLabel : labels->continueLabel);
+    return;
+  }
+  //Variables live in 4 byte slots below the frame base, pushed in declaration order
+  else if(currNode->nodeType == DECLARATION){
+    if(currNode->fields.children.right != NULL)
       generate(currNode->fields.children.right, outFile);
-      fprintf(outFile, " pop %%ecx\n");
-      fprintf(outFile, " xor %%ecx, %%eax\n");
-    }
-    else if(strncmp(opType, "|", 5) == 0){
-        generate(currNode->fields.children.left, outFile);
-        fprintf(outFile, " push %%eax\n");
-        generate(currNode->fields.children.right, outFile);
-        fprintf(outFile, " pop %%ecx\n");
-        fprintf(outFile, " or %%ecx, %%eax\n");
-            }
+    else
+      emit(outFile, " movl $0, %%eax\n");
+    emit(outFile, " push %%eax\n");
+    stackIndex -= 4;
+    setVarOffset(currNode->fields.children.left->fields.symbol, stackIndex);
     return;
   }
-  fclose(outFile);
+  //Expressions can nest arbitrarily deep, so they are walked without recursion
+  generateExpression(currNode, outFile);
 }
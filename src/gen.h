@@ -4,8 +4,99 @@
 #include "parse.h"
 #include <stdio.h>
 
+//Largest single emit() call mirrored to the asm dump channel
+#define EMIT_BUF_SIZE 512
+
+//Most a select's two arms may cost for them both to be evaluated and a cmov to pick one, see selectCost()
+#define CMOV_MAX_COST 6
+
+//Bumped whenever the assembly generated for a function changes, see codegenSignature()
+#define CODEGEN_VERSION 8
+
+//Lowering of a switch, see generateSwitch(): a bit test when its cases go to at most
+//BIT_TEST_MAX_TARGETS places and span at most 32 values, a jump table when at least
+//JUMP_TABLE_MIN_CASES cases fill at least JUMP_TABLE_MIN_DENSITY percent of their range, and
+//otherwise a binary search, comparing linearly once at most SEARCH_LINEAR_CASES cases are left
+#define BIT_TEST_MIN_CASES 3
+#define BIT_TEST_MAX_TARGETS 3
+#define JUMP_TABLE_MIN_CASES 4
+#define JUMP_TABLE_MIN_DENSITY 40
+#define SEARCH_LINEAR_CASES 3
+
+//Function entries are aligned to 2^FUNCTION_ALIGN bytes, and loop headers to 2^LOOP_ALIGN bytes
+//when that takes at most LOOP_ALIGN_MAX_SKIP bytes of padding
+#define FUNCTION_ALIGN 4
+#define LOOP_ALIGN 4
+#define LOOP_ALIGN_MAX_SKIP 10
+
+//How a short-circuit operator's right operand is laid out, see shortCircuitLayout()
+typedef enum LAYOUT {LAYOUT_STATIC, LAYOUT_INLINE, LAYOUT_OUT_OF_LINE, LAYOUT_UNLIKELY} LAYOUT;
+
+//Streams of a function's code generated apart from it, see deferredStream()
+typedef enum DEFERRED {DEFER_OUT_OF_LINE, DEFER_UNLIKELY} DEFERRED;
+#define NUM_DEFERRED 2
+
+typedef struct deferred_t {
+  FILE *file;
+  char *text;
+  size_t len;
+} deferred_t;
+
+//A case of a switch: its value and the index of the label it jumps to
+typedef struct switchcase_t {
+  int value;
+  int target;
+} switchcase_t;
+
+//Jump targets of a loop for break and continue, see generateLoop(); a switch has no continue label
+typedef struct looplabels_t {
+  char *breakLabel;
+  char *continueLabel;
+  int stackIndex;
+} looplabels_t;
+
+extern char outPath[LEN_PATH];
+extern char *currFuncName;
+extern int debugLines;
+
+void defaultOutPath();
 FILE *getOutFile();
+void emit(FILE *outFile, const char *format, ...);
+void emitText(FILE *outFile, const char *text, size_t len);
+void emitQuoted(FILE *outFile, const char *text);
+void startLineInfo(FILE *outFile);
+void emitLoc(astnode_t *node, FILE *outFile);
+uint64_t codegenSignature();
 char *generateLabel();
+void setVarOffset(uint32_t symbol, int offset);
+int getVarOffset(uint32_t symbol);
+const char *frameRegister();
+int slotOffset(int offset);
+FILE *deferredStream(DEFERRED kind);
+int isDeferred(FILE *outFile);
+void emitDeferredCode(char *funcName, int unlikely, FILE *outFile);
+LAYOUT shortCircuitLayout(astnode_t *node, FILE *outFile);
+void emitTruthValue(FILE *outFile);
+void emitEpilogue(FILE *outFile);
+void emitUnaryOp(char opType, FILE *outFile);
+int rightOperandFirst(char *opType);
+void emitBinaryOp(char *opType, FILE *outFile);
+int selectCost(astnode_t *expr);
+int useCmov(astnode_t *thenValue, astnode_t *elseValue);
+void emitCmov(FILE *outFile);
+void generateExpression(astnode_t *expr, FILE *outFile);
+int isTailCall(astnode_t *expr);
+void generateTailCall(astnode_t *call, FILE *outFile);
+int framePointerNeeded(astnode_t *funcNode);
+astnode_t *generateStatements(astnode_t *statement, FILE *outFile);
+void generateBlock(astnode_t *statement, FILE *outFile);
+int generateIfSelect(astnode_t *ifNode, FILE *outFile);
+int unlikelyBranch(astnode_t *chain);
+int endsInJump(astnode_t *chain);
+int generateIfLayout(astnode_t *ifNode, FILE *outFile);
+void generateLoop(astnode_t *loopNode, FILE *outFile);
+void generateCaseSearch(switchcase_t *cases, int lo, int hi, char **targetLabels, char *defaultLabel, FILE *outFile);
+void generateSwitch(astnode_t *switchNode, FILE *outFile);
 void generate(astnode_t *root, FILE *outFile);
 
 #endif // GEN_H_
@@ -0,0 +1,186 @@
+#include "intern.h"
+#include "parse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+//Open addressing table of symbol IDs (NO_SYMBOL when empty), indexed by name hash
+uint32_t *internSlots = NULL;
+uint32_t internMask = 0;
+//Name and hash of every symbol, indexed by symbol ID
+char **symbolNames = NULL;
+uint32_t *symbolHashes = NULL;
+uint32_t symbolCount = 0;
+size_t symbolNamesCap = 0;
+size_t symbolHashesCap = 0;
+//Name storage, names never move once interned. Blocks are chained through their first word
+char *arenaBlocks = NULL;
+char *arena = NULL;
+size_t arenaUsed = INTERN_ARENA_SIZE;
+
+//Set while several threads may intern at once
+int internLocking = 0;
+pthread_mutex_t internLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * hashName(const char *name, size_t len)
+ * FNV-1a hash of a name.
+ *
+ * param *name - the name to hash
+ * param len - the length of the name
+ * return uint32_t - returns the hash
+ **/
+static uint32_t hashName(const char *name, size_t len){
+  uint32_t hash = 2166136261u;
+  size_t i;
+  for(i = 0; i < len; i++){
+    hash ^= (unsigned char) name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * storeName(const char *name, size_t len)
+ * Copies a name into the arena, NUL terminated.
+ *
+ * param *name - the name to copy
+ * param len - the length of the name
+ * return char* - returns the stored copy
+ **/
+static char *storeName(const char *name, size_t len){
+  if(arenaUsed + len + 1 > INTERN_ARENA_SIZE){
+    //Names longer than an arena block get a block of their own
+    size_t blockSize = (len + 1 > INTERN_ARENA_SIZE) ? len + 1 : INTERN_ARENA_SIZE;
+    char *block = malloc(sizeof(char *) + blockSize);
+    if(block == NULL){
+      fprintf(stderr, "Failed to allocate space for interned names.\n");
+      exit(1);
+    }
+    *(char **) block = arenaBlocks;
+    arenaBlocks = block;
+    arena = block + sizeof(char *);
+    arenaUsed = 0;
+  }
+  char *stored = &arena[arenaUsed];
+  memcpy(stored, name, len);
+  stored[len] = '\0';
+  arenaUsed += len + 1;
+  return stored;
+}
+
+/**
+ * growSlots()
+ * Doubles the hash table (or creates it), re-inserting every symbol by its saved hash.
+ *
+ * return void
+ **/
+static void growSlots(){
+  uint32_t newSize = (internSlots == NULL) ? INTERN_INIT_SLOTS : (internMask + 1) * 2;
+  free(internSlots);
+  internSlots = malloc(sizeof(uint32_t) * newSize);
+  if(internSlots == NULL){
+    fprintf(stderr, "Failed to allocate space for the intern table.\n");
+    exit(1);
+  }
+  memset(internSlots, 0xff, sizeof(uint32_t) * newSize);
+  internMask = newSize - 1;
+  uint32_t symbol;
+  for(symbol = 0; symbol < symbolCount; symbol++){
+    uint32_t slot = symbolHashes[symbol] & internMask;
+    while(internSlots[slot] != NO_SYMBOL)
+      slot = (slot + 1) & internMask;
+    internSlots[slot] = symbol;
+  }
+}
+
+/**
+ * intern(const char *name, size_t len)
+ * Maps a name to its symbol ID, adding it to the table the first time it is seen.
+ * Equal names always get the same ID, so names can be compared as integers.
+ *
+ * param *name - the name to intern (need not be NUL terminated)
+ * param len - the length of the name
+ * return uint32_t - returns the symbol ID of the name
+ **/
+uint32_t intern(const char *name, size_t len){
+  uint32_t hash = hashName(name, len);
+  if(internLocking)
+    pthread_mutex_lock(&internLock);
+  //Keep the load factor under 1/2
+  if(internSlots == NULL || symbolCount * 2 >= internMask)
+    growSlots();
+  uint32_t slot = hash & internMask;
+  uint32_t symbol;
+  while((symbol = internSlots[slot]) != NO_SYMBOL){
+    if(symbolHashes[symbol] == hash && strncmp(symbolNames[symbol], name, len) == 0 && symbolNames[symbol][len] == '\0'){
+      if(internLocking)
+        pthread_mutex_unlock(&internLock);
+      return symbol;
+    }
+    slot = (slot + 1) & internMask;
+  }
+  growArray((void **) &symbolNames, &symbolNamesCap, (size_t) symbolCount + 1, sizeof(char *));
+  growArray((void **) &symbolHashes, &symbolHashesCap, (size_t) symbolCount + 1, sizeof(uint32_t));
+  symbol = symbolCount++;
+  symbolNames[symbol] = storeName(name, len);
+  symbolHashes[symbol] = hash;
+  internSlots[slot] = symbol;
+  if(internLocking)
+    pthread_mutex_unlock(&internLock);
+  return symbol;
+}
+
+/**
+ * symbolName(uint32_t symbol)
+ * Returns the name of an interned symbol.
+ *
+ * param symbol - the symbol ID
+ * return char* - returns the symbol's name, valid until freeSymbols()
+ **/
+char *symbolName(uint32_t symbol){
+  if(internLocking)
+    pthread_mutex_lock(&internLock);
+  char *name = (symbol < symbolCount) ? symbolNames[symbol] : NULL;
+  if(internLocking)
+    pthread_mutex_unlock(&internLock);
+  return name;
+}
+
+/**
+ * numSymbols()
+ * Returns the number of interned symbols, symbol IDs run from 0 to numSymbols()-1.
+ *
+ * return uint32_t - returns the number of symbols
+ **/
+uint32_t numSymbols(){
+  return symbolCount;
+}
+
+/**
+ * freeSymbols()
+ * Frees the intern table and every interned name.
+ *
+ * return void
+ **/
+void freeSymbols(){
+  while(arenaBlocks != NULL){
+    char *next = *(char **) arenaBlocks;
+    free(arenaBlocks);
+    arenaBlocks = next;
+  }
+  arena = NULL;
+  arenaUsed = INTERN_ARENA_SIZE;
+  free(internSlots);
+  free(symbolNames);
+  free(symbolHashes);
+  internSlots = NULL;
+  symbolNames = NULL;
+  symbolHashes = NULL;
+  symbolCount = 0;
+  symbolNamesCap = 0;
+  symbolHashesCap = 0;
+  internMask = 0;
+}
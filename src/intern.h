@@ -0,0 +1,21 @@
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Initial number of slots in the intern hash table (power of two)
+#define INTERN_INIT_SLOTS 1024
+//Size of each block of interned name storage
+#define INTERN_ARENA_SIZE (1 << 16)
+//Symbol ID of "no symbol"
+#define NO_SYMBOL UINT32_MAX
+
+extern int internLocking;
+
+uint32_t intern(const char *name, size_t len);
+char *symbolName(uint32_t symbol);
+uint32_t numSymbols();
+void freeSymbols();
+
+#endif // INTERN_H_
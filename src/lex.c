@@ -1,103 +1,86 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <regex.h>
-#include <ctype.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "lex.h"
-//Token Regex Types
-//Single char keywords
-regex_t openBrace, closeBrace, openParen, closeParen, semicolon;
+#include "dump.h"
+#include "ring.h"
+#include "intern.h"
 
-//Multi char keywords
-regex_t int_keyw, ret_keyw, identifier, int_literal;
+//Token type names, indexed by TOKEN_TYPE
+char *tokenTypeNames[NUM_TOKEN_TYPES] = {"OPEN_BRACE", "CLOSED_BRACE", "OPEN_PAREN", "CLOSED_PAREN", "SEMICOLON",
+                                         "INT_KEYW", "RET_KEYW", "INT_LITERAL", "IDENTIFIER",
+                                         "NEGATION", "BITWISE_COMP", "LOGIC_NEG", "ADD_OP", "MULT_OP", "DIV_OP",
+                                         "AND_OP", "OR_OP", "EQ_TO", "NEQ_TO", "LT_OP", "LE_OP", "GT_OP", "GE_OP", "MOD_OP",
+                                         "BIT_AND", "BIT_OR", "BIT_XOR", "SHIFT_LEFT", "SHIFT_RIGHT", "ASSIGN",
+                                         "QUESTION", "COLON", "IF_KEYW", "ELSE_KEYW",
+                                         "WHILE_KEYW", "DO_KEYW", "FOR_KEYW", "BREAK_KEYW", "CONTINUE_KEYW",
+                                         "SWITCH_KEYW", "CASE_KEYW", "DEFAULT_KEYW", "COMMA",
+                                         "HASH", "HASH_HASH", "DIRECTIVE", "OTHER",
+                                         "END_OF_INPUT"};
 
-regex_t negation, bitwise_comp, logic_neg;
+//Fixed spelling of each token type, shared by all tokens of that type (NULL if the value varies)
+char *tokenSpellings[NUM_TOKEN_TYPES] = {"{", "}", "(", ")", ";",
+                                         "int", "return", NULL, NULL,
+                                         "-", "~", "!", "+", "*", "/",
+                                         "&&", "||", "==", "!=", "<", "<=", ">", ">=", "%",
+                                         "&", "|", "^", "<<", ">>", "=",
+                                         "?", ":", "if", "else",
+                                         "while", "do", "for", "break", "continue",
+                                         "switch", "case", "default", ",",
+                                         "#", "##", NULL, NULL,
+                                         "end of input"};
 
-regex_t add_op, mult_op, div_op;
-
-regex_t and_op, or_op, eq_to, neq_to, lt_op, le_op, gt_op, ge_op;
+//Per-thread state for parallel chunked lexing
+typedef struct lexchunk_t {
+  const char *source;
+  size_t start;
+  size_t end;
+  tokenlist_t *tokens;
+  int numLines;
+  int index;
+  struct lexchunk_t *chunks;
+  pthread_barrier_t *barrier;
+} lexchunk_t;
 
-regex_t mod_op, bit_and, bit_or, bit_xor, shift_left, shift_right;
+//Keyword table slot of a word, given its first and last characters and its length.
+//This is a perfect hash for the C keywords int, return, if, else, while, do, for, break,
+//continue, switch, case and default (a collision shows up as an override-init warning)
+#define KEYWORD_SLOT(first, last, len) (((first) + (last) * 7 + (len)) & (NUM_KEYWORD_SLOTS - 1))
+#define NUM_KEYWORD_SLOTS 32
 
-regex_t assign;
+typedef struct keyword_t {
+  char *spelling;
+  size_t len;
+  TOKEN_TYPE type;
+} keyword_t;
 
-regex_t keywords[NUM_KEYWORDS];
+keyword_t keywordTable[NUM_KEYWORD_SLOTS] = {
+  [KEYWORD_SLOT('i', 't', 3)] = {"int", 3, INT_KEYW},
+  [KEYWORD_SLOT('r', 'n', 6)] = {"return", 6, RET_KEYW},
+  [KEYWORD_SLOT('i', 'f', 2)] = {"if", 2, IF_KEYW},
+  [KEYWORD_SLOT('e', 'e', 4)] = {"else", 4, ELSE_KEYW},
+  [KEYWORD_SLOT('w', 'e', 5)] = {"while", 5, WHILE_KEYW},
+  [KEYWORD_SLOT('d', 'o', 2)] = {"do", 2, DO_KEYW},
+  [KEYWORD_SLOT('f', 'r', 3)] = {"for", 3, FOR_KEYW},
+  [KEYWORD_SLOT('b', 'k', 5)] = {"break", 5, BREAK_KEYW},
+  [KEYWORD_SLOT('c', 'e', 8)] = {"continue", 8, CONTINUE_KEYW},
+  [KEYWORD_SLOT('s', 'h', 6)] = {"switch", 6, SWITCH_KEYW},
+  [KEYWORD_SLOT('c', 'e', 4)] = {"case", 4, CASE_KEYW},
+  [KEYWORD_SLOT('d', 't', 7)] = {"default", 7, DEFAULT_KEYW},
+};
 
-/**
- * initRegexp()
- * Initializes regular expression variables for use in lexing, and adds them to the keywords list.
- *
- * return void
- **/
-void initRegexp(){
-  int flag = 0;
-  flag += regcomp(&openBrace, "{", 0);
-  flag += regcomp(&closeBrace, "}", 0);
-  flag += regcomp(&openParen, "(", 0);
-  flag += regcomp(&closeParen, ")", 0);
-  flag += regcomp(&semicolon, ";", 0);
-  flag += regcomp(&int_keyw, "int", 0);
-  flag += regcomp(&ret_keyw, "return", 0);
-  flag += regcomp(&int_literal, "[0-9]\\+", 0);
-  flag += regcomp(&identifier, "[a-zA-Z]\\w*", 0);
-  flag += regcomp(&negation, "-", 0);
-  flag += regcomp(&bitwise_comp, "~", 0);
-  flag += regcomp(&logic_neg, "!", 0);
-  flag += regcomp(&add_op, "+", 0);
-  flag += regcomp(&mult_op, "*", 0);
-  flag += regcomp(&div_op, "/", 0);
-  flag += regcomp(&and_op, "&&", 0);
-  flag += regcomp(&or_op, "||", 0);
-  flag += regcomp(&eq_to, "==", 0);
-  flag += regcomp(&neq_to, "!=", 0);
-  flag += regcomp(&lt_op, "<", 0);
-  flag += regcomp(&le_op, "<=", 0);
-  flag += regcomp(&gt_op, ">", 0);
-  flag += regcomp(&ge_op, ">=", 0);
-  flag += regcomp(&mod_op, "%", 0);
-  flag += regcomp(&bit_and, "&", 0);
-  flag += regcomp(&bit_or, "|", 0);
-  flag += regcomp(&bit_xor, "\\^", 0);
-  flag += regcomp(&shift_left, "<<", 0);
-  flag += regcomp(&shift_right, ">>", 0);
-  flag += regcomp(&assign, "=", 0);
-  if(flag > 0){
-    fprintf(stderr, "Failed to init 1 or more regular expressions.\n");
-    exit(1);
-  }
-  //Assign keywords to regex_t types
-  keywords[0] = openBrace;
-  keywords[1] = closeBrace;
-  keywords[2] = openParen;
-  keywords[3] = closeParen;
-  keywords[4] = semicolon;
-  keywords[5] = int_keyw;
-  keywords[6] = ret_keyw;
-  keywords[7] = int_literal;
-  keywords[8] = identifier;
-  keywords[9] = negation;
-  keywords[10] = bitwise_comp;
-  keywords[11] = logic_neg;
-  keywords[12] = add_op;
-  keywords[13] = mult_op;
-  keywords[14] = div_op;
-  keywords[15] = and_op;
-  keywords[16] = or_op;
-  keywords[17] = eq_to;
-  keywords[18] = neq_to;
-  keywords[19] = lt_op;
-  keywords[20] = le_op;
-  keywords[21] = gt_op;
-  keywords[22] = ge_op;
-  keywords[23] = mod_op;
-  keywords[24] = bit_and;
-  keywords[25] = bit_or;
-  keywords[26] = bit_xor;
-  keywords[27] = shift_left;
-  keywords[28] = shift_right;
-  keywords[29] = assign;
-}
+//Lexer thread state for pipelined lexing
+typedef struct lexpipe_t {
+  lexer_t *lexer;
+  ring_t *ring;
+  pthread_t thread;
+} lexpipe_t;
 
 /**
  * *createToken(char *value, TOKEN_TYPE type, int lineNum)
@@ -122,20 +105,46 @@ token_t *createToken(char *value, TOKEN_TYPE type, int lineNum){
   newToken->type = type;
   newToken->next = NULL;
   newToken->lineNum = lineNum;
+  newToken->offset = 0;
+  newToken->symbol = NO_SYMBOL;
+  newToken->file = NO_SYMBOL;
   return newToken;
 }
 
 /**
- * freeRegs()
- * Free's all of the created keyword regular expressions.
+ * copyToken(token_t *token)
+ * Creates a copy of a token, with its own copy of the value if the token owns its value.
  *
- * return void
+ * param *token - the token to copy
+ * return token_t* - returns the new token
  **/
-void freeRegs(){
-  int i;
-  for(i = 0; i < NUM_KEYWORDS; i++){
-    regfree(&keywords[i]);
+token_t *copyToken(token_t *token){
+  char *value = token->value;
+  if(tokenSpellings[token->type] == NULL && token->type != IDENTIFIER){
+    value = strdup(value);
+    if(value == NULL){
+      fprintf(stderr, "Failed to allocate space for new token.\n");
+      exit(1);
+    }
   }
+  token_t *copy = createToken(value, token->type, token->lineNum);
+  copy->offset = token->offset;
+  copy->symbol = token->symbol;
+  copy->file = token->file;
+  return copy;
+}
+
+/**
+ * tokenTypeName(TOKEN_TYPE type)
+ * Returns the name of a token type, as spelled in the TOKEN_TYPE enum.
+ *
+ * param type - the token type to name
+ * return char* - returns the name of the token type
+ **/
+char *tokenTypeName(TOKEN_TYPE type){
+  if(type < 0 || type >= NUM_TOKEN_TYPES)
+    return "UNKNOWN";
+  return tokenTypeNames[type];
 }
 
 /**
@@ -168,64 +177,207 @@ tokenlist_t *initTokenlist(){
   tokens->head = NULL;
   tokens->tail = NULL;
   tokens->numTokens = 0;
+  tokens->pipe = NULL;
+  tokens->lexer = NULL;
+  tokens->lookStart = 0;
+  tokens->lookCount = 0;
+  tokens->retired = NULL;
+  tokens->numRetired = 0;
+  tokens->retiredCap = 0;
+  tokens->fingerprinting = 0;
+  tokens->fingerprint = FINGERPRINT_INIT;
+  tokens->endToken.value = tokenSpellings[END_OF_INPUT];
+  tokens->endToken.type = END_OF_INPUT;
+  tokens->endToken.lineNum = 1;
+  tokens->endToken.offset = 0;
+  tokens->endToken.symbol = NO_SYMBOL;
+  tokens->endToken.next = NULL;
+  tokens->pp = NULL;
+  tokens->ppNext = NULL;
   return tokens;
 }
 
+/**
+ * freeToken(token_t *token)
+ * Frees a token, and its value unless it is a shared fixed spelling or an interned name.
+ *
+ * param *token - the token to free
+ * return void
+ **/
+void freeToken(token_t *token){
+  if(tokenSpellings[token->type] == NULL && token->type != IDENTIFIER)
+    free(token->value);
+  free(token);
+}
+
+/**
+ * retireToken(tokenlist_t *tokens, token_t *token)
+ * Keeps a popped token until the parser releases it, so a popped token stays valid however
+ * many tokens are popped after it, see releaseTokens().
+ *
+ * param *tokens - the token list the token was popped from
+ * param *token - the popped token
+ * return void
+ **/
+void retireToken(tokenlist_t *tokens, token_t *token){
+  growArray((void **) &tokens->retired, &tokens->retiredCap, tokens->numRetired + 1, sizeof(token_t *));
+  tokens->retired[tokens->numRetired++] = token;
+}
+
+/**
+ * releaseTokens(tokenlist_t *tokens)
+ * Frees the tokens popped so far. The parser calls it between functions, where it holds no
+ * popped token, so consumed tokens do not pile up beyond one function's worth.
+ *
+ * param *tokens - the token list
+ * return void
+ **/
+void releaseTokens(tokenlist_t *tokens){
+  size_t i;
+  for(i = 0; i < tokens->numRetired; i++)
+    freeToken(tokens->retired[i]);
+  tokens->numRetired = 0;
+}
+
+/**
+ * pullRawToken(tokenlist_t *tokens)
+ * Takes the next token off of the token list, or from the lexer thread (or on demand lexer) once
+ * the list runs dry. Once the end of the stream is reached the lexer thread is joined.
+ *
+ * param *tokens - the token list to pull from
+ * return token_t* - returns the next token as lexed, or NULL at the end of the input
+ **/
+token_t *pullRawToken(tokenlist_t *tokens){
+  token_t *token = tokens->head;
+  if(token != NULL){
+    tokens->head = token->next;
+    if(tokens->head == NULL)
+      tokens->tail = NULL;
+    token->next = NULL;
+    return token;
+  }
+  if(tokens->lexer != NULL){
+    token = lexToken(tokens->lexer);
+    if(token == NULL)
+      return NULL;
+    tokens->numTokens++;
+    if(dumpEnabled(DUMP_TOKENS))
+      dumpToken(token);
+    return token;
+  }
+  lexpipe_t *pipe = tokens->pipe;
+  if(pipe == NULL)
+    return NULL;
+  token = ringPop(pipe->ring);
+  if(token == NULL){
+    pthread_join(pipe->thread, NULL);
+    internLocking = 0;
+    freeRing(pipe->ring);
+    freeLexer(pipe->lexer);
+    free(pipe);
+    tokens->pipe = NULL;
+    return NULL;
+  }
+  tokens->numTokens++;
+  return token;
+}
+
+/**
+ * pullToken(tokenlist_t *tokens)
+ * Takes the next token of the stream the parser reads: the next raw token, or the next token
+ * out of the preprocessor when one is attached. Characters no token starts with are reported here,
+ * so the preprocessor can skip over them.
+ *
+ * param *tokens - the token list to pull from
+ * return token_t* - returns the next token, or NULL at the end of the input
+ **/
+token_t *pullToken(tokenlist_t *tokens){
+  token_t *token = (tokens->pp != NULL) ? tokens->ppNext(tokens->pp) : pullRawToken(tokens);
+  if(token != NULL && token->type == OTHER){
+    fprintf(stderr, "Error on line %d: Unexpected character '%s'.\n", token->lineNum, token->value);
+    exit(1);
+  }
+  return token;
+}
+
+/**
+ * fingerprintToken(uint64_t fingerprint, token_t *token)
+ * Mixes a token into a running fingerprint (FNV-1a over its type and, for names and literals,
+ * its text), so token ranges that differ only in whitespace and comments fingerprint the same.
+ *
+ * param fingerprint - the fingerprint so far
+ * param *token - the token to mix in
+ * return uint64_t - returns the new fingerprint
+ **/
+uint64_t fingerprintToken(uint64_t fingerprint, token_t *token){
+  fingerprint = (fingerprint ^ (uint64_t) token->type) * 1099511628211ULL;
+  if(token->type == IDENTIFIER || token->type == INT_LITERAL){
+    const char *c;
+    for(c = token->value; *c != '\0'; c++)
+      fingerprint = (fingerprint ^ (unsigned char) *c) * 1099511628211ULL;
+    fingerprint = fingerprint * 1099511628211ULL;
+  }
+  return fingerprint;
+}
+
 /**
  * popToken(tokenlist_t *tokens)
- * Pops a token off of the linked list, and returns it
+ * Pops the next token off of the token stream, and returns it. With fingerprinting set, each
+ * popped token is mixed into the stream's fingerprint.
  *
  * param *tokens - the tokenlist to pop a token from
- * return token_t* - returns a pointer to the popped token
+ * return token_t* - returns a pointer to the popped token, the END_OF_INPUT token at the end
  **/
 token_t *popToken(tokenlist_t *tokens){
-  if(tokens->head == NULL)
-    return NULL;
-  //If one token left in list...
-  token_t *popped = tokens->head;
-  if(tokens->head == tokens->tail){
-    tokens->head = NULL;
-    tokens->tail = NULL;
+  token_t *popped = peekN(tokens, 0);
+  if(popped == &tokens->endToken)
     return popped;
-  }
-  tokens->head = popped->next;
-  popped->next = NULL;
+  tokens->lookStart = (tokens->lookStart + 1) & (LOOKAHEAD - 1);
+  tokens->lookCount--;
+  if(tokens->fingerprinting)
+    tokens->fingerprint = fingerprintToken(tokens->fingerprint, popped);
+  retireToken(tokens, popped);
   return popped;
 }
 
+
 /**
- * prependToken(tokenlist_t *tokens, token_t *token)
- * Prepends the provided token to the provided tokenlist
+ * peekN(tokenlist_t *tokens, int k)
+ * Peeks k tokens past the next token of the stream without consuming anything. Tokens are
+ * buffered in a fixed ring of LOOKAHEAD tokens, so k must be less than LOOKAHEAD.
  *
- * param *tokens - the token list to prepend the token to
- * param *token - the token to prepend to the token list
- * return void
+ * param *tokens - the token stream to peek
+ * param k - how far to look ahead, 0 for the next token
+ * return token_t* - returns the token, or the END_OF_INPUT token past the end of the input
  **/
-void prependToken(tokenlist_t *tokens, token_t *token){
-  if(token == NULL){
-    return;
+token_t *peekN(tokenlist_t *tokens, int k){
+  if(k >= LOOKAHEAD){
+    fprintf(stderr, "Cannot look %d tokens ahead, the lookahead limit is %d.\n", k + 1, LOOKAHEAD);
+    exit(1);
   }
-  if(tokens->head == NULL){
-    tokens->head = token;
-    tokens->tail = token;
-    return;
+  while(tokens->lookCount <= k){
+    token_t *token = pullToken(tokens);
+    if(token == NULL)
+      return &tokens->endToken;
+    tokens->lookahead[(tokens->lookStart + tokens->lookCount) & (LOOKAHEAD - 1)] = token;
+    tokens->lookCount++;
+    tokens->endToken.lineNum = token->lineNum;
   }
-  token->next = tokens->head;
-  tokens->head = token;
+  return tokens->lookahead[(tokens->lookStart + k) & (LOOKAHEAD - 1)];
 }
 
 /**
  * peek(tokenlist_t *tokens)
- * Peeks the token list, returning its top element
+ * Peeks the token stream, returning its next token
  *
  * param *tokens - the token list to peek
- * return token_t* - returns pointer to head of the token list
+ * return token_t* - returns pointer to the next token, the END_OF_INPUT token at the end
  **/
 token_t *peek(tokenlist_t *tokens){
   if(tokens == NULL){
     return NULL;
   }
-  return tokens->head;
+  return peekN(tokens, 0);
 }
 
 /**
@@ -259,95 +411,749 @@ void appendToken(tokenlist_t *tokens, token_t *token){
   }
 }
 
+
 /**
- * *lex()
- * Lex's the source file (path provided in argv[1] of main), and returns a list of valid tokens
+ * initLexer(FILE *sourceFile)
+ * Allocates a lexer reading the provided file in LEX_CHUNK_SIZE chunks.
  *
- * return tokenlist_t* - returns a list of valid tokens from the source file
+ * param *sourceFile - the file to lex, need not be seekable
+ * return lexer_t* - returns the newly initialized lexer
  **/
-tokenlist_t *lex(){
-  FILE *sourceFile;
-  char *fileBuf = NULL;
-  tokenlist_t *tokens;
+lexer_t *initLexer(FILE *sourceFile){
+  lexer_t *lexer = malloc(sizeof(lexer_t));
+  if(lexer == NULL){
+    fprintf(stderr, "Failed to allocate space for lexer.\n");
+    exit(1);
+  }
+  lexer->buf = malloc(LEX_CHUNK_SIZE);
+  if(lexer->buf == NULL){
+    fprintf(stderr, "Failed to allocate file buffer in Lexer.\n");
+    exit(1);
+  }
+  lexer->file = sourceFile;
+  lexer->cap = LEX_CHUNK_SIZE;
+  lexer->pos = 0;
+  lexer->len = 0;
+  lexer->bufOffset = 0;
+  lexer->eof = 0;
+  lexer->lineNum = 1;
+  lexer->lastLine = 0;
+  lexer->source = NULL;
+  lexer->scan.block = NULL;
+  return lexer;
+}
+
+/**
+ * initBufferLexer(const char *source, size_t start, size_t end)
+ * Allocates a lexer over bytes start..end of an in-memory source, without copying them.
+ *
+ * param *source - the whole source buffer
+ * param start - offset of the first byte to lex
+ * param end - offset one past the last byte to lex
+ * return lexer_t* - returns the newly initialized lexer
+ **/
+lexer_t *initBufferLexer(const char *source, size_t start, size_t end){
+  lexer_t *lexer = malloc(sizeof(lexer_t));
+  if(lexer == NULL){
+    fprintf(stderr, "Failed to allocate space for lexer.\n");
+    exit(1);
+  }
+  lexer->file = NULL;
+  lexer->buf = (char *) &source[start];
+  lexer->cap = end - start;
+  lexer->pos = 0;
+  lexer->len = end - start;
+  lexer->bufOffset = start;
+  lexer->eof = 1;
+  lexer->lineNum = 1;
+  lexer->lastLine = 0;
+  lexer->source = source;
+  lexer->scan.block = NULL;
+  return lexer;
+}
+
+/**
+ * lexErrorLine(lexer_t *lexer)
+ * Returns the source line the lexer is on, for error messages. Chunk lexers count lines from
+ * the start of their chunk, so the newlines before the chunk are added on here.
+ *
+ * param *lexer - the lexer that hit an error
+ * return int - returns the line number in the whole source
+ **/
+int lexErrorLine(lexer_t *lexer){
+  int lineNum = lexer->lineNum;
+  const char *c;
+  if(lexer->source == NULL)
+    return lineNum;
+  for(c = lexer->source; c < lexer->buf; c++){
+    if(*c == '\n')
+      lineNum++;
+  }
+  return lineNum;
+}
+
+/**
+ * freeLexer(lexer_t *lexer)
+ * Frees the lexer and its buffer (the source file is left open).
+ *
+ * param *lexer - the lexer to free
+ * return void
+ **/
+void freeLexer(lexer_t *lexer){
+  if(lexer == NULL)
+    return;
+  //Buffer lexers borrow their buffer
+  if(lexer->source == NULL)
+    free(lexer->buf);
+  free(lexer);
+}
+
+/**
+ * lexFill(lexer_t *lexer, size_t need)
+ * Buffers at least need bytes past the current position, unless the end of the file comes first.
+ * Consumed bytes are dropped from the front of the buffer, which only grows when a single token
+ * does not fit in it, so memory use is bounded by the chunk size and the longest token.
+ *
+ * param *lexer - the lexer to fill
+ * param need - the number of bytes wanted past the current position
+ * return size_t - returns the number of bytes buffered past the current position
+ **/
+size_t lexFill(lexer_t *lexer, size_t need){
+  if(lexer->eof)
+    return lexer->len - lexer->pos;
+  //The buffer is about to change under any classified block
+  lexer->scan.block = NULL;
+  if(lexer->pos > 0){
+    memmove(lexer->buf, &lexer->buf[lexer->pos], lexer->len - lexer->pos);
+    lexer->bufOffset += lexer->pos;
+    lexer->len -= lexer->pos;
+    lexer->pos = 0;
+  }
+  while(lexer->len < need && !lexer->eof){
+    growArray((void **) &lexer->buf, &lexer->cap, lexer->len + 1, 1);
+    size_t readLen = fread(&lexer->buf[lexer->len], 1, lexer->cap - lexer->len, lexer->file);
+    if(readLen == 0){
+      if(ferror(lexer->file)){
+        fprintf(stderr, "Failed to read source file %s\n", sourcePath);
+        exit(1);
+      }
+      lexer->eof = 1;
+    }
+    lexer->len += readLen;
+  }
+  return lexer->len - lexer->pos;
+}
+
+/**
+ * lexCharAt(lexer_t *lexer, size_t i)
+ * Returns the character i bytes past the current position, reading more of the file if needed.
+ *
+ * param *lexer - the lexer to read from
+ * param i - the distance from the current position
+ * return int - returns the character, or EOF past the end of the file
+ **/
+static inline int lexCharAt(lexer_t *lexer, size_t i){
+  if(lexer->pos + i < lexer->len)
+    return (unsigned char) lexer->buf[lexer->pos + i];
+  if(lexFill(lexer, i + 1) > i)
+    return (unsigned char) lexer->buf[lexer->pos + i];
+  return EOF;
+}
+
+/**
+ * lexSkip(lexer_t *lexer)
+ * Skips whitespace and comments, counting the newlines passed over.
+ *
+ * param *lexer - the lexer to advance
+ * return int - returns the first character of the next token, or EOF
+ **/
+int lexSkip(lexer_t *lexer){
+  int c;
+  while(1){
+    //Skip the whitespace run in the buffered part of the source in bulk
+    lexer->pos += scanRun(&lexer->scan, &lexer->buf[lexer->pos], lexer->len - lexer->pos, CC_SPACE, &lexer->lineNum);
+    if((c = lexCharAt(lexer, 0)) == EOF)
+      break;
+    if(charClass[c] & CC_SPACE)
+      continue;
+    else if(c == '/' && lexCharAt(lexer, 1) == '/'){
+      while((c = lexCharAt(lexer, 0)) != EOF && c != '\n')
+        lexer->pos++;
+    }
+    else if(c == '/' && lexCharAt(lexer, 1) == '*'){
+      int startLine = lexer->lineNum;
+      lexer->pos += 2;
+      while(!((c = lexCharAt(lexer, 0)) == '*' && lexCharAt(lexer, 1) == '/')){
+        if(c == EOF){
+          lexer->lineNum = startLine;
+          fprintf(stderr, "Error on line %d: Unterminated comment.\n", lexErrorLine(lexer));
+          exit(1);
+        }
+        if(c == '\n')
+          lexer->lineNum++;
+        lexer->pos++;
+      }
+      lexer->pos += 2;
+    }
+    else
+      break;
+  }
+  return c;
+}
+
+/**
+ * lexRun(lexer_t *lexer, size_t tokLen, int classes)
+ * Extends a token of tokLen characters over the following characters in classes, reading
+ * more of the file when the run reaches the end of the buffer.
+ *
+ * param *lexer - the lexer positioned at the start of the token
+ * param tokLen - the length of the token so far
+ * param classes - the CC_* classes the rest of the token is made of
+ * return size_t - returns the length of the token
+ **/
+size_t lexRun(lexer_t *lexer, size_t tokLen, int classes){
+  while(1){
+    tokLen += scanRun(&lexer->scan, &lexer->buf[lexer->pos + tokLen], lexer->len - lexer->pos - tokLen, classes, NULL);
+    if(lexer->pos + tokLen < lexer->len || lexFill(lexer, tokLen + 1) <= tokLen)
+      return tokLen;
+  }
+}
 
-  //Attempt to open source code file
-  sourceFile = fopen(sourcePath, "r");
+/**
+ * lookupKeyword(const char *word, size_t len)
+ * Looks a word up in the keyword table with a single probe of its perfect hash slot.
+ *
+ * param *word - the word (an identifier-shaped run, not NUL terminated)
+ * param len - the length of the word
+ * return TOKEN_TYPE - returns the keyword's token type, or IDENTIFIER for other words
+ **/
+TOKEN_TYPE lookupKeyword(const char *word, size_t len){
+  keyword_t *keyword = &keywordTable[KEYWORD_SLOT((unsigned char) word[0], (unsigned char) word[len-1], len)];
+  if(keyword->len == len && memcmp(keyword->spelling, word, len) == 0)
+    return keyword->type;
+  return IDENTIFIER;
+}
+
+/**
+ * lexOperator(lexer_t *lexer, int c, size_t *tokLen)
+ * Identifies the (longest) operator or punctuation token starting with c.
+ *
+ * param *lexer - the lexer positioned at c
+ * param c - the first character of the token
+ * param *tokLen - set to the length of the identified token
+ * return TOKEN_TYPE - returns the type of the token, exits on an invalid character
+ **/
+TOKEN_TYPE lexOperator(lexer_t *lexer, int c, size_t *tokLen){
+  int next = lexCharAt(lexer, 1);
+  *tokLen = 2;
+  switch(c){
+  case '{': *tokLen = 1; return OPEN_BRACE;
+  case '}': *tokLen = 1; return CLOSED_BRACE;
+  case '(': *tokLen = 1; return OPEN_PAREN;
+  case ')': *tokLen = 1; return CLOSED_PAREN;
+  case ';': *tokLen = 1; return SEMICOLON;
+  case '-': *tokLen = 1; return NEGATION;
+  case '~': *tokLen = 1; return BITWISE_COMP;
+  case '+': *tokLen = 1; return ADD_OP;
+  case '*': *tokLen = 1; return MULT_OP;
+  case '/': *tokLen = 1; return DIV_OP;
+  case '%': *tokLen = 1; return MOD_OP;
+  case '^': *tokLen = 1; return BIT_XOR;
+  case '?': *tokLen = 1; return QUESTION;
+  case ':': *tokLen = 1; return COLON;
+  case ',': *tokLen = 1; return COMMA;
+  case '#':
+    if(next == '#')
+      return HASH_HASH;
+    *tokLen = 1;
+    return HASH;
+  case '!':
+    if(next == '=')
+      return NEQ_TO;
+    *tokLen = 1;
+    return LOGIC_NEG;
+  case '=':
+    if(next == '=')
+      return EQ_TO;
+    *tokLen = 1;
+    return ASSIGN;
+  case '&':
+    if(next == '&')
+      return AND_OP;
+    *tokLen = 1;
+    return BIT_AND;
+  case '|':
+    if(next == '|')
+      return OR_OP;
+    *tokLen = 1;
+    return BIT_OR;
+  case '<':
+    if(next == '<')
+      return SHIFT_LEFT;
+    if(next == '=')
+      return LE_OP;
+    *tokLen = 1;
+    return LT_OP;
+  case '>':
+    if(next == '>')
+      return SHIFT_RIGHT;
+    if(next == '=')
+      return GE_OP;
+    *tokLen = 1;
+    return GT_OP;
+  }
+  *tokLen = 1;
+  return OTHER;
+}
+
+/**
+ * lexDirective(lexer_t *lexer)
+ * Scans a preprocessor directive, from its '#' to the end of its line, into a DIRECTIVE token.
+ * A backslash right before a newline continues the directive on the next line, and comments
+ * become single spaces, so the token's value is the directive on one line.
+ *
+ * param *lexer - the lexer positioned at the '#'
+ * return token_t* - returns the DIRECTIVE token
+ **/
+static token_t *lexDirective(lexer_t *lexer){
+  int lineNum = lexer->lineNum;
+  uint64_t offset = lexer->bufOffset + lexer->pos;
+  size_t len = 0;
+  size_t cap = 64;
+  char *text = malloc(cap);
+  if(text == NULL){
+    fprintf(stderr, "Failed to allocate space for directive.\n");
+    exit(1);
+  }
+  int c;
+  lexer->pos++;
+  while((c = lexCharAt(lexer, 0)) != EOF && c != '\n'){
+    if(c == '\\' && lexCharAt(lexer, 1) == '\n'){
+      lexer->pos += 2;
+      lexer->lineNum++;
+      c = ' ';
+    }
+    else if(c == '/' && lexCharAt(lexer, 1) == '/'){
+      while((c = lexCharAt(lexer, 0)) != EOF && c != '\n')
+        lexer->pos++;
+      continue;
+    }
+    else if(c == '/' && lexCharAt(lexer, 1) == '*'){
+      int startLine = lexer->lineNum;
+      lexer->pos += 2;
+      while(!((c = lexCharAt(lexer, 0)) == '*' && lexCharAt(lexer, 1) == '/')){
+        if(c == EOF){
+          lexer->lineNum = startLine;
+          fprintf(stderr, "Error on line %d: Unterminated comment.\n", lexErrorLine(lexer));
+          exit(1);
+        }
+        if(c == '\n')
+          lexer->lineNum++;
+        lexer->pos++;
+      }
+      lexer->pos += 2;
+      c = ' ';
+    }
+    else
+      lexer->pos++;
+    if(len == 0 && (charClass[c] & CC_SPACE))
+      continue;
+    growArray((void **) &text, &cap, len + 2, 1);
+    text[len++] = c;
+  }
+  while(len > 0 && (charClass[(unsigned char) text[len-1]] & CC_SPACE))
+    len--;
+  text[len] = '\0';
+  token_t *newToken = createToken(text, DIRECTIVE, lineNum);
+  newToken->offset = offset;
+  return newToken;
+}
+
+/**
+ * lexToken(lexer_t *lexer)
+ * Scans the next token from the source in a single forward pass (longest match wins).
+ *
+ * param *lexer - the lexer to scan from
+ * return token_t* - returns the next token, or NULL at the end of the file
+ **/
+token_t *lexToken(lexer_t *lexer){
+  int c = lexSkip(lexer);
+  if(c == EOF)
+    return NULL;
+  int lineStart = (lexer->lineNum != lexer->lastLine);
+  lexer->lastLine = lexer->lineNum;
+  if(c == '#' && lineStart)
+    return lexDirective(lexer);
+  size_t tokLen = 1;
+  TOKEN_TYPE tokType;
+  if(charClass[c] & CC_DIGIT){
+    tokLen = lexRun(lexer, tokLen, CC_DIGIT);
+    tokType = INT_LITERAL;
+  }
+  else if(charClass[c] & CC_ALPHA){
+    tokLen = lexRun(lexer, tokLen, CC_IDENT);
+    tokType = lookupKeyword(&lexer->buf[lexer->pos], tokLen);
+  }
+  else
+    tokType = lexOperator(lexer, c, &tokLen);
+  char *value = tokenSpellings[tokType];
+  uint32_t symbol = NO_SYMBOL;
+  if(tokType == IDENTIFIER){
+    symbol = intern(&lexer->buf[lexer->pos], tokLen);
+    value = symbolName(symbol);
+  }
+  else if(value == NULL)
+    value = strndup(&lexer->buf[lexer->pos], tokLen);
+  token_t *newToken = createToken(value, tokType, lexer->lineNum);
+  newToken->offset = lexer->bufOffset + lexer->pos;
+  newToken->symbol = symbol;
+  lexer->pos += tokLen;
+  return newToken;
+}
+
+/**
+ * openSource()
+ * Opens the source file (path provided on the command line, "-" for stdin).
+ *
+ * return FILE* - returns the opened source file
+ **/
+FILE *openSource(){
+  FILE *sourceFile;
+  if(strcmp(sourcePath, "-") == 0)
+    sourceFile = stdin;
+  else
+    sourceFile = fopen(sourcePath, "r");
   if(sourceFile == NULL){
     fprintf(stderr, "Failed to open source file %s\n", sourcePath);
     exit(1);
   }
-  //Allocate space for buffer containing source file contents
-  else{
-    fseek(sourceFile, 0, SEEK_END);
-    int sourceLen = ftell(sourceFile);
-    fseek(sourceFile, 0, SEEK_SET);
-    fileBuf = malloc(sizeof(char) * sourceLen + 1);
-    if(fileBuf == NULL){
-      fprintf(stderr, "Failed to allocate file buffer in Lexer.\n");
-      exit(1);
-    }
-    fread(fileBuf, 1, sourceLen, sourceFile);
+  return sourceFile;
+}
+
+/**
+ * *lex()
+ * Lex's the source file (path provided on the command line, "-" for stdin), and returns a list of valid tokens
+ *
+ * return tokenlist_t* - returns a list of valid tokens from the source file
+ **/
+tokenlist_t *lex(){
+  FILE *sourceFile = openSource();
+  tokenlist_t *tokens = initTokenlist();
+  lexer_t *lexer = initLexer(sourceFile);
+  token_t *newToken = NULL;
+  while((newToken = lexToken(lexer)) != NULL){
+    appendToken(tokens, newToken);
+    tokens->numTokens++;
+    if(dumpEnabled(DUMP_TOKENS))
+      dumpToken(newToken);
+  }
+  freeLexer(lexer);
+  if(sourceFile != stdin)
     fclose(sourceFile);
+  return tokens;
+}
+
+/**
+ * skipComment(const char *source, size_t len, size_t pos)
+ * Returns the position just past the comment starting at pos, or pos if no comment starts there.
+ * Line comments end before their newline.
+ *
+ * param *source - the source buffer
+ * param len - the length of the source buffer
+ * param pos - the position of a '/'
+ * return size_t - returns the position after the comment
+ **/
+size_t skipComment(const char *source, size_t len, size_t pos){
+  if(pos + 1 >= len)
+    return pos;
+  if(source[pos+1] == '/'){
+    const char *lineEnd = memchr(&source[pos], '\n', len - pos);
+    return (lineEnd == NULL) ? len : (size_t) (lineEnd - source);
+  }
+  if(source[pos+1] == '*'){
+    pos += 2;
+    while(pos < len){
+      const char *star = memchr(&source[pos], '*', len - pos);
+      if(star == NULL)
+        return len;
+      pos = star - source + 1;
+      if(pos < len && source[pos] == '/')
+        return pos + 1;
+    }
+    return len;
   }
-  tokens = initTokenlist();
-  //Lex the source file using regex
-  char *line = 0;
-  int lineNum = 1;
-
-  //printf("── lexing %s ──\n\n", sourcePath);
-  line = strtok(fileBuf, "\n");
-  //Parse line for tokens
-  while(line){
-    //printf("line %d: %s\n", lineNum, line);
-    //while inside line, parse and identify as many tokens as possible
-    //update token search offset in line as tokens are identified in order
-    //int main() { - should find 'int' 'main' '(' ')' '{'
-    //The lowest index match, not the FIRST match should be used
-    int i;
-    regmatch_t pmatch = {-1, -1};
-    int lineLen = strnlen(line, 1000);
-    int minStart = lineLen;
-    int minEnd = lineLen;
-    TOKEN_TYPE tokType = -1;
-    while(line[0] != '\0'){
-      //Chew through whitespace in line
-      if(isspace(line[0]) != 0){
-        line++;
-        continue;
+  return pos;
+}
+
+/**
+ * findChunkBounds(const char *source, size_t len, int numChunks, size_t *bounds)
+ * Splits the source into numChunks roughly equal chunks that end just after a newline outside
+ * of a comment and not continued by a backslash, so that no token, comment or directive straddles
+ * two chunks. Only '/' needs to be looked at to track comments, which keeps this serial pass far
+ * cheaper than lexing.
+ *
+ * param *source - the source buffer
+ * param len - the length of the source buffer
+ * param numChunks - the number of chunks to split into
+ * param *bounds - set to the numChunks+1 chunk boundaries, bounds[0] = 0, bounds[numChunks] = len
+ * return void
+ **/
+void findChunkBounds(const char *source, size_t len, int numChunks, size_t *bounds){
+  size_t pos = 0;
+  int k;
+  bounds[0] = 0;
+  for(k = 1; k < numChunks; k++){
+    size_t target = len / numChunks * k;
+    //Walk up to the target, stepping over any comments on the way
+    while(pos < target){
+      const char *slash = memchr(&source[pos], '/', target - pos);
+      if(slash == NULL){
+        pos = target;
+        break;
       }
-      for(i = 0; i < NUM_KEYWORDS; i++){
-        if(regexec(&keywords[i], line, 1, &pmatch, 0) == 0){
-          //If lower index match is found, update minStart & minEnd
-          if(pmatch.rm_so < minStart){
-            minStart = pmatch.rm_so;
-            minEnd = pmatch.rm_eo;
-            tokType = (TOKEN_TYPE) i;
-          }
-        }
+      pos = slash - source;
+      size_t after = skipComment(source, len, pos);
+      pos = (after == pos) ? pos + 1 : after;
+    }
+    //Then on to the next newline that is not inside a comment or continuing a directive
+    while(pos < len && (source[pos] != '\n' || (pos > 0 && source[pos-1] == '\\'))){
+      if(source[pos] == '/'){
+        size_t after = skipComment(source, len, pos);
+        pos = (after == pos) ? pos + 1 : after;
       }
-      //printf("\tToken found: ");
-      //printSubstr(line, minStart, minEnd);
-      //puts("");
-      token_t *newToken = createToken(strndup(&line[minStart], minEnd-minStart), tokType, lineNum);
-      appendToken(tokens, newToken);
-      tokens->numTokens++;
-      //printf("\t\tAdded token: %s\n", newToken->value);
-      //Update line position (and line length) to remove identified token
-      line += minEnd;
-      lineLen -= minEnd;
-      //Reset start/end indexes
-      minStart = lineLen;
-      minEnd = lineLen;
+      else
+        pos++;
     }
-    lineNum++;
-    line = strtok(NULL, "\n");
+    if(pos < len)
+      pos++;
+    bounds[k] = pos;
   }
-  //printf("Number of tokens identified: %d\n", tokens->numTokens);
-  free(fileBuf);
-  free(line);
+  bounds[numChunks] = len;
+}
+
+/**
+ * lexChunkMain(void *arg)
+ * Parallel lexing thread body. Lexes one chunk into its own token list, then once every chunk
+ * has counted its lines, shifts its tokens' line numbers by the lines in the chunks before it.
+ *
+ * param *arg - the lexchunk_t to lex
+ * return void* - returns NULL
+ **/
+void *lexChunkMain(void *arg){
+  lexchunk_t *chunk = arg;
+  lexer_t *lexer = initBufferLexer(chunk->source, chunk->start, chunk->end);
+  token_t *newToken = NULL;
+  while((newToken = lexToken(lexer)) != NULL){
+    appendToken(chunk->tokens, newToken);
+    chunk->tokens->numTokens++;
+  }
+  chunk->numLines = lexer->lineNum - 1;
+  freeLexer(lexer);
+  pthread_barrier_wait(chunk->barrier);
+  //Prefix sum of the line counts of the preceding chunks
+  int lineBase = 0;
+  int i;
+  for(i = 0; i < chunk->index; i++)
+    lineBase += chunk->chunks[i].numLines;
+  if(lineBase > 0){
+    token_t *currToken;
+    for(currToken = chunk->tokens->head; currToken != NULL; currToken = currToken->next)
+      currToken->lineNum += lineBase;
+  }
+  return NULL;
+}
+
+/**
+ * mapSource(size_t *len)
+ * Memory maps the source file read-only.
+ *
+ * param *len - set to the length of the source
+ * return const char* - returns the mapped source, or NULL for stdin, empty files and files that cannot be mapped
+ **/
+const char *mapSource(size_t *len){
+  if(strcmp(sourcePath, "-") == 0)
+    return NULL;
+  int fd = open(sourcePath, O_RDONLY);
+  struct stat sourceStat;
+  if(fd < 0 || fstat(fd, &sourceStat) != 0 || !S_ISREG(sourceStat.st_mode) || sourceStat.st_size == 0
+     || (uint64_t) sourceStat.st_size > SIZE_MAX){
+    if(fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  *len = sourceStat.st_size;
+  const char *source = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return (source == MAP_FAILED) ? NULL : source;
+}
+
+/**
+ * *lexParallel(int numThreads)
+ * Lex's the source file on numThreads threads, each tokenizing one chunk of the memory mapped
+ * file. The per-chunk token lists are linked together in order, so no tokens are copied.
+ * Falls back to lex() for stdin, files that cannot be mapped, and small files.
+ *
+ * param numThreads - the number of lexing threads to use
+ * return tokenlist_t* - returns a list of valid tokens from the source file
+ **/
+tokenlist_t *lexParallel(int numThreads){
+  if(numThreads <= 1)
+    return lex();
+  size_t len = 0;
+  const char *source = mapSource(&len);
+  if(source == NULL)
+    return lex();
+  if(len / numThreads < MIN_CHUNK_SIZE)
+    numThreads = (len / MIN_CHUNK_SIZE > 1) ? len / MIN_CHUNK_SIZE : 1;
+  if(numThreads == 1){
+    munmap((void *) source, len);
+    return lex();
+  }
+
+  size_t *bounds = malloc(sizeof(size_t) * (numThreads + 1));
+  lexchunk_t *chunks = malloc(sizeof(lexchunk_t) * numThreads);
+  pthread_t *threads = malloc(sizeof(pthread_t) * numThreads);
+  if(bounds == NULL || chunks == NULL || threads == NULL){
+    fprintf(stderr, "Failed to allocate space for lexer chunks.\n");
+    exit(1);
+  }
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, numThreads);
+  internLocking = 1;
+  findChunkBounds(source, len, numThreads, bounds);
+  int i;
+  for(i = 0; i < numThreads; i++){
+    chunks[i].source = source;
+    chunks[i].start = bounds[i];
+    chunks[i].end = bounds[i+1];
+    chunks[i].tokens = initTokenlist();
+    chunks[i].numLines = 0;
+    chunks[i].index = i;
+    chunks[i].chunks = chunks;
+    chunks[i].barrier = &barrier;
+    if(pthread_create(&threads[i], NULL, lexChunkMain, &chunks[i]) != 0){
+      fprintf(stderr, "Failed to start lexer thread.\n");
+      exit(1);
+    }
+  }
+  //Stitch the chunk lists together in source order
+  tokenlist_t *tokens = initTokenlist();
+  for(i = 0; i < numThreads; i++){
+    pthread_join(threads[i], NULL);
+    tokenlist_t *chunkTokens = chunks[i].tokens;
+    if(chunkTokens->head != NULL){
+      if(tokens->head == NULL)
+        tokens->head = chunkTokens->head;
+      else
+        tokens->tail->next = chunkTokens->head;
+      tokens->tail = chunkTokens->tail;
+      tokens->numTokens += chunkTokens->numTokens;
+    }
+    free(chunkTokens);
+  }
+  internLocking = 0;
+  pthread_barrier_destroy(&barrier);
+  munmap((void *) source, len);
+  free(bounds);
+  free(chunks);
+  free(threads);
+  if(dumpEnabled(DUMP_TOKENS)){
+    token_t *currToken;
+    for(currToken = tokens->head; currToken != NULL; currToken = currToken->next)
+      dumpToken(currToken);
+  }
+  return tokens;
+}
+
+/**
+ * lexThreadMain(void *arg)
+ * Lexer thread body for pipelined lexing, publishes every token to the ring followed by NULL.
+ *
+ * param *arg - the lexpipe_t of the pipeline
+ * return void* - returns NULL
+ **/
+void *lexThreadMain(void *arg){
+  lexpipe_t *pipe = arg;
+  token_t *newToken = NULL;
+  while((newToken = lexToken(pipe->lexer)) != NULL){
+    if(dumpEnabled(DUMP_TOKENS))
+      dumpToken(newToken);
+    ringPush(pipe->ring, newToken);
+  }
+  if(pipe->lexer->file != stdin)
+    fclose(pipe->lexer->file);
+  ringPush(pipe->ring, NULL);
+  return NULL;
+}
+
+/**
+ * *lexPipelined(size_t ringSize)
+ * Starts lexing the source file on its own thread, and returns a token list the parser can
+ * consume while lexing is still going. Tokens are handed over through a lock-free ring of
+ * ringSize tokens, so at most that many lexed tokens are waiting on the parser at a time.
+ *
+ * param ringSize - the number of tokens the lexer may run ahead of the parser
+ * return tokenlist_t* - returns a token list fed by the lexer thread
+ **/
+tokenlist_t *lexPipelined(size_t ringSize){
+  FILE *sourceFile = openSource();
+  tokenlist_t *tokens = initTokenlist();
+  lexpipe_t *pipe = malloc(sizeof(lexpipe_t));
+  if(pipe == NULL){
+    fprintf(stderr, "Failed to allocate space for lexer pipeline.\n");
+    exit(1);
+  }
+  pipe->lexer = initLexer(sourceFile);
+  pipe->ring = initRing(ringSize);
+  internLocking = 1;
+  if(pthread_create(&pipe->thread, NULL, lexThreadMain, pipe) != 0){
+    fprintf(stderr, "Failed to start lexer thread.\n");
+    exit(1);
+  }
+  tokens->pipe = pipe;
   return tokens;
 }
 
+/**
+ * lexOnDemand(lexer_t *lexer)
+ * Creates a token stream that lexes each token only when the parser asks for it, so the
+ * caller can skip over parts of an in-memory source with seekTokens().
+ *
+ * param *lexer - the buffer lexer to pull tokens from, owned by the token list afterwards
+ * return tokenlist_t* - returns the on demand token stream
+ **/
+tokenlist_t *lexOnDemand(lexer_t *lexer){
+  tokenlist_t *tokens = initTokenlist();
+  tokens->lexer = lexer;
+  return tokens;
+}
+
+/**
+ * seekTokens(tokenlist_t *tokens, uint64_t offset, int lineNum)
+ * Moves an on demand token stream to another position of its source, dropping any tokens
+ * already looked ahead at.
+ *
+ * param *tokens - the on demand token stream, see lexOnDemand()
+ * param offset - the source offset to continue lexing from
+ * param lineNum - the line number at that offset
+ * return void
+ **/
+void seekTokens(tokenlist_t *tokens, uint64_t offset, int lineNum){
+  lexer_t *lexer = tokens->lexer;
+  if(lexer == NULL || lexer->source == NULL || offset < lexer->bufOffset || offset > lexer->bufOffset + lexer->len){
+    fprintf(stderr, "Cannot seek a token stream that is not lexed on demand from memory.\n");
+    exit(1);
+  }
+  while(tokens->lookCount > 0){
+    freeToken(tokens->lookahead[tokens->lookStart]);
+    tokens->lookStart = (tokens->lookStart + 1) & (LOOKAHEAD - 1);
+    tokens->lookCount--;
+  }
+  lexer->pos = offset - lexer->bufOffset;
+  lexer->lineNum = lineNum;
+  lexer->scan.block = NULL;
+}
+
 /**
  * printTokens(tokenlist_t *tokens)
  * Prints the values of all tokens in the provided token list
@@ -377,13 +1183,17 @@ void printTokens(tokenlist_t *tokens){
 void freeTokens(tokenlist_t *tokens){
   if(tokens == NULL)
     return;
-  token_t *currToken = tokens->head;
-  token_t *prev = NULL;
-  while(currToken != NULL){
-    prev = currToken;
-    currToken = currToken->next;
-    free(prev->value);
-    free(prev);
+  token_t *currToken = NULL;
+  while(tokens->lookCount > 0){
+    freeToken(tokens->lookahead[tokens->lookStart]);
+    tokens->lookStart = (tokens->lookStart + 1) & (LOOKAHEAD - 1);
+    tokens->lookCount--;
   }
+  //Also lets a pipelined lexer run to completion so its thread can be joined
+  while(tokens->lexer == NULL && (currToken = pullRawToken(tokens)) != NULL)
+    freeToken(currToken);
+  freeLexer(tokens->lexer);
+  releaseTokens(tokens);
+  free(tokens->retired);
   free(tokens);
 }
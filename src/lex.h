@@ -1,8 +1,24 @@
 #ifndef LEX_H_
 #define LEX_H_
 
+#include <stdio.h>
+#include <stdint.h>
+
+#include "scan.h"
+#include "intern.h"
+
 #define LEN_PATH 4097
-#define NUM_KEYWORDS 30
+#define NUM_TOKEN_TYPES 48
+//Bytes read from the source file at a time
+#define LEX_CHUNK_SIZE (1 << 16)
+//Smallest chunk worth handing to its own thread in parallel lexing
+#define MIN_CHUNK_SIZE (1 << 18)
+//Starting value of token fingerprints (64 bit FNV-1a offset basis), see popToken()
+#define FINGERPRINT_INIT 14695981039346656037ULL
+//Tokens the parser can look ahead (power of two), see peekN()
+#define LOOKAHEAD 4
+//Default number of tokens the pipelined lexer may run ahead of the parser
+#define DEFAULT_RING_SIZE 4096
 
 extern char sourcePath[LEN_PATH];
 
@@ -12,40 +28,107 @@ typedef enum TOKEN_TYPE {OPEN_BRACE, CLOSED_BRACE, OPEN_PAREN, CLOSED_PAREN, SEM
                          INT_KEYW, RET_KEYW, INT_LITERAL, IDENTIFIER,
                          NEGATION, BITWISE_COMP, LOGIC_NEG, ADD_OP, MULT_OP, DIV_OP,
                          AND_OP, OR_OP, EQ_TO, NEQ_TO, LT_OP, LE_OP, GT_OP, GE_OP, MOD_OP,
-                         BIT_AND, BIT_OR, BIT_XOR, SHIFT_LEFT, SHIFT_RIGHT, ASSIGN} TOKEN_TYPE;
+                         BIT_AND, BIT_OR, BIT_XOR, SHIFT_LEFT, SHIFT_RIGHT, ASSIGN,
+                         QUESTION, COLON, IF_KEYW, ELSE_KEYW,
+                         WHILE_KEYW, DO_KEYW, FOR_KEYW, BREAK_KEYW, CONTINUE_KEYW,
+                         SWITCH_KEYW, CASE_KEYW, DEFAULT_KEYW, COMMA,
+                         HASH, HASH_HASH, DIRECTIVE, OTHER,
+                         END_OF_INPUT} TOKEN_TYPE;
 
 //Tokenlist node, contains token data and pointer to next token (if available)
+//Identifier tokens carry their interned symbol ID, and their value is the interned name
+//A DIRECTIVE token is a whole preprocessor directive line, its value the text after the '#' with
+//comments and line continuations taken out; OTHER is a character no token starts with, an error
+//unless the preprocessor skips it
+//file is the interned path of the header a token was read from, NO_SYMBOL for the source file
 typedef struct token_t {
   char *value;
   TOKEN_TYPE type;
   int lineNum;
+  uint64_t offset;
+  uint32_t symbol;
+  uint32_t file;
   struct token_t *next;
 } token_t;
 
-//Tokenlist type
+//Tokenlist type, optionally fed by a lexer thread (pipe) or lexed on demand (lexer). The parser reads it as a stream
+//through a fixed lookahead ring, and gets endToken once the input is exhausted. With a preprocessor attached
+//(see preprocess()), the parser reads what ppNext makes of the raw tokens instead. Popped tokens are kept in
+//retired until the parser releases them, see releaseTokens()
 typedef struct tokenlist_t {
   token_t *head;
   token_t *tail;
-  int numTokens;
+  uint64_t numTokens;
+  struct lexpipe_t *pipe;
+  struct lexer_t *lexer;
+  token_t *lookahead[LOOKAHEAD];
+  int lookStart;
+  int lookCount;
+  token_t endToken;
+  token_t **retired;
+  size_t numRetired;
+  size_t retiredCap;
+  int fingerprinting;
+  uint64_t fingerprint;
+  struct pp_t *pp;
+  token_t *(*ppNext)(struct pp_t *pp);
 } tokenlist_t;
 
+//Lexer state, a window of the source file that is read chunk by chunk,
+//or a chunk of an in-memory source (source set, buffer borrowed). lastLine is the line of the
+//last token, a '#' only starts a directive as the first token of its line.
+typedef struct lexer_t {
+  FILE *file;
+  char *buf;
+  size_t cap;
+  size_t pos;
+  size_t len;
+  uint64_t bufOffset;
+  int eof;
+  int lineNum;
+  int lastLine;
+  const char *source;
+  scancache_t scan;
+} lexer_t;
+
 
-//Regex functions
-void initRegexp();
+//Lexer functions
+lexer_t *initLexer(FILE *sourceFile);
+lexer_t *initBufferLexer(const char *source, size_t start, size_t end);
+int lexErrorLine(lexer_t *lexer);
+void freeLexer(lexer_t *lexer);
+size_t lexFill(lexer_t *lexer, size_t need);
+TOKEN_TYPE lookupKeyword(const char *word, size_t len);
+token_t *lexToken(lexer_t *lexer);
 token_t *createToken(char *value, TOKEN_TYPE type, int lineNum);
-void freeRegs();
+token_t *copyToken(token_t *token);
+char *tokenTypeName(TOKEN_TYPE type);
 
 
 //Token functions
 tokenlist_t *initTokenlist();
+void freeToken(token_t *token);
+void retireToken(tokenlist_t *tokens, token_t *token);
+void releaseTokens(tokenlist_t *tokens);
+token_t *pullRawToken(tokenlist_t *tokens);
+token_t *pullToken(tokenlist_t *tokens);
+uint64_t fingerprintToken(uint64_t fingerprint, token_t *token);
 token_t *popToken(tokenlist_t *tokens);
-void prependToken(tokenlist_t *tokens, token_t *token);
+token_t *peekN(tokenlist_t *tokens, int k);
 token_t *peek(tokenlist_t *tokens);
 void appendToken(tokenlist_t *tokens, token_t *token);
+tokenlist_t *lexOnDemand(lexer_t *lexer);
+void seekTokens(tokenlist_t *tokens, uint64_t offset, int lineNum);
 void printTokens(tokenlist_t *tokens);
 void freeTokens(tokenlist_t *tokens);
 
+FILE *openSource();
 tokenlist_t *lex();
+tokenlist_t *lexPipelined(size_t ringSize);
+const char *mapSource(size_t *len);
+size_t skipComment(const char *source, size_t len, size_t pos);
+void findChunkBounds(const char *source, size_t len, int numChunks, size_t *bounds);
+tokenlist_t *lexParallel(int numThreads);
 
 //Other functions
 void printSubstr(char *line, int start, int end);
@@ -0,0 +1,2021 @@
+#include "opt.h"
+#include "gen.h"
+#include "dump.h"
+#include "flow.h"
+#include "prof.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+unsigned int optFlags = OPT_CSE | OPT_DCE | OPT_CMOV | OPT_LICM | OPT_UNROLL | OPT_JUMP_TABLES | OPT_INLINE | OPT_FOLD
+  | OPT_OMIT_FRAME_POINTER | OPT_TAIL_CALLS;
+int inlineThreshold = DEFAULT_INLINE_THRESHOLD;
+
+//Names of the optimizations for -fno-<name>
+static const optflag_t optimizations[] = {
+  {"cse", OPT_CSE},
+  {"dce", OPT_DCE},
+  {"cmov", OPT_CMOV},
+  {"licm", OPT_LICM},
+  {"unroll", OPT_UNROLL},
+  {"jump-tables", OPT_JUMP_TABLES},
+  {"inline", OPT_INLINE},
+  {"fold", OPT_FOLD},
+  {"omit-frame-pointer", OPT_OMIT_FRAME_POINTER},
+  {"tail-calls", OPT_TAIL_CALLS},
+};
+
+#define NUM_OPTIMIZATIONS (sizeof(optimizations)/sizeof(optimizations[0]))
+
+//A hash-consed value: an operator applied to canonical operand nodes, or a leaf (INTEGER or SYMBOL).
+//node is the canonical node of the value, slot where it is first used, and shared the SHARED node
+//standing in for it once a duplicate has been found.
+typedef struct cseentry_t {
+  AST_TYPE nodeType;
+  const char *op;
+  int64_t value;
+  astnode_t *operands[2];
+  uint64_t hash;
+  astnode_t *node;
+  astnode_t **slot;
+  astnode_t *shared;
+  int next;
+} cseentry_t;
+
+//Chained hash table of the values available at the point of the walk. Entries are only ever
+//added and removed last in, first out, so each scope (the right operand of && and ||, or an arm
+//of ?:, which may not be evaluated) is closed by popping the entries made inside it.
+typedef struct csetable_t {
+  cseentry_t *entries;
+  size_t numEntries;
+  size_t entriesCap;
+  int *buckets;
+  size_t numBuckets;
+  size_t *scopes;
+  size_t numScopes;
+  size_t scopesCap;
+} csetable_t;
+
+//Explicit stack frame of the hash-consing walk: the slot holding the node, whether it is pure
+//so far, the size of its subtree, and the canonical nodes of its operands (left, right, middle)
+typedef struct cseframe_t {
+  astnode_t **slot;
+  int state;
+  int operand;
+  int scoped;
+  int pure;
+  int size;
+  astnode_t *operands[3];
+} cseframe_t;
+
+static csetable_t values = {0};
+static symset_t assigned = {NULL, 0};
+static cseframe_t *cseFrames = NULL;
+static size_t cseFramesCap = 0;
+static astnode_t ***slotStack = NULL;
+static size_t slotStackCap = 0;
+//SHARED nodes of the statement being optimized, by their provisional index, and their use counts
+static astnode_t **sharedNodes = NULL;
+static size_t sharedNodesCap = 0;
+static int *sharedRefs = NULL;
+static size_t sharedRefsCap = 0;
+//Variables of the function being optimized, for dataflow bitsets
+static varmap_t functionVars = {0};
+//Statements of the function being optimized, nested ones included, see collectStatements()
+static astnode_t **funcStatements = NULL;
+static size_t funcStatementsCap = 0;
+
+//Explicit stack frame of the invariant search: the slot holding the node, whether it is
+//invariant so far, and where the invariant subexpressions found below it start
+typedef struct licmframe_t {
+  astnode_t **slot;
+  int state;
+  int invariant;
+  size_t firstFound;
+} licmframe_t;
+
+static licmframe_t *licmFrames = NULL;
+static size_t licmFramesCap = 0;
+//Slots of the largest invariant subexpressions found in a loop
+static astnode_t ***invariants = NULL;
+static size_t invariantsCap = 0;
+//Number of variables made for hoisted expressions in the current function
+static int numHoisted = 0;
+
+//A node to copy and where to put the copy, for cloneTree(), and whether its symbols are substituted
+typedef struct clonepair_t {
+  astnode_t *node;
+  astnode_t **copy;
+  int substitute;
+} clonepair_t;
+
+//A symbol cloneTree() replaces, and the tree (copied as it is) put in its place
+typedef struct substitution_t {
+  uint32_t symbol;
+  astnode_t *value;
+} substitution_t;
+
+static clonepair_t *clonePairs = NULL;
+static size_t clonePairsCap = 0;
+static substitution_t *substitutions = NULL;
+static size_t numSubstitutions = 0;
+static size_t substitutionsCap = 0;
+
+//A function of the program for the inliner: its FUNCTION node, the functions it calls (by their
+//position in the program), whether it is in a cycle of calls, its size once calls are inlined into
+//it, the functions inlined into it (directly or not), and its state in the search for cycles
+typedef struct inlinefunc_t {
+  astnode_t *funcNode;
+  int *callees;
+  size_t numCallees;
+  size_t calleesCap;
+  int recursive;
+  int leaf;
+  int size;
+  int numSites;
+  int *inlined;
+  size_t numInlined;
+  size_t inlinedCap;
+  int order;
+  int lowLink;
+  int onStack;
+} inlinefunc_t;
+
+//Explicit stack frame of the search for cycles: the function, and the next of its callees to visit
+typedef struct sccframe_t {
+  int func;
+  size_t next;
+} sccframe_t;
+
+static inlinefunc_t *inlineFuncs = NULL;
+static size_t numInlineFuncs = 0;
+static size_t inlineFuncsCap = 0;
+//Position in the program of each function, by name symbol
+static int *funcPositions = NULL;
+static size_t funcPositionsCap = 0;
+static sccframe_t *sccFrames = NULL;
+static size_t sccFramesCap = 0;
+static int *sccStack = NULL;
+static size_t sccStackCap = 0;
+//Functions in the order calls are inlined into them, callees first
+static int *inlineOrder = NULL;
+static size_t inlineOrderCap = 0;
+static astnode_t **inlineStatements = NULL;
+static size_t inlineStatementsCap = 0;
+static astnode_t ***callSlots = NULL;
+static size_t callSlotsCap = 0;
+static astnode_t ***foldSlots = NULL;
+static size_t foldSlotsCap = 0;
+
+/**
+ * disableOptimization(const char *name)
+ * Turns off an optimization, for -fno-<name>
+ *
+ * param *name - the optimization's name
+ * return int - returns 0 on success, 1 if there is no such optimization
+ **/
+int disableOptimization(const char *name){
+  size_t i;
+  for(i = 0; i < NUM_OPTIMIZATIONS; i++){
+    if(strcmp(name, optimizations[i].name) == 0){
+      optFlags &= ~optimizations[i].flag;
+      return 0;
+    }
+  }
+  fprintf(stderr, "Unknown optimization -fno-%s.\n", name);
+  return 1;
+}
+
+/**
+ * evaluationOrder(astnode_t *node, astnode_t **slots[3])
+ * Finds the subexpressions of a statement or expression node, in the order the code generator
+ * evaluates them. Of an if or loop, only the condition belongs to its statement.
+ *
+ * param *node - the node
+ * param **slots[3] - filled with the addresses of the child pointers
+ * return int - returns the number of subexpressions
+ **/
+static int evaluationOrder(astnode_t *node, astnode_t **slots[3]){
+  switch(node->nodeType){
+  case BINARY_OP:
+    if(rightOperandFirst(node->fields.children.middle->fields.strVal)){
+      slots[0] = &node->fields.children.right;
+      slots[1] = &node->fields.children.left;
+    }
+    else{
+      slots[0] = &node->fields.children.left;
+      slots[1] = &node->fields.children.right;
+    }
+    return 2;
+  case UNARY_OP:
+  case ASSIGNMENT:
+  case DECLARATION:
+    slots[0] = &node->fields.children.right;
+    return node->fields.children.right != NULL;
+  case TERNARY:
+    slots[0] = &node->fields.children.left;
+    slots[1] = &node->fields.children.middle;
+    slots[2] = &node->fields.children.right;
+    return 3;
+  //Arguments are evaluated last to first
+  case CALL:
+    slots[0] = &node->fields.children.right;
+    return node->fields.children.right != NULL;
+  case ARGUMENT:
+    if(node->fields.children.right == NULL){
+      slots[0] = &node->fields.children.left;
+      return 1;
+    }
+    slots[0] = &node->fields.children.right;
+    slots[1] = &node->fields.children.left;
+    return 2;
+  case RETURN:
+  case SHARED:
+  case IF:
+  case WHILE:
+  case DO_WHILE:
+  case SWITCH:
+    slots[0] = &node->fields.children.left;
+    return node->fields.children.left != NULL;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * isShortCircuit(astnode_t *node)
+ * Checks whether a node is a && or || operator, whose right operand is only evaluated sometimes
+ * (the arms of ?: are handled by the caller)
+ *
+ * param *node - the node
+ * return int - returns 1 for && and ||, 0 otherwise
+ **/
+static int isShortCircuit(astnode_t *node){
+  if(node->nodeType != BINARY_OP)
+    return 0;
+  char *opType = node->fields.children.middle->fields.strVal;
+  return strcmp(opType, "&&") == 0 || strcmp(opType, "||") == 0;
+}
+
+/**
+ * hashMix(uint64_t hash, uint64_t value)
+ * Mixes a value into a value number hash
+ *
+ * param hash - the hash so far
+ * param value - the value to mix in
+ * return uint64_t - returns the new hash
+ **/
+static uint64_t hashMix(uint64_t hash, uint64_t value){
+  hash = (hash ^ value) * 1099511628211ULL;
+  return hash ^ (hash >> 29);
+}
+
+/**
+ * valueKey(cseentry_t *key, astnode_t *node, astnode_t *operands[2])
+ * Builds the hash-consing key of a pure expression node
+ *
+ * param *key - filled with the key
+ * param *node - an INTEGER, SYMBOL, UNARY_OP or BINARY_OP node
+ * param *operands[2] - the canonical nodes of its left and right operands
+ * return void
+ **/
+static void valueKey(cseentry_t *key, astnode_t *node, astnode_t *operands[2]){
+  memset(key, 0, sizeof(cseentry_t));
+  key->nodeType = node->nodeType;
+  if(node->nodeType == INTEGER)
+    key->value = node->fields.intVal;
+  else if(node->nodeType == SYMBOL)
+    key->value = node->fields.symbol;
+  else if(node->nodeType == UNARY_OP)
+    key->op = node->fields.children.left->fields.strVal;
+  else
+    key->op = node->fields.children.middle->fields.strVal;
+  key->operands[0] = operands[0];
+  key->operands[1] = operands[1];
+  uint64_t hash = hashMix(FINGERPRINT_INIT, key->nodeType);
+  const char *c = NULL;
+  for(c = key->op; c != NULL && *c != '\0'; c++)
+    hash = hashMix(hash, (unsigned char) *c);
+  hash = hashMix(hash, (uint64_t) key->value);
+  hash = hashMix(hash, (uint64_t) (uintptr_t) operands[0]);
+  key->hash = hashMix(hash, (uint64_t) (uintptr_t) operands[1]);
+}
+
+/**
+ * findValue(cseentry_t *key)
+ * Looks a value up among the ones available
+ *
+ * param *key - the value's key
+ * return cseentry_t* - returns the entry of the value, or NULL if it is not available
+ **/
+static cseentry_t *findValue(cseentry_t *key){
+  if(values.numBuckets == 0)
+    return NULL;
+  int i = values.buckets[key->hash & (values.numBuckets - 1)];
+  for(; i >= 0; i = values.entries[i].next){
+    cseentry_t *entry = &values.entries[i];
+    if(entry->hash == key->hash && entry->nodeType == key->nodeType && entry->value == key->value
+       && entry->operands[0] == key->operands[0] && entry->operands[1] == key->operands[1]
+       && (entry->op == key->op || (entry->op != NULL && key->op != NULL && strcmp(entry->op, key->op) == 0)))
+      return entry;
+  }
+  return NULL;
+}
+
+/**
+ * addValue(cseentry_t *key, astnode_t *node, astnode_t **slot)
+ * Makes a value available, with node as its canonical node
+ *
+ * param *key - the value's key
+ * param *node - the node computing the value
+ * param **slot - where node is used
+ * return void
+ **/
+static void addValue(cseentry_t *key, astnode_t *node, astnode_t **slot){
+  size_t i;
+  growArray((void **) &values.entries, &values.entriesCap, values.numEntries + 1, sizeof(cseentry_t));
+  if(values.numEntries >= values.numBuckets){
+    //Rehash in insertion order, keeping the newest entry at the head of each chain
+    growArray((void **) &values.buckets, &values.numBuckets, values.numEntries + 1, sizeof(int));
+    memset(values.buckets, 0xff, values.numBuckets*sizeof(int));
+    for(i = 0; i < values.numEntries; i++){
+      size_t bucket = values.entries[i].hash & (values.numBuckets - 1);
+      values.entries[i].next = values.buckets[bucket];
+      values.buckets[bucket] = i;
+    }
+  }
+  cseentry_t *entry = &values.entries[values.numEntries];
+  *entry = *key;
+  entry->node = node;
+  entry->slot = slot;
+  entry->shared = NULL;
+  size_t bucket = entry->hash & (values.numBuckets - 1);
+  entry->next = values.buckets[bucket];
+  values.buckets[bucket] = values.numEntries++;
+}
+
+/**
+ * openScope()
+ * Starts a scope of values that stop being available when it is closed
+ *
+ * return void
+ **/
+static void openScope(){
+  growArray((void **) &values.scopes, &values.scopesCap, values.numScopes + 1, sizeof(size_t));
+  values.scopes[values.numScopes++] = values.numEntries;
+}
+
+/**
+ * closeScope(size_t mark)
+ * Removes the values added since an entry count
+ *
+ * param mark - the number of entries to keep
+ * return void
+ **/
+static void closeScope(size_t mark){
+  while(values.numEntries > mark){
+    cseentry_t *entry = &values.entries[--values.numEntries];
+    values.buckets[entry->hash & (values.numBuckets - 1)] = entry->next;
+  }
+}
+
+/**
+ * shareValue(cseentry_t *entry, size_t index)
+ * Puts a SHARED node in front of a value's canonical node, at its first use
+ *
+ * param *entry - the value
+ * param index - the SHARED node's provisional index, see placeTemporaries()
+ * return astnode_t* - returns the SHARED node
+ **/
+static astnode_t *shareValue(cseentry_t *entry, size_t index){
+  astnode_t *shared = createNode(SHARED, 0);
+  shared->fields.children.left = entry->node;
+  shared->fields.children.right = createNode(INTEGER, 0);
+  shared->fields.children.right->fields.intVal = index;
+  *entry->slot = shared;
+  entry->shared = shared;
+  growArray((void **) &sharedNodes, &sharedNodesCap, index + 1, sizeof(astnode_t *));
+  sharedNodes[index] = shared;
+  return shared;
+}
+
+/**
+ * hashConsStatement(astnode_t **root, int *eliminated)
+ * Hash-conses the pure subexpressions of a statement, walking it in evaluation order. Repeated
+ * operators are replaced by a SHARED node of their first occurrence, turning the tree into a DAG.
+ * Variables assigned anywhere in the statement are not pure, and neither are values computed on
+ * the right of && and || or in an arm of ?: once past it, since it may not have been evaluated.
+ *
+ * param **root - where the statement is
+ * param *eliminated - incremented by the number of nodes replaced
+ * return size_t - returns the number of SHARED nodes made
+ **/
+static size_t hashConsStatement(astnode_t **root, int *eliminated){
+  size_t numShared = 0;
+  size_t depth = 0;
+  growArray((void **) &cseFrames, &cseFramesCap, 1, sizeof(cseframe_t));
+  memset(&cseFrames[0], 0, sizeof(cseframe_t));
+  cseFrames[0].slot = root;
+  depth = 1;
+  while(depth > 0){
+    cseframe_t *frame = &cseFrames[depth-1];
+    astnode_t *node = *frame->slot;
+    astnode_t **slots[3];
+    int numSlots = evaluationOrder(node, slots);
+    if(frame->state == 0){
+      frame->pure = 1;
+      frame->size = 1;
+    }
+    if(frame->state < numSlots){
+      astnode_t **slot = slots[frame->state++];
+      int scoped = (isShortCircuit(node) && slot == &node->fields.children.right)
+        || (node->nodeType == TERNARY && slot != &node->fields.children.left);
+      if(scoped)
+        openScope();
+      growArray((void **) &cseFrames, &cseFramesCap, depth + 1, sizeof(cseframe_t));
+      cseframe_t *child = &cseFrames[depth++];
+      memset(child, 0, sizeof(cseframe_t));
+      child->slot = slot;
+      child->operand = (slot == &node->fields.children.left) ? 0 : (slot == &node->fields.children.right) ? 1 : 2;
+      child->scoped = scoped;
+      continue;
+    }
+    astnode_t *canonical = NULL;
+    if(node->nodeType == SYMBOL)
+      frame->pure = !symsetHas(&assigned, node->fields.symbol);
+    else if(node->nodeType != INTEGER && node->nodeType != UNARY_OP && node->nodeType != BINARY_OP)
+      frame->pure = 0;
+    if(frame->pure){
+      cseentry_t key;
+      valueKey(&key, node, frame->operands);
+      cseentry_t *entry = findValue(&key);
+      if(entry == NULL){
+        addValue(&key, node, frame->slot);
+        canonical = node;
+      }
+      else{
+        canonical = entry->node;
+        //Leaves are as cheap to load again as a temporary
+        if(node->nodeType == UNARY_OP || node->nodeType == BINARY_OP){
+          *eliminated += frame->size;
+          *frame->slot = (entry->shared != NULL) ? entry->shared : shareValue(entry, numShared++);
+        }
+      }
+    }
+    depth--;
+    if(frame->scoped)
+      closeScope(values.scopes[--values.numScopes]);
+    if(depth > 0){
+      cseframe_t *parent = &cseFrames[depth-1];
+      parent->pure &= frame->pure;
+      parent->size += frame->size;
+      parent->operands[frame->operand] = canonical;
+    }
+  }
+  return numShared;
+}
+
+/**
+ * placeTemporaries(astnode_t **root, size_t numShared)
+ * Removes the SHARED nodes left with a single use (their duplicates were inside larger duplicates)
+ * and numbers the stack temporaries of the others
+ *
+ * param **root - where the statement is
+ * param numShared - the number of SHARED nodes made by hashConsStatement()
+ * return int - returns the number of temporaries the statement needs
+ **/
+static int placeTemporaries(astnode_t **root, size_t numShared){
+  size_t depth = 0;
+  size_t i;
+  int numTemps = 0;
+  growArray((void **) &sharedRefs, &sharedRefsCap, numShared, sizeof(int));
+  memset(sharedRefs, 0, numShared*sizeof(int));
+  int pass;
+  for(pass = 0; pass < 2; pass++){
+    growArray((void **) &slotStack, &slotStackCap, 1, sizeof(astnode_t **));
+    slotStack[0] = root;
+    depth = 1;
+    while(depth > 0){
+      astnode_t **slot = slotStack[--depth];
+      astnode_t *node = *slot;
+      if(node == NULL)
+        continue;
+      if(node->nodeType == SHARED){
+        int index = node->fields.children.right->fields.intVal;
+        //First pass counts uses, second unwraps single uses and numbers the rest once each
+        if(pass == 0 && sharedRefs[index]++ > 0)
+          continue;
+        if(pass == 1 && sharedRefs[index] == 1)
+          *slot = node = node->fields.children.left;
+        else if(pass == 1){
+          if(sharedRefs[index] < 0)
+            continue;
+          sharedRefs[index] = -1 - numTemps++;
+        }
+      }
+      astnode_t **slots[3];
+      int numSlots = evaluationOrder(node, slots);
+      growArray((void **) &slotStack, &slotStackCap, depth + numSlots, sizeof(astnode_t **));
+      while(numSlots > 0)
+        slotStack[depth++] = slots[--numSlots];
+    }
+  }
+  for(i = 0; i < numShared; i++){
+    if(sharedRefs[i] < 0)
+      sharedNodes[i]->fields.children.right->fields.intVal = -1 - sharedRefs[i];
+  }
+  return numTemps;
+}
+
+/**
+ * findAssignments(astnode_t **root)
+ * Collects the variables assigned in a statement into the assigned set
+ *
+ * param **root - where the statement is
+ * return int - returns the number of assignments found
+ **/
+static int findAssignments(astnode_t **root){
+  int numAssignments = 0;
+  size_t depth = 1;
+  growArray((void **) &slotStack, &slotStackCap, 1, sizeof(astnode_t **));
+  slotStack[0] = root;
+  while(depth > 0){
+    astnode_t *node = *slotStack[--depth];
+    if(node->nodeType == ASSIGNMENT){
+      symsetAdd(&assigned, node->fields.children.left->fields.symbol);
+      numAssignments++;
+    }
+    astnode_t **slots[3];
+    int numSlots = evaluationOrder(node, slots);
+    growArray((void **) &slotStack, &slotStackCap, depth + numSlots, sizeof(astnode_t **));
+    while(numSlots > 0)
+      slotStack[depth++] = slots[--numSlots];
+  }
+  return numAssignments;
+}
+
+/**
+ * eliminateCommonSubexprs(astnode_t *funcNode)
+ * Common subexpression elimination within each statement of a function. Repeated pure
+ * subexpressions become SHARED nodes, computed once into a stack temporary by the code
+ * generator; each STATEMENT's middle child is set to an INTEGER holding the number of
+ * temporaries it needs. Statements are optimized on their own, since any of them may
+ * assign to the variables the next one reads; those in if and else branches included.
+ *
+ * param *funcNode - the FUNCTION node
+ * return int - returns the number of AST nodes eliminated
+ **/
+int eliminateCommonSubexprs(astnode_t *funcNode){
+  int eliminated = 0;
+  size_t numStatements = collectStatements(funcNode, &funcStatements, &funcStatementsCap);
+  size_t i;
+  for(i = 0; i < numStatements; i++){
+    astnode_t *statement = funcStatements[i];
+    astnode_t **root = &statement->fields.children.left;
+    int numAssignments = findAssignments(root);
+    size_t numShared = hashConsStatement(root, &eliminated);
+    for(; values.numEntries > 0; values.numEntries--)
+      values.buckets[values.entries[values.numEntries-1].hash & (values.numBuckets - 1)] = -1;
+    values.numScopes = 0;
+    if(numAssignments > 0)
+      symsetClear(&assigned);
+    if(numShared == 0)
+      continue;
+    int numTemps = placeTemporaries(root, numShared);
+    if(numTemps > 0){
+      statement->fields.children.middle = createNode(INTEGER, 0);
+      statement->fields.children.middle->fields.intVal = numTemps;
+    }
+  }
+  return eliminated;
+}
+
+/**
+ * isLeaf(astnode_t *node)
+ * Checks whether a node's fields hold a value rather than children
+ *
+ * param *node - the node
+ * return int - returns 1 for nodes without children, 0 otherwise
+ **/
+static int isLeaf(astnode_t *node){
+  return node->nodeType == INTEGER || node->nodeType == SYMBOL || node->nodeType == DATA
+    || node->nodeType == BREAK || node->nodeType == CONTINUE;
+}
+
+/**
+ * countNodes(astnode_t *root, int limit)
+ * Counts the nodes of a subtree (or chain of statements), with an explicit stack
+ *
+ * param *root - the subtree
+ * param limit - the count to stop at
+ * return int - returns the number of nodes, or more than limit if it has more
+ **/
+static int countNodes(astnode_t *root, int limit){
+  int count = 0;
+  size_t depth = 0;
+  growArray((void **) &funcStatements, &funcStatementsCap, 1, sizeof(astnode_t *));
+  funcStatements[depth++] = root;
+  while(depth > 0 && count <= limit){
+    astnode_t *node = funcStatements[--depth];
+    if(node == NULL)
+      continue;
+    count++;
+    if(isLeaf(node))
+      continue;
+    growArray((void **) &funcStatements, &funcStatementsCap, depth + 3, sizeof(astnode_t *));
+    funcStatements[depth++] = node->fields.children.left;
+    funcStatements[depth++] = node->fields.children.middle;
+    funcStatements[depth++] = node->fields.children.right;
+  }
+  return count;
+}
+
+/**
+ * addSubstitution(uint32_t symbol, astnode_t *value)
+ * Makes cloneTree() put a copy of a tree in place of each read of a symbol
+ *
+ * param symbol - the symbol
+ * param *value - the tree, a SYMBOL to rename the symbol
+ * return void
+ **/
+static void addSubstitution(uint32_t symbol, astnode_t *value){
+  growArray((void **) &substitutions, &substitutionsCap, numSubstitutions + 1, sizeof(substitution_t));
+  substitutions[numSubstitutions].symbol = symbol;
+  substitutions[numSubstitutions++].value = value;
+}
+
+/**
+ * cloneTree(astnode_t *root)
+ * Copies a subtree (or chain of statements), replacing each symbol given a substitution (see
+ * addSubstitution()) by a copy of its tree. The substitutions are cleared afterwards.
+ *
+ * param *root - the subtree
+ * return astnode_t* - returns the copy
+ **/
+static astnode_t *cloneTree(astnode_t *root){
+  astnode_t *copy = NULL;
+  size_t depth = 0;
+  size_t i;
+  growArray((void **) &clonePairs, &clonePairsCap, 1, sizeof(clonepair_t));
+  clonePairs[depth].node = root;
+  clonePairs[depth].substitute = 1;
+  clonePairs[depth++].copy = &copy;
+  while(depth > 0){
+    clonepair_t pair = clonePairs[--depth];
+    if(pair.node == NULL){
+      *pair.copy = NULL;
+      continue;
+    }
+    if(pair.substitute && pair.node->nodeType == SYMBOL){
+      for(i = 0; i < numSubstitutions && substitutions[i].symbol != pair.node->fields.symbol; i++);
+      if(i < numSubstitutions){
+        pair.node = substitutions[i].value;
+        pair.substitute = 0;
+      }
+    }
+    astnode_t *node = createNode(pair.node->nodeType, pair.node->lineNum);
+    node->fields = pair.node->fields;
+    node->profile = pair.node->profile;
+    node->file = pair.node->file;
+    *pair.copy = node;
+    if(isLeaf(node))
+      continue;
+    growArray((void **) &clonePairs, &clonePairsCap, depth + 3, sizeof(clonepair_t));
+    clonePairs[depth].node = node->fields.children.left;
+    clonePairs[depth].substitute = pair.substitute;
+    clonePairs[depth++].copy = &node->fields.children.left;
+    clonePairs[depth].node = node->fields.children.middle;
+    clonePairs[depth].substitute = pair.substitute;
+    clonePairs[depth++].copy = &node->fields.children.middle;
+    clonePairs[depth].node = node->fields.children.right;
+    clonePairs[depth].substitute = pair.substitute;
+    clonePairs[depth++].copy = &node->fields.children.right;
+  }
+  numSubstitutions = 0;
+  return copy;
+}
+
+/**
+ * alwaysTaken(astnode_t *chain)
+ * Makes an "if(1)" around a chain of statements, giving it a scope of its own
+ *
+ * param *chain - the first STATEMENT node of the chain
+ * return astnode_t* - returns the IF node
+ **/
+static astnode_t *alwaysTaken(astnode_t *chain){
+  astnode_t *ifNode = createNode(IF, 0);
+  ifNode->fields.children.left = createNode(INTEGER, 0);
+  ifNode->fields.children.left->fields.intVal = 1;
+  ifNode->fields.children.middle = chain;
+  return ifNode;
+}
+
+/**
+ * inSwitchBody(astnode_t *funcNode, astnode_t *statement)
+ * Checks whether a statement is directly in the body of a switch, where its case labels are
+ *
+ * param *funcNode - the FUNCTION node
+ * param *statement - the STATEMENT node
+ * return int - returns 1 if a switch body holds the statement, 0 otherwise
+ **/
+static int inSwitchBody(astnode_t *funcNode, astnode_t *statement){
+  size_t numStatements = collectStatements(funcNode, &funcStatements, &funcStatementsCap);
+  size_t i;
+  for(i = 0; i < numStatements; i++){
+    astnode_t *content = funcStatements[i]->fields.children.left;
+    if(content->nodeType != SWITCH)
+      continue;
+    astnode_t *node = content->fields.children.middle;
+    for(; node != NULL; node = node->fields.children.right)
+      if(node == statement)
+        return 1;
+  }
+  return 0;
+}
+
+/**
+ * constantValue(astnode_t *node, int64_t *value)
+ * Reads the value of an integer constant, possibly negated
+ *
+ * param *node - the expression
+ * param *value - filled with its value
+ * return int - returns 1 if the expression is a constant, 0 otherwise
+ **/
+static int constantValue(astnode_t *node, int64_t *value){
+  int negate = 0;
+  if(node->nodeType == UNARY_OP && node->fields.children.left->fields.strVal[0] == '-'){
+    negate = 1;
+    node = node->fields.children.right;
+  }
+  if(node->nodeType != INTEGER)
+    return 0;
+  *value = negate ? -(int64_t) node->fields.intVal : node->fields.intVal;
+  return 1;
+}
+
+/**
+ * tripCount(astnode_t *init, astnode_t *loopNode, uint32_t *symbol, int64_t value[2])
+ * Finds how many times a counted loop runs: one whose variable is set to a constant by the
+ * statement before it, compared to a constant by its condition, and stepped by a constant by
+ * its step, like "for(int i = 0; i < 8; i = i + 1)"
+ *
+ * param *init - the content of the statement before the loop
+ * param *loopNode - the WHILE node
+ * param *symbol - filled with the loop's variable
+ * param value - filled with the variable's value in the first iteration, and the step between iterations
+ * return int - returns the number of iterations, or -1 if it is not a counted loop running at most UNROLL_MAX_TRIPS times
+ **/
+static int tripCount(astnode_t *init, astnode_t *loopNode, uint32_t *symbol, int64_t value[2]){
+  astnode_t *cond = loopNode->fields.children.left;
+  astnode_t *step = loopNode->fields.children.right;
+  int64_t limit = 0;
+  if((init->nodeType != DECLARATION && init->nodeType != ASSIGNMENT) || init->fields.children.right == NULL
+     || !constantValue(init->fields.children.right, &value[0]))
+    return -1;
+  *symbol = init->fields.children.left->fields.symbol;
+  if(cond == NULL || cond->nodeType != BINARY_OP || cond->fields.children.left->nodeType != SYMBOL
+     || cond->fields.children.left->fields.symbol != *symbol || !constantValue(cond->fields.children.right, &limit))
+    return -1;
+  if(step == NULL || step->fields.children.right != NULL || step->fields.children.left->nodeType != ASSIGNMENT)
+    return -1;
+  astnode_t *stepValue = step->fields.children.left->fields.children.right;
+  if(step->fields.children.left->fields.children.left->fields.symbol != *symbol || stepValue->nodeType != BINARY_OP)
+    return -1;
+  char *stepOp = stepValue->fields.children.middle->fields.strVal;
+  astnode_t *stepLeft = stepValue->fields.children.left;
+  astnode_t *stepRight = stepValue->fields.children.right;
+  if(strcmp(stepOp, "+") == 0 && stepRight->nodeType == SYMBOL){
+    stepRight = stepLeft;
+    stepLeft = stepValue->fields.children.right;
+  }
+  else if(strcmp(stepOp, "+") != 0 && strcmp(stepOp, "-") != 0)
+    return -1;
+  if(stepLeft->nodeType != SYMBOL || stepLeft->fields.symbol != *symbol || !constantValue(stepRight, &value[1]))
+    return -1;
+  if(stepOp[0] == '-')
+    value[1] = -value[1];
+  char *condOp = cond->fields.children.middle->fields.strVal;
+  int trips = 0;
+  int64_t i;
+  for(i = value[0]; trips <= UNROLL_MAX_TRIPS; i += value[1], trips++){
+    if(i < INT32_MIN || i > INT32_MAX)
+      return -1;
+    int holds = 0;
+    if(strcmp(condOp, "<") == 0)
+      holds = i < limit;
+    else if(strcmp(condOp, "<=") == 0)
+      holds = i <= limit;
+    else if(strcmp(condOp, ">") == 0)
+      holds = i > limit;
+    else if(strcmp(condOp, ">=") == 0)
+      holds = i >= limit;
+    else if(strcmp(condOp, "!=") == 0)
+      holds = i != limit;
+    else
+      return -1;
+    if(!holds)
+      return trips;
+  }
+  return -1;
+}
+
+/**
+ * unrollLoop(astnode_t **link, astnode_t *init)
+ * Fully unrolls a counted loop, see tripCount(): the loop is replaced by a copy of its body for
+ * each iteration, with the loop's variable replaced by its value in that iteration, and a
+ * statement setting the variable to its final value. The body must not assign the variable,
+ * break or continue. A copy of a body declaring variables is wrapped in an "if(1)" block,
+ * keeping each copy's variables in a scope of their own.
+ *
+ * param **link - where the loop's STATEMENT node is
+ * param *init - the content of the statement before the loop
+ * return int - returns 1 if the loop was unrolled, 0 otherwise
+ **/
+static int unrollLoop(astnode_t **link, astnode_t *init){
+  astnode_t *statement = *link;
+  astnode_t *loopNode = statement->fields.children.left;
+  astnode_t *body = loopNode->fields.children.middle;
+  uint32_t symbol = NO_SYMBOL;
+  int64_t value[2];
+  int trips = tripCount(init, loopNode, &symbol, value);
+  //With a profile, loops that never ran are left alone and hot ones may grow more
+  int maxNodes = UNROLL_MAX_NODES;
+  uint64_t entries = 0;
+  if(profileCount(loopNode, COUNT_REACHED, &entries))
+    maxNodes = (entries == 0) ? 0 : profileHot(entries) ? UNROLL_MAX_NODES*PROFILE_HOT_SCALE : maxNodes;
+  if(trips < 0 || countNodes(body, maxNodes) * trips > maxNodes)
+    return 0;
+  int scoped = 0;
+  astnode_t *node = NULL;
+  for(node = body; node != NULL; node = node->fields.children.right)
+    scoped |= (node->fields.children.left->nodeType == DECLARATION);
+  //Anything that could change the loop's course, found with countNodes()'s stack
+  size_t depth = 0;
+  growArray((void **) &funcStatements, &funcStatementsCap, 1, sizeof(astnode_t *));
+  funcStatements[depth++] = body;
+  while(depth > 0){
+    node = funcStatements[--depth];
+    if(node == NULL)
+      continue;
+    if(node->nodeType == BREAK || node->nodeType == CONTINUE
+       || (node->nodeType == ASSIGNMENT && node->fields.children.left->fields.symbol == symbol))
+      return 0;
+    if(isLeaf(node))
+      continue;
+    growArray((void **) &funcStatements, &funcStatementsCap, depth + 3, sizeof(astnode_t *));
+    funcStatements[depth++] = node->fields.children.left;
+    funcStatements[depth++] = node->fields.children.middle;
+    funcStatements[depth++] = node->fields.children.right;
+  }
+  astnode_t *last = createNode(STATEMENT, 0);
+  last->fields.children.left = createNode(ASSIGNMENT, 0);
+  last->fields.children.left->fields.children.left = createNode(SYMBOL, 0);
+  last->fields.children.left->fields.children.left->fields.symbol = symbol;
+  last->fields.children.left->fields.children.right = createNode(INTEGER, 0);
+  last->fields.children.left->fields.children.right->fields.intVal = (int) (value[0] + trips*value[1]);
+  last->fields.children.right = statement->fields.children.right;
+  //Copies are made last to first, each put in front of the ones after it
+  while(trips-- > 0){
+    astnode_t *counter = createNode(INTEGER, 0);
+    counter->fields.intVal = (int) (value[0] + trips*value[1]);
+    addSubstitution(symbol, counter);
+    astnode_t *copy = cloneTree(body);
+    if(copy == NULL)
+      continue;
+    if(scoped){
+      astnode_t *block = createNode(STATEMENT, 0);
+      block->fields.children.left = alwaysTaken(copy);
+      copy = block;
+    }
+    for(node = copy; node->fields.children.right != NULL; node = node->fields.children.right);
+    node->fields.children.right = last;
+    last = copy;
+  }
+  *link = last;
+  return 1;
+}
+
+/**
+ * unrollChain(astnode_t **link, int *unrolled)
+ * Unrolls the counted loops of a chain of statements and the chains nested in it, see unrollLoop().
+ * The copies of an unrolled body are looked at in turn, so nested counted loops are unrolled too.
+ *
+ * param **link - where the chain starts
+ * param *unrolled - incremented by the number of loops unrolled
+ * return void
+ **/
+static void unrollChain(astnode_t **link, int *unrolled){
+  astnode_t *prev = NULL;
+  while(*link != NULL){
+    astnode_t *content = (*link)->fields.children.left;
+    if(content->nodeType == WHILE && prev != NULL && unrollLoop(link, prev->fields.children.left)){
+      (*unrolled)++;
+      continue;
+    }
+    if(hasNestedStatements(content)){
+      unrollChain(&content->fields.children.middle, unrolled);
+      unrollChain(&content->fields.children.right, unrolled);
+    }
+    prev = *link;
+    link = &(*link)->fields.children.right;
+  }
+}
+
+/**
+ * unrollLoops(astnode_t *funcNode)
+ * Fully unrolls the small counted loops of a function, see unrollLoop()
+ *
+ * param *funcNode - the FUNCTION node
+ * return int - returns the number of loops unrolled
+ **/
+int unrollLoops(astnode_t *funcNode){
+  int unrolled = 0;
+  unrollChain(&funcNode->fields.children.right, &unrolled);
+  return unrolled;
+}
+
+/**
+ * findInvariants(astnode_t **root, uint64_t *writes, size_t *numFound)
+ * Finds the largest loop invariant subexpressions of a statement in a loop, adding their slots
+ * to invariants: pure operators (division, which may trap, excepted) over constants and
+ * variables the loop does not write. Each is evaluated once before the loop even if the loop
+ * would not have evaluated it at all, which is safe as it has no effects.
+ *
+ * param **root - where the statement's content is
+ * param *writes - the variables the loop declares or assigns
+ * param *numFound - the number of slots in invariants, updated
+ * return void
+ **/
+static void findInvariants(astnode_t **root, uint64_t *writes, size_t *numFound){
+  size_t depth = 1;
+  growArray((void **) &licmFrames, &licmFramesCap, 1, sizeof(licmframe_t));
+  memset(&licmFrames[0], 0, sizeof(licmframe_t));
+  licmFrames[0].slot = root;
+  licmFrames[0].firstFound = *numFound;
+  while(depth > 0){
+    licmframe_t *frame = &licmFrames[depth-1];
+    astnode_t *node = *frame->slot;
+    astnode_t **slots[3];
+    int numSlots = evaluationOrder(node, slots);
+    if(frame->state == 0){
+      int index = -1;
+      switch(node->nodeType){
+      case SYMBOL:
+        index = variableIndex(&functionVars, node->fields.symbol);
+        frame->invariant = (index < 0 || !bitsetHas(writes, index));
+        break;
+      case BINARY_OP:
+        frame->invariant = strcmp(node->fields.children.middle->fields.strVal, "/") != 0
+          && strcmp(node->fields.children.middle->fields.strVal, "%") != 0;
+        break;
+      case INTEGER:
+      case UNARY_OP:
+      case TERNARY:
+        frame->invariant = 1;
+        break;
+      default:
+        frame->invariant = 0;
+        break;
+      }
+    }
+    if(frame->state < numSlots){
+      astnode_t **slot = slots[frame->state++];
+      growArray((void **) &licmFrames, &licmFramesCap, depth + 1, sizeof(licmframe_t));
+      licmframe_t *child = &licmFrames[depth++];
+      memset(child, 0, sizeof(licmframe_t));
+      child->slot = slot;
+      child->firstFound = *numFound;
+      continue;
+    }
+    depth--;
+    //An invariant operator replaces the invariant subexpressions found under it
+    if(frame->invariant && node->nodeType != INTEGER && node->nodeType != SYMBOL){
+      *numFound = frame->firstFound;
+      growArray((void **) &invariants, &invariantsCap, *numFound + 1, sizeof(astnode_t **));
+      invariants[(*numFound)++] = frame->slot;
+    }
+    if(depth > 0)
+      licmFrames[depth-1].invariant &= frame->invariant;
+  }
+}
+
+/**
+ * compareLoopSize(const void *a, const void *b)
+ * Orders loops from the largest to the smallest, so loops come before the loops nested in them
+ *
+ * param *a - a loop_t
+ * param *b - another loop_t
+ * return int - returns the qsort() comparison
+ **/
+static int compareLoopSize(const void *a, const void *b){
+  size_t sizeA = ((const loop_t *) a)->numBlocks;
+  size_t sizeB = ((const loop_t *) b)->numBlocks;
+  return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+/**
+ * hoistInvariants(astnode_t *funcNode)
+ * Loop invariant code motion over the natural loops of a function's CFG, see findLoops(). The
+ * largest invariant subexpressions of each loop, see findInvariants(), are computed into
+ * variables declared just before the loop, and the loop reads the variables instead. Outer
+ * loops go first, so an expression invariant in several nested loops leaves them all.
+ *
+ * param *funcNode - the FUNCTION node
+ * return int - returns the number of expressions hoisted
+ **/
+int hoistInvariants(astnode_t *funcNode){
+  cfg_t cfg;
+  looplist_t loops;
+  buildCFG(&cfg, funcNode);
+  findLoops(&cfg, &loops);
+  if(loops.numLoops == 0){
+    freeCFG(&cfg);
+    return 0;
+  }
+  numberVariables(&functionVars, funcNode);
+  qsort(loops.loops, loops.numLoops, sizeof(loop_t), compareLoopSize);
+  uint64_t *writes = (uint64_t *) calloc((functionVars.numVars + 63) / 64 + 1, sizeof(uint64_t));
+  if(writes == NULL){
+    fprintf(stderr, "Failed to allocate space for dataflow sets.\n");
+    exit(1);
+  }
+  int hoisted = 0;
+  size_t l, b, i;
+  for(l = 0; l < loops.numLoops; l++){
+    loop_t *loop = &loops.loops[l];
+    astnode_t *loopStatement = cfg.blocks[loop->header].loop;
+    if(loopStatement == NULL)
+      continue;
+    memset(writes, 0, ((functionVars.numVars + 63) / 64) * sizeof(uint64_t));
+    for(b = 0; b < loop->numBlocks; b++){
+      block_t *block = &cfg.blocks[loop->blocks[b]];
+      for(i = 0; i < block->numStatements; i++){
+        astnode_t *content = block->statements[i]->fields.children.left;
+        if(content->nodeType == DECLARATION){
+          int index = variableIndex(&functionVars, content->fields.children.left->fields.symbol);
+          if(index >= 0)
+            bitsetAdd(writes, index);
+        }
+        scanExpression(content, &functionVars, NULL, writes);
+      }
+    }
+    size_t numFound = 0;
+    for(b = 0; b < loop->numBlocks; b++){
+      block_t *block = &cfg.blocks[loop->blocks[b]];
+      for(i = 0; i < block->numStatements; i++)
+        findInvariants(&block->statements[i]->fields.children.left, writes, &numFound);
+    }
+    if(numFound == 0)
+      continue;
+    //The loop moves to a new STATEMENT node after the declarations, which take over its old one.
+    //A case label must not jump over declarations, so in a switch body they go in a block with the loop.
+    astnode_t *moved = createNode(STATEMENT, 0);
+    *moved = *loopStatement;
+    astnode_t *first = loopStatement;
+    if(inSwitchBody(funcNode, loopStatement)){
+      first = createNode(STATEMENT, 0);
+      moved->fields.children.right = NULL;
+      loopStatement->fields.children.left = alwaysTaken(first);
+    }
+    astnode_t *prev = first;
+    for(i = 0; i < numFound; i++){
+      char name[32];
+      int nameLen = snprintf(name, sizeof(name), "licm.%d", numHoisted++);
+      astnode_t *decl = createNode(DECLARATION, 0);
+      decl->fields.children.left = createNode(SYMBOL, 0);
+      decl->fields.children.left->fields.symbol = intern(name, nameLen);
+      decl->fields.children.right = *invariants[i];
+      *invariants[i] = createNode(SYMBOL, 0);
+      (*invariants[i])->fields.symbol = decl->fields.children.left->fields.symbol;
+      astnode_t *declStatement = (i == 0) ? first : createNode(STATEMENT, 0);
+      declStatement->fields.children.left = decl;
+      declStatement->fields.children.middle = NULL;
+      if(i > 0)
+        prev->fields.children.right = declStatement;
+      prev = declStatement;
+    }
+    prev->fields.children.right = moved;
+    hoisted += numFound;
+  }
+  free(writes);
+  freeLoops(&loops);
+  freeCFG(&cfg);
+  return hoisted;
+}
+
+/**
+ * sweepStatements(astnode_t **link)
+ * Unlinks the statements the optimizer emptied (left child NULL) from a chain of statements,
+ * and from the chains nested in it
+ *
+ * param **link - where the chain starts
+ * return void
+ **/
+static void sweepStatements(astnode_t **link){
+  while(*link != NULL){
+    astnode_t *content = (*link)->fields.children.left;
+    if(content == NULL){
+      *link = (*link)->fields.children.right;
+      continue;
+    }
+    if(hasNestedStatements(content)){
+      sweepStatements(&content->fields.children.middle);
+      sweepStatements(&content->fields.children.right);
+    }
+    link = &(*link)->fields.children.right;
+  }
+}
+
+/**
+ * isRemovable(astnode_t *content, varmap_t *vars)
+ * Checks whether a statement does nothing that outlives it: an expression without side effects,
+ * or an if or switch whose branches or body are empty and whose condition has none. Loops are
+ * kept, as they may never end, and so are case labels.
+ *
+ * param *content - the statement's content
+ * param *vars - the function's variables
+ * return int - returns 1 if the statement can be removed, 0 otherwise
+ **/
+static int isRemovable(astnode_t *content, varmap_t *vars){
+  if(content->nodeType == RETURN || content->nodeType == DECLARATION || content->nodeType == BREAK
+     || content->nodeType == CONTINUE || content->nodeType == WHILE || content->nodeType == DO_WHILE
+     || content->nodeType == CASE || content->nodeType == DEFAULT)
+    return 0;
+  if((content->nodeType == IF || content->nodeType == SWITCH)
+     && (content->fields.children.middle != NULL || content->fields.children.right != NULL))
+    return 0;
+  return !scanExpression(content, vars, NULL, NULL);
+}
+
+/**
+ * removeDeadAssignments(astnode_t **root, uint64_t *live, uint64_t *reads)
+ * Replaces the assignments nested in a statement by their values when their variable is neither
+ * read in the statement nor live after it
+ *
+ * param **root - where the statement's content is
+ * param *live - the variables live after the statement
+ * param *reads - the variables the statement reads
+ * return int - returns the number of assignments removed
+ **/
+static int removeDeadAssignments(astnode_t **root, uint64_t *live, uint64_t *reads){
+  int removed = 0;
+  size_t depth = 1;
+  growArray((void **) &slotStack, &slotStackCap, 1, sizeof(astnode_t **));
+  slotStack[0] = root;
+  while(depth > 0){
+    astnode_t **slot = slotStack[--depth];
+    astnode_t *node = *slot;
+    if(node == NULL)
+      continue;
+    if(node->nodeType == ASSIGNMENT){
+      int index = variableIndex(&functionVars, node->fields.children.left->fields.symbol);
+      if(index >= 0 && !bitsetHas(live, index) && !bitsetHas(reads, index)){
+        *slot = node->fields.children.right;
+        removed++;
+        slotStack[depth++] = slot;
+        continue;
+      }
+    }
+    astnode_t **slots[3];
+    int numSlots = evaluationOrder(node, slots);
+    growArray((void **) &slotStack, &slotStackCap, depth + numSlots, sizeof(astnode_t **));
+    while(numSlots > 0)
+      slotStack[depth++] = slots[--numSlots];
+  }
+  return removed;
+}
+
+/**
+ * removeDeadStores(astnode_t *statement, uint64_t *live, uint64_t *reads, int *deadStores)
+ * Removes the stores of a statement to variables not live after it. A dead top level assignment
+ * is replaced by its value, a dead initializer is dropped (or evaluated in a statement of its
+ * own before the declaration, if it has side effects), and nested dead assignments by their values.
+ *
+ * param *statement - the STATEMENT node
+ * param *live - the variables live after the statement
+ * param *reads - scratch bitset
+ * param *deadStores - incremented by the number of stores removed
+ * return int - returns 1 if the statement changed, 0 otherwise
+ **/
+static int removeDeadStores(astnode_t *statement, uint64_t *live, uint64_t *reads, int *deadStores){
+  astnode_t *content = statement->fields.children.left;
+  int removed = 0;
+  if(content->nodeType == ASSIGNMENT || content->nodeType == DECLARATION){
+    int index = variableIndex(&functionVars, content->fields.children.left->fields.symbol);
+    if(index >= 0 && !bitsetHas(live, index) && content->fields.children.right != NULL){
+      astnode_t *value = content->fields.children.right;
+      removed++;
+      if(content->nodeType == ASSIGNMENT)
+        statement->fields.children.left = value;
+      else{
+        content->fields.children.right = NULL;
+        if(scanExpression(value, &functionVars, NULL, NULL)){
+          astnode_t *declStatement = createNode(STATEMENT, 0);
+          declStatement->fields.children.left = content;
+          declStatement->fields.children.right = statement->fields.children.right;
+          statement->fields.children.right = declStatement;
+          statement->fields.children.left = value;
+        }
+      }
+    }
+  }
+  memset(reads, 0, ((functionVars.numVars + 63) / 64) * sizeof(uint64_t));
+  scanExpression(statement->fields.children.left, &functionVars, reads, NULL);
+  removed += removeDeadAssignments(&statement->fields.children.left, live, reads);
+  *deadStores += removed;
+  return removed > 0;
+}
+
+/**
+ * loopEntered(cfg_t *cfg, astnode_t *statement)
+ * Checks whether control gets to a loop's header block
+ *
+ * param *cfg - the function's CFG
+ * param *statement - the loop's STATEMENT node
+ * return int - returns 1 if the header is reachable, 0 otherwise
+ **/
+static int loopEntered(cfg_t *cfg, astnode_t *statement){
+  size_t b;
+  for(b = 0; b < cfg->numBlocks; b++)
+    if(cfg->blocks[b].loop == statement)
+      return cfg->blocks[b].reachable;
+  return 0;
+}
+
+/**
+ * eliminateDeadCode(astnode_t *funcNode, int *unreachable, int *deadStatements, int *deadStores)
+ * Dead code elimination over a function's CFG, driven by live variable analysis: removes
+ * statements no path from the entry reaches (those after a return), stores to variables that
+ * are not live, expression statements without side effects, and declarations of variables
+ * nothing refers to. Repeats until nothing changes, since each removal can make more code dead.
+ *
+ * param *funcNode - the FUNCTION node
+ * param *unreachable - incremented by the number of unreachable statements removed
+ * param *deadStatements - incremented by the number of other statements removed
+ * param *deadStores - incremented by the number of stores removed
+ * return void
+ **/
+void eliminateDeadCode(astnode_t *funcNode, int *unreachable, int *deadStatements, int *deadStores){
+  int changed = 1;
+  while(changed){
+    changed = 0;
+    cfg_t cfg;
+    dataflow_t flow;
+    buildCFG(&cfg, funcNode);
+    numberVariables(&functionVars, funcNode);
+    computeLiveness(&cfg, &functionVars, &flow);
+    uint64_t *live = (uint64_t *) calloc(flow.numWords + 1, sizeof(uint64_t));
+    uint64_t *reads = (uint64_t *) calloc(flow.numWords + 1, sizeof(uint64_t));
+    if(live == NULL || reads == NULL){
+      fprintf(stderr, "Failed to allocate space for dataflow sets.\n");
+      exit(1);
+    }
+    size_t b;
+    for(b = 0; b < cfg.numBlocks; b++){
+      block_t *block = &cfg.blocks[b];
+      size_t i = block->numStatements;
+      if(!block->reachable){
+        for(i = 0; i < block->numStatements; i++){
+          //A do-while's condition is unreachable when its body never finishes, but the body may run
+          if(block->statements[i]->fields.children.left->nodeType == DO_WHILE
+             && loopEntered(&cfg, block->statements[i]))
+            continue;
+          block->statements[i]->fields.children.left = NULL;
+          (*unreachable)++;
+          changed = 1;
+        }
+        continue;
+      }
+      memcpy(live, blockSet(flow.out, &flow, b), flow.numWords * sizeof(uint64_t));
+      while(i-- > 0){
+        astnode_t *statement = block->statements[i];
+        changed |= removeDeadStores(statement, live, reads, deadStores);
+        astnode_t *content = statement->fields.children.left;
+        if(isRemovable(content, &functionVars)){
+          statement->fields.children.left = NULL;
+          (*deadStatements)++;
+          changed = 1;
+          continue;
+        }
+        statementLiveness(statement, &functionVars, live);
+      }
+    }
+    free(live);
+    free(reads);
+    freeDataflow(&flow);
+    freeCFG(&cfg);
+    sweepStatements(&funcNode->fields.children.right);
+  }
+  //Declarations of variables no statement refers to any more
+  numberVariables(&functionVars, funcNode);
+  uint64_t *refs = (uint64_t *) calloc((functionVars.numVars + 63) / 64 + 1, sizeof(uint64_t));
+  if(refs == NULL){
+    fprintf(stderr, "Failed to allocate space for dataflow sets.\n");
+    exit(1);
+  }
+  size_t numStatements = collectStatements(funcNode, &funcStatements, &funcStatementsCap);
+  size_t i;
+  for(i = 0; i < numStatements; i++)
+    scanExpression(funcStatements[i]->fields.children.left, &functionVars, refs, refs);
+  for(i = 0; i < numStatements; i++){
+    astnode_t *statement = funcStatements[i];
+    astnode_t *decl = statement->fields.children.left;
+    if(decl->nodeType != DECLARATION
+       || bitsetHas(refs, variableIndex(&functionVars, decl->fields.children.left->fields.symbol)))
+      continue;
+    astnode_t *value = decl->fields.children.right;
+    statement->fields.children.left = (value != NULL && scanExpression(value, &functionVars, NULL, NULL)) ? value : NULL;
+    (*deadStores)++;
+  }
+  free(refs);
+  sweepStatements(&funcNode->fields.children.right);
+}
+
+/**
+ * countMatches(astnode_t *root, AST_TYPE nodeType, uint32_t symbol)
+ * Counts the nodes of a type in a subtree (or chain of statements): reads of a symbol for SYMBOL,
+ * assignments to it for ASSIGNMENT, and any node of the type when symbol is NO_SYMBOL
+ *
+ * param *root - the subtree
+ * param nodeType - the type of node to count
+ * param symbol - the symbol to match, or NO_SYMBOL
+ * return int - returns the number of matching nodes
+ **/
+static int countMatches(astnode_t *root, AST_TYPE nodeType, uint32_t symbol){
+  int count = 0;
+  size_t depth = 0;
+  growArray((void **) &funcStatements, &funcStatementsCap, 1, sizeof(astnode_t *));
+  funcStatements[depth++] = root;
+  while(depth > 0){
+    astnode_t *node = funcStatements[--depth];
+    if(node == NULL)
+      continue;
+    if(node->nodeType == nodeType){
+      if(symbol == NO_SYMBOL)
+        count++;
+      else if(nodeType == SYMBOL)
+        count += (node->fields.symbol == symbol);
+      else if(nodeType == ASSIGNMENT)
+        count += (node->fields.children.left->fields.symbol == symbol);
+    }
+    if(isLeaf(node))
+      continue;
+    growArray((void **) &funcStatements, &funcStatementsCap, depth + 3, sizeof(astnode_t *));
+    funcStatements[depth++] = node->fields.children.left;
+    funcStatements[depth++] = node->fields.children.middle;
+    funcStatements[depth++] = node->fields.children.right;
+  }
+  return count;
+}
+
+/**
+ * foldValue(astnode_t *node, int *value)
+ * Computes the value of an operator whose operands are constants, as the generated code would:
+ * wrapping around on overflow and masking shift counts to 5 bits. Divisions that trap are not folded.
+ *
+ * param *node - a UNARY_OP or BINARY_OP node
+ * param *value - filled with its value
+ * return int - returns 1 if the node was folded, 0 otherwise
+ **/
+static int foldValue(astnode_t *node, int *value){
+  if(node->nodeType == UNARY_OP){
+    if(node->fields.children.right->nodeType != INTEGER)
+      return 0;
+    uint32_t operand = (uint32_t) node->fields.children.right->fields.intVal;
+    char opType = node->fields.children.left->fields.strVal[0];
+    *value = (int) ((opType == '-') ? 0u - operand : (opType == '~') ? ~operand : (uint32_t) (operand == 0));
+    return 1;
+  }
+  astnode_t *left = node->fields.children.left;
+  astnode_t *right = node->fields.children.right;
+  char *opType = node->fields.children.middle->fields.strVal;
+  //A constant left operand of && or || may decide it alone
+  if(left->nodeType == INTEGER && ((strcmp(opType, "&&") == 0 && left->fields.intVal == 0)
+                                   || (strcmp(opType, "||") == 0 && left->fields.intVal != 0))){
+    *value = (opType[0] == '|');
+    return 1;
+  }
+  if(left->nodeType != INTEGER || right->nodeType != INTEGER)
+    return 0;
+  int32_t a = left->fields.intVal;
+  int32_t b = right->fields.intVal;
+  if((opType[0] == '/' || opType[0] == '%') && (b == 0 || (a == INT32_MIN && b == -1)))
+    return 0;
+  if(strcmp(opType, "+") == 0)
+    *value = (int) ((uint32_t) a + (uint32_t) b);
+  else if(strcmp(opType, "-") == 0)
+    *value = (int) ((uint32_t) a - (uint32_t) b);
+  else if(strcmp(opType, "*") == 0)
+    *value = (int) ((uint32_t) a * (uint32_t) b);
+  else if(strcmp(opType, "/") == 0)
+    *value = a / b;
+  else if(strcmp(opType, "%") == 0)
+    *value = a % b;
+  else if(strcmp(opType, "<<") == 0)
+    *value = (int) ((uint32_t) a << (b & 31));
+  else if(strcmp(opType, ">>") == 0)
+    *value = a >> (b & 31);
+  else if(strcmp(opType, "<") == 0)
+    *value = a < b;
+  else if(strcmp(opType, ">") == 0)
+    *value = a > b;
+  else if(strcmp(opType, "<=") == 0)
+    *value = a <= b;
+  else if(strcmp(opType, ">=") == 0)
+    *value = a >= b;
+  else if(strcmp(opType, "==") == 0)
+    *value = a == b;
+  else if(strcmp(opType, "!=") == 0)
+    *value = a != b;
+  else if(strcmp(opType, "&&") == 0)
+    *value = a != 0 && b != 0;
+  else if(strcmp(opType, "||") == 0)
+    *value = a != 0 || b != 0;
+  else if(strcmp(opType, "&") == 0)
+    *value = a & b;
+  else if(strcmp(opType, "|") == 0)
+    *value = a | b;
+  else if(strcmp(opType, "^") == 0)
+    *value = a ^ b;
+  else
+    return 0;
+  return 1;
+}
+
+/**
+ * foldTree(astnode_t **root)
+ * Constant folding of a statement or expression: operators whose operands are constants become
+ * INTEGER nodes, and a ?: with a constant condition the arm it selects. The slots are listed in
+ * preorder and folded last to first, so operands are folded before their operators and constants
+ * propagate up whole expressions.
+ *
+ * param **root - where the statement's content or the expression is
+ * return int - returns the number of nodes folded
+ **/
+static int foldTree(astnode_t **root){
+  int folded = 0;
+  size_t numSlots = 0;
+  size_t depth = 1;
+  growArray((void **) &slotStack, &slotStackCap, 1, sizeof(astnode_t **));
+  slotStack[0] = root;
+  while(depth > 0){
+    astnode_t **slot = slotStack[--depth];
+    growArray((void **) &foldSlots, &foldSlotsCap, numSlots + 1, sizeof(astnode_t **));
+    foldSlots[numSlots++] = slot;
+    astnode_t **slots[3];
+    int numChildren = evaluationOrder(*slot, slots);
+    growArray((void **) &slotStack, &slotStackCap, depth + numChildren, sizeof(astnode_t **));
+    while(numChildren > 0)
+      slotStack[depth++] = slots[--numChildren];
+  }
+  while(numSlots-- > 0){
+    astnode_t **slot = foldSlots[numSlots];
+    astnode_t *node = *slot;
+    int value = 0;
+    if(node->nodeType == TERNARY && node->fields.children.left->nodeType == INTEGER){
+      *slot = node->fields.children.left->fields.intVal ? node->fields.children.middle : node->fields.children.right;
+      folded++;
+    }
+    else if((node->nodeType == UNARY_OP || node->nodeType == BINARY_OP) && foldValue(node, &value)){
+      *slot = createNode(INTEGER, 0);
+      (*slot)->fields.intVal = value;
+      folded++;
+    }
+  }
+  return folded;
+}
+
+/**
+ * foldConstants(astnode_t *funcNode)
+ * Constant folding over every statement of a function, see foldTree()
+ *
+ * param *funcNode - the FUNCTION node
+ * return int - returns the number of nodes folded
+ **/
+int foldConstants(astnode_t *funcNode){
+  int folded = 0;
+  size_t numStatements = collectStatements(funcNode, &inlineStatements, &inlineStatementsCap);
+  size_t i;
+  for(i = 0; i < numStatements; i++)
+    folded += foldTree(&inlineStatements[i]->fields.children.left);
+  return folded;
+}
+
+/**
+ * foldExpression(astnode_t **expr)
+ * Constant folding of an expression on its own, as for the condition of an #if, see foldTree()
+ *
+ * param **expr - where the expression is
+ * return int - returns the number of nodes folded
+ **/
+int foldExpression(astnode_t **expr){
+  return foldTree(expr);
+}
+
+/**
+ * functionPosition(uint32_t symbol)
+ * Finds where a function is in the program, see inlineFunctions()
+ *
+ * param symbol - the function's name symbol ID
+ * return int - returns the function's position, or -1 if there is no such function
+ **/
+static int functionPosition(uint32_t symbol){
+  return (symbol < funcPositionsCap) ? funcPositions[symbol] : -1;
+}
+
+/**
+ * addInlined(inlinefunc_t *func, int callee)
+ * Records that a function's body was inlined into another, along with those inlined into it
+ *
+ * param *func - the function inlined into
+ * param callee - the position of the function inlined
+ * return void
+ **/
+static void addInlined(inlinefunc_t *func, int callee){
+  size_t i, j;
+  inlinefunc_t *calleeFunc = &inlineFuncs[callee];
+  for(j = 0; j <= calleeFunc->numInlined; j++){
+    int added = (j == calleeFunc->numInlined) ? callee : calleeFunc->inlined[j];
+    for(i = 0; i < func->numInlined && func->inlined[i] != added; i++);
+    if(i < func->numInlined)
+      continue;
+    growArray((void **) &func->inlined, &func->inlinedCap, func->numInlined + 1, sizeof(int));
+    func->inlined[func->numInlined++] = added;
+  }
+}
+
+/**
+ * findRecursion()
+ * Finds the functions that may call themselves, which are never inlined: those in a strongly
+ * connected component of the call graph with more than one function, or calling themselves.
+ * Tarjan's algorithm, with an explicit stack; it completes the components callees first, which
+ * is the order calls are inlined into the functions (inlineOrder), so a function is inlined
+ * with the calls in its own body already inlined.
+ *
+ * return void
+ **/
+static void findRecursion(){
+  size_t numOrdered = 0;
+  size_t depth = 0;
+  size_t sccDepth = 0;
+  int counter = 0;
+  size_t f;
+  growArray((void **) &inlineOrder, &inlineOrderCap, numInlineFuncs, sizeof(int));
+  for(f = 0; f < numInlineFuncs; f++){
+    if(inlineFuncs[f].order >= 0)
+      continue;
+    growArray((void **) &sccFrames, &sccFramesCap, depth + 1, sizeof(sccframe_t));
+    sccFrames[depth].func = f;
+    sccFrames[depth++].next = 0;
+    inlineFuncs[f].order = inlineFuncs[f].lowLink = counter++;
+    growArray((void **) &sccStack, &sccStackCap, sccDepth + 1, sizeof(int));
+    sccStack[sccDepth++] = f;
+    inlineFuncs[f].onStack = 1;
+    while(depth > 0){
+      sccframe_t *frame = &sccFrames[depth-1];
+      inlinefunc_t *func = &inlineFuncs[frame->func];
+      if(frame->next < func->numCallees){
+        int callee = func->callees[frame->next++];
+        inlinefunc_t *calleeFunc = &inlineFuncs[callee];
+        if(calleeFunc->order < 0){
+          calleeFunc->order = calleeFunc->lowLink = counter++;
+          growArray((void **) &sccStack, &sccStackCap, sccDepth + 1, sizeof(int));
+          sccStack[sccDepth++] = callee;
+          calleeFunc->onStack = 1;
+          growArray((void **) &sccFrames, &sccFramesCap, depth + 1, sizeof(sccframe_t));
+          sccFrames[depth].func = callee;
+          sccFrames[depth++].next = 0;
+        }
+        else if(calleeFunc->onStack && calleeFunc->order < func->lowLink)
+          func->lowLink = calleeFunc->order;
+        continue;
+      }
+      depth--;
+      if(depth > 0 && func->lowLink < inlineFuncs[sccFrames[depth-1].func].lowLink)
+        inlineFuncs[sccFrames[depth-1].func].lowLink = func->lowLink;
+      if(func->lowLink != func->order)
+        continue;
+      //The function is the root of a component, made of it and the functions above it on the stack
+      size_t first = sccDepth;
+      while(sccStack[--first] != frame->func);
+      size_t size = sccDepth - first;
+      for(; sccDepth > first; sccDepth--){
+        int member = sccStack[sccDepth-1];
+        inlineFuncs[member].onStack = 0;
+        inlineFuncs[member].recursive |= (size > 1);
+        inlineOrder[numOrdered++] = member;
+      }
+    }
+  }
+}
+
+/**
+ * isConstant(astnode_t *node)
+ * Checks whether an argument is an integer constant, possibly negated
+ *
+ * param *node - the argument's expression
+ * return int - returns 1 for constants, 0 otherwise
+ **/
+static int isConstant(astnode_t *node){
+  int64_t value;
+  return constantValue(node, &value);
+}
+
+/**
+ * bindArguments(astnode_t *callee, astnode_t *call, int inExpression)
+ * Decides how each parameter of an inlined function gets its argument: replaced by a copy of it
+ * (see addSubstitution()) or, failing that, declared in the inlined block. Constants can always
+ * replace a parameter the callee does not assign. Variables can too, unless an argument assigns
+ * one, since the callee cannot change the caller's variables; the arguments are evaluated last
+ * to first, and a later read could see a different value. In an expression, where nothing can
+ * be declared, an argument without effects can also replace a parameter read at most once.
+ *
+ * param *callee - the FUNCTION node of the inlined function
+ * param *call - the CALL node
+ * param inExpression - 1 if every parameter must be replaced
+ * return int - returns a bitmask of the parameters to declare, or -1 if the call cannot be inlined this way
+ **/
+static int bindArguments(astnode_t *callee, astnode_t *call, int inExpression){
+  int assigns = countMatches(call->fields.children.right, ASSIGNMENT, NO_SYMBOL) > 0;
+  int declared = 0;
+  int i = 0;
+  astnode_t *param = callee->fields.children.middle;
+  astnode_t *arg = call->fields.children.right;
+  for(; param != NULL; param = param->fields.children.right, arg = arg->fields.children.right, i++){
+    uint32_t symbol = param->fields.children.left->fields.symbol;
+    astnode_t *value = arg->fields.children.left;
+    int replace = 0;
+    if(i >= 31){
+      numSubstitutions = 0;
+      return -1;
+    }
+    if(countMatches(callee->fields.children.right, ASSIGNMENT, symbol) == 0){
+      if(isConstant(value))
+        replace = 1;
+      else if(!assigns && value->nodeType == SYMBOL)
+        replace = 1;
+      else if(!assigns && inExpression && countMatches(value, CALL, NO_SYMBOL) == 0
+              && countMatches(callee->fields.children.right, SYMBOL, symbol) <= 1)
+        replace = 1;
+    }
+    if(replace)
+      addSubstitution(symbol, value);
+    else if(inExpression){
+      numSubstitutions = 0;
+      return -1;
+    }
+    else
+      declared |= 1 << i;
+  }
+  return declared;
+}
+
+/**
+ * inlineStatement(inlinefunc_t *func, astnode_t *statement, astnode_t *callee, astnode_t *call)
+ * Inlines a call that is a whole statement, or all of the value it assigns, declares or returns.
+ * The statement becomes an "if(1)" block declaring the parameters that are not replaced by their
+ * arguments (last to first, the order arguments are evaluated in), then a copy of the callee's
+ * body, in which the callee's variables are renamed <name>.i<n> for the n-th call inlined into the
+ * function. Its final return becomes the assignment or declaration's store (a declaration is
+ * split from its value), or the value of an expression statement; a returned call keeps every
+ * return of the callee, which then return from the caller.
+ *
+ * param *func - the function inlined into
+ * param *statement - the STATEMENT node of the call
+ * param *callee - the FUNCTION node of the inlined function
+ * param *call - the CALL node
+ * return int - returns 1 if the call was inlined, 0 otherwise
+ **/
+static int inlineStatement(inlinefunc_t *func, astnode_t *statement, astnode_t *callee, astnode_t *call){
+  astnode_t *content = statement->fields.children.left;
+  astnode_t *body = callee->fields.children.right;
+  astnode_t *last = body;
+  for(; last != NULL && last->fields.children.right != NULL; last = last->fields.children.right);
+  int endsInReturn = (last != NULL && last->fields.children.left->nodeType == RETURN);
+  uint32_t target = NO_SYMBOL;
+  if(content->nodeType == ASSIGNMENT || content->nodeType == DECLARATION){
+    target = content->fields.children.left->fields.symbol;
+    if(content->nodeType == DECLARATION && countMatches(call, SYMBOL, target) > 0)
+      return 0;
+  }
+  //Anywhere but in a return, only a final return can leave the inlined body
+  if(content->nodeType != RETURN && countMatches(body, RETURN, NO_SYMBOL) > endsInReturn)
+    return 0;
+  int declared = bindArguments(callee, call, 0);
+  if(declared < 0)
+    return 0;
+  int site = func->numSites++;
+  char name[64];
+  size_t i;
+  astnode_t *param = NULL;
+  astnode_t *arg = NULL;
+  int p;
+  //Renamed parameters and variables
+  size_t numStatements = collectStatements(callee, &funcStatements, &funcStatementsCap);
+  for(param = callee->fields.children.middle, p = 0; param != NULL; param = param->fields.children.right, p++){
+    if(!(declared & (1 << p)))
+      continue;
+    uint32_t symbol = param->fields.children.left->fields.symbol;
+    astnode_t *renamed = createNode(SYMBOL, 0);
+    renamed->fields.symbol = intern(name, snprintf(name, sizeof(name), "%.40s.i%d", symbolName(symbol), site));
+    addSubstitution(symbol, renamed);
+  }
+  for(i = 0; i < numStatements; i++){
+    astnode_t *decl = funcStatements[i]->fields.children.left;
+    if(decl->nodeType != DECLARATION)
+      continue;
+    uint32_t symbol = decl->fields.children.left->fields.symbol;
+    astnode_t *renamed = createNode(SYMBOL, 0);
+    renamed->fields.symbol = intern(name, snprintf(name, sizeof(name), "%.40s.i%d", symbolName(symbol), site));
+    addSubstitution(symbol, renamed);
+  }
+  //The declared parameters, with their renamed symbols, which cloneTree() clears
+  astnode_t *chain = NULL;
+  for(param = callee->fields.children.middle, arg = call->fields.children.right, p = 0; param != NULL;
+      param = param->fields.children.right, arg = arg->fields.children.right, p++){
+    if(!(declared & (1 << p)))
+      continue;
+    astnode_t *declStatement = createNode(STATEMENT, 0);
+    declStatement->fields.children.left = createNode(DECLARATION, 0);
+    for(i = 0; substitutions[i].symbol != param->fields.children.left->fields.symbol; i++);
+    declStatement->fields.children.left->fields.children.left = substitutions[i].value;
+    declStatement->fields.children.left->fields.children.right = arg->fields.children.left;
+    declStatement->fields.children.right = chain;
+    chain = declStatement;
+  }
+  astnode_t *copy = cloneTree(body);
+  astnode_t **link = &chain;
+  for(; *link != NULL; link = &(*link)->fields.children.right);
+  *link = copy;
+  for(; *link != NULL && (*link)->fields.children.right != NULL; link = &(*link)->fields.children.right);
+  //The statement ending the copy: its final return, or where one goes
+  astnode_t *end = *link;
+  if(!endsInReturn){
+    end = createNode(STATEMENT, 0);
+    end->fields.children.left = createNode(RETURN, 0);
+    end->fields.children.left->fields.children.left = createNode(INTEGER, 0);
+    if(*link != NULL)
+      link = &(*link)->fields.children.right;
+    *link = end;
+  }
+  astnode_t *value = end->fields.children.left->fields.children.left;
+  if(target != NO_SYMBOL){
+    end->fields.children.left = createNode(ASSIGNMENT, 0);
+    end->fields.children.left->fields.children.left = createNode(SYMBOL, 0);
+    end->fields.children.left->fields.children.left->fields.symbol = target;
+    end->fields.children.left->fields.children.right = value;
+  }
+  else if(content->nodeType != RETURN){
+    if(endsInReturn)
+      end->fields.children.left = value;
+    else
+      *link = NULL;
+  }
+  if(content->nodeType == DECLARATION){
+    astnode_t *block = createNode(STATEMENT, 0);
+    block->fields.children.left = alwaysTaken(chain);
+    block->fields.children.right = statement->fields.children.right;
+    statement->fields.children.right = block;
+    content->fields.children.right = NULL;
+  }
+  else
+    statement->fields.children.left = alwaysTaken(chain);
+  return 1;
+}
+
+/**
+ * inlineCall(inlinefunc_t *func, astnode_t *statement, astnode_t **slot)
+ * Inlines a call if it is worth it, see the INLINE_ constants, and possible: a callee whose body
+ * is a single return is inlined in the expression, its parameters replaced by the arguments (see
+ * bindArguments()); other callees only when the call is a whole statement or all of the value it
+ * assigns, declares or returns, see inlineStatement(). Functions that may call themselves are never
+ * inlined.
+ *
+ * param *func - the function inlined into
+ * param *statement - the STATEMENT node of the call
+ * param **slot - where the CALL node is
+ * return int - returns 1 if the call was inlined, 0 otherwise
+ **/
+static int inlineCall(inlinefunc_t *func, astnode_t *statement, astnode_t **slot){
+  astnode_t *call = *slot;
+  int callee = functionPosition(call->fields.children.left->fields.symbol);
+  inlinefunc_t *calleeFunc = &inlineFuncs[callee];
+  if(calleeFunc->recursive || func->size > INLINE_MAX_FUNCTION_NODES)
+    return 0;
+  int benefit = INLINE_CALL_NODES;
+  astnode_t *arg = call->fields.children.right;
+  for(; arg != NULL; arg = arg->fields.children.right)
+    benefit += 1 + (isConstant(arg->fields.children.left) ? INLINE_CONSTANT_BONUS : 0);
+  //With a profile, calls that were never made only inline tiny leaves, and hot ones bigger callees
+  int threshold = inlineThreshold;
+  uint64_t calls = 0;
+  if(profileCount(call, COUNT_REACHED, &calls))
+    threshold = (calls == 0) ? 0 : profileHot(calls) ? inlineThreshold*PROFILE_HOT_SCALE : threshold;
+  if(calleeFunc->size - benefit > threshold && !(calleeFunc->leaf && calleeFunc->size <= INLINE_ALWAYS_NODES))
+    return 0;
+  astnode_t *body = calleeFunc->funcNode->fields.children.right;
+  astnode_t *content = statement->fields.children.left;
+  int inlined = 0;
+  if(body != NULL && body->fields.children.right == NULL && body->fields.children.left->nodeType == RETURN
+     && bindArguments(calleeFunc->funcNode, call, 1) == 0){
+    *slot = cloneTree(body->fields.children.left->fields.children.left);
+    //Folded right away, so the calls around it see its constants
+    if(optFlags & OPT_FOLD)
+      foldTree(slot);
+    inlined = 1;
+  }
+  else if(slot == &statement->fields.children.left
+          || ((content->nodeType == ASSIGNMENT || content->nodeType == DECLARATION) && slot == &content->fields.children.right)
+          || (content->nodeType == RETURN && slot == &content->fields.children.left))
+    inlined = inlineStatement(func, statement, calleeFunc->funcNode, call);
+  if(!inlined)
+    return 0;
+  func->size += calleeFunc->size;
+  addInlined(func, callee);
+  return 1;
+}
+
+/**
+ * inlineInto(inlinefunc_t *func)
+ * Inlines the calls of a function worth inlining, see inlineCall(). The calls of each statement
+ * are tried innermost first (in reverse preorder), so an argument may be inlined before its call.
+ * The function is gone over again while calls are inlined, for those in the inlined code.
+ *
+ * param *func - the function
+ * return int - returns the number of calls inlined
+ **/
+static int inlineInto(inlinefunc_t *func){
+  int inlined = 0;
+  int changed = 1;
+  while(changed){
+    changed = 0;
+    size_t numStatements = collectStatements(func->funcNode, &inlineStatements, &inlineStatementsCap);
+    size_t i;
+    for(i = 0; i < numStatements; i++){
+      astnode_t *statement = inlineStatements[i];
+      size_t numCalls = 0;
+      size_t depth = 1;
+      growArray((void **) &slotStack, &slotStackCap, 1, sizeof(astnode_t **));
+      slotStack[0] = &statement->fields.children.left;
+      while(depth > 0){
+        astnode_t **slot = slotStack[--depth];
+        if((*slot)->nodeType == CALL){
+          growArray((void **) &callSlots, &callSlotsCap, numCalls + 1, sizeof(astnode_t **));
+          callSlots[numCalls++] = slot;
+        }
+        astnode_t **slots[3];
+        int numSlots = evaluationOrder(*slot, slots);
+        growArray((void **) &slotStack, &slotStackCap, depth + numSlots, sizeof(astnode_t **));
+        while(numSlots > 0)
+          slotStack[depth++] = slots[--numSlots];
+      }
+      while(numCalls-- > 0){
+        if(inlineCall(func, statement, callSlots[numCalls])){
+          inlined++;
+          changed = 1;
+        }
+      }
+    }
+  }
+  return inlined;
+}
+
+/**
+ * inlineFunctions(astnode_t *root)
+ * Inlines calls across the whole program, before the other optimizations go over each function
+ * (constant folding first, so constant arguments propagate into the inlined code). Functions are
+ * processed callees first, see findRecursion(), each with the calls in its body already inlined.
+ *
+ * param *root - the first PROGRAM node of the program
+ * return int - returns the number of calls inlined
+ **/
+int inlineFunctions(astnode_t *root){
+  size_t f, i;
+  for(f = 0; f < numInlineFuncs; f++){
+    free(inlineFuncs[f].callees);
+    free(inlineFuncs[f].inlined);
+  }
+  numInlineFuncs = 0;
+  astnode_t *program = NULL;
+  for(program = root; program != NULL; program = program->fields.children.right){
+    uint32_t symbol = program->fields.children.left->fields.children.left->fields.symbol;
+    size_t oldCap = funcPositionsCap;
+    growArray((void **) &funcPositions, &funcPositionsCap, (size_t) symbol + 1, sizeof(int));
+    memset(&funcPositions[oldCap], 0xff, (funcPositionsCap - oldCap) * sizeof(int));
+    funcPositions[symbol] = numInlineFuncs;
+    growArray((void **) &inlineFuncs, &inlineFuncsCap, numInlineFuncs + 1, sizeof(inlinefunc_t));
+    inlinefunc_t *func = &inlineFuncs[numInlineFuncs++];
+    memset(func, 0, sizeof(inlinefunc_t));
+    func->funcNode = program->fields.children.left;
+    func->order = -1;
+  }
+  if(!(optFlags & OPT_INLINE))
+    return 0;
+  //The call graph, from the calls in each function's statements
+  for(f = 0; f < numInlineFuncs; f++){
+    inlinefunc_t *func = &inlineFuncs[f];
+    size_t depth = 1;
+    growArray((void **) &funcStatements, &funcStatementsCap, 1, sizeof(astnode_t *));
+    funcStatements[0] = func->funcNode->fields.children.right;
+    while(depth > 0){
+      astnode_t *node = funcStatements[--depth];
+      if(node == NULL)
+        continue;
+      if(node->nodeType == CALL){
+        int callee = functionPosition(node->fields.children.left->fields.symbol);
+        for(i = 0; i < func->numCallees && func->callees[i] != callee; i++);
+        if(i == func->numCallees){
+          growArray((void **) &func->callees, &func->calleesCap, func->numCallees + 1, sizeof(int));
+          func->callees[func->numCallees++] = callee;
+        }
+        func->recursive |= ((size_t) callee == f);
+      }
+      if(isLeaf(node))
+        continue;
+      growArray((void **) &funcStatements, &funcStatementsCap, depth + 3, sizeof(astnode_t *));
+      funcStatements[depth++] = node->fields.children.left;
+      funcStatements[depth++] = node->fields.children.middle;
+      funcStatements[depth++] = node->fields.children.right;
+    }
+  }
+  findRecursion();
+  int inlined = 0;
+  for(i = 0; i < numInlineFuncs; i++){
+    inlinefunc_t *func = &inlineFuncs[inlineOrder[i]];
+    func->size = countNodes(func->funcNode->fields.children.right, INT32_MAX - 1);
+    if(func->numCallees > 0)
+      inlined += inlineInto(func);
+    func->size = countNodes(func->funcNode->fields.children.right, INT32_MAX - 1);
+    func->leaf = countMatches(func->funcNode->fields.children.right, CALL, NO_SYMBOL) == 0;
+  }
+  return inlined;
+}
+
+/**
+ * inlinedCallees(size_t function, const int **callees)
+ * Lists the functions whose bodies inlineFunctions() inlined into a function, directly or not
+ *
+ * param function - the function's position in the program
+ * param **callees - set to the positions of the inlined functions
+ * return size_t - returns the number of functions inlined
+ **/
+size_t inlinedCallees(size_t function, const int **callees){
+  if(function >= numInlineFuncs)
+    return 0;
+  *callees = inlineFuncs[function].inlined;
+  return inlineFuncs[function].numInlined;
+}
+
+/**
+ * optimize(astnode_t *root)
+ * Inlines calls across the program, then runs the enabled optimizations over every function of it
+ *
+ * param *root - the PROGRAM node of the AST
+ * return void
+ **/
+void optimize(astnode_t *root){
+  int inlined = 0;
+  int folded = 0;
+  int unrolled = 0;
+  int hoisted = 0;
+  int eliminated = 0;
+  int unreachable = 0;
+  int deadStatements = 0;
+  int deadStores = 0;
+  astnode_t *program = NULL;
+  inlined = inlineFunctions(root);
+  for(program = root; program != NULL; program = program->fields.children.right){
+    astnode_t *funcNode = program->fields.children.left;
+    numHoisted = 0;
+    if(optFlags & OPT_FOLD)
+      folded += foldConstants(funcNode);
+    //Unrolled copies of a body have constants for the loop's variable
+    if(optFlags & OPT_UNROLL){
+      int funcUnrolled = unrollLoops(funcNode);
+      if(funcUnrolled > 0 && (optFlags & OPT_FOLD))
+        folded += foldConstants(funcNode);
+      unrolled += funcUnrolled;
+    }
+    if(optFlags & OPT_LICM)
+      hoisted += hoistInvariants(funcNode);
+    if(optFlags & OPT_DCE)
+      eliminateDeadCode(funcNode, &unreachable, &deadStatements, &deadStores);
+    if(optFlags & OPT_CSE)
+      eliminated += eliminateCommonSubexprs(funcNode);
+  }
+  if(verbose && (optFlags & OPT_INLINE))
+    fprintf(stderr, "Inline: inlined %d calls\n", inlined);
+  if(verbose && (optFlags & OPT_FOLD))
+    fprintf(stderr, "Fold: folded %d nodes\n", folded);
+  if(verbose && (optFlags & OPT_UNROLL))
+    fprintf(stderr, "Unroll: unrolled %d loops\n", unrolled);
+  if(verbose && (optFlags & OPT_LICM))
+    fprintf(stderr, "LICM: hoisted %d invariant expressions\n", hoisted);
+  if(verbose && (optFlags & OPT_DCE))
+    fprintf(stderr, "DCE: removed %d unreachable and %d dead statements, %d dead stores\n",
+            unreachable, deadStatements, deadStores);
+  if(verbose && (optFlags & OPT_CSE))
+    fprintf(stderr, "CSE: eliminated %d nodes\n", eliminated);
+}
@@ -0,0 +1,52 @@
+#ifndef OPT_H_
+#define OPT_H_
+
+#include "parse.h"
+
+//Optimizations, each on by default and turned off by its -fno-<name> option
+#define OPT_CSE 0x1
+#define OPT_DCE 0x2
+#define OPT_CMOV 0x4
+#define OPT_LICM 0x8
+#define OPT_UNROLL 0x10
+#define OPT_JUMP_TABLES 0x20
+#define OPT_INLINE 0x40
+#define OPT_FOLD 0x80
+#define OPT_OMIT_FRAME_POINTER 0x100
+#define OPT_TAIL_CALLS 0x200
+
+//Loops are only unrolled fully, when they run at most UNROLL_MAX_TRIPS times and the unrolled
+//body is at most UNROLL_MAX_NODES AST nodes
+#define UNROLL_MAX_TRIPS 16
+#define UNROLL_MAX_NODES 256
+
+//A call is inlined when the callee's AST nodes, less INLINE_CALL_NODES for the call itself, one for each
+//argument pushed and INLINE_CONSTANT_BONUS for each constant argument (which folding then propagates),
+//are at most inlineThreshold (--inline-threshold), and always when the callee calls nothing and has at
+//most INLINE_ALWAYS_NODES nodes. Nothing more is inlined into a function past INLINE_MAX_FUNCTION_NODES.
+#define DEFAULT_INLINE_THRESHOLD 40
+#define INLINE_ALWAYS_NODES 16
+#define INLINE_CALL_NODES 4
+#define INLINE_CONSTANT_BONUS 4
+#define INLINE_MAX_FUNCTION_NODES 4096
+
+typedef struct optflag_t {
+  const char *name;
+  unsigned int flag;
+} optflag_t;
+
+extern unsigned int optFlags;
+extern int inlineThreshold;
+
+int disableOptimization(const char *name);
+void optimize(astnode_t *root);
+int inlineFunctions(astnode_t *root);
+size_t inlinedCallees(size_t function, const int **callees);
+int foldConstants(astnode_t *funcNode);
+int foldExpression(astnode_t **expr);
+int eliminateCommonSubexprs(astnode_t *funcNode);
+int unrollLoops(astnode_t *funcNode);
+int hoistInvariants(astnode_t *funcNode);
+void eliminateDeadCode(astnode_t *funcNode, int *unreachable, int *deadStatements, int *deadStores);
+
+#endif // OPT_H_
@@ -2,587 +2,813 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+//Variables declared so far in the function being parsed, and the functions defined so far
+symset_t declared = {NULL, 0};
+symset_t definedFunctions = {NULL, 0};
+//Variables declared in the open scopes, innermost last, see enterScope()
+uint32_t *scopeVars = NULL;
+size_t numScopeVars = 0;
+size_t scopeVarsCap = 0;
+//Loops around the statement being parsed, for break and continue, and switches, for break
+int loopDepth = 0;
+int switchDepth = 0;
+//Case values of the switches being parsed, innermost last, with the line of each for errors
+int *caseValues = NULL;
+int *caseLines = NULL;
+size_t numCaseValues = 0;
+size_t caseValuesCap = 0;
+size_t caseLinesCap = 0;
+//FUNCTION node of each function of the program by name symbol, see indexFunctions()
+astnode_t **functionNodes = NULL;
+size_t functionNodesCap = 0;
+//Deepest nesting of parentheses, unary operators, assignments and calls within an expression
+int maxNesting = DEFAULT_MAX_NESTING;
+//File of the statement being parsed, given to the nodes made for it, see token_t
+uint32_t parseFile = NO_SYMBOL;
 
 /**
  * Backus Naur Grammar:
  *
- * <program> ::= <function>
- * <function> ::= "int" <id> "(" ")" "{" { <statement> } "}"
- * <statement> ::= "return" <exp> ";" | "int" <id> "=" [ <exp> ] ";" | <exp> ";"
- * <exp> ::= <id> "=" <exp> | <logical-or-exp>
- * <logical-or-exp> ::= <logical-and-exp> { "&&" <logical-and-exp> }
- * <logical-and-exp> ::= <equality-exp> { "&&" <equality-exp> }
+ * <program> ::= <function> { <function> }
+ * <function> ::= "int" <id> "(" [ "int" <id> { "," "int" <id> } ] ")" "{" { <statement> } "}"
+ * <statement> ::= "return" <exp> ";" | "int" <id> [ "=" <exp> ] ";"
+ *               | "if" "(" <exp> ")" <body> [ "else" <body> ]
+ *               | "while" "(" <exp> ")" <body> | "do" <body> "while" "(" <exp> ")" ";"
+ *               | "for" "(" [ <exp> ] ";" [ <exp> ] ";" [ <exp> ] ")" <body>
+ *               | "for" "(" "int" <id> [ "=" <exp> ] ";" [ <exp> ] ";" [ <exp> ] ")" <body>
+ *               | "switch" "(" <exp> ")" "{" { <case-label> | <statement> } "}"
+ *               | "{" { <statement> } "}" | "break" ";" | "continue" ";" | <exp> ";"
+ * <case-label> ::= "case" [ "-" ] <int> ":" | "default" ":"
+ * <body> ::= "{" { <statement> } "}" | <statement>
+ * <exp> ::= <id> "=" <exp> | <conditional-exp>
+ * <conditional-exp> ::= <logical-or-exp> [ "?" <exp> ":" <conditional-exp> ]
+ * <logical-or-exp> ::= <logical-and-exp> { "||" <logical-and-exp> }
+ * <logical-and-exp> ::= <bit-or-expr> { "&&" <bit-or-expr> }
+ * <bit-or-expr> ::= <bit-xor-expr> { "|" <bit-xor-expr> }
+ * <bit-xor-expr> ::= <bit-and-expr> { "^" <bit-and-expr> }
+ * <bit-and-expr> ::= <equality-exp> { "&" <equality-exp> }
  * <equality-exp> ::= <relational-exp> { ("!=" | "==") <relational-exp> }
- * <relational-exp> ::= <bit-or-expr> { ("<" | ">" | "<=" | ">=") <bit-or-exp> }
- * <bit-or-expr> ::= <bit-xor-expr> { "^" <bit-xor-expr }
- * <bit-xor-expr> ::= <bit-and-expr> { "|" <bit-and-expr }
- * <bit-and-expr> ::= <shift-expr> { "&" <shift-expr }
- * <shift-expr> ::= <additive-expr> { ("<<" | ">>") <additive-expr}
+ * <relational-exp> ::= <shift-expr> { ("<" | ">" | "<=" | ">=") <shift-expr> }
+ * <shift-expr> ::= <additive-exp> { ("<<" | ">>") <additive-exp> }
  * <additive-exp> ::= <term> { ("+" | "-") <term> }
  * <term> ::= <factor> { ("*" | "/" | "%") <factor> }
- * <factor> ::= "(" <exp> ")" | <unary_op> <factor> | <int> | <id>
+ * <factor> ::= "(" <exp> ")" | <unary_op> <factor> | <int> | <id> | <id> "(" [ <exp> { "," <exp> } ] ")"
  * <unary_op> ::= "!" | "~" | "-"
+ *
+ * Everything from <exp> down is parsed by parseExpression() with operator precedence.
  **/
 /**
- * parseLogicalAndExp(tokenlist_t *tokens)
- * Parses an equality expression, returning an expression-type AST node
- *
- * <logical-and-expr> ::= <equality-expr> { "&&" <equality-expr> }
+ * createNode(AST_TYPE nodeType, int lineNum)
+ * Allocates an AST node of the given type with empty children
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param nodeType - the type of the new node
+ * param lineNum - the source line the node came from, for the allocation error
+ * return astnode_t* - returns the new AST node
  **/
-astnode_t *parseLogicalOrExp(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+astnode_t *createNode(AST_TYPE nodeType, int lineNum){
+  astnode_t *node = (astnode_t *) calloc(1, sizeof(astnode_t));
+  if(node == NULL){
+    fprintf(stderr, "Error on line %d: Failed to allocate space for %s node.\n", lineNum, astTypeName(nodeType));
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseLogicalAndExp(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == AND_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseLogicalAndExp(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+  node->nodeType = nodeType;
+  node->lineNum = lineNum;
+  node->file = parseFile;
+  return node;
 }
 
 /**
- * parseBitOrExpr(tokenlist_t *tokens)
- * Parses a bitwise-xor expression, returning an expression-type AST node
+ * createSymbolNode(token_t *token)
+ * Creates a SYMBOL node for an identifier token
  *
- * <bit-or-expr> ::= <bit-xor-expr> { "^" <bit-xor-expr }
+ * param *token - the identifier token
+ * return astnode_t* - returns the new SYMBOL node
+ **/
+astnode_t *createSymbolNode(token_t *token){
+  astnode_t *node = createNode(SYMBOL, token->lineNum);
+  node->fields.symbol = token->symbol;
+  return node;
+}
+
+/**
+ * symsetHas(symset_t *set, uint32_t symbol)
+ * Checks if a symbol is in a set
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param *set - the set to check
+ * param symbol - the symbol ID to look for
+ * return int - returns 1 if the symbol is in the set, 0 otherwise
  **/
-astnode_t *parseBitXorExpr(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
-    exit(1);
-  }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseBitAndExpr(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == BIT_XOR){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on Line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseBitAndExpr(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+int symsetHas(symset_t *set, uint32_t symbol){
+  return symbol < set->cap && set->marks[symbol];
 }
 
 /**
- * parseBitOrExpr(tokenlist_t *tokens)
- * Parses a bitwise-or expression, returning an expression-type AST node
+ * symsetAdd(symset_t *set, uint32_t symbol)
+ * Adds a symbol to a set, growing it to cover the symbol ID
  *
- * <bit-or-expr> ::= <bit-xor-expr> { "^" <bit-xor-expr }
+ * param *set - the set to add to
+ * param symbol - the symbol ID to add
+ * return void
+ **/
+void symsetAdd(symset_t *set, uint32_t symbol){
+  growArray((void **) &set->marks, &set->cap, (size_t) symbol + 1, 1);
+  set->marks[symbol] = 1;
+}
+
+/**
+ * symsetRemove(symset_t *set, uint32_t symbol)
+ * Removes a symbol from a set
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param *set - the set to remove from
+ * param symbol - the symbol ID to remove
+ * return void
  **/
-astnode_t *parseBitOrExpr(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
-    exit(1);
-  }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseBitXorExpr(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == BIT_OR){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseBitXorExpr(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+void symsetRemove(symset_t *set, uint32_t symbol){
+  if(symbol < set->cap)
+    set->marks[symbol] = 0;
 }
 
 /**
- * parseBitAndExpr(tokenlist_t *tokens)
- * Parses a bitwise-and expression, returning an expression-type AST node
+ * symsetClear(symset_t *set)
+ * Removes every symbol from a set, keeping its space
  *
- * <bit-and-expr> ::= <shift-expr> { "&" <shift-expr }
+ * param *set - the set to clear
+ * return void
+ **/
+void symsetClear(symset_t *set){
+  if(set->marks != NULL)
+    memset(set->marks, 0, set->cap);
+}
+
+/**
+ * growArray(void **array, size_t *cap, size_t need, size_t elemSize)
+ * Grows a malloc'd array by doubling until it holds at least need elements. The new elements are
+ * zeroed, so tables indexed by symbol ID read 0 for symbols never set.
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param **array - the array to grow
+ * param *cap - the array's capacity in elements
+ * param need - the number of elements needed
+ * param elemSize - the size of an element
+ * return void
  **/
-astnode_t *parseBitAndExpr(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+void growArray(void **array, size_t *cap, size_t need, size_t elemSize){
+  if(need <= *cap)
+    return;
+  size_t newCap = (*cap == 0) ? 64 : *cap;
+  while(newCap < need)
+    newCap *= 2;
+  *array = realloc(*array, newCap * elemSize);
+  if(*array == NULL){
+    fprintf(stderr, "Failed to allocate space for a growable array.\n");
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseShiftExpr(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == BIT_AND){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseShiftExpr(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+  memset((char *) *array + *cap * elemSize, 0, (newCap - *cap) * elemSize);
+  *cap = newCap;
 }
 
 /**
- * parseLogicalAndExp(tokenlist_t *tokens)
- * Parses an equality expression, returning an expression-type AST node
+ * isDeclared(uint32_t symbol)
+ * Checks if a variable has been declared in the function being parsed
  *
- * <logical-and-expr> ::= <equality-expr> { "&&" <equality-expr> }
+ * param symbol - the variable's symbol ID
+ * return int - returns 1 if the variable is declared, 0 otherwise
+ **/
+int isDeclared(uint32_t symbol){
+  return symsetHas(&declared, symbol);
+}
+
+/**
+ * declareVariable(uint32_t symbol, int lineNum)
+ * Records a variable as declared in the function being parsed, raising an error on redeclaration
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param symbol - the variable's symbol ID
+ * param lineNum - the line of the declaration
+ * return void
  **/
-astnode_t *parseLogicalAndExp(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+void declareVariable(uint32_t symbol, int lineNum){
+  if(isDeclared(symbol)){
+    fprintf(stderr, "Error on line %d: Redeclaration of variable %s.\n", lineNum, symbolName(symbol));
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseBitOrExpr(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == AND_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseBitOrExpr(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+  symsetAdd(&declared, symbol);
+  growArray((void **) &scopeVars, &scopeVarsCap, numScopeVars + 1, sizeof(uint32_t));
+  scopeVars[numScopeVars++] = symbol;
 }
 
 /**
- * parseEqualityExp(tokenlist_t *tokens)
- * Parses an equality expression, returning an expression-type AST node
+ * enterScope()
+ * Opens a block scope; variables declared in it go out of scope when it is left
  *
- * <equality-expr> ::= <relational-expr> { ("!=" | "==" ) <relational-expr> }
+ * return size_t - returns the scope's mark, for leaveScope()
+ **/
+size_t enterScope(){
+  return numScopeVars;
+}
+
+/**
+ * leaveScope(size_t mark)
+ * Closes a block scope, undeclaring the variables declared in it. Inner scopes cannot
+ * shadow the variables of the scopes around them, so nothing needs to be restored.
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param mark - the scope's mark, from enterScope()
+ * return void
  **/
-astnode_t *parseEqualityExp(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+void leaveScope(size_t mark){
+  while(numScopeVars > mark)
+    symsetRemove(&declared, scopeVars[--numScopeVars]);
+}
+
+/**
+ * defineFunction(uint32_t symbol, int lineNum)
+ * Records a function as defined in the program, raising an error on redefinition
+ *
+ * param symbol - the function's name symbol ID
+ * param lineNum - the line the function starts on
+ * return void
+ **/
+void defineFunction(uint32_t symbol, int lineNum){
+  if(symsetHas(&definedFunctions, symbol)){
+    fprintf(stderr, "Error on line %d: Redefinition of function %s.\n", lineNum, symbolName(symbol));
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseRelationalExp(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == NEQ_TO || currToken->type == EQ_TO){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseRelationalExp(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
-  }
-  return exprNode;
+  symsetAdd(&definedFunctions, symbol);
 }
 
 /**
- * parseShiftExpr(tokenlist_t *tokens)
- * Parses a bit-shift expression, returning an expression-type AST node
+ * forgetFunctions()
+ * Forgets the functions defined so far, before parsing the next source file of a batch
  *
- * <relational-expr> ::= <additive-expr> { ("<" | ">" | "<=" | ">=") <additive-expr> }
+ * return void
+ **/
+void forgetFunctions(){
+  symsetClear(&definedFunctions);
+}
+
+/**
+ * binaryPrecedence(TOKEN_TYPE type)
+ * Returns how tightly a binary operator token binds, following C
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param type - the token type of the operator
+ * return int - returns the operator's precedence, higher binds tighter, 0 if not a binary operator
  **/
-astnode_t *parseShiftExpr(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
-    exit(1);
+int binaryPrecedence(TOKEN_TYPE type){
+  switch(type){
+  case OR_OP:
+    return 1;
+  case AND_OP:
+    return 2;
+  case BIT_OR:
+    return 3;
+  case BIT_XOR:
+    return 4;
+  case BIT_AND:
+    return 5;
+  case EQ_TO:
+  case NEQ_TO:
+    return 6;
+  case LT_OP:
+  case GT_OP:
+  case LE_OP:
+  case GE_OP:
+    return 7;
+  case SHIFT_LEFT:
+  case SHIFT_RIGHT:
+    return 8;
+  case ADD_OP:
+  case NEGATION:
+    return 9;
+  case MULT_OP:
+  case DIV_OP:
+  case MOD_OP:
+    return 10;
+  default:
+    return 0;
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseAdditiveExp(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == LT_OP || currToken->type == GT_OP || currToken->type == LE_OP || currToken->type == GE_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseAdditiveExp(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
+}
+
+/**
+ * pushPending(exprstack_t *stack, EXPR_OP kind, token_t *token)
+ * Pushes an operator whose operands are still being parsed onto the operator stack
+ *
+ * param *stack - the expression parser's stacks
+ * param kind - what the pending operator is
+ * param *token - the operator's token
+ * return pendingop_t* - returns the pushed operator
+ **/
+pendingop_t *pushPending(exprstack_t *stack, EXPR_OP kind, token_t *token){
+  if(kind != PENDING_BINARY && ++stack->nesting > maxNesting){
+    fprintf(stderr, "Error on line %d: Expression nested deeper than %d levels (see --max-nesting).\n", token->lineNum, maxNesting);
+    exit(1);
   }
-  return exprNode;
+  growArray((void **) &stack->ops, &stack->opsCap, stack->numOps + 1, sizeof(pendingop_t));
+  pendingop_t *pending = &stack->ops[stack->numOps++];
+  pending->kind = kind;
+  pending->type = token->type;
+  pending->value = token->value;
+  pending->lineNum = token->lineNum;
+  pending->symbol = token->symbol;
+  return pending;
 }
 
 /**
- * parseRelationalExp(tokenlist_t *tokens)
- * Parses a relational expression, returning an expression-type AST node
+ * pushOperand(exprstack_t *stack, astnode_t *node)
+ * Pushes a finished subexpression onto the operand stack
  *
- * <relational-expr> ::= <additive-expr> { ("<" | ">" | "<=" | ">=") <additive-expr> }
+ * param *stack - the expression parser's stacks
+ * param *node - the subexpression
+ * return void
+ **/
+void pushOperand(exprstack_t *stack, astnode_t *node){
+  growArray((void **) &stack->operands, &stack->operandsCap, stack->numOperands + 1, sizeof(astnode_t *));
+  stack->operands[stack->numOperands++] = node;
+}
+
+/**
+ * reducePending(exprstack_t *stack)
+ * Pops the top pending operator and combines it with its operands into an AST node
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * param *stack - the expression parser's stacks
+ * return void
  **/
-astnode_t *parseRelationalExp(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+void reducePending(exprstack_t *stack){
+  pendingop_t *pending = &stack->ops[--stack->numOps];
+  astnode_t *opNode = NULL;
+  astnode_t *exprNode = NULL;
+  if(pending->kind == PENDING_ELSE){
+    exprNode = createNode(TERNARY, pending->lineNum);
+    exprNode->fields.children.right = stack->operands[--stack->numOperands];
+    exprNode->fields.children.middle = stack->operands[--stack->numOperands];
+    exprNode->fields.children.left = stack->operands[--stack->numOperands];
+    stack->nesting--;
+  }
+  else if(pending->kind == PENDING_COND){
+    fprintf(stderr, "Error on line %d: Missing : in conditional expression.\n", pending->lineNum);
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseShiftExpr(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == LT_OP || currToken->type == GT_OP || currToken->type == LE_OP || currToken->type == GE_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
+  //The arguments are the operands pushed since the call's '(', chained first to last
+  else if(pending->kind == PENDING_CALL){
+    exprNode = createNode(CALL, pending->lineNum);
+    exprNode->fields.children.left = createNode(SYMBOL, pending->lineNum);
+    exprNode->fields.children.left->fields.symbol = pending->symbol;
+    while(stack->numOperands > pending->firstOperand){
+      astnode_t *argNode = createNode(ARGUMENT, pending->lineNum);
+      argNode->fields.children.left = stack->operands[--stack->numOperands];
+      argNode->fields.children.right = exprNode->fields.children.right;
+      exprNode->fields.children.right = argNode;
     }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseShiftExpr(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
+    stack->nesting--;
+  }
+  else if(pending->kind == PENDING_ASSIGN){
+    exprNode = createNode(ASSIGNMENT, pending->lineNum);
+    exprNode->fields.children.left = createNode(SYMBOL, pending->lineNum);
+    exprNode->fields.children.left->fields.symbol = pending->symbol;
+    exprNode->fields.children.right = stack->operands[--stack->numOperands];
+    stack->nesting--;
+  }
+  else{
+    opNode = createNode(DATA, pending->lineNum);
+    opNode->fields.strVal = pending->value;
+    if(pending->kind == PENDING_UNARY){
+      exprNode = createNode(UNARY_OP, pending->lineNum);
+      exprNode->fields.children.left = opNode;
+      exprNode->fields.children.right = stack->operands[--stack->numOperands];
+      stack->nesting--;
+    }
+    else{
+      exprNode = createNode(BINARY_OP, pending->lineNum);
+      exprNode->fields.children.middle = opNode;
+      exprNode->fields.children.right = stack->operands[--stack->numOperands];
+      exprNode->fields.children.left = stack->operands[--stack->numOperands];
     }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
   }
-  return exprNode;
+  pushOperand(stack, exprNode);
 }
 
 /**
- * parseAdditiveExp(tokenlist_t *tokens)
- * Parses an additive expression, returning an expression-type AST node
+ * parseExpression(tokenlist_t *tokens)
+ * Parses an expression, returning an expression-type AST node. Operators are matched by
+ * precedence on explicit operand/operator stacks rather than by recursive descent, so nesting
+ * depth costs heap instead of C stack; it is capped at maxNesting parentheses, unary operators,
+ * assignments and calls. Two tokens of lookahead tell an assignment apart from an expression
+ * starting with a variable. The conditional operator binds loosest and groups to the right: a
+ * pending "?" is a barrier like an open parenthesis until its ":" arrives. A call is a barrier
+ * too, until its ")"; each "," before it completes an argument.
  *
- * <additive-expr> ::= <term> { ( "+" | - ) <term> }
+ * <exp> ::= <id> "=" <exp> | <conditional-exp>
+ * <conditional-exp> ::= <logical-or-exp> [ "?" <exp> ":" <conditional-exp> ]
  *
  * param *tokens - the token list to parse the expression from
  * return astnode_t* - returns an expression AST node
  **/
-astnode_t *parseAdditiveExp(tokenlist_t *tokens){
+astnode_t *parseExpression(tokenlist_t *tokens){
   if(tokens == NULL){
     fprintf(stderr, "Cannot parse expression, null token list.\n");
     exit(1);
   }
+  exprstack_t stack = {0};
+  int expectOperand = 1;
+  //Assignments may only start an <exp>, i.e. the whole expression or a parenthesized one
+  int expStart = 1;
   token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseTerm(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == ADD_OP || currToken->type == NEGATION){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
+  for(;;){
+    currToken = peek(tokens);
+    if(expectOperand){
+      popToken(tokens);
+      if(currToken->type == IDENTIFIER && expStart && peekN(tokens, 0)->type == ASSIGN){
+        if(!isDeclared(currToken->symbol)){
+          fprintf(stderr, "Error on line %d: Assignment to undeclared variable %s.\n", currToken->lineNum, currToken->value);
+          exit(1);
+        }
+        pushPending(&stack, PENDING_ASSIGN, currToken);
+        popToken(tokens);
+        continue;
+      }
+      expStart = 0;
+      if(currToken->type == OPEN_PAREN){
+        pushPending(&stack, PENDING_PAREN, currToken);
+        expStart = 1;
+      }
+      else if(currToken->type == NEGATION || currToken->type == BITWISE_COMP || currToken->type == LOGIC_NEG)
+        pushPending(&stack, PENDING_UNARY, currToken);
+      //Calls are checked against the functions of the whole program once it is parsed, see checkCalls()
+      else if(currToken->type == IDENTIFIER && peekN(tokens, 0)->type == OPEN_PAREN){
+        pushPending(&stack, PENDING_CALL, currToken)->firstOperand = stack.numOperands;
+        popToken(tokens);
+        if(peek(tokens)->type == CLOSED_PAREN){
+          popToken(tokens);
+          reducePending(&stack);
+          expectOperand = 0;
+        }
+        else
+          expStart = 1;
+      }
+      else if(currToken->type == INT_LITERAL){
+        astnode_t *intNode = createNode(INTEGER, currToken->lineNum);
+        intNode->fields.intVal = atoi(currToken->value);
+        pushOperand(&stack, intNode);
+        expectOperand = 0;
+      }
+      else if(currToken->type == IDENTIFIER){
+        if(!isDeclared(currToken->symbol)){
+          fprintf(stderr, "Error on line %d: Variable %s used before its declaration.\n", currToken->lineNum, currToken->value);
+          exit(1);
+        }
+        pushOperand(&stack, createSymbolNode(currToken));
+        expectOperand = 0;
+      }
+      else if(currToken->type == END_OF_INPUT){
+        fprintf(stderr, "Error on line %d: Empty factor, invalid format.\n", currToken->lineNum);
+        exit(1);
+      }
+      else{
+        fprintf(stderr, "Error on line %d: Invalid factor.\n", currToken->lineNum);
+        exit(1);
+      }
+      continue;
+    }
+    int precedence = binaryPrecedence(currToken->type);
+    if(precedence > 0){
+      //Everything binding at least as tightly is complete, operators are left associative
+      while(stack.numOps > 0){
+        pendingop_t *top = &stack.ops[stack.numOps-1];
+        if(top->kind == PENDING_UNARY || (top->kind == PENDING_BINARY && binaryPrecedence(top->type) >= precedence))
+          reducePending(&stack);
+        else
+          break;
+      }
+      pushPending(&stack, PENDING_BINARY, popToken(tokens));
+      expectOperand = 1;
+      continue;
+    }
+    if(currToken->type == QUESTION){
+      while(stack.numOps > 0 && (stack.ops[stack.numOps-1].kind == PENDING_UNARY
+                                 || stack.ops[stack.numOps-1].kind == PENDING_BINARY))
+        reducePending(&stack);
+      pushPending(&stack, PENDING_COND, popToken(tokens));
+      expectOperand = 1;
+      expStart = 1;
+      continue;
+    }
+    //A ':' completes the then operand of the innermost pending '?', if there is one
+    if(currToken->type == COLON){
+      while(stack.numOps > 0 && stack.ops[stack.numOps-1].kind != PENDING_PAREN
+            && stack.ops[stack.numOps-1].kind != PENDING_COND && stack.ops[stack.numOps-1].kind != PENDING_CALL)
+        reducePending(&stack);
+      if(stack.numOps > 0 && stack.ops[stack.numOps-1].kind == PENDING_COND){
+        popToken(tokens);
+        stack.ops[stack.numOps-1].kind = PENDING_ELSE;
+        expectOperand = 1;
+        continue;
+      }
+    }
+    //A ',' completes an argument of the innermost pending call, if there is one
+    if(currToken->type == COMMA){
+      while(stack.numOps > 0 && stack.ops[stack.numOps-1].kind != PENDING_PAREN
+            && stack.ops[stack.numOps-1].kind != PENDING_COND && stack.ops[stack.numOps-1].kind != PENDING_CALL)
+        reducePending(&stack);
+      if(stack.numOps > 0 && stack.ops[stack.numOps-1].kind == PENDING_CALL){
+        popToken(tokens);
+        expectOperand = 1;
+        expStart = 1;
+        continue;
+      }
+    }
+    //Anything else ends the innermost open parenthesis or call, or the whole expression
+    while(stack.numOps > 0 && stack.ops[stack.numOps-1].kind != PENDING_PAREN
+          && stack.ops[stack.numOps-1].kind != PENDING_CALL)
+      reducePending(&stack);
+    if(stack.numOps == 0)
+      break;
+    pendingop_t *open = &stack.ops[stack.numOps-1];
+    if(currToken->type != CLOSED_PAREN && open->kind == PENDING_CALL){
+      fprintf(stderr, "Error on line %d: Missing closed parenthese in call to %s.\n", currToken->lineNum, open->value);
       exit(1);
     }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseTerm(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
+    if(currToken->type != CLOSED_PAREN){
+      fprintf(stderr, "Error on line %d: Missing closed parenthese in factor.\n", currToken->lineNum);
       exit(1);
     }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
+    popToken(tokens);
+    if(open->kind == PENDING_CALL)
+      reducePending(&stack);
+    else{
+      stack.numOps--;
+      stack.nesting--;
+    }
   }
+  astnode_t *exprNode = stack.operands[0];
+  free(stack.ops);
+  free(stack.operands);
   return exprNode;
 }
 
 /**
- * parseTerm(tokenlist_t *tokens)
- * Parse a term, returning a term-type AST node
- *
- * <term> ::= <factor> { ("*" | "/" | "%") <factor> }
+ * parseCondition(tokenlist_t *tokens, char *keyword)
+ * Parses the parenthesized condition of an if, while or do-while
  *
- * return astnode_t* - returns the created AST node
+ * param *tokens - the token list to parse the condition from
+ * param *keyword - the statement's keyword, for error messages
+ * return astnode_t* - returns the condition's expression AST node
  **/
-astnode_t *parseTerm(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse term, null token list.\n");
+astnode_t *parseCondition(tokenlist_t *tokens, char *keyword){
+  token_t *currToken = popToken(tokens);
+  if(currToken->type != OPEN_PAREN){
+    fprintf(stderr, "Error on line %d: Open parenthese did not follow %s.\n", currToken->lineNum, keyword);
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *termNode = NULL;
-  termNode = parseFactor(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == MULT_OP || currToken->type == DIV_OP || currToken->type == MOD_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = termNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
-      exit(1);
-    }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseFactor(tokens);
-    termNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(termNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
-      exit(1);
-    }
-    termNode->nodeType = BINARY_OP;
-    termNode->fields.children.left = leftOperand;
-    termNode->fields.children.middle = operator;
-    termNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
+  astnode_t *condNode = parseExpression(tokens);
+  currToken = popToken(tokens);
+  if(currToken->type != CLOSED_PAREN){
+    fprintf(stderr, "Error on line %d: Closed parenthese did not follow %s condition.\n", currToken->lineNum, keyword);
+    exit(1);
   }
-  return termNode;
+  return condNode;
+}
+
+/**
+ * parseLoopBody(tokenlist_t *tokens)
+ * Parses the body of a loop, where break and continue may be used
+ *
+ * param *tokens - the token list to parse the body from
+ * return astnode_t* - returns the first STATEMENT node of the body, or NULL if it is empty
+ **/
+astnode_t *parseLoopBody(tokenlist_t *tokens){
+  loopDepth++;
+  astnode_t *body = parseBody(tokens);
+  loopDepth--;
+  return body;
 }
 
 /**
- * parseFactor(tokenlist_t *tokens)
- * Parse a factor, returning a factor-type AST node
+ * parseFor(tokenlist_t *tokens)
+ * Parses a for loop into its first clause, as a statement of its own, followed by a WHILE
+ * statement with the other two. The whole loop is a scope, so a variable declared in the
+ * first clause goes out of scope after it.
  *
- * <factor> ::= "(" <expression> ")" | <un_op> <factor> | <int>
+ * <statement> ::= "for" "(" [ <exp> ] ";" [ <exp> ] ";" [ <exp> ] ")" <body>
+ *               | "for" "(" "int" <id> [ "=" <exp> ] ";" [ <exp> ] ";" [ <exp> ] ")" <body>
  *
- * return astnode_t* - returns the created AST node
+ * param *tokens - the token list to parse the loop from
+ * return astnode_t* - returns the first clause's STATEMENT node chained to the loop's, or just
+ *                     the loop's without a first clause
  **/
-astnode_t *parseFactor(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse factor, null token list.\n");
+astnode_t *parseFor(tokenlist_t *tokens){
+  int lineNum = popToken(tokens)->lineNum;
+  token_t *currToken = popToken(tokens);
+  if(currToken->type != OPEN_PAREN){
+    fprintf(stderr, "Error on line %d: Open parenthese did not follow for.\n", currToken->lineNum);
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *factNode = NULL;
-  currToken = popToken(tokens);
-  if(currToken == NULL){
-    fprintf(stderr, "Error on line %d: Empty factor, invalid format.\n", currToken->lineNum);
-    exit(1);
+  size_t scope = enterScope();
+  astnode_t *initNode = NULL;
+  if(peek(tokens)->type == INT_KEYW)
+    initNode = parseStatement(tokens);
+  else if(peek(tokens)->type != SEMICOLON){
+    initNode = createNode(STATEMENT, peek(tokens)->lineNum);
+    initNode->fields.children.left = parseExpression(tokens);
   }
-  if(currToken->type == OPEN_PAREN){
-    factNode = parseExpression(tokens);
+  if(initNode == NULL || initNode->fields.children.left->nodeType != DECLARATION){
     currToken = popToken(tokens);
-    if(currToken->type != CLOSED_PAREN){
-      fprintf(stderr, "Error on line %d: Missing closed parenthese in factor.\n", currToken->lineNum);
+    if(currToken->type != SEMICOLON){
+      fprintf(stderr, "Error on line %d: Semicolon did not follow for loop initializer.\n", currToken->lineNum);
       exit(1);
     }
-    return factNode;
   }
-  //Need to malloc factNode for remaining cases
-  factNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-  if(factNode == NULL){
-    fprintf(stderr, "Error on line %d: Failed to allocate space for int factor node.\n", currToken->lineNum);
+  astnode_t *loopNode = createNode(WHILE, lineNum);
+  if(peek(tokens)->type != SEMICOLON)
+    loopNode->fields.children.left = parseExpression(tokens);
+  currToken = popToken(tokens);
+  if(currToken->type != SEMICOLON){
+    fprintf(stderr, "Error on line %d: Semicolon did not follow for loop condition.\n", currToken->lineNum);
     exit(1);
   }
-  else if(currToken->type == NEGATION || currToken->type == BITWISE_COMP || currToken->type == LOGIC_NEG){
-    astnode_t *unOp = (astnode_t*) malloc(sizeof(astnode_t)*1);
-    if(unOp == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for unary operator node.\n", currToken->lineNum);
-      exit(1);
-    }
-    unOp->fields.strVal = currToken->value;
-    unOp->nodeType = DATA;
-    factNode->nodeType = UNARY_OP;
-    factNode->fields.children.left = unOp;
-    factNode->fields.children.right = parseFactor(tokens);
-    return factNode;
+  if(peek(tokens)->type != CLOSED_PAREN){
+    loopNode->fields.children.right = createNode(STATEMENT, peek(tokens)->lineNum);
+    loopNode->fields.children.right->fields.children.left = parseExpression(tokens);
   }
-  else if(currToken->type == INT_LITERAL){
-    factNode->nodeType = INTEGER;
-    factNode->fields.intVal = atoi(currToken->value);
-    return factNode;
+  currToken = popToken(tokens);
+  if(currToken->type != CLOSED_PAREN){
+    fprintf(stderr, "Error on line %d: Closed parenthese did not follow for loop clauses.\n", currToken->lineNum);
+    exit(1);
   }
+  loopNode->fields.children.middle = parseLoopBody(tokens);
+  leaveScope(scope);
+  astnode_t *loopStatement = createNode(STATEMENT, lineNum);
+  loopStatement->fields.children.left = loopNode;
+  if(initNode == NULL)
+    return loopStatement;
+  initNode->fields.children.right = loopStatement;
+  return initNode;
+}
+
+/**
+ * blockStatement(astnode_t *body, int lineNum)
+ * Makes a block statement around a chain of statements: an if that is always taken
+ *
+ * param *body - the first STATEMENT node of the chain
+ * param lineNum - the line the block starts on
+ * return astnode_t* - returns the block's STATEMENT node
+ **/
+astnode_t *blockStatement(astnode_t *body, int lineNum){
+  astnode_t *statementNode = createNode(STATEMENT, lineNum);
+  astnode_t *ifNode = createNode(IF, lineNum);
+  ifNode->fields.children.left = createNode(INTEGER, lineNum);
+  ifNode->fields.children.left->fields.intVal = 1;
+  ifNode->fields.children.middle = body;
+  statementNode->fields.children.left = ifNode;
+  return statementNode;
+}
+
+/**
+ * parseCaseLabel(tokenlist_t *tokens)
+ * Parses a case or default label of a switch body, checking that its value is not used by
+ * another case of the same switch
+ *
+ * <case-label> ::= "case" [ "-" ] <int> ":" | "default" ":"
+ *
+ * param *tokens - the token list to parse the label from
+ * return astnode_t* - returns a STATEMENT node holding the CASE or DEFAULT node
+ **/
+astnode_t *parseCaseLabel(tokenlist_t *tokens){
+  token_t *currToken = popToken(tokens);
+  int lineNum = currToken->lineNum;
+  astnode_t *statementNode = createNode(STATEMENT, lineNum);
+  if(currToken->type == DEFAULT_KEYW)
+    statementNode->fields.children.left = createNode(DEFAULT, lineNum);
   else{
-    fprintf(stderr, "Error on line %d: Invalid factor.\n", currToken->lineNum);
+    int negate = 0;
+    currToken = popToken(tokens);
+    if(currToken->type == NEGATION){
+      negate = 1;
+      currToken = popToken(tokens);
+    }
+    if(currToken->type != INT_LITERAL){
+      fprintf(stderr, "Error on line %d: Case value is not an integer constant.\n", currToken->lineNum);
+      exit(1);
+    }
+    astnode_t *valueNode = createNode(INTEGER, lineNum);
+    valueNode->fields.intVal = negate ? -atoi(currToken->value) : atoi(currToken->value);
+    statementNode->fields.children.left = createNode(CASE, lineNum);
+    statementNode->fields.children.left->fields.children.left = valueNode;
+    growArray((void **) &caseValues, &caseValuesCap, numCaseValues + 1, sizeof(int));
+    growArray((void **) &caseLines, &caseLinesCap, numCaseValues + 1, sizeof(int));
+    caseValues[numCaseValues] = valueNode->fields.intVal;
+    caseLines[numCaseValues++] = lineNum;
+  }
+  currToken = popToken(tokens);
+  if(currToken->type != COLON){
+    fprintf(stderr, "Error on line %d: Colon did not follow case label.\n", currToken->lineNum);
     exit(1);
   }
-  return NULL;
+  return statementNode;
 }
 
 /**
- * parseExpression(tokenlist_t *tokens)
- * Parses an expression, returning an expression-type AST node
+ * compareCaseIndex(const void *a, const void *b)
+ * Orders indices into caseValues by value, then by position
  *
- * <expression> ::= <logical-and-expr> { "||" < logical-and-expr> }
+ * param *a - an index
+ * param *b - another index
+ * return int - returns the qsort() comparison
+ **/
+static int compareCaseIndex(const void *a, const void *b){
+  size_t indexA = *(const size_t *) a;
+  size_t indexB = *(const size_t *) b;
+  if(caseValues[indexA] != caseValues[indexB])
+    return (caseValues[indexA] < caseValues[indexB]) ? -1 : 1;
+  return (indexA > indexB) - (indexA < indexB);
+}
+
+/**
+ * parseSwitch(tokenlist_t *tokens)
+ * Parses a switch statement. Case labels may only label the statements directly in the switch
+ * body, and variables may only be declared in blocks nested in it, so jumping to a case never
+ * skips a declaration; a for loop declaring its variable is wrapped in an always taken if.
  *
- * param *tokens - the token list to parse the expression from
- * return astnode_t* - returns an expression AST node
+ * <statement> ::= "switch" "(" <exp> ")" "{" { <case-label> | <statement> } "}"
+ *
+ * param *tokens - the token list to parse the switch from
+ * return astnode_t* - returns a STATEMENT node holding the SWITCH node
  **/
-astnode_t *parseExpression(tokenlist_t *tokens){
-  if(tokens == NULL){
-    fprintf(stderr, "Cannot parse expression, null token list.\n");
+astnode_t *parseSwitch(tokenlist_t *tokens){
+  int lineNum = popToken(tokens)->lineNum;
+  astnode_t *switchNode = createNode(SWITCH, lineNum);
+  switchNode->fields.children.left = parseCondition(tokens, "switch");
+  token_t *currToken = popToken(tokens);
+  if(currToken->type != OPEN_BRACE){
+    fprintf(stderr, "Error on line %d: Open bracket did not follow switch.\n", currToken->lineNum);
     exit(1);
   }
-  token_t *currToken = NULL;
-  astnode_t *exprNode = NULL;
-  exprNode = parseLogicalOrExp(tokens);
-  currToken = peek(tokens);
-  //Found first factor, now check for additional mult/division
-  while(currToken->type == OR_OP){
-    currToken = popToken(tokens);
-    char *opVal = currToken->value;
-    astnode_t *leftOperand = exprNode;
-    astnode_t *operator = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(operator == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for operator node in term.\n", currToken->lineNum);
+  size_t firstCase = numCaseValues;
+  int defaultLine = 0;
+  switchDepth++;
+  astnode_t **nextStatement = &switchNode->fields.children.middle;
+  while((currToken = peek(tokens))->type != CLOSED_BRACE){
+    if(currToken->type == END_OF_INPUT){
+      fprintf(stderr, "Error on line %d: Closed bracket missing for switch on line %d.\n", currToken->lineNum, lineNum);
       exit(1);
     }
-    operator->nodeType = DATA;
-    operator->fields.strVal = opVal;
-    astnode_t *rightOperand = parseLogicalOrExp(tokens);
-    exprNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-    if(exprNode == NULL){
-      fprintf(stderr, "Error on line %d: Failed to allocate space for binary operator term node.\n", currToken->lineNum);
+    if(currToken->type == INT_KEYW){
+      fprintf(stderr, "Error on line %d: A declaration in a switch body must be inside a block.\n", currToken->lineNum);
       exit(1);
     }
-    exprNode->nodeType = BINARY_OP;
-    exprNode->fields.children.left = leftOperand;
-    exprNode->fields.children.middle = operator;
-    exprNode->fields.children.right = rightOperand;
-    currToken = peek(tokens);
+    if(currToken->type == DEFAULT_KEYW){
+      if(defaultLine != 0){
+        fprintf(stderr, "Error on line %d: Switch already has a default label, on line %d.\n", currToken->lineNum, defaultLine);
+        exit(1);
+      }
+      defaultLine = currToken->lineNum;
+    }
+    astnode_t *statementNode = NULL;
+    if(currToken->type == CASE_KEYW || currToken->type == DEFAULT_KEYW)
+      statementNode = parseCaseLabel(tokens);
+    else{
+      int statementLine = currToken->lineNum;
+      statementNode = parseStatement(tokens);
+      if(statementNode->fields.children.left->nodeType == DECLARATION)
+        statementNode = blockStatement(statementNode, statementLine);
+    }
+    for(*nextStatement = statementNode; *nextStatement != NULL; nextStatement = &(*nextStatement)->fields.children.right);
   }
-  return exprNode;
+  popToken(tokens);
+  switchDepth--;
+  //Duplicate case values sort next to each other
+  size_t numCases = numCaseValues - firstCase;
+  size_t *order = (size_t *) malloc((numCases + 1)*sizeof(size_t));
+  if(order == NULL){
+    fprintf(stderr, "Failed to allocate space for case values.\n");
+    exit(1);
+  }
+  size_t i;
+  for(i = 0; i < numCases; i++)
+    order[i] = firstCase + i;
+  qsort(order, numCases, sizeof(size_t), compareCaseIndex);
+  for(i = 1; i < numCases; i++){
+    if(caseValues[order[i]] == caseValues[order[i-1]]){
+      fprintf(stderr, "Error on line %d: Duplicate case value %d, first used on line %d.\n",
+              caseLines[order[i]], caseValues[order[i]], caseLines[order[i-1]]);
+      exit(1);
+    }
+  }
+  free(order);
+  numCaseValues = firstCase;
+  astnode_t *statementNode = createNode(STATEMENT, lineNum);
+  statementNode->fields.children.left = switchNode;
+  return statementNode;
 }
 
 /**
  * parseStatement(tokenlist_t *tokens)
- * Parses a statement, returning a statement-type AST node
+ * Parses a statement, returning a statement-type AST node holding the return, declaration, if,
+ * loop, switch, break, continue or expression. A for loop is two statements, see parseFor().
  *
- * <statement> ::= "return" <expression> ";"
+ * <statement> ::= "return" <exp> ";" | "int" <id> [ "=" <exp> ] ";"
+ *               | "if" "(" <exp> ")" <body> [ "else" <body> ]
+ *               | "while" "(" <exp> ")" <body> | "do" <body> "while" "(" <exp> ")" ";"
+ *               | "switch" "(" <exp> ")" "{" { <case-label> | <statement> } "}"
+ *               | "{" { <statement> } "}" | "break" ";" | "continue" ";" | <exp> ";"
  *
  * param *tokens - the token list to parse the statement from
  * return astnode_t* - returns a statement AST node
@@ -594,22 +820,136 @@ astnode_t *parseStatement(tokenlist_t *tokens){
     fprintf(stderr, "Cannot parse statement, null token list.\n");
     exit(1);
   }
-  currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != RET_KEYW){
-    fprintf(stderr, "Error on line %d: Statement did not begin with return.\n", currToken->lineNum);
+  currToken = peek(tokens);
+  parseFile = currToken->file;
+  statementNode = createNode(STATEMENT, currToken->lineNum);
+  if(currToken->type == RET_KEYW){
+    popToken(tokens);
+    statementNode->fields.children.left = createNode(RETURN, currToken->lineNum);
+    statementNode->fields.children.left->fields.children.left = parseExpression(tokens);
+  }
+  else if(currToken->type == INT_KEYW){
+    popToken(tokens);
+    currToken = popToken(tokens);
+    if(currToken->type != IDENTIFIER){
+      fprintf(stderr, "Error on line %d: Identifier did not follow int keyword in declaration.\n", currToken->lineNum);
+      exit(1);
+    }
+    int declLine = currToken->lineNum;
+    astnode_t *declNode = createNode(DECLARATION, declLine);
+    declNode->fields.children.left = createSymbolNode(currToken);
+    if(peek(tokens)->type == ASSIGN){
+      popToken(tokens);
+      declNode->fields.children.right = parseExpression(tokens);
+    }
+    //Declared after the initializer, so "int a = a;" is a use before declaration
+    declareVariable(declNode->fields.children.left->fields.symbol, declLine);
+    statementNode->fields.children.left = declNode;
+  }
+  else if(currToken->type == IF_KEYW){
+    popToken(tokens);
+    astnode_t *ifNode = createNode(IF, currToken->lineNum);
+    ifNode->fields.children.left = parseCondition(tokens, "if");
+    ifNode->fields.children.middle = parseBody(tokens);
+    if(peek(tokens)->type == ELSE_KEYW){
+      popToken(tokens);
+      ifNode->fields.children.right = parseBody(tokens);
+    }
+    statementNode->fields.children.left = ifNode;
+    return statementNode;
+  }
+  else if(currToken->type == WHILE_KEYW){
+    popToken(tokens);
+    astnode_t *loopNode = createNode(WHILE, currToken->lineNum);
+    loopNode->fields.children.left = parseCondition(tokens, "while");
+    loopNode->fields.children.middle = parseLoopBody(tokens);
+    statementNode->fields.children.left = loopNode;
+    return statementNode;
+  }
+  else if(currToken->type == DO_KEYW){
+    popToken(tokens);
+    astnode_t *loopNode = createNode(DO_WHILE, currToken->lineNum);
+    loopNode->fields.children.middle = parseLoopBody(tokens);
+    currToken = popToken(tokens);
+    if(currToken->type != WHILE_KEYW){
+      fprintf(stderr, "Error on line %d: While did not follow do loop body.\n", currToken->lineNum);
+      exit(1);
+    }
+    loopNode->fields.children.left = parseCondition(tokens, "while");
+    statementNode->fields.children.left = loopNode;
+  }
+  else if(currToken->type == FOR_KEYW){
+    free(statementNode);
+    return parseFor(tokens);
+  }
+  else if(currToken->type == SWITCH_KEYW){
+    free(statementNode);
+    return parseSwitch(tokens);
+  }
+  else if(currToken->type == OPEN_BRACE){
+    free(statementNode);
+    int blockLine = currToken->lineNum;
+    return blockStatement(parseBody(tokens), blockLine);
+  }
+  else if(currToken->type == CASE_KEYW || currToken->type == DEFAULT_KEYW){
+    fprintf(stderr, "Error on line %d: A %s label must be directly in a switch body.\n", currToken->lineNum, currToken->value);
     exit(1);
   }
-  statementNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-  statementNode->nodeType = STATEMENT;
-  statementNode->fields.children.left = parseExpression(tokens);
+  else if(currToken->type == BREAK_KEYW || currToken->type == CONTINUE_KEYW){
+    popToken(tokens);
+    if(loopDepth == 0 && (currToken->type == CONTINUE_KEYW || switchDepth == 0)){
+      fprintf(stderr, "Error on line %d: %s outside of a %s.\n", currToken->lineNum, currToken->value,
+              (currToken->type == BREAK_KEYW) ? "loop or switch" : "loop");
+      exit(1);
+    }
+    statementNode->fields.children.left = createNode((currToken->type == BREAK_KEYW) ? BREAK : CONTINUE, currToken->lineNum);
+  }
+  else
+    statementNode->fields.children.left = parseExpression(tokens);
   currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != SEMICOLON){
+  if(currToken->type != SEMICOLON){
     fprintf(stderr, "Error on line %d: Statement did not end with semicolon.\n", currToken->lineNum);
     exit(1);
   }
   return statementNode;
 }
 
+/**
+ * parseBody(tokenlist_t *tokens)
+ * Parses the body of an if, else or loop: a braced block of statements, or a single statement.
+ * Either way it is a scope of its own.
+ *
+ * <body> ::= "{" { <statement> } "}" | <statement>
+ *
+ * param *tokens - the token list to parse the body from
+ * return astnode_t* - returns the first STATEMENT node of the body, or NULL if it is empty
+ **/
+astnode_t *parseBody(tokenlist_t *tokens){
+  token_t *currToken = peek(tokens);
+  if(currToken->type != OPEN_BRACE){
+    if(currToken->type == INT_KEYW){
+      fprintf(stderr, "Error on line %d: A declaration cannot be the body of an if, else or loop.\n", currToken->lineNum);
+      exit(1);
+    }
+    return parseStatement(tokens);
+  }
+  int lineNum = currToken->lineNum;
+  popToken(tokens);
+  size_t scope = enterScope();
+  astnode_t *body = NULL;
+  astnode_t **nextStatement = &body;
+  while(peek(tokens)->type != CLOSED_BRACE){
+    if(peek(tokens)->type == END_OF_INPUT){
+      fprintf(stderr, "Error on line %d: Closed bracket missing for block opened on line %d.\n", peek(tokens)->lineNum, lineNum);
+      exit(1);
+    }
+    for(*nextStatement = parseStatement(tokens); *nextStatement != NULL; nextStatement = &(*nextStatement)->fields.children.right);
+  }
+  popToken(tokens);
+  leaveScope(scope);
+  return body;
+}
+
 /**
  * parseFunction(tokenlist_t *tokens)
  * Parses a function, returning a function-type AST node
@@ -622,48 +962,70 @@ astnode_t *parseFunction(tokenlist_t *tokens){
   currToken = popToken(tokens);
   astnode_t *funcNode = NULL;
   char *funcName = NULL;
-  if(currToken == NULL || currToken->type != INT_KEYW){
+  if(currToken->type != INT_KEYW){
     fprintf(stderr, "Error on line %d: Function did not begin with int keyword.\n", currToken->lineNum);
     exit(1);
   }
   currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != IDENTIFIER){
+  if(currToken->type != IDENTIFIER){
     fprintf(stderr, "Error on line %d: Identifier did not follow int keyword.\n", currToken->lineNum);
     exit(1);
   }
   funcName = currToken->value;
-  funcNode = (astnode_t *) malloc(sizeof(astnode_t)*1);
-  funcNode->nodeType = FUNCTION;
-  funcNode->fields.children.left = (astnode_t *) malloc(sizeof(astnode_t)*1);
-  funcNode->fields.children.left->nodeType = DATA;
-  if(funcNode->fields.children.left == NULL){
-    fprintf(stderr, "Error on line %d: Failed to allocate space for function name node.\n", currToken->lineNum);
-    exit(1);
-  }
-  //Function left child node will contain value of function's name, right func body
-  funcNode->fields.children.left->fields.strVal = funcName;
+  defineFunction(currToken->symbol, currToken->lineNum);
+  parseFile = currToken->file;
+  funcNode = createNode(FUNCTION, currToken->lineNum);
+  //Function left child node will contain the function's name symbol, middle its parameters, right func body
+  funcNode->fields.children.left = createSymbolNode(currToken);
   currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != OPEN_PAREN){
+  if(currToken->type != OPEN_PAREN){
     fprintf(stderr, "Error on line %d: Open parenthese did not follow identifier.\n", currToken->lineNum);
     exit(1);
   }
+  //Parameters are declared in a fresh set of variables, the body's outermost scope
+  symsetClear(&declared);
+  numScopeVars = 0;
+  astnode_t **nextParam = &funcNode->fields.children.middle;
   currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != CLOSED_PAREN){
-    fprintf(stderr, "Error on line %d: Closed parenthese did not follow open parenthese.\n", currToken->lineNum);
-    exit(1);
+  while(currToken->type != CLOSED_PAREN){
+    if(nextParam != &funcNode->fields.children.middle){
+      if(currToken->type != COMMA){
+        fprintf(stderr, "Error on line %d: Comma or closed parenthese did not follow parameter.\n", currToken->lineNum);
+        exit(1);
+      }
+      currToken = popToken(tokens);
+    }
+    if(currToken->type != INT_KEYW){
+      fprintf(stderr, "Error on line %d: Parameter did not begin with int keyword.\n", currToken->lineNum);
+      exit(1);
+    }
+    currToken = popToken(tokens);
+    if(currToken->type != IDENTIFIER){
+      fprintf(stderr, "Error on line %d: Identifier did not follow int keyword in parameter.\n", currToken->lineNum);
+      exit(1);
+    }
+    declareVariable(currToken->symbol, currToken->lineNum);
+    *nextParam = createNode(PARAMETER, currToken->lineNum);
+    (*nextParam)->fields.children.left = createSymbolNode(currToken);
+    nextParam = &(*nextParam)->fields.children.right;
+    currToken = popToken(tokens);
   }
   currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != OPEN_BRACE){
+  if(currToken->type != OPEN_BRACE){
     fprintf(stderr, "Error on line %d: Open bracket did not follow closed parenthese.\n", currToken->lineNum);
     exit(1);
   }
-  //Create func body
-  funcNode->fields.children.right = parseStatement(tokens);
-  currToken = popToken(tokens);
-  if(currToken == NULL || currToken->type != CLOSED_BRACE){
-    fprintf(stderr, "Error on line %d: Closed bracket missing for function %s.\n", currToken->lineNum, funcName);
-    exit(1);
+  //Create func body, a chain of statements
+  astnode_t **nextStatement = &funcNode->fields.children.right;
+  while(peek(tokens)->type != CLOSED_BRACE){
+    if(peek(tokens)->type == END_OF_INPUT){
+      fprintf(stderr, "Error on line %d: Closed bracket missing for function %s.\n", peek(tokens)->lineNum, funcName);
+      exit(1);
+    }
+    //A for loop is parsed into two statements
+    for(*nextStatement = parseStatement(tokens); *nextStatement != NULL; nextStatement = &(*nextStatement)->fields.children.right);
   }
+  popToken(tokens);
   return funcNode;
 }
 
@@ -671,67 +1033,250 @@ astnode_t *parseFunction(tokenlist_t *tokens){
  * parseProgram(tokenlist_t *tokens)
  * Parses a program, returning a program-type AST node
  *
+ * <program> ::= <function> { <function> }
+ *
  * param *tokens - the token list to parse the program from
- * return astnode_t* - returns a function AST node
+ * return astnode_t* - returns the first PROGRAM node of the program's function chain
  **/
 astnode_t* parseProgram(tokenlist_t *tokens){
-  //printf("── parsing %s ──\n", sourcePath);
   astnode_t *root = NULL;
   if(tokens == NULL){
     fprintf(stderr, "Cannot parse program, null token list.\n");
     exit(1);
   }
-  root = (astnode_t *) malloc(sizeof(astnode_t)*1);
-  if(root == NULL){
-    fprintf(stderr, "Failed to allocate space for root AST Node.\n");
-    exit(1);
-  }
-  root->nodeType = PROGRAM;
-  root->fields.children.left = parseFunction(tokens);
-  //printf(" - parsing complete -\n\n");
+  astnode_t **nextFunction = &root;
+  do{
+    *nextFunction = createNode(PROGRAM, peek(tokens)->lineNum);
+    (*nextFunction)->fields.children.left = parseFunction(tokens);
+    nextFunction = &(*nextFunction)->fields.children.right;
+    releaseTokens(tokens);
+  } while(peek(tokens)->type != END_OF_INPUT);
   return root;
 }
 
 /**
- * printASTNodeType(astnode_t *node)
- * When provided an AST Node, it prints the nodeType enum as a string
+ * indexFunctions(astnode_t *root)
+ * Indexes the FUNCTION nodes of a program by name, for findFunction()
  *
- * param *node - the node to print the nodeType of
+ * param *root - the first PROGRAM node of the program
  * return void
  **/
-void printASTNodeType(astnode_t *node){
-  if(node == NULL)
-    return;
-  AST_TYPE nodeType = node->nodeType;
+void indexFunctions(astnode_t *root){
+  if(functionNodes != NULL)
+    memset(functionNodes, 0, functionNodesCap*sizeof(astnode_t *));
+  for(; root != NULL; root = root->fields.children.right){
+    uint32_t symbol = root->fields.children.left->fields.children.left->fields.symbol;
+    growArray((void **) &functionNodes, &functionNodesCap, (size_t) symbol + 1, sizeof(astnode_t *));
+    functionNodes[symbol] = root->fields.children.left;
+  }
+}
+
+/**
+ * findFunction(uint32_t symbol)
+ * Looks a function of the program up by name, see indexFunctions()
+ *
+ * param symbol - the function's name symbol ID
+ * return astnode_t* - returns the FUNCTION node, or NULL if there is no such function
+ **/
+astnode_t *findFunction(uint32_t symbol){
+  return (symbol < functionNodesCap) ? functionNodes[symbol] : NULL;
+}
+
+/**
+ * countParameters(astnode_t *funcNode)
+ * Counts the parameters of a function
+ *
+ * param *funcNode - the FUNCTION node
+ * return int - returns the number of parameters
+ **/
+int countParameters(astnode_t *funcNode){
+  int count = 0;
+  astnode_t *param = funcNode->fields.children.middle;
+  for(; param != NULL; param = param->fields.children.right)
+    count++;
+  return count;
+}
+
+/**
+ * countArguments(astnode_t *call)
+ * Counts the arguments of a call
+ *
+ * param *call - the CALL node
+ * return int - returns the number of arguments
+ **/
+int countArguments(astnode_t *call){
+  int count = 0;
+  astnode_t *arg = call->fields.children.right;
+  for(; arg != NULL; arg = arg->fields.children.right)
+    count++;
+  return count;
+}
+
+/**
+ * checkCalls(astnode_t *root)
+ * Checks every call of a program against the function it calls, raising an error if there is no
+ * such function or the call has the wrong number of arguments. Functions may be called before
+ * their definition, so this waits until the whole program is parsed (or loaded from the AST
+ * cache, which is why errors name the calling function rather than a line).
+ *
+ * param *root - the first PROGRAM node of the program
+ * return void
+ **/
+void checkCalls(astnode_t *root){
+  aststack_t stack = {0};
+  indexFunctions(root);
+  for(; root != NULL; root = root->fields.children.right){
+    astnode_t *funcNode = root->fields.children.left;
+    pushFrame(&stack, funcNode->fields.children.right);
+    while(stack.depth > 0){
+      astnode_t *node = stack.frames[--stack.depth].node;
+      if(node == NULL || node->nodeType == INTEGER || node->nodeType == SYMBOL || node->nodeType == DATA)
+        continue;
+      if(node->nodeType == CALL){
+        uint32_t symbol = node->fields.children.left->fields.symbol;
+        astnode_t *callee = findFunction(symbol);
+        int numArgs = countArguments(node);
+        if(callee == NULL){
+          fprintf(stderr, "Error in function %s: Call to undefined function %s.\n",
+                  symbolName(funcNode->fields.children.left->fields.symbol), symbolName(symbol));
+          exit(1);
+        }
+        if(numArgs != countParameters(callee)){
+          fprintf(stderr, "Error in function %s: Call to %s with %d arguments, it takes %d.\n",
+                  symbolName(funcNode->fields.children.left->fields.symbol), symbolName(symbol), numArgs,
+                  countParameters(callee));
+          exit(1);
+        }
+      }
+      pushFrame(&stack, node->fields.children.left);
+      pushFrame(&stack, node->fields.children.middle);
+      pushFrame(&stack, node->fields.children.right);
+    }
+  }
+  freeASTStack(&stack);
+}
+
+/**
+ * hasNestedStatements(astnode_t *node)
+ * Checks whether a statement's content holds chains of statements of its own: the branches of
+ * an if, the body and step of a loop, or the body of a switch, in its middle and right children.
+ * Only its left child, the condition, is evaluated as part of the statement itself.
+ *
+ * param *node - the statement's content
+ * return int - returns 1 for IF, WHILE, DO_WHILE and SWITCH nodes, 0 otherwise
+ **/
+int hasNestedStatements(astnode_t *node){
+  return node->nodeType == IF || node->nodeType == WHILE || node->nodeType == DO_WHILE || node->nodeType == SWITCH;
+}
+
+/**
+ * pushFrame(aststack_t *stack, astnode_t *node)
+ * Pushes a node to visit onto an iterative AST walk's stack. Pushing may move the
+ * frames, so pointers to older frames must not be held across a push.
+ *
+ * param *stack - the walk's stack
+ * param *node - the node to visit
+ * return astframe_t* - returns the pushed frame, in state 0
+ **/
+astframe_t *pushFrame(aststack_t *stack, astnode_t *node){
+  growArray((void **) &stack->frames, &stack->cap, stack->depth + 1, sizeof(astframe_t));
+  astframe_t *frame = &stack->frames[stack->depth++];
+  frame->node = node;
+  frame->state = 0;
+  frame->labels[0] = frame->labels[1] = NULL;
+  return frame;
+}
+
+/**
+ * freeASTStack(aststack_t *stack)
+ * Frees an iterative AST walk's stack
+ *
+ * param *stack - the walk's stack
+ * return void
+ **/
+void freeASTStack(aststack_t *stack){
+  free(stack->frames);
+  stack->frames = NULL;
+  stack->depth = 0;
+  stack->cap = 0;
+}
+
+/**
+ * astTypeName(AST_TYPE nodeType)
+ * Returns the nodeType enum as a string
+ *
+ * param nodeType - the node type to name
+ * return char* - returns the name of the node type
+ **/
+char *astTypeName(AST_TYPE nodeType){
   switch(nodeType){
   case PROGRAM:
-    printf("PROGRAM");
-    break;
+    return "PROGRAM";
   case FUNCTION:
-    printf("FUNCTION");
-    break;
+    return "FUNCTION";
   case STATEMENT:
-    printf("STATEMENT");
-    break;
+    return "STATEMENT";
   case EXPRESSION:
-    printf("EXPRESSION");
-    break;
+    return "EXPRESSION";
   case TERM:
-    printf("TERM");
-    break;
+    return "TERM";
   case DATA:
-    printf("DATA");
-    break;
+    return "DATA";
   case INTEGER:
-    printf("INTEGER");
-    break;
+    return "INTEGER";
   case UNARY_OP:
-    printf("UN_OP");
-    break;
+    return "UN_OP";
   case BINARY_OP:
-    printf("BIN_OP");
-    break;
+    return "BIN_OP";
+  case SYMBOL:
+    return "SYMBOL";
+  case RETURN:
+    return "RETURN";
+  case DECLARATION:
+    return "DECLARATION";
+  case ASSIGNMENT:
+    return "ASSIGNMENT";
+  case SHARED:
+    return "SHARED";
+  case IF:
+    return "IF";
+  case TERNARY:
+    return "TERNARY";
+  case WHILE:
+    return "WHILE";
+  case DO_WHILE:
+    return "DO_WHILE";
+  case BREAK:
+    return "BREAK";
+  case CONTINUE:
+    return "CONTINUE";
+  case SWITCH:
+    return "SWITCH";
+  case CASE:
+    return "CASE";
+  case DEFAULT:
+    return "DEFAULT";
+  case CALL:
+    return "CALL";
+  case ARGUMENT:
+    return "ARGUMENT";
+  case PARAMETER:
+    return "PARAMETER";
   }
+  return "UNKNOWN";
+}
+
+/**
+ * printASTNodeType(astnode_t *node)
+ * When provided an AST Node, it prints the nodeType enum as a string
+ *
+ * param *node - the node to print the nodeType of
+ * return void
+ **/
+void printASTNodeType(astnode_t *node){
+  if(node == NULL)
+    return;
+  printf("%s", astTypeName(node->nodeType));
 }
 
 /**
@@ -746,17 +1291,48 @@ void printAST(astnode_t *root){
     return;
   astnode_t *currNode = root;
   if(currNode->nodeType == PROGRAM){
-    printAST(currNode->fields.children.left);
+    for(; currNode != NULL; currNode = currNode->fields.children.right)
+      printAST(currNode->fields.children.left);
+    return;
   }
   else if(currNode->nodeType == FUNCTION){
-    printf("FUNC INT %s\n\tbody:\n", currNode->fields.children.left->fields.strVal);
-    printAST(currNode->fields.children.right);
+    printf("FUNC INT %s\n\tparams:", symbolName(currNode->fields.children.left->fields.symbol));
+    astnode_t *param = currNode->fields.children.middle;
+    for(; param != NULL; param = param->fields.children.right)
+      printf(" %s", symbolName(param->fields.children.left->fields.symbol));
+    printf("\n\tbody:\n");
+    if(currNode->fields.children.right != NULL)
+      printAST(currNode->fields.children.right);
     return;
   }
   else if(currNode->nodeType == STATEMENT){
-    printf("\treturn ");
+    for(; currNode != NULL; currNode = currNode->fields.children.right){
+      printf("\t");
+      printAST(currNode->fields.children.left);
+      printf(";\n");
+    }
+    return;
+  }
+  else if(currNode->nodeType == RETURN){
+    printf("return ");
     printAST(currNode->fields.children.left);
-    printf(";");
+    return;
+  }
+  else if(currNode->nodeType == DECLARATION){
+    printf("int %s", symbolName(currNode->fields.children.left->fields.symbol));
+    if(currNode->fields.children.right != NULL){
+      printf(" = ");
+      printAST(currNode->fields.children.right);
+    }
+    return;
+  }
+  else if(currNode->nodeType == ASSIGNMENT){
+    printf("%s = ", symbolName(currNode->fields.children.left->fields.symbol));
+    printAST(currNode->fields.children.right);
+    return;
+  }
+  else if(currNode->nodeType == SYMBOL){
+    printf("%s", symbolName(currNode->fields.symbol));
     return;
   }
   else if(currNode->nodeType == UNARY_OP){
@@ -774,5 +1350,73 @@ void printAST(astnode_t *root){
     printAST(currNode->fields.children.right);
     return;
   }
+  else if(currNode->nodeType == IF){
+    printf("if (");
+    printAST(currNode->fields.children.left);
+    printf(") {\n");
+    printAST(currNode->fields.children.middle);
+    printf("\t}");
+    if(currNode->fields.children.right != NULL){
+      printf(" else {\n");
+      printAST(currNode->fields.children.right);
+      printf("\t}");
+    }
+    return;
+  }
+  else if(currNode->nodeType == WHILE || currNode->nodeType == DO_WHILE){
+    printf((currNode->nodeType == WHILE) ? "while (" : "do while (");
+    printAST(currNode->fields.children.left);
+    printf(") {\n");
+    printAST(currNode->fields.children.middle);
+    if(currNode->fields.children.right != NULL){
+      printf("\tstep:\n");
+      printAST(currNode->fields.children.right);
+    }
+    printf("\t}");
+    return;
+  }
+  else if(currNode->nodeType == BREAK || currNode->nodeType == CONTINUE){
+    printf((currNode->nodeType == BREAK) ? "break" : "continue");
+    return;
+  }
+  else if(currNode->nodeType == SWITCH){
+    printf("switch (");
+    printAST(currNode->fields.children.left);
+    printf(") {\n");
+    printAST(currNode->fields.children.middle);
+    printf("\t}");
+    return;
+  }
+  else if(currNode->nodeType == CASE){
+    printf("case %d:", currNode->fields.children.left->fields.intVal);
+    return;
+  }
+  else if(currNode->nodeType == DEFAULT){
+    printf("default:");
+    return;
+  }
+  else if(currNode->nodeType == TERNARY){
+    printAST(currNode->fields.children.left);
+    printf(" ? ");
+    printAST(currNode->fields.children.middle);
+    printf(" : ");
+    printAST(currNode->fields.children.right);
+    return;
+  }
+  else if(currNode->nodeType == SHARED){
+    printAST(currNode->fields.children.left);
+    return;
+  }
+  else if(currNode->nodeType == CALL){
+    printf("%s(", symbolName(currNode->fields.children.left->fields.symbol));
+    astnode_t *arg = currNode->fields.children.right;
+    for(; arg != NULL; arg = arg->fields.children.right){
+      printAST(arg->fields.children.left);
+      if(arg->fields.children.right != NULL)
+        printf(", ");
+    }
+    printf(")");
+    return;
+  }
   puts("");
 }
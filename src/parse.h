@@ -5,11 +5,40 @@
 
 //Abstract Syntax Tree data types
 typedef enum AST_TYPE {PROGRAM, FUNCTION, STATEMENT, EXPRESSION,
-                       DATA, INTEGER, UNARY_OP, BINARY_OP, TERM} AST_TYPE;
+                       DATA, INTEGER, UNARY_OP, BINARY_OP, TERM, SYMBOL,
+                       RETURN, DECLARATION, ASSIGNMENT, SHARED, IF, TERNARY,
+                       WHILE, DO_WHILE, BREAK, CONTINUE, SWITCH, CASE, DEFAULT,
+                       CALL, ARGUMENT, PARAMETER} AST_TYPE;
 
+#define NUM_AST_TYPES 26
+
+//PROGRAM nodes chain the functions of a program: left is the FUNCTION, right the next PROGRAM
+//FUNCTION nodes have the name's SYMBOL on the left, the first PARAMETER (NULL without parameters) in
+//the middle and the first STATEMENT of the body on the right; PARAMETER nodes chain the parameters:
+//left is a parameter's SYMBOL, right the next PARAMETER
+//CALL nodes have the called function's SYMBOL on the left and the first ARGUMENT (NULL without
+//arguments) on the right; ARGUMENT nodes chain the arguments: left is an argument's expression,
+//right the next ARGUMENT. Arguments are evaluated last to first, as they are pushed.
+//SYMBOL nodes hold the interned symbol ID of a name, see symbolName()
+//STATEMENT nodes chain a function body: left is the statement itself, right the next STATEMENT
+//DECLARATION and ASSIGNMENT nodes have the variable's SYMBOL on the left and the value (or NULL) on the right
+//IF nodes have the condition on the left, and the first STATEMENT of the then and else branches
+//(NULL when empty or missing) in the middle and on the right; each branch is a scope of its own
+//A braced block used as a statement is an IF whose condition is the INTEGER 1
+//WHILE and DO_WHILE nodes have the condition on the left (NULL for "for(;;)"), the first STATEMENT of
+//the body in the middle, and of the step (the third clause of a for, run after the body and on
+//continue) on the right; a for's first clause is the statement before its WHILE
+//SWITCH nodes have the controlling expression on the left and the first STATEMENT of the body in the
+//middle; CASE (with an INTEGER value on the left) and DEFAULT statements label the body's top level
+//statements, and break leaves the switch
+//TERNARY nodes have the condition, then and else expressions on the left, middle and right
+//SHARED nodes (made by the optimizer, see eliminateCommonSubexprs()) stand for every use of a repeated
+//subexpression: left is the subexpression, right an INTEGER with the index of its stack temporary,
+//and the STATEMENT's middle child an INTEGER with the number of temporaries the statement needs
 typedef union fields {
     int intVal;
     char *strVal;
+    uint32_t symbol;
     struct children{
       struct astnode_t *left;
       struct astnode_t *middle;
@@ -17,29 +46,109 @@ typedef union fields {
     } children;
 } fields;
 
+//profile is one past the index of the node's first profile counter, 0 for none, see assignCounters()
+//lineNum and file are where the node was parsed from, see token_t; nodes the optimizer made have line 0
 typedef struct astnode_t {
   AST_TYPE nodeType;
+  int profile;
+  int lineNum;
+  uint32_t file;
   fields fields;
 } astnode_t;
 
+//Default for --max-nesting
+#define DEFAULT_MAX_NESTING 100000
+
+//Operators waiting on the expression parser's stack for their operands
+//PENDING_COND is a ?: waiting for its ':', PENDING_ELSE one waiting for its else operand, and
+//PENDING_CALL a call waiting for its ')', with its finished arguments on the operand stack from firstOperand up
+typedef enum EXPR_OP {PENDING_PAREN, PENDING_UNARY, PENDING_BINARY, PENDING_ASSIGN, PENDING_COND, PENDING_ELSE,
+                      PENDING_CALL} EXPR_OP;
+
+typedef struct pendingop_t {
+  EXPR_OP kind;
+  TOKEN_TYPE type;
+  char *value;
+  int lineNum;
+  uint32_t symbol;
+  int firstOperand;
+} pendingop_t;
+
+//Explicit operand and operator stacks of parseExpression()
+typedef struct exprstack_t {
+  astnode_t **operands;
+  int numOperands;
+  size_t operandsCap;
+  pendingop_t *ops;
+  int numOps;
+  size_t opsCap;
+  int nesting;
+} exprstack_t;
+
+//Explicit stack frame for iterative AST walks; state counts the children already visited
+typedef struct astframe_t {
+  astnode_t *node;
+  int state;
+  char *labels[2];
+} astframe_t;
+
+typedef struct aststack_t {
+  astframe_t *frames;
+  int depth;
+  size_t cap;
+} aststack_t;
+
+//Set of symbol IDs, a growable array of marks indexed by symbol
+typedef struct symset_t {
+  unsigned char *marks;
+  size_t cap;
+} symset_t;
+
+extern int maxNesting;
+extern uint32_t parseFile;
+
 //Parsing functions
-astnode_t *parseLogicalOrExp(tokenlist_t *tokens);
-astnode_t *parseBitXorExpr(tokenlist_t *tokens);
-astnode_t *parseBitOrExpr(tokenlist_t *tokens);
-astnode_t *parseBitAndExpr(tokenlist_t *tokens);
-astnode_t *parseShiftExpr(tokenlist_t *tokens);
-astnode_t *parseLogicalAndExp(tokenlist_t *tokens);
-astnode_t *parseEqualityExp(tokenlist_t *tokens);
-astnode_t *parseRelationalExp(tokenlist_t *tokens);
-astnode_t *parseAdditiveExp(tokenlist_t *tokens);
-astnode_t *parseTerm(tokenlist_t *tokens);
-astnode_t *parseFactor(tokenlist_t *tokens);
+astnode_t *createNode(AST_TYPE nodeType, int lineNum);
+astnode_t *createSymbolNode(token_t *token);
+int symsetHas(symset_t *set, uint32_t symbol);
+void symsetAdd(symset_t *set, uint32_t symbol);
+void symsetRemove(symset_t *set, uint32_t symbol);
+void symsetClear(symset_t *set);
+void growArray(void **array, size_t *cap, size_t need, size_t elemSize);
+int isDeclared(uint32_t symbol);
+void declareVariable(uint32_t symbol, int lineNum);
+size_t enterScope();
+void leaveScope(size_t mark);
+void defineFunction(uint32_t symbol, int lineNum);
+void forgetFunctions();
+int binaryPrecedence(TOKEN_TYPE type);
+pendingop_t *pushPending(exprstack_t *stack, EXPR_OP kind, token_t *token);
+void pushOperand(exprstack_t *stack, astnode_t *node);
+void reducePending(exprstack_t *stack);
 astnode_t *parseExpression(tokenlist_t *tokens);
+astnode_t *parseCondition(tokenlist_t *tokens, char *keyword);
+astnode_t *parseLoopBody(tokenlist_t *tokens);
+astnode_t *parseFor(tokenlist_t *tokens);
+astnode_t *blockStatement(astnode_t *body, int lineNum);
+astnode_t *parseCaseLabel(tokenlist_t *tokens);
+astnode_t *parseSwitch(tokenlist_t *tokens);
 astnode_t *parseStatement(tokenlist_t *tokens);
+astnode_t *parseBody(tokenlist_t *tokens);
 astnode_t *parseFunction(tokenlist_t *tokens);
 astnode_t *parseProgram(tokenlist_t *tokens);
+void indexFunctions(astnode_t *root);
+astnode_t *findFunction(uint32_t symbol);
+int countParameters(astnode_t *funcNode);
+int countArguments(astnode_t *call);
+void checkCalls(astnode_t *root);
+
+//Iterative AST walk functions
+int hasNestedStatements(astnode_t *node);
+astframe_t *pushFrame(aststack_t *stack, astnode_t *node);
+void freeASTStack(aststack_t *stack);
 
 //AST printing functions
+char *astTypeName(AST_TYPE nodeType);
 void printASTNodeType(astnode_t *node);
 void printAST(astnode_t *root);
 
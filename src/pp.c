@@ -0,0 +1,1069 @@
+#include "pp.h"
+#include "parse.h"
+#include "opt.h"
+#include "dump.h"
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+//Directories searched for included files, in -I order, and the -D options every translation unit starts with
+static const char **includeDirs = NULL;
+static size_t numIncludeDirs = 0;
+static size_t includeDirsCap = 0;
+static const char **macroOptions = NULL;
+static size_t numMacroOptions = 0;
+static size_t macroOptionsCap = 0;
+//Macros defined in the current translation unit, indexed by name symbol ID
+static macro_t **macros = NULL;
+static size_t macrosCap = 0;
+//Every header read so far, indexed by the symbol ID of its real path; kept across translation units
+static header_t **headers = NULL;
+static size_t headersCap = 0;
+//Number of the current translation unit, for #pragma once
+static int translationUnit = 0;
+//Tokens of the directive being run
+static tokenarray_t lineTokens = {NULL, 0, 0};
+
+/**
+ * addIncludeDir(const char *dir)
+ * Adds a directory to search for included files (-I), after those added before it
+ *
+ * param *dir - the directory
+ * return void
+ **/
+void addIncludeDir(const char *dir){
+  growArray((void **) &includeDirs, &includeDirsCap, numIncludeDirs + 1, sizeof(char *));
+  includeDirs[numIncludeDirs++] = dir;
+}
+
+/**
+ * addMacroOption(const char *spec)
+ * Records a -D option, defining a macro at the start of every translation unit: NAME defines it
+ * to 1, NAME=tokens to the tokens (NAME(params)=tokens for a function-like macro)
+ *
+ * param *spec - the option's argument
+ * return void
+ **/
+void addMacroOption(const char *spec){
+  growArray((void **) &macroOptions, &macroOptionsCap, numMacroOptions + 1, sizeof(char *));
+  macroOptions[numMacroOptions++] = spec;
+}
+
+/**
+ * hasMacroOptions()
+ * Checks whether any -D option was given
+ *
+ * return int - returns 1 if a macro is defined on the command line, 0 otherwise
+ **/
+int hasMacroOptions(){
+  return numMacroOptions > 0;
+}
+
+/**
+ * pushToken(tokenarray_t *array, token_t *token)
+ * Appends a token to a token array
+ *
+ * param *array - the array
+ * param *token - the token to append
+ * return void
+ **/
+static void pushToken(tokenarray_t *array, token_t *token){
+  growArray((void **) &array->tokens, &array->tokensCap, array->numTokens + 1, sizeof(token_t *));
+  array->tokens[array->numTokens++] = token;
+}
+
+/**
+ * clearTokens(tokenarray_t *array)
+ * Frees the tokens of an array (slots set to NULL were moved out) and empties it, keeping its space
+ *
+ * param *array - the array
+ * return void
+ **/
+static void clearTokens(tokenarray_t *array){
+  size_t i;
+  for(i = 0; i < array->numTokens; i++){
+    if(array->tokens[i] != NULL)
+      freeToken(array->tokens[i]);
+  }
+  array->numTokens = 0;
+}
+
+/**
+ * lexText(const char *text, int lineNum, tokenarray_t *array)
+ * Lexes a line of text, a directive's or a pasted token's, into a token array. Each token's offset
+ * is its position in the text.
+ *
+ * param *text - the text
+ * param lineNum - the line number to give the tokens
+ * param *array - the array to append the tokens to
+ * return void
+ **/
+static void lexText(const char *text, int lineNum, tokenarray_t *array){
+  lexer_t *lexer = initBufferLexer(text, 0, strlen(text));
+  //Already on a line with a token, so a '#' is not taken for another directive
+  lexer->lastLine = lexer->lineNum;
+  token_t *token = NULL;
+  while((token = lexToken(lexer)) != NULL){
+    token->lineNum = lineNum;
+    pushToken(array, token);
+  }
+  freeLexer(lexer);
+}
+
+/**
+ * findMacro(uint32_t symbol)
+ * Looks up the macro a name is defined as
+ *
+ * param symbol - the name's symbol ID
+ * return macro_t* - returns the macro, or NULL if the name is not a macro
+ **/
+static macro_t *findMacro(uint32_t symbol){
+  return (symbol < macrosCap) ? macros[symbol] : NULL;
+}
+
+/**
+ * undefineMacro(uint32_t symbol)
+ * Frees the macro a name is defined as, if any
+ *
+ * param symbol - the name's symbol ID
+ * return void
+ **/
+static void undefineMacro(uint32_t symbol){
+  macro_t *macro = findMacro(symbol);
+  if(macro == NULL)
+    return;
+  clearTokens(&macro->body);
+  free(macro->body.tokens);
+  free(macro->params);
+  free(macro);
+  macros[symbol] = NULL;
+}
+
+/**
+ * paramIndex(macro_t *macro, token_t *token)
+ * Finds which parameter of a macro a token of its body names
+ *
+ * param *macro - the macro
+ * param *token - the token
+ * return int - returns the parameter's index, or -1 if the token is not a parameter
+ **/
+static int paramIndex(macro_t *macro, token_t *token){
+  int i;
+  if(token->type != IDENTIFIER)
+    return -1;
+  for(i = 0; i < macro->numParams; i++){
+    if(macro->params[i] == token->symbol)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * defineMacro()
+ * Runs a #define, whose tokens are in lineTokens. A macro is function-like when an open parenthesis
+ * follows its name without a space. The body tokens are moved out of lineTokens into the macro.
+ *
+ * return void
+ **/
+static void defineMacro(){
+  token_t **tokens = lineTokens.tokens;
+  size_t numTokens = lineTokens.numTokens;
+  int lineNum = tokens[0]->lineNum;
+  if(numTokens < 2 || tokens[1]->type != IDENTIFIER){
+    fprintf(stderr, "Error on line %d: #define expects a macro name.\n", lineNum);
+    exit(1);
+  }
+  token_t *name = tokens[1];
+  macro_t *macro = (macro_t *) calloc(1, sizeof(macro_t));
+  if(macro == NULL){
+    fprintf(stderr, "Failed to allocate space for macro %s.\n", name->value);
+    exit(1);
+  }
+  macro->name = name->symbol;
+  size_t i = 2;
+  if(i < numTokens && tokens[i]->type == OPEN_PAREN && tokens[i]->offset == name->offset + strlen(name->value)){
+    size_t paramsCap = 0;
+    macro->funcLike = 1;
+    if(++i < numTokens && tokens[i]->type == CLOSED_PAREN)
+      i++;
+    else{
+      for(;;){
+        if(i >= numTokens || tokens[i]->type != IDENTIFIER){
+          fprintf(stderr, "Error on line %d: Bad parameter list of macro %s.\n", lineNum, name->value);
+          exit(1);
+        }
+        if(paramIndex(macro, tokens[i]) >= 0){
+          fprintf(stderr, "Error on line %d: Duplicate parameter %s of macro %s.\n", lineNum, tokens[i]->value, name->value);
+          exit(1);
+        }
+        growArray((void **) &macro->params, &paramsCap, macro->numParams + 1, sizeof(uint32_t));
+        macro->params[macro->numParams++] = tokens[i++]->symbol;
+        if(i < numTokens && tokens[i]->type == CLOSED_PAREN){
+          i++;
+          break;
+        }
+        if(i >= numTokens || tokens[i]->type != COMMA){
+          fprintf(stderr, "Error on line %d: Bad parameter list of macro %s.\n", lineNum, name->value);
+          exit(1);
+        }
+        i++;
+      }
+    }
+  }
+  for(; i < numTokens; i++){
+    if(macro->funcLike && tokens[i]->type == HASH){
+      fprintf(stderr, "Error on line %d: # in macro %s would make a string, and strings are not supported.\n", lineNum, name->value);
+      exit(1);
+    }
+    pushToken(&macro->body, tokens[i]);
+    tokens[i] = NULL;
+  }
+  if(macro->body.numTokens > 0 && (macro->body.tokens[0]->type == HASH_HASH
+                                   || macro->body.tokens[macro->body.numTokens-1]->type == HASH_HASH)){
+    fprintf(stderr, "Error on line %d: ## cannot begin or end macro %s.\n", lineNum, name->value);
+    exit(1);
+  }
+  undefineMacro(macro->name);
+  growArray((void **) &macros, &macrosCap, (size_t) macro->name + 1, sizeof(macro_t *));
+  macros[macro->name] = macro;
+}
+
+/**
+ * directiveIs(token_t *directive, const char *word)
+ * Checks whether a DIRECTIVE token is a given directive
+ *
+ * param *directive - the DIRECTIVE token
+ * param *word - the directive's name, e.g. "ifndef"
+ * return int - returns 1 if it is, 0 otherwise
+ **/
+static int directiveIs(token_t *directive, const char *word){
+  size_t len = strlen(word);
+  return strncmp(directive->value, word, len) == 0 && !(charClass[(unsigned char) directive->value[len]] & CC_IDENT);
+}
+
+/**
+ * directiveName(token_t *directive, const char *word)
+ * Reads the macro name a directive is about, as in "#ifndef NAME" or "#define NAME ..."
+ *
+ * param *directive - the DIRECTIVE token
+ * param *word - the directive it has to be
+ * return uint32_t - returns the name's symbol ID, or NO_SYMBOL if the token is not that directive
+ **/
+static uint32_t directiveName(token_t *directive, const char *word){
+  if(directive->type != DIRECTIVE || !directiveIs(directive, word))
+    return NO_SYMBOL;
+  const char *name = directive->value + strlen(word);
+  while(charClass[(unsigned char) *name] & CC_SPACE)
+    name++;
+  size_t len = 0;
+  if(!(charClass[(unsigned char) name[0]] & CC_ALPHA))
+    return NO_SYMBOL;
+  while(charClass[(unsigned char) name[len]] & CC_IDENT)
+    len++;
+  return intern(name, len);
+}
+
+/**
+ * findGuard(tokenarray_t *tokens)
+ * Detects the include guard pattern: a header starting with #ifndef NAME and #define NAME, whose
+ * matching #endif is its last token. Once NAME is defined, including the header again adds nothing.
+ *
+ * param *tokens - the header's tokens
+ * return uint32_t - returns the guard macro's symbol ID, or NO_SYMBOL if there is no include guard
+ **/
+static uint32_t findGuard(tokenarray_t *tokens){
+  if(tokens->numTokens < 3)
+    return NO_SYMBOL;
+  uint32_t guard = directiveName(tokens->tokens[0], "ifndef");
+  if(guard == NO_SYMBOL || directiveName(tokens->tokens[1], "define") != guard)
+    return NO_SYMBOL;
+  int depth = 0;
+  size_t i;
+  for(i = 0; i < tokens->numTokens; i++){
+    token_t *token = tokens->tokens[i];
+    if(token->type != DIRECTIVE)
+      continue;
+    if(directiveIs(token, "if") || directiveIs(token, "ifdef") || directiveIs(token, "ifndef"))
+      depth++;
+    else if(depth == 1 && (directiveIs(token, "else") || directiveIs(token, "elif")))
+      return NO_SYMBOL;
+    else if(directiveIs(token, "endif") && --depth == 0)
+      return (i == tokens->numTokens - 1) ? guard : NO_SYMBOL;
+  }
+  return NO_SYMBOL;
+}
+
+/**
+ * loadHeader(pp_t *pp, const char *path)
+ * Gets a header's tokens, lexing the file the first time it is included by any translation unit
+ *
+ * param *pp - the preprocessor, to count the headers read
+ * param *path - the header's real path
+ * return header_t* - returns the header
+ **/
+static header_t *loadHeader(pp_t *pp, const char *path){
+  uint32_t key = intern(path, strlen(path));
+  if(key < headersCap && headers[key] != NULL)
+    return headers[key];
+  FILE *file = fopen(path, "r");
+  header_t *header = (header_t *) calloc(1, sizeof(header_t));
+  if(header == NULL){
+    fprintf(stderr, "Failed to allocate space for header %s.\n", path);
+    exit(1);
+  }
+  header->path = strdup(path);
+  header->dir = strdup(path);
+  if(file == NULL || header->path == NULL || header->dir == NULL){
+    fprintf(stderr, "Failed to read included file %s\n", path);
+    exit(1);
+  }
+  *strrchr(header->dir, '/') = '\0';
+  lexer_t *lexer = initLexer(file);
+  token_t *token = NULL;
+  while((token = lexToken(lexer)) != NULL)
+    pushToken(&header->tokens, token);
+  freeLexer(lexer);
+  fclose(file);
+  header->guard = findGuard(&header->tokens);
+  header->file = key;
+  pp->headersRead++;
+  growArray((void **) &headers, &headersCap, (size_t) key + 1, sizeof(header_t *));
+  headers[key] = header;
+  return header;
+}
+
+/**
+ * findHeader(pp_t *pp, const char *name, int quoted, int lineNum)
+ * Finds an included file: a "quoted" one first next to the file including it, then in the -I
+ * directories in order, which are the only place <angled> ones are looked for
+ *
+ * param *pp - the preprocessor
+ * param *name - the file name as written in the #include
+ * param quoted - 1 for "name", 0 for <name>
+ * param lineNum - the line of the #include, for errors
+ * return header_t* - returns the header
+ **/
+static header_t *findHeader(pp_t *pp, const char *name, int quoted, int lineNum){
+  char path[2*LEN_PATH];
+  char resolved[PATH_MAX];
+  if(name[0] == '/' && realpath(name, resolved) != NULL)
+    return loadHeader(pp, resolved);
+  if(name[0] != '/' && quoted){
+    const char *dir = pp->baseDir;
+    size_t i;
+    for(i = pp->numFrames; i > 0; i--){
+      if(pp->frames[i-1].header != NULL){
+        dir = pp->frames[i-1].header->dir;
+        break;
+      }
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if(realpath(path, resolved) != NULL)
+      return loadHeader(pp, resolved);
+  }
+  size_t i;
+  for(i = 0; name[0] != '/' && i < numIncludeDirs; i++){
+    snprintf(path, sizeof(path), "%s/%s", includeDirs[i], name);
+    if(realpath(path, resolved) != NULL)
+      return loadHeader(pp, resolved);
+  }
+  fprintf(stderr, "Error on line %d: Cannot find included file %s.\n", lineNum, name);
+  exit(1);
+}
+
+/**
+ * pushPPFrame(pp_t *pp, tokenarray_t *tokens)
+ * Starts reading tokens from an array, before whatever was being read
+ *
+ * param *pp - the preprocessor
+ * param *tokens - the tokens, owned by the frame unless it is a header's
+ * return ppframe_t* - returns the frame, valid until the next frame is pushed
+ **/
+static ppframe_t *pushPPFrame(pp_t *pp, tokenarray_t *tokens){
+  growArray((void **) &pp->frames, &pp->framesCap, pp->numFrames + 1, sizeof(ppframe_t));
+  ppframe_t *frame = &pp->frames[pp->numFrames++];
+  memset(frame, 0, sizeof(ppframe_t));
+  frame->tokens = *tokens;
+  return frame;
+}
+
+/**
+ * popPPFrame(pp_t *pp)
+ * Finishes reading the top frame: a macro can expand again once its expansion is read, and a header
+ * has to close every #if it opened
+ *
+ * param *pp - the preprocessor
+ * return void
+ **/
+static void popPPFrame(pp_t *pp){
+  ppframe_t *frame = &pp->frames[--pp->numFrames];
+  if(frame->macro != NULL)
+    frame->macro->disabled = 0;
+  if(frame->header == NULL){
+    free(frame->tokens.tokens);
+    return;
+  }
+  if(pp->numConds > pp->condBase){
+    fprintf(stderr, "Error on line %d: Unterminated #if in %s.\n", pp->conds[pp->numConds-1].lineNum, frame->header->path);
+    exit(1);
+  }
+  pp->condBase = frame->condBase;
+  pp->includeDepth--;
+}
+
+/**
+ * ppRead(pp_t *pp)
+ * Reads the next token, unexpanded: a token pushed back, then the top frame's, then once every frame
+ * is read, the raw token stream's (unless a macro argument is being expanded on its own)
+ *
+ * param *pp - the preprocessor
+ * return token_t* - returns the token, owned by the caller, or NULL at the end
+ **/
+static token_t *ppRead(pp_t *pp){
+  token_t *token = pp->pushback;
+  if(token != NULL){
+    pp->pushback = NULL;
+    return token;
+  }
+  while(pp->numFrames > pp->floor){
+    ppframe_t *frame = &pp->frames[pp->numFrames-1];
+    if(frame->next < frame->tokens.numTokens){
+      token = frame->tokens.tokens[frame->next++];
+      if(frame->header == NULL)
+        return token;
+      token = copyToken(token);
+      token->lineNum += frame->lineDelta;
+      token->file = frame->header->file;
+      return token;
+    }
+    popPPFrame(pp);
+  }
+  if(pp->isolated)
+    return NULL;
+  token = pullRawToken(pp->base);
+  if(token != NULL)
+    token->lineNum += pp->baseLineDelta;
+  return token;
+}
+
+/**
+ * skipping(pp_t *pp)
+ * Checks whether the tokens being read are in an #if group that is left out
+ *
+ * param *pp - the preprocessor
+ * return int - returns 1 if they are skipped, 0 otherwise
+ **/
+static int skipping(pp_t *pp){
+  return pp->numConds > 0 && !pp->conds[pp->numConds-1].active;
+}
+
+/**
+ * expandTokens(pp_t *pp, tokenarray_t *array)
+ * Macro expands an array of tokens on its own, as a macro argument is expanded before it is
+ * substituted: a macro call in there cannot take tokens from past its end.
+ *
+ * param *pp - the preprocessor
+ * param *array - the tokens, replaced by their expansion
+ * return void
+ **/
+static void expandTokens(pp_t *pp, tokenarray_t *array){
+  if(array->numTokens == 0)
+    return;
+  if(++pp->expansionDepth > MAX_EXPANSION_DEPTH){
+    fprintf(stderr, "Error on line %d: Macro calls nested too deeply.\n", array->tokens[0]->lineNum);
+    exit(1);
+  }
+  size_t savedFloor = pp->floor;
+  int savedIsolated = pp->isolated;
+  token_t *savedPushback = pp->pushback;
+  pp->pushback = NULL;
+  pushPPFrame(pp, array);
+  pp->floor = pp->numFrames - 1;
+  pp->isolated = 1;
+  tokenarray_t expansion = {NULL, 0, 0};
+  token_t *token = NULL;
+  while((token = ppNext(pp)) != NULL)
+    pushToken(&expansion, token);
+  pp->floor = savedFloor;
+  pp->isolated = savedIsolated;
+  pp->pushback = savedPushback;
+  pp->expansionDepth--;
+  *array = expansion;
+}
+
+/**
+ * collectArguments(pp_t *pp, macro_t *macro, token_t *name)
+ * Reads the arguments of a call of a function-like macro, up to its closing parenthesis. Arguments are
+ * split at the commas outside of nested parentheses.
+ *
+ * param *pp - the preprocessor, just past the call's open parenthesis
+ * param *macro - the macro called
+ * param *name - the macro name token of the call
+ * return tokenarray_t* - returns an array of macro->numParams arguments
+ **/
+static tokenarray_t *collectArguments(pp_t *pp, macro_t *macro, token_t *name){
+  tokenarray_t *args = NULL;
+  size_t argsCap = 0;
+  int numArgs = 1;
+  int depth = 0;
+  growArray((void **) &args, &argsCap, 1, sizeof(tokenarray_t));
+  memset(args, 0, sizeof(tokenarray_t));
+  for(;;){
+    token_t *token = ppRead(pp);
+    if(token == NULL){
+      fprintf(stderr, "Error on line %d: Unterminated call of macro %s.\n", name->lineNum, name->value);
+      exit(1);
+    }
+    if(token->type == DIRECTIVE){
+      fprintf(stderr, "Error on line %d: Directive inside the arguments of macro %s.\n", token->lineNum, name->value);
+      exit(1);
+    }
+    if(depth == 0 && (token->type == CLOSED_PAREN || token->type == COMMA)){
+      TOKEN_TYPE type = token->type;
+      freeToken(token);
+      if(type == CLOSED_PAREN)
+        break;
+      growArray((void **) &args, &argsCap, numArgs + 1, sizeof(tokenarray_t));
+      memset(&args[numArgs++], 0, sizeof(tokenarray_t));
+      continue;
+    }
+    depth += (token->type == OPEN_PAREN) - (token->type == CLOSED_PAREN);
+    pushToken(&args[numArgs-1], token);
+  }
+  //F() passes no arguments to a macro without parameters
+  if(macro->numParams == 0 && numArgs == 1 && args[0].numTokens == 0)
+    numArgs = 0;
+  if(numArgs != macro->numParams){
+    fprintf(stderr, "Error on line %d: Macro %s takes %d arguments, %d given.\n", name->lineNum, name->value,
+            macro->numParams, numArgs);
+    exit(1);
+  }
+  return args;
+}
+
+/**
+ * pasteTokens(token_t *left, token_t *right)
+ * Pastes two tokens together with ##, the spellings joined having to make a single token
+ *
+ * param *left - the token on the left of ##
+ * param *right - the token on the right
+ * return token_t* - returns the new token
+ **/
+static token_t *pasteTokens(token_t *left, token_t *right){
+  size_t len = strlen(left->value) + strlen(right->value);
+  char *text = malloc(len + 1);
+  if(text == NULL){
+    fprintf(stderr, "Failed to allocate space for pasted token.\n");
+    exit(1);
+  }
+  snprintf(text, len + 1, "%s%s", left->value, right->value);
+  lexer_t *lexer = initBufferLexer(text, 0, len);
+  lexer->lastLine = lexer->lineNum;
+  token_t *token = lexToken(lexer);
+  if(token == NULL || lexer->pos != len){
+    fprintf(stderr, "Error on line %d: Pasting %s and %s does not give a valid token.\n", left->lineNum, left->value,
+            right->value);
+    exit(1);
+  }
+  token->lineNum = left->lineNum;
+  token->file = left->file;
+  token->offset = left->offset;
+  freeLexer(lexer);
+  free(text);
+  return token;
+}
+
+/**
+ * appendCopies(tokenarray_t *array, tokenarray_t *tokens, size_t from, token_t *name)
+ * Appends copies of tokens to an expansion, placed at the macro call
+ *
+ * param *array - the expansion
+ * param *tokens - the tokens to copy
+ * param from - the first token to copy
+ * param *name - the macro name token of the call
+ * return void
+ **/
+static void appendCopies(tokenarray_t *array, tokenarray_t *tokens, size_t from, token_t *name){
+  for(; from < tokens->numTokens; from++){
+    token_t *copy = copyToken(tokens->tokens[from]);
+    copy->lineNum = name->lineNum;
+    copy->file = name->file;
+    copy->offset = name->offset;
+    pushToken(array, copy);
+  }
+}
+
+/**
+ * substituteMacro(pp_t *pp, macro_t *macro, tokenarray_t *args, token_t *name, tokenarray_t *expansion)
+ * Builds the expansion of a macro call from its body. A parameter is replaced by its argument
+ * macro expanded, except next to ## where the argument is pasted as written; an empty argument
+ * pastes as nothing.
+ *
+ * param *pp - the preprocessor
+ * param *macro - the macro called
+ * param *args - the call's arguments, NULL for an object-like macro
+ * param *name - the macro name token of the call
+ * param *expansion - filled with the expansion
+ * return void
+ **/
+static void substituteMacro(pp_t *pp, macro_t *macro, tokenarray_t *args, token_t *name, tokenarray_t *expansion){
+  tokenarray_t *expanded = NULL;
+  if(macro->numParams > 0){
+    expanded = (tokenarray_t *) calloc(macro->numParams, sizeof(tokenarray_t));
+    if(expanded == NULL){
+      fprintf(stderr, "Failed to allocate space for macro arguments.\n");
+      exit(1);
+    }
+  }
+  int *isExpanded = (int *) calloc(macro->numParams + 1, sizeof(int));
+  if(isExpanded == NULL){
+    fprintf(stderr, "Failed to allocate space for macro arguments.\n");
+    exit(1);
+  }
+  token_t **body = macro->body.tokens;
+  size_t numBody = macro->body.numTokens;
+  //Whether what the last ## operand appended was an empty argument
+  int leftEmpty = 0;
+  size_t i;
+  for(i = 0; i < numBody; i++){
+    token_t *token = body[i];
+    tokenarray_t single = {&body[i], 1, 1};
+    if(token->type == HASH_HASH){
+      int param = paramIndex(macro, body[++i]);
+      single.tokens = &body[i];
+      tokenarray_t *right = (param >= 0) ? &args[param] : &single;
+      if(right->numTokens == 0)
+        continue;
+      if(leftEmpty)
+        appendCopies(expansion, right, 0, name);
+      else{
+        token_t *left = expansion->tokens[--expansion->numTokens];
+        pushToken(expansion, pasteTokens(left, right->tokens[0]));
+        freeToken(left);
+        appendCopies(expansion, right, 1, name);
+      }
+      leftEmpty = 0;
+      continue;
+    }
+    int param = paramIndex(macro, token);
+    if(param < 0){
+      appendCopies(expansion, &single, 0, name);
+      leftEmpty = 0;
+    }
+    else if(i + 1 < numBody && body[i+1]->type == HASH_HASH){
+      appendCopies(expansion, &args[param], 0, name);
+      leftEmpty = (args[param].numTokens == 0);
+    }
+    else{
+      if(!isExpanded[param]){
+        appendCopies(&expanded[param], &args[param], 0, name);
+        expandTokens(pp, &expanded[param]);
+        isExpanded[param] = 1;
+      }
+      appendCopies(expansion, &expanded[param], 0, name);
+    }
+  }
+  int param;
+  for(param = 0; param < macro->numParams; param++){
+    clearTokens(&expanded[param]);
+    free(expanded[param].tokens);
+  }
+  free(expanded);
+  free(isExpanded);
+}
+
+/**
+ * expandMacro(pp_t *pp, macro_t *macro, token_t *name)
+ * Expands a macro name read: its expansion is read next, with the macro disabled until it has been.
+ * A function-like macro name not followed by an open parenthesis is not a call, and stays a name.
+ *
+ * param *pp - the preprocessor
+ * param *macro - the macro the name is defined as
+ * param *name - the name token, freed if it was expanded
+ * return int - returns 1 if the name was expanded, 0 otherwise
+ **/
+static int expandMacro(pp_t *pp, macro_t *macro, token_t *name){
+  tokenarray_t *args = NULL;
+  if(macro->funcLike){
+    token_t *next = ppRead(pp);
+    if(next == NULL || next->type != OPEN_PAREN){
+      pp->pushback = next;
+      return 0;
+    }
+    freeToken(next);
+    args = collectArguments(pp, macro, name);
+  }
+  tokenarray_t expansion = {NULL, 0, 0};
+  substituteMacro(pp, macro, args, name, &expansion);
+  int param;
+  for(param = 0; args != NULL && param < macro->numParams; param++){
+    clearTokens(&args[param]);
+    free(args[param].tokens);
+  }
+  free(args);
+  ppframe_t *frame = pushPPFrame(pp, &expansion);
+  frame->macro = macro;
+  macro->disabled = 1;
+  freeToken(name);
+  return 1;
+}
+
+/**
+ * evaluateCondition(pp_t *pp, int lineNum)
+ * Evaluates the expression of an #if or #elif in lineTokens: defined NAME and defined(NAME) become 1
+ * or 0, macros are expanded, names left become 0, and the result is parsed as an expression and folded.
+ *
+ * param *pp - the preprocessor
+ * param lineNum - the line of the directive
+ * return int - returns 1 if the expression is true, 0 otherwise
+ **/
+static int evaluateCondition(pp_t *pp, int lineNum){
+  tokenarray_t expr = {NULL, 0, 0};
+  token_t **tokens = lineTokens.tokens;
+  size_t numTokens = lineTokens.numTokens;
+  size_t i;
+  for(i = 1; i < numTokens; i++){
+    if(tokens[i]->type != IDENTIFIER || strcmp(tokens[i]->value, "defined") != 0){
+      pushToken(&expr, copyToken(tokens[i]));
+      continue;
+    }
+    int paren = (i + 1 < numTokens && tokens[i+1]->type == OPEN_PAREN);
+    size_t nameIndex = i + 1 + paren;
+    if(nameIndex >= numTokens || tokens[nameIndex]->type != IDENTIFIER
+       || (paren && (nameIndex + 1 >= numTokens || tokens[nameIndex+1]->type != CLOSED_PAREN))){
+      fprintf(stderr, "Error on line %d: defined expects a macro name.\n", lineNum);
+      exit(1);
+    }
+    pushToken(&expr, createToken(strdup(findMacro(tokens[nameIndex]->symbol) != NULL ? "1" : "0"), INT_LITERAL, lineNum));
+    i = nameIndex + paren;
+  }
+  expandTokens(pp, &expr);
+  if(expr.numTokens == 0){
+    fprintf(stderr, "Error on line %d: #if with no expression.\n", lineNum);
+    exit(1);
+  }
+  tokenlist_t *list = initTokenlist();
+  for(i = 0; i < expr.numTokens; i++){
+    token_t *token = expr.tokens[i];
+    if(token->type == IDENTIFIER){
+      freeToken(token);
+      token = createToken(strdup("0"), INT_LITERAL, lineNum);
+    }
+    appendToken(list, token);
+  }
+  free(expr.tokens);
+  astnode_t *value = parseExpression(list);
+  if(peek(list)->type != END_OF_INPUT){
+    fprintf(stderr, "Error on line %d: Unexpected %s after the #if expression.\n", lineNum, peek(list)->value);
+    exit(1);
+  }
+  foldExpression(&value);
+  if(value->nodeType != INTEGER){
+    fprintf(stderr, "Error on line %d: #if expression divides by zero.\n", lineNum);
+    exit(1);
+  }
+  freeTokens(list);
+  return value->fields.intVal != 0;
+}
+
+/**
+ * pushCondition(pp_t *pp, int value, int lineNum)
+ * Opens an #if group
+ *
+ * param *pp - the preprocessor
+ * param value - whether the condition is true
+ * param lineNum - the line of the directive
+ * return void
+ **/
+static void pushCondition(pp_t *pp, int value, int lineNum){
+  int outerActive = !skipping(pp);
+  growArray((void **) &pp->conds, &pp->condsCap, pp->numConds + 1, sizeof(ppcond_t));
+  ppcond_t *cond = &pp->conds[pp->numConds++];
+  cond->outerActive = outerActive;
+  cond->active = outerActive && value;
+  cond->taken = cond->active;
+  cond->sawElse = 0;
+  cond->lineNum = lineNum;
+}
+
+/**
+ * currentCondition(pp_t *pp, const char *word, int lineNum)
+ * Finds the #if group an #elif, #else or #endif belongs to, in the file it is in
+ *
+ * param *pp - the preprocessor
+ * param *word - the directive
+ * param lineNum - the line of the directive
+ * return ppcond_t* - returns the group
+ **/
+static ppcond_t *currentCondition(pp_t *pp, const char *word, int lineNum){
+  if(pp->numConds <= pp->condBase){
+    fprintf(stderr, "Error on line %d: #%s without #if.\n", lineNum, word);
+    exit(1);
+  }
+  ppcond_t *cond = &pp->conds[pp->numConds-1];
+  if(cond->sawElse && strcmp(word, "endif") != 0){
+    fprintf(stderr, "Error on line %d: #%s after #else.\n", lineNum, word);
+    exit(1);
+  }
+  return cond;
+}
+
+/**
+ * includeFile(pp_t *pp, token_t *directive)
+ * Runs an #include: the header's tokens are read next, unless its #pragma once was already seen in
+ * this translation unit or its include guard macro is defined, when it would add nothing
+ *
+ * param *pp - the preprocessor
+ * param *directive - the DIRECTIVE token
+ * return void
+ **/
+static void includeFile(pp_t *pp, token_t *directive){
+  const char *text = directive->value + strlen("include");
+  while(charClass[(unsigned char) *text] & CC_SPACE)
+    text++;
+  char close = (*text == '"') ? '"' : ((*text == '<') ? '>' : '\0');
+  const char *end = (close != '\0') ? strchr(text + 1, close) : NULL;
+  if(end == NULL || end == text + 1){
+    fprintf(stderr, "Error on line %d: #include expects \"file\" or <file>.\n", directive->lineNum);
+    exit(1);
+  }
+  char name[LEN_PATH];
+  snprintf(name, LEN_PATH, "%.*s", (int) (end - text - 1), text + 1);
+  header_t *header = findHeader(pp, name, close == '"', directive->lineNum);
+  pp->includes++;
+  if(header->onceUnit == translationUnit || (header->guard != NO_SYMBOL && findMacro(header->guard) != NULL)){
+    pp->skippedIncludes++;
+    return;
+  }
+  if(pp->includeDepth >= MAX_INCLUDE_DEPTH){
+    fprintf(stderr, "Error on line %d: #include nested too deeply.\n", directive->lineNum);
+    exit(1);
+  }
+  ppframe_t *frame = pushPPFrame(pp, &header->tokens);
+  frame->header = header;
+  frame->condBase = pp->condBase;
+  pp->condBase = pp->numConds;
+  pp->includeDepth++;
+}
+
+/**
+ * setLine(pp_t *pp, token_t *number, int lineNum)
+ * Runs a #line (or a "# 12 file" line marker as cpp writes them): the next line of the file the
+ * directive is in is numbered as given
+ *
+ * param *pp - the preprocessor
+ * param *number - the INT_LITERAL with the new line number
+ * param lineNum - the line of the directive
+ * return void
+ **/
+static void setLine(pp_t *pp, token_t *number, int lineNum){
+  if(number == NULL || number->type != INT_LITERAL){
+    fprintf(stderr, "Error on line %d: #line expects a line number.\n", lineNum);
+    exit(1);
+  }
+  //Directives only come from the base stream and headers, and the header one is in is the top frame
+  int *lineDelta = (pp->numFrames > 0) ? &pp->frames[pp->numFrames-1].lineDelta : &pp->baseLineDelta;
+  *lineDelta += atoi(number->value) - (lineNum + 1);
+}
+
+/**
+ * runDirective(pp_t *pp, token_t *directive)
+ * Runs a directive. Conditional directives are followed even in a group that is skipped, the others
+ * only outside of one.
+ *
+ * param *pp - the preprocessor
+ * param *directive - the DIRECTIVE token
+ * return void
+ **/
+static void runDirective(pp_t *pp, token_t *directive){
+  int lineNum = directive->lineNum;
+  clearTokens(&lineTokens);
+  lexText(directive->value, lineNum, &lineTokens);
+  //A lone # does nothing
+  if(lineTokens.numTokens == 0)
+    return;
+  const char *word = lineTokens.tokens[0]->value;
+  token_t *operand = (lineTokens.numTokens > 1) ? lineTokens.tokens[1] : NULL;
+  int skipped = skipping(pp);
+  if(strcmp(word, "if") == 0)
+    pushCondition(pp, !skipped && evaluateCondition(pp, lineNum), lineNum);
+  else if(strcmp(word, "ifdef") == 0 || strcmp(word, "ifndef") == 0){
+    if(operand == NULL || operand->type != IDENTIFIER){
+      fprintf(stderr, "Error on line %d: #%s expects a macro name.\n", lineNum, word);
+      exit(1);
+    }
+    pushCondition(pp, (findMacro(operand->symbol) != NULL) == (word[2] == 'd'), lineNum);
+  }
+  else if(strcmp(word, "elif") == 0){
+    ppcond_t *cond = currentCondition(pp, word, lineNum);
+    cond->active = cond->outerActive && !cond->taken && evaluateCondition(pp, lineNum);
+    cond->taken |= cond->active;
+  }
+  else if(strcmp(word, "else") == 0){
+    ppcond_t *cond = currentCondition(pp, word, lineNum);
+    cond->active = cond->outerActive && !cond->taken;
+    cond->taken = 1;
+    cond->sawElse = 1;
+  }
+  else if(strcmp(word, "endif") == 0){
+    currentCondition(pp, word, lineNum);
+    pp->numConds--;
+  }
+  else if(skipped)
+    return;
+  else if(strcmp(word, "define") == 0)
+    defineMacro();
+  else if(strcmp(word, "undef") == 0){
+    if(operand == NULL || operand->type != IDENTIFIER){
+      fprintf(stderr, "Error on line %d: #undef expects a macro name.\n", lineNum);
+      exit(1);
+    }
+    undefineMacro(operand->symbol);
+  }
+  else if(strcmp(word, "include") == 0)
+    includeFile(pp, directive);
+  else if(strcmp(word, "pragma") == 0){
+    //Other pragmas are ignored
+    if(operand != NULL && strcmp(operand->value, "once") == 0 && pp->numFrames > 0)
+      pp->frames[pp->numFrames-1].header->onceUnit = translationUnit;
+  }
+  else if(strcmp(word, "line") == 0)
+    setLine(pp, operand, lineNum);
+  else if(lineTokens.tokens[0]->type == INT_LITERAL)
+    setLine(pp, lineTokens.tokens[0], lineNum);
+  else if(strcmp(word, "error") == 0){
+    fprintf(stderr, "Error on line %d: #%s\n", lineNum, directive->value);
+    exit(1);
+  }
+  else if(strcmp(word, "warning") == 0)
+    fprintf(stderr, "Warning on line %d: #%s\n", lineNum, directive->value);
+  else{
+    fprintf(stderr, "Error on line %d: Unknown directive #%s.\n", lineNum, word);
+    exit(1);
+  }
+}
+
+/**
+ * ppNext(pp_t *pp)
+ * Gives the parser its next token: directives are run, skipped groups dropped and macros expanded.
+ * While a macro argument is expanded on its own, gives the next token of its expansion instead.
+ *
+ * param *pp - the preprocessor
+ * return token_t* - returns the next token, or NULL at the end of the input
+ **/
+token_t *ppNext(pp_t *pp){
+  token_t *token = NULL;
+  while((token = ppRead(pp)) != NULL){
+    if(token->type == DIRECTIVE){
+      runDirective(pp, token);
+      freeToken(token);
+      continue;
+    }
+    if(!pp->isolated && skipping(pp)){
+      freeToken(token);
+      continue;
+    }
+    macro_t *macro = (token->type == IDENTIFIER) ? findMacro(token->symbol) : NULL;
+    if(macro != NULL && !macro->disabled && expandMacro(pp, macro, token))
+      continue;
+    return token;
+  }
+  if(!pp->isolated && pp->numConds > 0){
+    fprintf(stderr, "Error on line %d: Unterminated #if.\n", pp->conds[pp->numConds-1].lineNum);
+    exit(1);
+  }
+  return NULL;
+}
+
+/**
+ * preprocess(tokenlist_t *tokens)
+ * Attaches a preprocessor to a token stream, so the parser reads it preprocessed. Each call starts
+ * a translation unit: only the -D macros are defined, but headers read before are not read again.
+ *
+ * param *tokens - the raw token stream of the source file
+ * return void
+ **/
+void preprocess(tokenlist_t *tokens){
+  pp_t *pp = (pp_t *) calloc(1, sizeof(pp_t));
+  if(pp == NULL){
+    fprintf(stderr, "Failed to allocate space for the preprocessor.\n");
+    exit(1);
+  }
+  pp->base = tokens;
+  translationUnit++;
+  //Included files are looked for next to the source first
+  const char *slash = strrchr(sourcePath, '/');
+  if(strcmp(sourcePath, "-") == 0 || slash == NULL)
+    snprintf(pp->baseDir, LEN_PATH, ".");
+  else
+    snprintf(pp->baseDir, LEN_PATH, "%.*s", (int) (slash - sourcePath), sourcePath);
+  size_t i;
+  for(i = 0; i < numMacroOptions; i++){
+    char text[LEN_PATH];
+    const char *equals = strchr(macroOptions[i], '=');
+    if(equals == NULL)
+      snprintf(text, LEN_PATH, "define %s 1", macroOptions[i]);
+    else
+      snprintf(text, LEN_PATH, "define %.*s %s", (int) (equals - macroOptions[i]), macroOptions[i], equals + 1);
+    clearTokens(&lineTokens);
+    lexText(text, 0, &lineTokens);
+    defineMacro();
+  }
+  tokens->pp = pp;
+  tokens->ppNext = ppNext;
+}
+
+/**
+ * freePreprocessor(tokenlist_t *tokens)
+ * Detaches and frees the preprocessor of a token stream, and the macros of its translation unit
+ *
+ * param *tokens - the token stream
+ * return void
+ **/
+void freePreprocessor(tokenlist_t *tokens){
+  if(tokens == NULL || tokens->pp == NULL)
+    return;
+  pp_t *pp = tokens->pp;
+  if(verbose)
+    fprintf(stderr, "Preprocessor: %d includes, %d skipped by include guards and #pragma once, %d headers read\n",
+            pp->includes, pp->skippedIncludes, pp->headersRead);
+  uint32_t symbol;
+  for(symbol = 0; symbol < macrosCap; symbol++)
+    undefineMacro(symbol);
+  if(pp->pushback != NULL)
+    freeToken(pp->pushback);
+  free(pp->frames);
+  free(pp->conds);
+  free(pp);
+  tokens->pp = NULL;
+  tokens->ppNext = NULL;
+}
+
+/**
+ * freeHeaders()
+ * Frees every header read, once no more files are compiled
+ *
+ * return void
+ **/
+void freeHeaders(){
+  size_t i;
+  for(i = 0; i < headersCap; i++){
+    if(headers[i] == NULL)
+      continue;
+    clearTokens(&headers[i]->tokens);
+    free(headers[i]->tokens.tokens);
+    free(headers[i]->path);
+    free(headers[i]->dir);
+    free(headers[i]);
+  }
+  free(headers);
+  headers = NULL;
+  headersCap = 0;
+  clearTokens(&lineTokens);
+  free(lineTokens.tokens);
+  lineTokens.tokens = NULL;
+  lineTokens.tokensCap = 0;
+}
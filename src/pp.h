@@ -0,0 +1,96 @@
+#ifndef PP_H_
+#define PP_H_
+
+#include "lex.h"
+#include <stdint.h>
+
+//Deepest nesting of #include, and of macro calls in the arguments of macro calls
+#define MAX_INCLUDE_DEPTH 200
+#define MAX_EXPANSION_DEPTH 200
+
+//A growable array of tokens
+typedef struct tokenarray_t {
+  token_t **tokens;
+  size_t numTokens;
+  size_t tokensCap;
+} tokenarray_t;
+
+//A #define: its replacement tokens, and for a function-like macro the symbols of its parameters.
+//A macro is disabled while its own expansion is being read, so it does not expand again in there.
+typedef struct macro_t {
+  uint32_t name;
+  int funcLike;
+  uint32_t *params;
+  int numParams;
+  tokenarray_t body;
+  int disabled;
+} macro_t;
+
+//A header as lexed, shared by every #include of it in every file compiled. guard is the macro of
+//its include guard (an #ifndef and #define of the same macro around the whole header), NO_SYMBOL if
+//it has none, onceUnit the translation unit that last read its #pragma once, and file the interned
+//path its tokens are marked with as they are read, see token_t.
+typedef struct header_t {
+  char *path;
+  char *dir;
+  tokenarray_t tokens;
+  uint32_t guard;
+  int onceUnit;
+  uint32_t file;
+} header_t;
+
+//A source of tokens being read: the expansion of a macro (tokens owned, macro re-enabled when done),
+//an included header (tokens borrowed from its header_t and copied as they are read), or the tokens of a
+//macro argument being expanded on their own
+typedef struct ppframe_t {
+  tokenarray_t tokens;
+  size_t next;
+  macro_t *macro;
+  header_t *header;
+  int condBase;
+  int lineDelta;
+} ppframe_t;
+
+//An #if group: whether its tokens are being kept, whether one of the group's branches was already
+//taken, whether #else was seen, and whether the enclosing group is kept
+typedef struct ppcond_t {
+  int active;
+  int taken;
+  int sawElse;
+  int outerActive;
+  int lineNum;
+} ppcond_t;
+
+//Preprocessor state of a translation unit, baseDir being the source file's directory. Tokens come from
+//the top frame, or from the raw token stream once there are none; floor frames at the bottom belong to
+//an expansion further out when a macro argument is being expanded on its own (isolated).
+typedef struct pp_t {
+  tokenlist_t *base;
+  char baseDir[LEN_PATH];
+  int baseLineDelta;
+  ppframe_t *frames;
+  size_t numFrames;
+  size_t framesCap;
+  size_t floor;
+  int isolated;
+  int expansionDepth;
+  int includeDepth;
+  token_t *pushback;
+  ppcond_t *conds;
+  int numConds;
+  size_t condsCap;
+  int condBase;
+  int includes;
+  int skippedIncludes;
+  int headersRead;
+} pp_t;
+
+void addIncludeDir(const char *dir);
+void addMacroOption(const char *spec);
+int hasMacroOptions();
+void preprocess(tokenlist_t *tokens);
+token_t *ppNext(pp_t *pp);
+void freePreprocessor(tokenlist_t *tokens);
+void freeHeaders();
+
+#endif // PP_H_
@@ -0,0 +1,388 @@
+#include "prof.h"
+#include "gen.h"
+#include "opt.h"
+#include "dump.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//-fprofile-generate or -fprofile-use, and the profile file given with it ("" for the default)
+PROFILE_MODE profileMode = PROFILE_NONE;
+char profileOption[LEN_PATH];
+//The profile file of the current translation unit, see setProfilePath()
+char profilePath[LEN_PATH];
+//Counters of the current translation unit and the checksum of where they are, see assignCounters()
+static int numCounters = 0;
+static uint32_t profileChecksum = 0;
+//Counts read by loadProfile(), NULL without a usable profile, and the largest of them
+static uint64_t *profileCounts = NULL;
+static uint64_t maxCount = 0;
+//Stack of assignCounters()'s walk
+static astnode_t **counterStack = NULL;
+static size_t counterStackCap = 0;
+
+//Writes the counters to the profile file when the instrumented program exits: opens it (i386
+//Linux system calls, as the program may not use libc), adds in the counts of earlier runs if its
+//header matches, and writes the header and counters back. Labels are local to the assembly file.
+static const char *dumpCode =
+  "_prof.dump:\n"
+  " push %%ebx\n"
+  " push %%esi\n"
+  " push %%edi\n"
+  //open(path, O_RDWR | O_CREAT, 0644)
+  " movl $5, %%eax\n"
+  " movl $_prof.path, %%ebx\n"
+  " movl $0x42, %%ecx\n"
+  " movl $0x1a4, %%edx\n"
+  " int $0x80\n"
+  " testl %%eax, %%eax\n"
+  " js _prof.done\n"
+  " movl %%eax, %%esi\n"
+  " movl $3, %%eax\n"
+  " movl %%esi, %%ebx\n"
+  " movl $_prof.scratch, %%ecx\n"
+  " movl $%d, %%edx\n"
+  " int $0x80\n"
+  " cmpl $%d, %%eax\n"
+  " jne _prof.write\n"
+  " movl $0, %%edi\n"
+  "_prof.header:\n"
+  " movl _prof.scratch(%%edi), %%eax\n"
+  " cmpl _prof.data(%%edi), %%eax\n"
+  " jne _prof.write\n"
+  " addl $4, %%edi\n"
+  " cmpl $12, %%edi\n"
+  " jne _prof.header\n"
+  " movl $0, %%edi\n"
+  "_prof.add:\n"
+  " movl _prof.scratch+16(,%%edi,8), %%eax\n"
+  " movl _prof.scratch+20(,%%edi,8), %%edx\n"
+  " addl %%eax, _prof.counters(,%%edi,8)\n"
+  " adcl %%edx, _prof.counters+4(,%%edi,8)\n"
+  " incl %%edi\n"
+  " cmpl $%d, %%edi\n"
+  " jne _prof.add\n"
+  //lseek(fd, 0, SEEK_SET), write, ftruncate (an older program's profile may be longer), close
+  "_prof.write:\n"
+  " movl $19, %%eax\n"
+  " movl %%esi, %%ebx\n"
+  " xorl %%ecx, %%ecx\n"
+  " xorl %%edx, %%edx\n"
+  " int $0x80\n"
+  " movl $4, %%eax\n"
+  " movl %%esi, %%ebx\n"
+  " movl $_prof.data, %%ecx\n"
+  " movl $%d, %%edx\n"
+  " int $0x80\n"
+  " movl $93, %%eax\n"
+  " movl %%esi, %%ebx\n"
+  " movl $%d, %%ecx\n"
+  " int $0x80\n"
+  " movl $6, %%eax\n"
+  " movl %%esi, %%ebx\n"
+  " int $0x80\n"
+  "_prof.done:\n"
+  " pop %%edi\n"
+  " pop %%esi\n"
+  " pop %%ebx\n"
+  " ret\n"
+  " .section .fini_array,\"aw\"\n"
+  " .p2align 2\n"
+  " .long _prof.dump\n"
+  " .text\n";
+
+/**
+ * setProfileOption(PROFILE_MODE mode, const char *path)
+ * Turns on -fprofile-generate or -fprofile-use. Instrumented code has to count every call and
+ * loop the profile is read for, so -fprofile-generate turns off inlining and unrolling.
+ *
+ * param mode - PROFILE_GENERATE or PROFILE_USE
+ * param *path - the profile file, "" for <output>.prof
+ * return void
+ **/
+void setProfileOption(PROFILE_MODE mode, const char *path){
+  profileMode = mode;
+  strncpy(profileOption, path, LEN_PATH-1);
+  if(mode == PROFILE_GENERATE)
+    optFlags &= ~(OPT_INLINE | OPT_UNROLL);
+}
+
+/**
+ * setProfilePath()
+ * Sets the profile file of the current translation unit: the one given, or the output path with
+ * its .s extension replaced by .prof. The instrumented program may run anywhere, so it gets an
+ * absolute path.
+ *
+ * return void
+ **/
+static void setProfilePath(){
+  char path[2*LEN_PATH];
+  defaultOutPath();
+  if(profileOption[0] != '\0')
+    snprintf(path, sizeof(path), "%s", profileOption);
+  else if(strcmp(outPath, "-") == 0){
+    fprintf(stderr, "Name the profile file with -fprofile-%s=<file> when writing to stdout.\n",
+            (profileMode == PROFILE_GENERATE) ? "generate" : "use");
+    exit(1);
+  }
+  else{
+    int outLen = strnlen(outPath, LEN_PATH);
+    if(outLen > 2 && strcmp(&outPath[outLen-2], ".s") == 0)
+      outLen -= 2;
+    snprintf(path, sizeof(path), "%.*s.prof", outLen, outPath);
+  }
+  char cwd[LEN_PATH];
+  if(profileMode == PROFILE_GENERATE && path[0] != '/' && getcwd(cwd, LEN_PATH) != NULL){
+    char relative[LEN_PATH];
+    strncpy(relative, path, LEN_PATH-1);
+    relative[LEN_PATH-1] = '\0';
+    snprintf(path, sizeof(path), "%s/%s", cwd, relative);
+  }
+  if(strnlen(path, sizeof(path)) >= LEN_PATH){
+    fprintf(stderr, "Profile file path too long: %s\n", path);
+    exit(1);
+  }
+  strcpy(profilePath, path);
+}
+
+/**
+ * countersNeeded(astnode_t *node)
+ * Says how many counters a node gets, see COUNT_REACHED and COUNT_TAKEN. Blocks (ifs with a
+ * constant condition) get none.
+ *
+ * param *node - the node
+ * return int - returns the number of counters
+ **/
+static int countersNeeded(astnode_t *node){
+  switch(node->nodeType){
+  case FUNCTION:
+  case CALL:
+    return 1;
+  case IF:
+    return (node->fields.children.left->nodeType == INTEGER) ? 0 : 2;
+  case WHILE:
+  case DO_WHILE:
+    return 2;
+  case BINARY_OP:
+    return (strcmp(node->fields.children.middle->fields.strVal, "&&") == 0
+            || strcmp(node->fields.children.middle->fields.strVal, "||") == 0) ? 2 : 0;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * assignCounters(astnode_t *root)
+ * Numbers the counters of a freshly parsed program, in source order, for -fprofile-generate and
+ * -fprofile-use alike: it runs before the optimizer copies or removes any node, so both number
+ * them the same way. The checksum of where the counters are tells a profile of another program
+ * apart. Then sets the profile file, and reads it for -fprofile-use.
+ *
+ * param *root - the first PROGRAM node of the program
+ * return void
+ **/
+void assignCounters(astnode_t *root){
+  numCounters = 0;
+  profileChecksum = 2166136261u;
+  astnode_t *program = NULL;
+  for(program = root; program != NULL; program = program->fields.children.right){
+    size_t depth = 0;
+    growArray((void **) &counterStack, &counterStackCap, 1, sizeof(astnode_t *));
+    counterStack[depth++] = program->fields.children.left;
+    while(depth > 0){
+      astnode_t *node = counterStack[--depth];
+      if(node == NULL || node->nodeType == INTEGER || node->nodeType == SYMBOL || node->nodeType == DATA
+         || node->nodeType == BREAK || node->nodeType == CONTINUE)
+        continue;
+      int needed = countersNeeded(node);
+      if(needed > 0){
+        node->profile = numCounters + 1;
+        numCounters += needed;
+        profileChecksum = (profileChecksum ^ node->nodeType) * 16777619u;
+      }
+      if(node->nodeType == FUNCTION){
+        const char *name = symbolName(node->fields.children.left->fields.symbol);
+        for(; *name != '\0'; name++)
+          profileChecksum = (profileChecksum ^ (unsigned char) *name) * 16777619u;
+      }
+      growArray((void **) &counterStack, &counterStackCap, depth + 3, sizeof(astnode_t *));
+      counterStack[depth++] = node->fields.children.right;
+      counterStack[depth++] = node->fields.children.middle;
+      counterStack[depth++] = node->fields.children.left;
+    }
+  }
+  setProfilePath();
+  if(profileMode == PROFILE_USE)
+    loadProfile();
+}
+
+/**
+ * loadProfile()
+ * Reads the counts of the profile file, see assignCounters(). A missing profile or one of another
+ * program is ignored with a warning.
+ *
+ * return void
+ **/
+void loadProfile(){
+  freeProfile();
+  FILE *file = fopen(profilePath, "rb");
+  if(file == NULL){
+    fprintf(stderr, "Warning: no profile %s, compiling without one.\n", profilePath);
+    return;
+  }
+  char header[PROFILE_HEADER_SIZE];
+  uint32_t checksum = 0;
+  int32_t count = 0;
+  int usable = fread(header, 1, PROFILE_HEADER_SIZE, file) == PROFILE_HEADER_SIZE;
+  if(usable){
+    memcpy(&checksum, &header[4], 4);
+    memcpy(&count, &header[8], 4);
+    usable = memcmp(header, PROFILE_MAGIC, 4) == 0 && checksum == profileChecksum && count == numCounters;
+  }
+  if(usable){
+    profileCounts = (uint64_t *) malloc((numCounters + 1)*sizeof(uint64_t));
+    if(profileCounts == NULL){
+      fprintf(stderr, "Failed to allocate space for the profile.\n");
+      exit(1);
+    }
+    usable = fread(profileCounts, sizeof(uint64_t), numCounters, file) == (size_t) numCounters;
+  }
+  fclose(file);
+  if(!usable){
+    fprintf(stderr, "Warning: profile %s is not one of this program, compiling without it.\n", profilePath);
+    freeProfile();
+    return;
+  }
+  int i;
+  for(i = 0; i < numCounters; i++){
+    if(profileCounts[i] > maxCount)
+      maxCount = profileCounts[i];
+  }
+  if(verbose)
+    fprintf(stderr, "Profile: %d counters from %s, hottest %llu\n", numCounters, profilePath, (unsigned long long) maxCount);
+}
+
+/**
+ * profileCount(astnode_t *node, int which, uint64_t *count)
+ * Looks up a count of the profile. Nodes the optimizer made have none, and copies (inlined or
+ * unrolled code) share the counts of the original.
+ *
+ * param *node - the node
+ * param which - COUNT_REACHED or COUNT_TAKEN
+ * param *count - set to the count
+ * return int - returns 1 if there is a count, 0 otherwise
+ **/
+int profileCount(astnode_t *node, int which, uint64_t *count){
+  if(profileCounts == NULL || node->profile == 0 || node->profile - 1 + which >= numCounters)
+    return 0;
+  *count = profileCounts[node->profile - 1 + which];
+  return 1;
+}
+
+/**
+ * profileHot(uint64_t count)
+ * Checks whether a count is hot, see PROFILE_HOT_FRACTION
+ *
+ * param count - the count
+ * return int - returns 1 if it is hot, 0 otherwise
+ **/
+int profileHot(uint64_t count){
+  return count > 0 && count >= maxCount / PROFILE_HOT_FRACTION;
+}
+
+/**
+ * profileCold(uint64_t count, uint64_t reached)
+ * Checks whether a branch is taken rarely enough to go out of line, see PROFILE_COLD_PERCENT
+ *
+ * param count - how often the branch was taken
+ * param reached - how often it was reached
+ * return int - returns 1 if it is cold, 0 otherwise
+ **/
+int profileCold(uint64_t count, uint64_t reached){
+  return reached > 0 && 100*count <= PROFILE_COLD_PERCENT*reached;
+}
+
+/**
+ * emitCounter(astnode_t *node, int which, FILE *outFile)
+ * Counts a node's counter up (-fprofile-generate). This changes the flags.
+ *
+ * param *node - the node
+ * param which - COUNT_REACHED or COUNT_TAKEN
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitCounter(astnode_t *node, int which, FILE *outFile){
+  if(profileMode != PROFILE_GENERATE || node->profile == 0)
+    return;
+  int offset = 8*(node->profile - 1 + which);
+  emit(outFile, " addl $1, _prof.counters+%d\n", offset);
+  emit(outFile, " adcl $0, _prof.counters+%d\n", offset + 4);
+}
+
+/**
+ * emitCounterIf(astnode_t *node, int which, FILE *outFile)
+ * Counts a node's counter up if %eax is not 0, without branching, for selects (-fprofile-generate).
+ * This changes %ecx and the flags.
+ *
+ * param *node - the node
+ * param which - COUNT_REACHED or COUNT_TAKEN
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitCounterIf(astnode_t *node, int which, FILE *outFile){
+  if(profileMode != PROFILE_GENERATE || node->profile == 0)
+    return;
+  int offset = 8*(node->profile - 1 + which);
+  emit(outFile, " cmpl $0, %%eax\n");
+  emit(outFile, " setne %%cl\n");
+  emit(outFile, " movzbl %%cl, %%ecx\n");
+  emit(outFile, " addl %%ecx, _prof.counters+%d\n", offset);
+  emit(outFile, " adcl $0, _prof.counters+%d\n", offset + 4);
+}
+
+/**
+ * emitProfileRuntime(FILE *outFile)
+ * Writes the counters of the translation unit and the code saving them at exit (-fprofile-generate)
+ *
+ * param *outFile - the file pointer to write the assembly to
+ * return void
+ **/
+void emitProfileRuntime(FILE *outFile){
+  if(profileMode != PROFILE_GENERATE || numCounters == 0)
+    return;
+  int size = PROFILE_HEADER_SIZE + 8*numCounters;
+  emit(outFile, " .data\n");
+  emit(outFile, " .p2align 3\n");
+  emit(outFile, "_prof.data:\n");
+  emit(outFile, " .ascii \"%s\"\n", PROFILE_MAGIC);
+  emit(outFile, " .long %u\n", profileChecksum);
+  emit(outFile, " .long %d\n", numCounters);
+  emit(outFile, " .long 0\n");
+  emit(outFile, "_prof.counters:\n");
+  emit(outFile, " .zero %d\n", 8*numCounters);
+  emit(outFile, "_prof.path:\n");
+  emit(outFile, " .asciz \"");
+  emitQuoted(outFile, profilePath);
+  emit(outFile, "\"\n");
+  emit(outFile, " .local _prof.scratch\n");
+  emit(outFile, " .comm _prof.scratch, %d, 8\n", size);
+  emit(outFile, " .text\n");
+  //Longer than emit() takes
+  char text[4096];
+  int len = snprintf(text, sizeof(text), dumpCode, size, size, numCounters, size, size);
+  emitText(outFile, text, len);
+}
+
+/**
+ * freeProfile()
+ * Frees the counts read by loadProfile()
+ *
+ * return void
+ **/
+void freeProfile(){
+  free(profileCounts);
+  profileCounts = NULL;
+  maxCount = 0;
+}
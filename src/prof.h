@@ -0,0 +1,44 @@
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "parse.h"
+#include <stdio.h>
+
+//Counters of a node, see assignCounters(): a FUNCTION counts its calls and a CALL how often it is
+//made; an IF, loop or short-circuit operator counts how often it is reached (COUNT_REACHED) and how
+//often it takes its then branch, runs its body or evaluates its right operand (COUNT_TAKEN)
+#define COUNT_REACHED 0
+#define COUNT_TAKEN 1
+
+//Profile file: PROFILE_MAGIC, the checksum of the program's counters, their number and padding,
+//then each counter as a 64 bit integer. Each run of the instrumented program adds its counts in.
+#define PROFILE_MAGIC "CPF1"
+#define PROFILE_HEADER_SIZE 16
+
+//With a profile, a branch taken at most PROFILE_COLD_PERCENT percent of the times it is reached goes
+//to the unlikely code, see generateIfLayout(). Code run at least 1/PROFILE_HOT_FRACTION as often as the
+//hottest counter of the program is hot: its calls may inline callees PROFILE_HOT_SCALE times bigger,
+//and its loops unroll to PROFILE_HOT_SCALE times more nodes. Calls and loops that never ran are not
+//inlined (unless tiny) or unrolled.
+#define PROFILE_COLD_PERCENT 5
+#define PROFILE_HOT_FRACTION 1000
+#define PROFILE_HOT_SCALE 2
+
+typedef enum PROFILE_MODE {PROFILE_NONE, PROFILE_GENERATE, PROFILE_USE} PROFILE_MODE;
+
+extern PROFILE_MODE profileMode;
+extern char profileOption[LEN_PATH];
+extern char profilePath[LEN_PATH];
+
+void setProfileOption(PROFILE_MODE mode, const char *path);
+void assignCounters(astnode_t *root);
+void loadProfile();
+int profileCount(astnode_t *node, int which, uint64_t *count);
+int profileHot(uint64_t count);
+int profileCold(uint64_t count, uint64_t reached);
+void emitCounter(astnode_t *node, int which, FILE *outFile);
+void emitCounterIf(astnode_t *node, int which, FILE *outFile);
+void emitProfileRuntime(FILE *outFile);
+void freeProfile();
+
+#endif // PROF_H_
@@ -0,0 +1,104 @@
+#include "ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+/**
+ * initRing(size_t capacity)
+ * Allocates an empty ring, rounding the capacity up to a power of two.
+ *
+ * param capacity - the minimum number of items the ring can hold
+ * return ring_t* - returns the newly initialized ring
+ **/
+ring_t *initRing(size_t capacity){
+  size_t size = 2;
+  while(size < capacity)
+    size <<= 1;
+  ring_t *ring = aligned_alloc(CACHE_LINE, sizeof(ring_t));
+  if(ring == NULL){
+    fprintf(stderr, "Failed to allocate space for ring.\n");
+    exit(1);
+  }
+  ring->slots = malloc(sizeof(void *) * size);
+  if(ring->slots == NULL){
+    fprintf(stderr, "Failed to allocate space for ring slots.\n");
+    exit(1);
+  }
+  ring->mask = size - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  ring->cachedTail = 0;
+  ring->cachedHead = 0;
+  return ring;
+}
+
+/**
+ * ringWait(int *spins)
+ * Backs off while waiting on the other side of the ring, spinning briefly before yielding.
+ *
+ * param *spins - the number of times the caller has waited so far
+ * return void
+ **/
+static void ringWait(int *spins){
+  if(++(*spins) < RING_SPIN_LIMIT)
+    return;
+  *spins = 0;
+  sched_yield();
+}
+
+/**
+ * ringPush(ring_t *ring, void *item)
+ * Publishes an item to the ring, waiting while it is full. Producer side only.
+ *
+ * param *ring - the ring to push to
+ * param *item - the item to push
+ * return void
+ **/
+void ringPush(ring_t *ring, void *item){
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  int spins = 0;
+  //Only re-read the consumer's index when the cached copy says the ring is full
+  while(tail - ring->cachedHead > ring->mask){
+    ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(tail - ring->cachedHead > ring->mask)
+      ringWait(&spins);
+  }
+  ring->slots[tail & ring->mask] = item;
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * ringPop(ring_t *ring)
+ * Takes the oldest item off of the ring, waiting while it is empty. Consumer side only.
+ *
+ * param *ring - the ring to pop from
+ * return void* - returns the popped item
+ **/
+void *ringPop(ring_t *ring){
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  int spins = 0;
+  //Only re-read the producer's index when the cached copy says the ring is empty
+  while(head == ring->cachedTail){
+    ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(head == ring->cachedTail)
+      ringWait(&spins);
+  }
+  void *item = ring->slots[head & ring->mask];
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return item;
+}
+
+/**
+ * freeRing(ring_t *ring)
+ * Frees the ring (not the items left in it).
+ *
+ * param *ring - the ring to free
+ * return void
+ **/
+void freeRing(ring_t *ring){
+  if(ring == NULL)
+    return;
+  free(ring->slots);
+  free(ring);
+}
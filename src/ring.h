@@ -0,0 +1,29 @@
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+//Assumed cache line size, the producer and consumer indexes live on separate lines
+#define CACHE_LINE 64
+//Spins on a full/empty ring before yielding the CPU
+#define RING_SPIN_LIMIT 128
+
+//Bounded single-producer/single-consumer lock-free ring of pointers
+typedef struct ring_t {
+  void **slots;
+  size_t mask;
+  //Written by the consumer only
+  _Alignas(CACHE_LINE) atomic_size_t head;
+  size_t cachedTail;
+  //Written by the producer only
+  _Alignas(CACHE_LINE) atomic_size_t tail;
+  size_t cachedHead;
+} ring_t;
+
+ring_t *initRing(size_t capacity);
+void ringPush(ring_t *ring, void *item);
+void *ringPop(ring_t *ring);
+void freeRing(ring_t *ring);
+
+#endif // RING_H_
@@ -0,0 +1,216 @@
+#include "scan.h"
+
+#include <immintrin.h>
+
+//Character class of every byte value (bytes >= 0x80 have no class)
+const unsigned char charClass[256] = {
+  ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE, [' '] = CC_SPACE,
+  ['0' ... '9'] = CC_DIGIT,
+  ['a' ... 'z'] = CC_ALPHA, ['A' ... 'Z'] = CC_ALPHA, ['_'] = CC_ALPHA,
+  ['!' ... '/'] = CC_OPER, [':' ... '@'] = CC_OPER, ['['] = CC_OPER, ['\\'] = CC_OPER, [']'] = CC_OPER,
+  ['^'] = CC_OPER, ['`'] = CC_OPER, ['{' ... '~'] = CC_OPER
+};
+
+SCAN_LEVEL scanLevel = SCAN_SCALAR;
+void (*classifyBlock)(const char *block, scancache_t *cache) = classifyBlockScalar;
+
+/**
+ * initScan(SCAN_LEVEL level)
+ * Selects the block classifier, using the best one the CPU supports up to the requested level.
+ *
+ * param level - the highest implementation to use, SCAN_AUTO for the best available
+ * return SCAN_LEVEL - returns the implementation selected
+ **/
+SCAN_LEVEL initScan(SCAN_LEVEL level){
+  __builtin_cpu_init();
+  if(level >= SCAN_AVX2 && __builtin_cpu_supports("avx2")){
+    scanLevel = SCAN_AVX2;
+    classifyBlock = classifyBlockAVX2;
+  }
+  else if(level >= SCAN_SSE2 && __builtin_cpu_supports("sse2")){
+    scanLevel = SCAN_SSE2;
+    classifyBlock = classifyBlockSSE2;
+  }
+  else{
+    scanLevel = SCAN_SCALAR;
+    classifyBlock = classifyBlockScalar;
+  }
+  return scanLevel;
+}
+
+/**
+ * scanLevelName(SCAN_LEVEL level)
+ * Returns the name of a scanner implementation.
+ *
+ * param level - the implementation to name
+ * return char* - returns the name of the implementation
+ **/
+char *scanLevelName(SCAN_LEVEL level){
+  switch(level){
+  case SCAN_SCALAR:
+    return "scalar";
+  case SCAN_SSE2:
+    return "sse2";
+  case SCAN_AVX2:
+    return "avx2";
+  case SCAN_AUTO:
+    return "auto";
+  }
+  return "unknown";
+}
+
+/**
+ * scanRunScalar(const char *str, size_t len, int classes, int *newlines)
+ * Returns the length of the run of characters at the start of str that belong to one of classes.
+ *
+ * param *str - the characters to scan
+ * param len - the number of characters available
+ * param classes - the CC_* classes the run is made of
+ * param *newlines - if not NULL, incremented by the number of newlines in the run
+ * return size_t - returns the length of the run
+ **/
+size_t scanRunScalar(const char *str, size_t len, int classes, int *newlines){
+  size_t i = 0;
+  while(i < len && (charClass[(unsigned char) str[i]] & classes)){
+    if(str[i] == '\n' && newlines != NULL)
+      (*newlines)++;
+    i++;
+  }
+  return i;
+}
+
+/**
+ * scanRun(scancache_t *cache, const char *str, size_t len, int classes, int *newlines)
+ * Same as scanRunScalar(), but with the vector scanners the run end is found with a bit scan of
+ * the class masks of the block holding str. Blocks are classified SCAN_BLOCK bytes at a time
+ * and kept in the cache, so the following runs in the same block cost a shift and a ctz.
+ *
+ * param *cache - the classified block, reused while str falls inside it
+ * param *str - the characters to scan
+ * param len - the number of characters available
+ * param classes - the CC_* classes the run is made of (not CC_OPER)
+ * param *newlines - if not NULL, incremented by the number of newlines in the run
+ * return size_t - returns the length of the run
+ **/
+size_t scanRun(scancache_t *cache, const char *str, size_t len, int classes, int *newlines){
+  if(scanLevel == SCAN_SCALAR)
+    return scanRunScalar(str, len, classes, newlines);
+  size_t i = 0;
+  while(1){
+    const char *pos = &str[i];
+    if(cache->block == NULL || pos < cache->block || pos >= cache->block + SCAN_BLOCK){
+      if(len - i < SCAN_BLOCK)
+        return i + scanRunScalar(pos, len - i, classes, newlines);
+      classifyBlock(pos, cache);
+    }
+    unsigned shift = pos - cache->block;
+    uint32_t mask = 0;
+    if(classes & CC_SPACE)
+      mask |= cache->space;
+    if(classes & CC_DIGIT)
+      mask |= cache->digit;
+    if(classes & CC_ALPHA)
+      mask |= cache->alpha;
+    //Bits shifted in past the end of the block read as not in class
+    uint32_t stop = ~(mask >> shift);
+    unsigned run = (stop == 0) ? SCAN_BLOCK : __builtin_ctz(stop);
+    if(newlines != NULL && (cache->newline >> shift) != 0){
+      uint32_t inRun = (run == SCAN_BLOCK) ? ~0u : (1u << run) - 1;
+      *newlines += __builtin_popcount((cache->newline >> shift) & inRun);
+    }
+    i += run;
+    if(run < SCAN_BLOCK - shift)
+      return i;
+  }
+}
+
+/**
+ * classifyBlockScalar(const char *block, scancache_t *cache)
+ * Fills the cache with the class masks of SCAN_BLOCK bytes, one byte at a time.
+ *
+ * param *block - the bytes to classify
+ * param *cache - the cache to fill
+ * return void
+ **/
+void classifyBlockScalar(const char *block, scancache_t *cache){
+  int i;
+  cache->block = block;
+  cache->space = cache->newline = cache->digit = cache->alpha = cache->oper = 0;
+  for(i = 0; i < SCAN_BLOCK; i++){
+    int classes = charClass[(unsigned char) block[i]];
+    cache->space |= (uint32_t) ((classes & CC_SPACE) != 0) << i;
+    cache->newline |= (uint32_t) (block[i] == '\n') << i;
+    cache->digit |= (uint32_t) ((classes & CC_DIGIT) != 0) << i;
+    cache->alpha |= (uint32_t) ((classes & CC_ALPHA) != 0) << i;
+    cache->oper |= (uint32_t) ((classes & CC_OPER) != 0) << i;
+  }
+}
+
+/**
+ * classify16SSE2(const char *chars, uint32_t *masks)
+ * Classifies 16 bytes, setting masks[] to the space, newline, digit, alpha and operator bitmasks.
+ * Signed compares are used, bytes >= 0x80 are negative and fall outside every range.
+ **/
+__attribute__((target("sse2")))
+static inline void classify16SSE2(const char *chars, uint32_t *masks){
+  __m128i v = _mm_loadu_si128((const __m128i *) chars);
+  __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+  __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i alpha = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                             _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1))),
+                               _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  __m128i graph = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(' ')),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+  masks[0] = _mm_movemask_epi8(space);
+  masks[1] = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+  masks[2] = _mm_movemask_epi8(digit);
+  masks[3] = _mm_movemask_epi8(alpha);
+  masks[4] = _mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(digit, alpha), graph));
+}
+
+/**
+ * classifyBlockSSE2(const char *block, scancache_t *cache)
+ * SSE2 version of classifyBlockScalar(), classifying 16 bytes per step.
+ **/
+__attribute__((target("sse2")))
+void classifyBlockSSE2(const char *block, scancache_t *cache){
+  uint32_t low[5], high[5];
+  classify16SSE2(block, low);
+  classify16SSE2(&block[16], high);
+  cache->block = block;
+  cache->space = low[0] | high[0] << 16;
+  cache->newline = low[1] | high[1] << 16;
+  cache->digit = low[2] | high[2] << 16;
+  cache->alpha = low[3] | high[3] << 16;
+  cache->oper = low[4] | high[4] << 16;
+}
+
+/**
+ * classifyBlockAVX2(const char *block, scancache_t *cache)
+ * AVX2 version of classifyBlockScalar(), classifying all 32 bytes in one step.
+ **/
+__attribute__((target("avx2")))
+void classifyBlockAVX2(const char *block, scancache_t *cache){
+  __m256i v = _mm256_loadu_si256((const __m256i *) block);
+  __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+  __m256i space = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+  __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i alpha = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower)),
+                                  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  __m256i graph = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(' ')),
+                                   _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), v));
+  cache->block = block;
+  cache->space = _mm256_movemask_epi8(space);
+  cache->newline = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+  cache->digit = _mm256_movemask_epi8(digit);
+  cache->alpha = _mm256_movemask_epi8(alpha);
+  cache->oper = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_or_si256(digit, alpha), graph));
+}
@@ -0,0 +1,42 @@
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Character classes, as bits of charClass[]
+#define CC_SPACE 0x01
+#define CC_DIGIT 0x02
+#define CC_ALPHA 0x04
+#define CC_OPER  0x08
+#define CC_IDENT (CC_DIGIT | CC_ALPHA)
+
+//Bytes classified at once by the vector scanners
+#define SCAN_BLOCK 32
+
+//Scanner implementations, in order of preference
+typedef enum SCAN_LEVEL {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2, SCAN_AUTO} SCAN_LEVEL;
+
+//Class bitmasks of the SCAN_BLOCK bytes starting at block (bit i is block[i])
+typedef struct scancache_t {
+  const char *block;
+  uint32_t space;
+  uint32_t newline;
+  uint32_t digit;
+  uint32_t alpha;
+  uint32_t oper;
+} scancache_t;
+
+extern const unsigned char charClass[256];
+extern SCAN_LEVEL scanLevel;
+extern void (*classifyBlock)(const char *block, scancache_t *cache);
+
+SCAN_LEVEL initScan(SCAN_LEVEL level);
+char *scanLevelName(SCAN_LEVEL level);
+size_t scanRun(scancache_t *cache, const char *str, size_t len, int classes, int *newlines);
+size_t scanRunScalar(const char *str, size_t len, int classes, int *newlines);
+void classifyBlockScalar(const char *block, scancache_t *cache);
+void classifyBlockSSE2(const char *block, scancache_t *cache);
+void classifyBlockAVX2(const char *block, scancache_t *cache);
+
+#endif // SCAN_H_
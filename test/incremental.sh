@@ -0,0 +1,57 @@
+#!/bin/sh
+#Regression checks of --incremental: each case is built twice with --incremental (cold, then warm
+#cache) and must give the same assembly as a full build with the same options
+#Usage: test/incremental.sh [compiler]
+compiler=$(realpath "${1:-./compiler}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+failures=0
+
+#check <name> <options...>: builds $dir/<name>.c in full and incrementally and compares the output
+check(){
+  name=$1
+  shift
+  if ! "$compiler" "$@" "$dir/$name.c" -o "$dir/$name.full.s"; then
+    echo "FAIL $name: full build failed"
+    failures=$((failures + 1))
+    return
+  fi
+  for run in cold warm; do
+    if ! "$compiler" --incremental "$@" "$dir/$name.c" -o "$dir/$name.s" || ! cmp -s "$dir/$name.s" "$dir/$name.full.s"; then
+      echo "FAIL $name: --incremental $* ($run cache) differs from the full build"
+      failures=$((failures + 1))
+      return
+    fi
+  done
+  echo "ok   $name"
+}
+
+cat > "$dir/functions.c" <<'EOF'
+int twice(int x){
+  return 2*x;
+}
+
+int main(){
+  return twice(21);
+}
+EOF
+check functions
+
+#A -D macro used without any directive in the source
+cat > "$dir/define.c" <<'EOF'
+int main(){
+  return K;
+}
+EOF
+check define -DK=3
+check define -DK=4
+
+cat > "$dir/directive.c" <<'EOF'
+#define K 5
+int main(){
+  return K;
+}
+EOF
+check directive
+
+[ "$failures" -eq 0 ]